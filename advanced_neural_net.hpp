@@ -10,6 +10,8 @@
 #include <functional>
 #include <variant>
 #include <nlohmann/json.hpp>
+#include "metrics.hpp"
+#include "write_scheduler.hpp"
 
 namespace ann {
 
@@ -215,6 +217,17 @@ private:
     bool use_layer_normalization;
     bool use_residual_connections;
     bool use_attention_mechanism;
+    
+    // Inference only; training passes are not counted
+    metrics::Histogram forward_latency = metrics::histogram("nn_forward");
+    
+    std::vector<double> forward_pass(const std::vector<double>& input) {
+        auto current = input;
+        for (auto& layer : layers) {
+            current = layer->forward(current);
+        }
+        return current;
+    }
 
 public:
     AdvancedNeuralNetwork(double lr = 0.001, double m = 0.9, double dropout = 0.2)
@@ -228,11 +241,8 @@ public:
     }
 
     std::vector<double> predict(const std::vector<double>& input) {
-        auto current = input;
-        for (auto& layer : layers) {
-            current = layer->forward(current);
-        }
-        return current;
+        metrics::ScopedTimer timer(forward_latency);
+        return forward_pass(input);
     }
 
     void train(const std::vector<std::vector<double>>& inputs,
@@ -264,7 +274,7 @@ public:
         // Forward pass
         std::vector<std::vector<double>> predictions;
         for (const auto& input : batch_inputs) {
-            predictions.push_back(predict(input));
+            predictions.push_back(forward_pass(input));
         }
         
         // Backward pass
@@ -285,7 +295,8 @@ public:
         return batch_loss / batch_inputs.size();
     }
 
-    void save(const std::string& filename) {
+    // Queued on writes as a LAZY model write when given
+    void save(const std::string& filename, persist::WriteScheduler* writes = nullptr) {
         nlohmann::json j;
         j["learning_rate"] = learning_rate;
         j["momentum"] = momentum;
@@ -299,8 +310,7 @@ public:
             j["layers"].push_back(layer->to_json());
         }
         
-        std::ofstream file(filename);
-        file << j.dump(4);
+        persist::save_file(writes, "models", filename, j.dump(4), persist::Durability::LAZY);
     }
 
     void load(const std::string& filename) {
@@ -5,39 +5,59 @@
 #include <atomic>
 #include <chrono>
 #include <queue>
+#include <unordered_map>
 #include <filesystem>
 #include "advanced_neural_net.hpp"
 #include "network_intelligence.hpp"
 #include "attack_optimizer.hpp"
 #include "ai_communication.hpp"
+#include "boot_orchestrator.hpp"
 #include "display_system.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "reactor.hpp"
+#include "energy_scheduler.hpp"
 #include "system_config.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
+#include "snapshot_writer.hpp"
 
 namespace fs = std::filesystem;
 
 class AdvancedPwnagotchi {
 private:
-    // Core components
-    std::unique_ptr<net_intel::NetworkIntelligence> intelligence;
-    std::unique_ptr<attack::AttackOptimizer> attack_optimizer;
-    std::unique_ptr<ai_comm::AICommunication> ai_comm;
-    std::unique_ptr<display::DisplaySystem> display;
+    // Core components, built by startup; their models load as they are built
+    boot::Lazy<net_intel::NetworkIntelligence> intelligence;
+    boot::Lazy<attack::AttackOptimizer> attack_optimizer;
+    boot::Lazy<ai_comm::AICommunication> ai_comm;
+    boot::Lazy<display::DisplaySystem> display;
     SystemConfig sys_config;
+    boot::Orchestrator startup;  // after the components it builds
+    runtime::Reactor& reactor = runtime::Reactor::shared();
+    runtime::TimerId intelligence_timer{0};
+    runtime::TimerId attack_timer{0};
     
     // State management
     struct State {
         bool hunting_mode;
         bool stealth_mode;
         bool learning_mode;
-        double energy_level;
-        std::chrono::system_clock::time_point last_action;
-        std::map<std::string, int> successful_handshakes;
+        timesvc::MonoTime last_action;
+        std::unordered_map<wifi::Bssid, int> successful_handshakes;
     } state;
     
     // Threading
     std::atomic<bool> running{false};
-    std::vector<std::thread> worker_threads;
+    runtime::EnergyScheduler& energy = runtime::EnergyScheduler::shared();
+    runtime::TaskHandle attack_task;  // loop thread only
+    bool attacking{false};            // a campaign is queued or running; loop thread only
     std::mutex state_mutex;
+    uint64_t displayed_table_version{0};
+    uint64_t seen_training_rounds{0};
+    
+    // state.json, written atomically with a checksummed header
+    static constexpr uint32_t STATE_VERSION = 1;
+    persist::SnapshotWriter state_writer;
     
     // Advanced features
     struct AdvancedFeatures {
@@ -56,105 +76,166 @@ private:
         std::chrono::milliseconds average_capture_time;
     } metrics;
     
-    void intelligence_loop() {
-        while (running) {
-            try {
-                process_network_data();
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            } catch (const std::exception& e) {
-                log_error("Intelligence loop error: " + std::string(e.what()));
-            }
+    // The running mean above is kept for state.json; tails show up here
+    ::metrics::Histogram attack_latency = ::metrics::histogram("attack");
+    ::metrics::Counter attacks_succeeded = ::metrics::counter("attacks_succeeded");
+    
+    static constexpr std::chrono::milliseconds INTELLIGENCE_PERIOD{100};
+    
+    // Battery charge below which no strategy starts, and below which one
+    // in progress stops
+    static constexpr double MIN_ATTACK_BATTERY = 0.2;
+    static constexpr double STOP_ATTACK_BATTERY = 0.1;
+    
+    void intelligence_tick() {
+        auto scope = energy.measure("intelligence");
+        try {
+            timesvc::tick();
+            intelligence->tick();
+            process_network_data();
+        } catch (const std::exception& e) {
+            log_error("Intelligence loop error: " + std::string(e.what()));
         }
     }
     
-    void attack_loop() {
-        while (running) {
+    static constexpr std::chrono::milliseconds ATTACK_PERIOD{500};
+    
+    // A strategy against one target, worked through an attack at a time
+    struct Campaign {
+        net_intel::AccessPoint target;
+        std::vector<attack::AttackVector> strategy;
+        size_t next{0};
+    };
+    
+    // A strategy can run for a long time, so it never holds a pool worker
+    // for more than one attack: each step hands the next back to the loop,
+    // and HIGH work such as handshake drains gets the worker in between.
+    // The next strategy is not planned until the last has finished.
+    void attack_tick() {
+        if (!running || attacking) return;
+        if (!state.hunting_mode || energy.battery_level() <= MIN_ATTACK_BATTERY) return;
+        attacking = true;
+        submit_attack_step(nullptr);
+    }
+    
+    // Loop thread only; a null campaign plans one first
+    void submit_attack_step(std::shared_ptr<Campaign> campaign) {
+        runtime::TaskSpec spec{"attack", runtime::Priority::NORMAL, {}, ATTACK_PERIOD};
+        attack_task = energy.submit(spec, [this, campaign](const runtime::CancelToken& token) mutable {
+            bool more = false;
             try {
-                if (state.hunting_mode && state.energy_level > 0.2) {
-                    execute_attack_strategy();
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                if (!campaign) campaign = plan_attack();
+                if (campaign && !token.cancelled()) more = attack_step(*campaign);
             } catch (const std::exception& e) {
                 log_error("Attack loop error: " + std::string(e.what()));
             }
-        }
+            reactor.post([this, campaign, more] {
+                if (more && running) {
+                    submit_attack_step(campaign);
+                } else {
+                    attacking = false;
+                }
+            });
+        });
     }
     
-    void communication_loop() {
-        while (running) {
-            try {
-                process_communications();
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            } catch (const std::exception& e) {
-                log_error("Communication loop error: " + std::string(e.what()));
-            }
+    // Runs on the reactor whenever ai_comm queues a message
+    void communication_ready() {
+        auto scope = energy.measure("communication");
+        try {
+            process_communications();
+        } catch (const std::exception& e) {
+            log_error("Communication loop error: " + std::string(e.what()));
         }
     }
     
     void process_network_data() {
-        std::lock_guard<std::mutex> lock(state_mutex);
-        
-        // Get potential targets
-        auto targets = intelligence->get_potential_targets();
+        // Read the published AP table without holding state_mutex
+        auto table = intelligence->get_target_table();
+        if (table && table.version() != displayed_table_version) {
+            displayed_table_version = table.version();
+            
+            // Update display
+            std::vector<display::NetworkMapWidget::NetworkNode> nodes;
+            size_t count = table->target_count();
+            nodes.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                const auto& target = *table->entries[i];
+                nodes.push_back({
+                    0, 0,  // Position will be calculated by force-directed layout
+                    target.bssid,
+                    target.ssid,
+                    target.rssi,
+                    target.is_target,
+                    target.clients
+                });
+            }
+            display->update_network_map(nodes);
+        }
         
-        // Update display
-        std::vector<display::NetworkMapWidget::NetworkNode> nodes;
-        for (const auto& target : targets) {
-            nodes.push_back({
-                0, 0,  // Position will be calculated by force-directed layout
-                target.bssid,
-                target.ssid,
-                target.rssi,
-                target.is_target,
-                target.clients
-            });
+        // Ingest pressure and training drive the CPU frequency
+        auto& cpufreq = sys_config.getCpuFreq();
+        auto load = intelligence->get_load_stats();
+        cpufreq.report_backlog(load.mode == net_intel::ShedMode::FULL ? load.utilization : 1.0);
+        uint64_t rounds = intelligence->get_training_rounds();
+        if (rounds != seen_training_rounds) {
+            seen_training_rounds = rounds;
+            cpufreq.report_training();
         }
-        display->update_network_map(nodes);
         
         // Update metrics
+        std::lock_guard<std::mutex> lock(state_mutex);
         metrics.packets_processed++;
     }
     
-    void execute_attack_strategy() {
-        std::lock_guard<std::mutex> lock(state_mutex);
-        
-        // Get targets from intelligence
+    std::shared_ptr<Campaign> plan_attack() {
         auto targets = intelligence->get_potential_targets();
-        if (targets.empty()) return;
+        if (targets.empty()) return nullptr;
         
         // Get optimized attack strategy
-        auto strategy = attack_optimizer->optimize_strategy(targets[0]);
+        auto campaign = std::make_shared<Campaign>();
+        campaign->target = targets[0];
+        campaign->strategy = attack_optimizer->optimize_strategy(campaign->target);
+        return campaign;
+    }
+    
+    // Runs the campaign's next attack; false once there is none left to run
+    bool attack_step(Campaign& campaign) {
+        if (campaign.next >= campaign.strategy.size()) return false;
+        if (!running || energy.battery_level() < STOP_ATTACK_BATTERY) return false;
+        auto& attack = campaign.strategy[campaign.next++];
+        const auto& target = campaign.target;
         
-        // Execute strategy
-        for (const auto& attack : strategy) {
-            if (!running || state.energy_level < 0.1) break;
-            
-            // Apply stealth modifications if needed
-            if (state.stealth_mode) {
-                modify_attack_for_stealth(attack);
-            }
-            
-            // Execute attack
-            bool success = execute_attack(attack, targets[0]);
-            
-            // Update metrics and learning
-            if (success) {
-                metrics.successful_attacks++;
-                metrics.handshakes_captured++;
-                state.successful_handshakes[targets[0].bssid]++;
-            }
-            
-            // Update attack optimizer
-            attack_optimizer->update_strategy(attack, success, targets[0].bssid);
-            
-            // Update energy level
-            state.energy_level -= attack.energy_cost;
+        std::lock_guard<std::mutex> lock(state_mutex);
+        
+        // Apply stealth modifications if needed
+        if (state.stealth_mode) {
+            modify_attack_for_stealth(attack);
         }
+        
+        // Execute attack
+        bool success = execute_attack(attack, target);
+        
+        // Update metrics and learning
+        if (success) {
+            metrics.successful_attacks++;
+            metrics.handshakes_captured++;
+            state.successful_handshakes[target.bssid]++;
+        }
+        
+        // Update attack optimizer
+        attack_optimizer->update_strategy(attack, success, target.bssid);
+        return campaign.next < campaign.strategy.size();
     }
     
     void process_communications() {
-        auto msg = ai_comm->receive_message();
-        ai_comm->process_message(msg);
+        ::ai_comm::Message msg;
+        bool any = false;
+        while (ai_comm->try_receive_message(msg)) {
+            ai_comm->process_message(msg);
+            any = true;
+        }
+        if (!any) return;
         
         // Update display with new status
         std::string status = generate_status_message();
@@ -174,15 +255,17 @@ private:
     bool execute_attack(const attack::AttackVector& attack,
                        const net_intel::AccessPoint& target) {
         // Implement actual attack execution
-        auto start_time = std::chrono::high_resolution_clock::now();
+        auto start_time = timesvc::precise_now();
         
         // Simulate attack success (replace with actual implementation)
         bool success = (std::rand() % 100) < (attack.success_rate * 100);
         
-        auto end_time = std::chrono::high_resolution_clock::now();
+        auto end_time = timesvc::precise_now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
             end_time - start_time
         );
+        attack_latency.record(end_time - start_time);
+        if (success) attacks_succeeded.add();
         
         // Update metrics
         metrics.average_capture_time = std::chrono::milliseconds(
@@ -196,73 +279,138 @@ private:
     std::string generate_status_message() {
         std::stringstream ss;
         ss << "Mode: " << (state.hunting_mode ? "Hunting" : "Passive") << "\n"
-           << "Energy: " << static_cast<int>(state.energy_level * 100) << "%\n"
+           << "Battery: " << static_cast<int>(energy.battery_level() * 100) << "%\n"
            << "Handshakes: " << metrics.handshakes_captured << "\n"
            << "Success Rate: " << static_cast<int>(metrics.average_success_rate * 100) << "%";
+        
+        auto load = intelligence->get_load_stats();
+        ss << "\nIngest: " << net_intel::to_string(load.mode)
+           << " (" << static_cast<int>(load.shed_rate * 100) << "% shed)";
+        
+        auto usage = energy.stats();
+        ss << "\nCPU: " << static_cast<int>(usage.cpu_seconds) << "s (~"
+           << static_cast<int>(usage.energy_mah) << " mAh)";
+        if (usage.constrained) ss << ", " << usage.deferred << " held (" << usage.reason << ")";
         return ss.str();
     }
     
     void log_error(const std::string& error) {
-        // Implement error logging
-        std::cerr << "Error: " << error << std::endl;
+        logging::error("{}", error);
     }
 
 public:
     AdvancedPwnagotchi()
-        : state{true, false, true, 1.0,
-                std::chrono::system_clock::now(),
-                std::map<std::string, int>()},
+        : state{true, false, true,
+                timesvc::coarse_now(),
+                std::unordered_map<wifi::Bssid, int>()},
           features{true, true, true, true},
           metrics{0, 0, 0, 0.0, std::chrono::milliseconds(0)} {
         
-        // Initialize components
-        intelligence = std::make_unique<net_intel::NetworkIntelligence>();
-        attack_optimizer = std::make_unique<attack::AttackOptimizer>();
-        ai_comm = std::make_unique<ai_comm::AICommunication>();
+        // The display is declared first since it gates the first frame; the
+        // models build alongside it, the attack optimizer on first attack
+        const fs::path models = sys_config.getPaths().models;
+        display.bind(startup, "display", {}, boot::Start::EAGER, [this] {
+            display::DisplayMetrics metrics{800, 480, 96, 1.0, true, false};
+            display::Theme theme{
+                {0, 0, 0, 255},      // background
+                {255, 255, 255, 255}, // text_primary
+                {200, 200, 200, 255}, // text_secondary
+                {0, 255, 0, 255},     // accent
+                {255, 0, 0, 255},     // warning
+                {0, 255, 0, 255},     // success
+                10, 5,                // padding, margin
+                "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+                14                    // font_size
+            };
+            auto system = std::make_unique<display::DisplaySystem>(metrics, theme);
+            system->set_first_frame_hook([this] { startup.mark("first_frame"); });
+            return system;
+        });
+        intelligence.bind(startup, "intelligence", {}, boot::Start::EAGER, [models] {
+            auto component = std::make_unique<net_intel::NetworkIntelligence>();
+            component->load_models(models / "intelligence");
+            return component;
+        });
+        ai_comm.bind(startup, "ai_comm", {}, boot::Start::EAGER, [models] {
+            auto component = std::make_unique<ai_comm::AICommunication>();
+            component->load_models(models / "communication");
+            return component;
+        });
+        attack_optimizer.bind(startup, "attack_optimizer", {}, boot::Start::ON_DEMAND, [models] {
+            auto component = std::make_unique<attack::AttackOptimizer>();
+            component->load_models(models / "attacks");
+            return component;
+        });
+        startup.run();
         
-        // Initialize display
-        display::DisplayMetrics metrics{800, 480, 96, 1.0, true, false};
-        display::Theme theme{
-            {0, 0, 0, 255},      // background
-            {255, 255, 255, 255}, // text_primary
-            {200, 200, 200, 255}, // text_secondary
-            {0, 255, 0, 255},     // accent
-            {255, 0, 0, 255},     // warning
-            {0, 255, 0, 255},     // success
-            10, 5,                // padding, margin
-            "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
-            14                    // font_size
-        };
-        display = std::make_unique<display::DisplaySystem>(metrics, theme);
+        state_writer.open(sys_config.getPaths().models / "state.json", STATE_VERSION);
+        state_writer.set_scheduler(&sys_config.getWriteScheduler(), "state",
+                                   persist::Durability::NORMAL);
     }
     
     void start() {
         running = true;
         
-        // Start display
-        display->start();
+        // Rendering starts as soon as the display is built
+        startup.on_ready("display", [this] {
+            reactor.post([this] {
+                if (running) display.peek()->start();
+            });
+        });
         
-        // Start worker threads
-        worker_threads.emplace_back(&AdvancedPwnagotchi::intelligence_loop, this);
-        worker_threads.emplace_back(&AdvancedPwnagotchi::attack_loop, this);
-        worker_threads.emplace_back(&AdvancedPwnagotchi::communication_loop, this);
+        // Network data and attacks on timers, messages as they arrive. The
+        // process loop is shared, so nothing goes on it until startup has
+        // built the components the handlers use.
+        startup.on_complete([this] {
+            reactor.post([this] {
+                if (!running) return;
+                startup.report();
+                intelligence_timer = reactor.add_periodic(INTELLIGENCE_PERIOD, [this] { intelligence_tick(); });
+                attack_timer = reactor.add_periodic(ATTACK_PERIOD, [this] { attack_tick(); });
+                if (auto* component = ai_comm.peek()) {
+                    component->set_message_hook([this] {
+                        reactor.post([this] { communication_ready(); });
+                    });
+                    communication_ready();
+                }
+            });
+        });
     }
     
     void stop() {
         running = false;
+        startup.join();  // boot has handed over to the loop
+        runtime::TaskHandle attack;
+        reactor.call([this, &attack] {
+            for (auto id : {intelligence_timer, attack_timer}) reactor.cancel_timer(id);
+            if (auto* component = ai_comm.peek()) component->set_message_hook(nullptr);
+            attack = attack_task;
+        });
         
-        // Stop display
-        display->stop();
+        // An attack in progress finishes; the step it hands back to the
+        // loop sees running cleared and ends the campaign
+        if (!attack.cancel()) attack.wait();
+        reactor.call([] {});
         
-        // Join worker threads
-        for (auto& thread : worker_threads) {
-            if (thread.joinable()) {
-                thread.join();
-            }
-        }
+        // Stop display
+        if (auto* system = display.peek()) system->stop();
         
         // Save state and models
         save_state();
+        energy.log_report();
+    }
+    
+    boot::Timeline get_boot_timeline() const {
+        return startup.timeline();
+    }
+    
+    runtime::ReactorStats get_reactor_stats() const {
+        return reactor.stats();
+    }
+    
+    // Measured CPU time and estimated energy, per subsystem
+    runtime::EnergyStats get_energy_stats() const {
+        return energy.stats();
     }
     
     void set_hunting_mode(bool enabled) {
@@ -282,9 +430,18 @@ public:
     
     void save_state() {
         // Save neural network models
-        intelligence->save_models(sys_config.getPaths().models / "intelligence");
-        attack_optimizer->save_models(sys_config.getPaths().models / "attacks");
-        ai_comm->save_models(sys_config.getPaths().models / "communication");
+        // Models are large and cheap to lose; they go out with the next lazy flush.
+        // Components never built hold nothing newer than what is on disk.
+        auto& writes = sys_config.getWriteScheduler();
+        if (auto* component = intelligence.peek()) {
+            component->save_models(sys_config.getPaths().models / "intelligence", &writes);
+        }
+        if (auto* component = attack_optimizer.peek()) {
+            component->save_models(sys_config.getPaths().models / "attacks", &writes);
+        }
+        if (auto* component = ai_comm.peek()) {
+            component->save_models(sys_config.getPaths().models / "communication", &writes);
+        }
         
         // Save metrics and state
         nlohmann::json j;
@@ -295,30 +452,42 @@ public:
             {"average_success_rate", metrics.average_success_rate},
             {"average_capture_time", metrics.average_capture_time.count()}
         };
+        std::map<std::string, int> handshakes_by_bssid;
+        for (const auto& [bssid, count] : state.successful_handshakes) {
+            handshakes_by_bssid[bssid.str()] = count;
+        }
         j["state"] = {
             {"hunting_mode", state.hunting_mode},
             {"stealth_mode", state.stealth_mode},
             {"learning_mode", state.learning_mode},
-            {"energy_level", state.energy_level},
-            {"successful_handshakes", state.successful_handshakes}
+            {"successful_handshakes", handshakes_by_bssid}
         };
         
-        std::ofstream file(sys_config.getPaths().models / "state.json");
-        file << j.dump(4);
+        // Skipped when nothing changed since the last save
+        std::string text = j.dump(4);
+        state_writer.submit(std::vector<uint8_t>(text.begin(), text.end()));
+        if (!state_writer.flush()) {
+            log_error("Failed to save state to " + state_writer.get_path().string());
+        }
     }
     
+    // Models load as startup builds each component
     void load_state() {
-        // Load neural network models
-        intelligence->load_models(sys_config.getPaths().models / "intelligence");
-        attack_optimizer->load_models(sys_config.getPaths().models / "attacks");
-        ai_comm->load_models(sys_config.getPaths().models / "communication");
-        
         // Load metrics and state
-        std::ifstream file(sys_config.getPaths().models / "state.json");
-        if (file) {
-            nlohmann::json j;
-            file >> j;
-            
+        std::vector<uint8_t> payload;
+        auto status = state_writer.load(payload);
+        nlohmann::json j;
+        if (status == persist::LoadStatus::OK) {
+            j = nlohmann::json::parse(payload.begin(), payload.end(), nullptr, false);
+        } else if (status == persist::LoadStatus::NOT_SNAPSHOT) {
+            // Plain JSON written before snapshots had a header
+            std::ifstream file(state_writer.get_path());
+            j = nlohmann::json::parse(file, nullptr, false);
+        } else if (status != persist::LoadStatus::MISSING) {
+            log_error("Ignoring saved state: " + std::string(persist::to_string(status)));
+        }
+        
+        if (j.is_object()) {
             metrics.packets_processed = j["metrics"]["packets_processed"];
             metrics.handshakes_captured = j["metrics"]["handshakes_captured"];
             metrics.successful_attacks = j["metrics"]["successful_attacks"];
@@ -330,9 +499,15 @@ public:
             state.hunting_mode = j["state"]["hunting_mode"];
             state.stealth_mode = j["state"]["stealth_mode"];
             state.learning_mode = j["state"]["learning_mode"];
-            state.energy_level = j["state"]["energy_level"];
-            state.successful_handshakes = j["state"]["successful_handshakes"]
+            state.successful_handshakes.clear();
+            auto handshakes_by_bssid = j["state"]["successful_handshakes"]
                 .get<std::map<std::string, int>>();
+            for (const auto& [text, count] : handshakes_by_bssid) {
+                wifi::Bssid bssid;
+                if (wifi::Bssid::parse(text, bssid)) {
+                    state.successful_handshakes[bssid] = count;
+                }
+            }
         }
     }
 };
@@ -4,6 +4,7 @@
 #include <vector>
 #include <queue>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -11,6 +12,8 @@
 #include <functional>
 #include <nlohmann/json.hpp>
 #include "advanced_neural_net.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
 
 namespace ai_comm {
 
@@ -33,6 +36,7 @@ private:
     std::queue<Message> message_queue;
     std::mutex queue_mutex;
     std::condition_variable queue_cv;
+    std::function<void()> message_hook;
     
     // Personality traits
     struct Personality {
@@ -53,8 +57,8 @@ private:
     // Context memory
     struct ContextMemory {
         std::vector<Message> short_term;
-        std::map<std::string, std::vector<Message>> long_term;
-        std::map<std::string, double> interaction_scores;
+        std::unordered_map<wifi::PeerId, std::vector<Message>> long_term;
+        std::unordered_map<wifi::PeerId, double> interaction_scores;
     } context;
     
     // Advanced features
@@ -90,7 +94,7 @@ private:
         features.push_back(calculate_complexity(msg.content));
         
         // Context features
-        features.push_back(context.interaction_scores[msg.sender]);
+        features.push_back(interaction_score(msg.sender));
         features.push_back(context.short_term.size());
         
         // Emotional state features
@@ -101,6 +105,12 @@ private:
         return features;
     }
     
+    // Looks up without interning, so reading a score never adds a peer
+    double interaction_score(const std::string& sender) const {
+        auto it = context.interaction_scores.find(wifi::Interner::instance().find(sender));
+        return it == context.interaction_scores.end() ? 0.0 : it->second;
+    }
+    
     void adjust_response(std::vector<double>& response) {
         // Apply personality traits
         for (auto& value : response) {
@@ -167,18 +177,41 @@ public:
     }
     
     void send_message(const Message& msg) {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        message_queue.push(msg);
-        queue_cv.notify_one();
-        
-        // Update context
-        context.short_term.push_back(msg);
-        if (context.short_term.size() > 100) {
-            context.short_term.erase(context.short_term.begin());
+        std::function<void()> hook;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            message_queue.push(msg);
+            queue_cv.notify_one();
+            hook = message_hook;
+            
+            // Update context
+            context.short_term.push_back(msg);
+            if (context.short_term.size() > 100) {
+                context.short_term.erase(context.short_term.begin());
+            }
+            
+            // Update interaction score; senders beyond the interner's cap are not tracked
+            wifi::PeerId peer = wifi::intern(msg.sender);
+            if (peer != wifi::NO_PEER) {
+                context.interaction_scores[peer] += 0.1;
+            }
         }
-        
-        // Update interaction score
-        context.interaction_scores[msg.sender] += 0.1;
+        if (hook) hook();
+    }
+    
+    // Called after each send_message, outside the queue lock, so an event
+    // loop can drain with try_receive_message instead of blocking
+    void set_message_hook(std::function<void()> hook) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        message_hook = std::move(hook);
+    }
+    
+    bool try_receive_message(Message& out) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (message_queue.empty()) return false;
+        out = std::move(message_queue.front());
+        message_queue.pop();
+        return true;
     }
     
     Message receive_message() {
@@ -206,7 +239,7 @@ public:
             response_text,
             "AI",
             msg.sender,
-            std::chrono::system_clock::now().time_since_epoch().count(),
+            timesvc::to_unix_millis(timesvc::coarse_wall_now()),
             {{"type", "response"}}
         };
         
@@ -250,10 +283,10 @@ public:
     }
     
     // Save and load models
-    void save_models(const std::string& prefix) {
-        language_model->save(prefix + "_language.model");
-        sentiment_analyzer->save(prefix + "_sentiment.model");
-        intent_classifier->save(prefix + "_intent.model");
+    void save_models(const std::string& prefix, persist::WriteScheduler* writes = nullptr) {
+        language_model->save(prefix + "_language.model", writes);
+        sentiment_analyzer->save(prefix + "_sentiment.model", writes);
+        intent_classifier->save(prefix + "_intent.model", writes);
         
         // Save personality and emotional state
         nlohmann::json j;
@@ -270,8 +303,8 @@ public:
             {"satisfaction", emotional_state.satisfaction}
         };
         
-        std::ofstream file(prefix + "_state.json");
-        file << j.dump(4);
+        persist::save_file(writes, "models", prefix + "_state.json", j.dump(4),
+                           persist::Durability::LAZY);
     }
     
     void load_models(const std::string& prefix) {
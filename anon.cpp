@@ -1,8 +1,13 @@
 #include "anon_core.hpp"
+#include "cpufreq_controller.hpp"
 #include "display_system.hpp"
 #include "mesh_network.hpp"
 #include "handshake_processor.hpp"
 #include "personality_module.hpp"
+#include "logger.hpp"
+#include "metrics_export.hpp"
+#include "energy_scheduler.hpp"
+#include "write_scheduler.hpp"
 #include <signal.h>
 #include <thread>
 #include <iostream>
@@ -22,30 +27,59 @@ int main() {
         signal(SIGINT, signal_handler);
         signal(SIGTERM, signal_handler);
 
+        // All card writes go through one scheduler; it outlives its users
+        persist::WriteScheduler writes;
+        writes.start();
+
+        std::filesystem::create_directories("/opt/anon/logs");
+        logging::Config log_config;
+        log_config.path = "/opt/anon/logs/anon.log";
+        log_config.writes = &writes;
+        logging::Session log_session(log_config);
+
         // Initialize core components
         g_anon = std::make_unique<anon::AnonCore>();
         auto display = std::make_unique<anon::DisplaySystem>();
         auto mesh = std::make_unique<anon::MeshNetwork>();
-        auto processor = std::make_unique<anon::HandshakeProcessor>();
+        auto processor = std::make_unique<anon::HandshakeProcessor>(&writes);
         auto personality = std::make_unique<anon::PersonalityModule>();
 
-        // Start mesh networking in background
-        std::thread mesh_thread([&]() {
+        // Clock all cores to handshake backlog, battery and temperature
+        power::CpuFreqController cpufreq;
+        cpufreq.attach(&g_anon->get_telemetry());
+        cpufreq.start();
+
+        // Training, compression and cleanup wait out low battery and heat
+        auto& energy = runtime::EnergyScheduler::shared();
+        energy.attach(&g_anon->get_telemetry());
+
+        // Stage latencies on /run/anon/metrics.sock and metrics.txt
+        metrics::Exporter exporter;
+        metrics::Exporter::Config export_config;
+        export_config.socket_path = "/run/anon/metrics.sock";
+        export_config.file_path = "/run/anon/metrics.txt";
+        if (!exporter.start(export_config)) logging::warn("Metrics export unavailable");
+
+        // Mesh setup waits on netlink, so it runs on the pool
+        auto& tasks = runtime::TaskPool::shared();
+        auto mesh_start = tasks.submit(runtime::Priority::NORMAL, [&]() {
             mesh->start();
         });
 
-        // Start handshake processing in background
-        std::thread processor_thread([&]() {
-            processor->start();
-        });
+        // Start handshake processing; batches are drained on the pool
+        processor->start();
 
         // Start personality module
         personality->bind_to_core(g_anon.get());
 
         // Main loop
         while (g_running) {
+            timesvc::tick();
+            auto scope = energy.measure("main_loop");
+            
             // Update AI state
             g_anon->update();
+            cpufreq.report_backlog(processor->get_queue_fill());
             
             // Update display
             display->update(g_anon->get_status());
@@ -69,11 +103,15 @@ int main() {
             );
         }
 
-        // Clean shutdown
+        // Clean shutdown; captures already queued are still written, other
+        // background work still queued is dropped
+        mesh_start.wait();
         mesh->stop();
         processor->stop();
-        mesh_thread.join();
-        processor_thread.join();
+        energy.attach(nullptr);
+        energy.log_report();
+        exporter.stop();
+        tasks.shutdown(runtime::TaskPool::Shutdown::CANCEL);
         
         return 0;
     }
@@ -6,19 +6,26 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <unordered_map>
+#include "channel_scheduler.hpp"
+#include "nl80211_client.hpp"
+#include "power_telemetry.hpp"
 #include "stealth_system.hpp"
+#include "timing_wheel.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
 #include "advanced_neural_net.hpp"
 
 namespace anon {
 
 struct WiFiTarget {
-    std::string essid;
-    std::string bssid;
+    wifi::Ssid essid;
+    wifi::Bssid bssid;
     int8_t signal_strength;
     uint16_t channel;
     bool has_pmkid;
     bool has_handshake;
-    std::chrono::system_clock::time_point last_seen;
+    timesvc::MonoTime last_seen;
 };
 
 class AnonCore {
@@ -45,6 +52,11 @@ private:
     // Target management
     std::vector<WiFiTarget> known_targets;
     std::vector<WiFiTarget> priority_targets;
+    std::unordered_map<wifi::Bssid, size_t> target_index;  // bssid -> known_targets slot
+    
+    // Target expiry
+    expiry::TimingWheel<wifi::Bssid> expiry_wheel;
+    expiry::StoreId target_store;
     
     // Attack stats
     struct {
@@ -62,6 +74,17 @@ private:
         uint32_t uptime_seconds;
         int8_t temperature;
     } power_state;
+    
+    // Channel, TX power and interface control over netlink
+    static constexpr const char* MONITOR_IFACE = "wlan1mon";
+    netlink::Nl80211 radio;
+    
+    // Picks the next channel and its dwell from recent discoveries
+    channel::ChannelScheduler channels;
+    
+    // Battery and thermal readings, sampled in the background
+    power::Telemetry telemetry;
+    int8_t applied_wifi_power{0};  // last TX power set over nl80211
 
     // Channel hopping
     void hop_channels() {
@@ -70,15 +93,12 @@ private:
             std::this_thread::sleep_for(std::chrono::milliseconds(500));
         }
         
-        auto timing = stealth->get_next_timing_window();
-        hardware_state.current_channel = (hardware_state.current_channel % 14) + 1;
+        auto visit = channels.next(timesvc::precise_now());
+        hardware_state.current_channel = visit.channel;
         
-        // Set channel using iw command
-        std::string cmd = "iw dev wlan1mon set channel " + 
-                         std::to_string(hardware_state.current_channel);
-        system(cmd.c_str());
+        radio.set_channel(MONITOR_IFACE, hardware_state.current_channel);
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(timing));
+        std::this_thread::sleep_for(visit.dwell);
     }
     
     // Target selection
@@ -103,7 +123,7 @@ private:
         // Factors to consider
         float signal_factor = (target.signal_strength + 100) / 100.0f;
         float time_factor = std::chrono::duration_cast<std::chrono::minutes>(
-            std::chrono::system_clock::now() - target.last_seen).count();
+            timesvc::coarse_now() - target.last_seen).count();
         time_factor = 1.0f / (1.0f + time_factor);
         
         // Neural network input
@@ -125,7 +145,9 @@ public:
         power_state{100.0f, false, 0, 25} {
         
         initialize_neural_networks();
+        target_store = expiry_wheel.add_store("targets", std::chrono::hours(24));
         stealth = std::make_unique<stealth::LightweightStealthSystem>();
+        telemetry.start();
     }
     
     void initialize_neural_networks() {
@@ -144,13 +166,14 @@ public:
     
     void start() {
         // Initialize WiFi interface in monitor mode
-        system("ip link set wlan1 down");
-        system("iw dev wlan1 set type monitor");
-        system("ip link set wlan1 name wlan1mon");
-        system("ip link set wlan1mon up");
+        radio.set_link("wlan1", false);
+        radio.set_type("wlan1", netlink::IfType::MONITOR);
+        radio.rename("wlan1", MONITOR_IFACE);
+        radio.set_link(MONITOR_IFACE, true);
         
         // Main loop
         while (true) {
+            timesvc::tick();
             update_power_state();
             hop_channels();
             scan_for_targets();
@@ -169,19 +192,13 @@ public:
     }
     
     void update_power_state() {
-        // Read battery level
-        std::ifstream power_supply("/sys/class/power_supply/battery/capacity");
-        if (power_supply) {
-            power_supply >> power_state.battery_level;
-        }
-        
-        // Read temperature
-        std::ifstream temp("/sys/class/thermal/thermal_zone0/temp");
-        if (temp) {
-            int temp_millicelsius;
-            temp >> temp_millicelsius;
-            power_state.temperature = temp_millicelsius / 1000;
-        }
+        // Latest sampled values; missing attributes keep the previous reading
+        power_state.battery_level = static_cast<float>(
+            telemetry.get(power::Metric::BATTERY_PERCENT,
+                          static_cast<int64_t>(power_state.battery_level)));
+        power_state.temperature = static_cast<int8_t>(
+            telemetry.get(power::Metric::CPU_TEMPERATURE,
+                          power_state.temperature * 1000) / 1000);
         
         // Update power mode
         power_state.low_power_mode = (power_state.battery_level < 20.0f || 
@@ -193,10 +210,11 @@ public:
             hardware_state.wifi_power = -10; // Normal power
         }
         
-        // Set WiFi TX power
-        std::string cmd = "iw dev wlan1mon set txpower fixed " + 
-                         std::to_string(hardware_state.wifi_power * 100);
-        system(cmd.c_str());
+        // Set WiFi TX power, only when it changes
+        if (hardware_state.wifi_power != applied_wifi_power) {
+            radio.set_tx_power(MONITOR_IFACE, hardware_state.wifi_power * 100);
+            applied_wifi_power = hardware_state.wifi_power;
+        }
     }
     
     void scan_for_targets() {
@@ -205,22 +223,41 @@ public:
         // and process them for targets
     }
     
+    // Adds a target or refreshes one we already know
+    void observe_target(const WiFiTarget& target) {
+        channels.on_frame(target.bssid, timesvc::coarse_now());
+        auto [it, inserted] = target_index.try_emplace(target.bssid, known_targets.size());
+        if (inserted) {
+            known_targets.push_back(target);
+        } else {
+            known_targets[it->second] = target;
+        }
+        expiry_wheel.touch(target_store, target.bssid, timesvc::coarse_now());
+    }
+    
+    void set_target_ttl(timesvc::MonoClock::duration ttl) {
+        expiry_wheel.set_ttl(target_store, ttl);
+    }
+    
+    uint64_t get_expired_target_count() const {
+        return expiry_wheel.expired_count(target_store);
+    }
+    
     void process_targets() {
-        auto now = std::chrono::system_clock::now();
-        
-        // Remove old targets
-        known_targets.erase(
-            std::remove_if(
-                known_targets.begin(),
-                known_targets.end(),
-                [&](const WiFiTarget& target) {
-                    auto age = std::chrono::duration_cast<std::chrono::hours>(
-                        now - target.last_seen).count();
-                    return age > 24; // Remove targets not seen in 24 hours
+        // Drop targets whose TTL ran out; only expiring entries are visited
+        expiry_wheel.advance(timesvc::coarse_now(),
+            [this](expiry::StoreId, const wifi::Bssid& bssid) {
+                auto it = target_index.find(bssid);
+                if (it == target_index.end()) return;
+                
+                size_t slot = it->second;
+                target_index.erase(it);
+                if (slot != known_targets.size() - 1) {
+                    known_targets[slot] = std::move(known_targets.back());
+                    target_index[known_targets[slot].bssid] = slot;
                 }
-            ),
-            known_targets.end()
-        );
+                known_targets.pop_back();
+            });
         
         // Update priority targets
         priority_targets.clear();
@@ -291,6 +328,9 @@ public:
     // Status getters
     const auto& get_stats() const { return stats; }
     const auto& get_power_state() const { return power_state; }
+    const power::Telemetry& get_telemetry() const { return telemetry; }
+    netlink::ClientStats get_radio_stats() { return radio.stats(); }
+    std::vector<channel::ChannelStats> get_channel_stats() const { return channels.stats(); }
     const auto& get_known_targets() const { return known_targets; }
     const std::string& get_name() const { return name; }
 };
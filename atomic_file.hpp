@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Whole-file replacement that survives power loss: the new contents go to a
+// temp file, which is fsynced and renamed over the old one before the
+// directory is fsynced, so the path holds either the old or the new file.
+namespace persist {
+
+namespace detail {
+    inline bool write_all(int fd, const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = ::write(fd, data, length);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+// Makes a rename or unlink in dir durable
+inline void sync_directory(const std::filesystem::path& dir) {
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// Replaces path with the given chunks (written back to back) atomically.
+// With durable unset the fsyncs are skipped: the rename still never exposes
+// a partial file, but a crash may bring back the previous contents.
+inline bool write_file_atomic(const std::filesystem::path& path,
+                              std::initializer_list<std::pair<const void*, size_t>> chunks,
+                              bool durable = true) {
+    auto temp_path = path;
+    temp_path += ".tmp";
+
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = true;
+    for (const auto& [data, length] : chunks) {
+        if (!detail::write_all(fd, static_cast<const uint8_t*>(data), length)) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && (!durable || ::fsync(fd) == 0);
+    ok = (::close(fd) == 0) && ok;
+
+    if (!ok || ::rename(temp_path.c_str(), path.c_str()) != 0) {
+        ::unlink(temp_path.c_str());
+        return false;
+    }
+    if (durable) sync_directory(path.parent_path());
+    return true;
+}
+
+inline bool write_file_atomic(const std::filesystem::path& path, const void* data, size_t length,
+                              bool durable = true) {
+    return write_file_atomic(path, {{data, length}}, durable);
+}
+
+} // namespace persist
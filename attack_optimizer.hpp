@@ -2,12 +2,15 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <random>
 #include <algorithm>
 #include <chrono>
 #include "advanced_neural_net.hpp"
 #include "network_intelligence.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
 
 namespace attack {
 
@@ -39,7 +42,7 @@ private:
     
     // Attack vectors and their effectiveness
     std::map<AttackVector::Type, std::vector<double>> attack_history;
-    std::map<std::string, std::vector<AttackVector>> ap_specific_strategies;
+    std::unordered_map<wifi::Bssid, std::vector<AttackVector>> ap_specific_strategies;
     
     // Environmental factors
     struct Environment {
@@ -47,7 +50,7 @@ private:
         double channel_utilization;
         double client_density;
         double interference_level;
-        std::chrono::system_clock::time_point time_of_day;
+        timesvc::WallTime time_of_day;
     } env;
     
     // Reinforcement learning parameters
@@ -96,7 +99,7 @@ private:
         attack.prerequisites = {"hostapd", "dnsmasq"};
         
         // Configure attack parameters based on target
-        attack.parameters["ssid"] = target.ssid;
+        attack.parameters["ssid"] = target.ssid.str();
         attack.parameters["channel"] = std::to_string(target.channel);
         attack.parameters["power"] = std::to_string(std::min(20, -target.rssi));  // Match power to avoid detection
         
@@ -132,7 +135,7 @@ private:
     
     void update_environment() {
         // Update environmental factors based on observations
-        env.time_of_day = std::chrono::system_clock::now();
+        env.time_of_day = timesvc::coarse_wall_now();
         
         // Calculate noise level from recent measurements
         std::normal_distribution<> noise_dist(0.3, 0.1);
@@ -225,7 +228,7 @@ public:
     }
     
     void update_strategy(const AttackVector& attack, bool success, 
-                        const std::string& target_bssid) {
+                        const wifi::Bssid& target_bssid) {
         // Update attack history
         attack_history[attack.type].push_back(success ? 1.0 : 0.0);
         
@@ -268,10 +271,10 @@ public:
     }
     
     // Save and load models
-    void save_models(const std::string& prefix) {
-        strategy_optimizer->save(prefix + "_strategy.model");
-        timing_predictor->save(prefix + "_timing.model");
-        success_estimator->save(prefix + "_success.model");
+    void save_models(const std::string& prefix, persist::WriteScheduler* writes = nullptr) {
+        strategy_optimizer->save(prefix + "_strategy.model", writes);
+        timing_predictor->save(prefix + "_timing.model", writes);
+        success_estimator->save(prefix + "_success.model", writes);
         
         // Save Q-table and parameters
         nlohmann::json j;
@@ -279,8 +282,8 @@ public:
         j["learning_rate"] = rl_params.learning_rate;
         j["exploration_rate"] = rl_params.exploration_rate;
         
-        std::ofstream file(prefix + "_rl.json");
-        file << j.dump(4);
+        persist::save_file(writes, "models", prefix + "_rl.json", j.dump(4),
+                           persist::Durability::LAZY);
     }
     
     void load_models(const std::string& prefix) {
@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include "logger.hpp"
+
+// Startup orchestration. Components are declared with their dependencies
+// and either started during boot, concurrently on a few worker threads as
+// soon as their dependencies are ready, or left until first use. Every
+// start is timed against CLOCK_BOOTTIME, so the timeline reads as time
+// since power-on and shows where the path to the first frame goes.
+namespace boot {
+
+// Time since the kernel started, counting suspend
+inline std::chrono::nanoseconds since_power_on() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_BOOTTIME, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+enum class Start {
+    EAGER,      // initialized during boot, in parallel with its peers
+    ON_DEMAND   // initialized by the first require(), on the caller's thread
+};
+
+enum class Status { PENDING, RUNNING, READY, FAILED, SKIPPED };
+
+inline const char* to_string(Status status) {
+    switch (status) {
+        case Status::PENDING: return "pending";
+        case Status::RUNNING: return "running";
+        case Status::READY: return "ready";
+        case Status::FAILED: return "failed";
+        case Status::SKIPPED: return "skipped";
+    }
+    return "unknown";
+}
+
+struct ComponentTiming {
+    std::string name;
+    Start start{Start::EAGER};
+    Status status{Status::PENDING};
+    std::chrono::nanoseconds started{0};   // since power-on; zero if never started
+    std::chrono::nanoseconds finished{0};
+    std::string thread;                 // "boot-N" or "on-demand"
+    std::string error;
+
+    std::chrono::nanoseconds duration() const { return finished - started; }
+};
+
+struct Milestone {
+    std::string name;
+    std::chrono::nanoseconds at;  // since power-on
+};
+
+struct Timeline {
+    std::chrono::nanoseconds process_start;  // orchestrator creation, since power-on
+    std::vector<ComponentTiming> components;  // in start order
+    std::vector<Milestone> milestones;
+
+    // One line per component and milestone, times in ms since power-on
+    std::vector<std::string> lines() const {
+        auto ms = [](std::chrono::nanoseconds t) { return t.count() / 1e6; };
+        std::vector<std::string> out;
+        char line[192];
+        std::snprintf(line, sizeof(line), "boot: process      at %9.1fms", ms(process_start));
+        out.push_back(line);
+        for (const auto& c : components) {
+            if (c.started.count() == 0) {
+                std::snprintf(line, sizeof(line), "boot: %-18s %-7s%s%s", c.name.c_str(),
+                              to_string(c.status), c.error.empty() ? "" : ": ", c.error.c_str());
+                out.push_back(line);
+                continue;
+            }
+            std::snprintf(line, sizeof(line), "boot: %-18s %-7s %9.1fms .. %9.1fms (%7.1fms, %s)%s%s",
+                          c.name.c_str(), to_string(c.status), ms(c.started), ms(c.finished),
+                          ms(c.duration()), c.thread.c_str(), c.error.empty() ? "" : ": ",
+                          c.error.c_str());
+            out.push_back(line);
+        }
+        for (const auto& m : milestones) {
+            std::snprintf(line, sizeof(line), "boot: %-18s at %9.1fms", m.name.c_str(), ms(m.at));
+            out.push_back(line);
+        }
+        return out;
+    }
+};
+
+class Orchestrator {
+private:
+    struct Component {
+        std::string name;
+        std::vector<std::string> deps;
+        Start start;
+        std::function<void()> init;  // throws on failure
+        Status status{Status::PENDING};
+        std::vector<std::function<void()>> ready_hooks;  // run once READY
+        ComponentTiming timing;
+    };
+
+    std::chrono::nanoseconds origin{since_power_on()};
+    std::map<std::string, Component> components;
+    std::vector<Component*> declared;  // workers prefer earlier declarations
+    std::vector<std::string> start_order;
+    std::vector<Milestone> milestones;
+    std::vector<std::thread> workers;
+    bool launched{false};
+    size_t active_workers{0};
+    bool booted{false};  // every eager component has settled
+    std::vector<std::function<void()>> completion;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;  // a component finished or was claimed
+
+    bool settled(const Component& c) const {
+        return c.status == Status::READY || c.status == Status::FAILED || c.status == Status::SKIPPED;
+    }
+
+    // READY if every dependency is, SKIPPED if one cannot be, else PENDING
+    Status deps_state(const Component& c) const {
+        for (const auto& dep : c.deps) {
+            auto it = components.find(dep);
+            if (it == components.end()) return Status::SKIPPED;
+            if (it->second.status == Status::FAILED || it->second.status == Status::SKIPPED) {
+                return Status::SKIPPED;
+            }
+            if (it->second.status != Status::READY) return Status::PENDING;
+        }
+        return Status::READY;
+    }
+
+    // Claims c and runs its init without the lock held
+    void execute(std::unique_lock<std::mutex>& lock, Component& c, const std::string& thread) {
+        c.status = Status::RUNNING;
+        c.timing.thread = thread;
+        c.timing.started = since_power_on();
+        start_order.push_back(c.name);
+        lock.unlock();
+
+        std::string error;
+        try {
+            c.init();
+        } catch (const std::exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "unknown error";
+        }
+
+        auto finished = since_power_on();
+        lock.lock();
+        c.timing.finished = finished;
+        c.timing.error = error;
+        c.status = error.empty() ? Status::READY : Status::FAILED;
+        if (!error.empty()) logging::error("boot: {} failed: {}", c.name, error);
+        changed.notify_all();
+
+        std::vector<std::function<void()>> hooks;
+        hooks.swap(c.ready_hooks);
+        if (c.status != Status::READY || hooks.empty()) return;
+        lock.unlock();
+        for (auto& fn : hooks) fn();
+        lock.lock();
+    }
+
+    // lock held on entry, released on return; runs the completion callbacks
+    void finish_boot(std::unique_lock<std::mutex>& lock) {
+        booted = true;
+        std::vector<std::function<void()>> callbacks;
+        callbacks.swap(completion);
+        lock.unlock();
+        for (auto& fn : callbacks) fn();
+    }
+
+    void skip(Component& c) {
+        c.status = Status::SKIPPED;
+        c.timing.error = "dependency unavailable";
+        changed.notify_all();
+    }
+
+    // Pulls runnable eager components until none are left
+    void worker(size_t index) {
+        std::string thread = "boot-" + std::to_string(index);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            Component* runnable = nullptr;
+            bool waiting = false;
+            for (Component* component : declared) {
+                Component& c = *component;
+                if (c.start != Start::EAGER || c.status != Status::PENDING) continue;
+                Status deps = deps_state(c);
+                if (deps == Status::SKIPPED) {
+                    skip(c);
+                } else if (deps == Status::READY) {
+                    runnable = &c;
+                    break;
+                } else {
+                    waiting = true;
+                }
+            }
+            if (runnable) {
+                execute(lock, *runnable, thread);
+            } else if (waiting) {
+                changed.wait(lock);
+            } else {
+                break;
+            }
+        }
+        // The last worker out completes the boot
+        if (--active_workers == 0) finish_boot(lock);
+    }
+
+    // An eager component pulls its on-demand dependencies forward
+    void promote(const std::string& name) {
+        auto it = components.find(name);
+        if (it == components.end()) return;
+        for (const auto& dep : it->second.deps) {
+            auto dep_it = components.find(dep);
+            if (dep_it != components.end() && dep_it->second.start == Start::ON_DEMAND) {
+                dep_it->second.start = Start::EAGER;
+                promote(dep);
+            }
+        }
+    }
+
+public:
+    Orchestrator() = default;
+    ~Orchestrator() { join(); }
+    Orchestrator(const Orchestrator&) = delete;
+    Orchestrator& operator=(const Orchestrator&) = delete;
+
+    // Declares a component; deps must be declared before run(). Among
+    // runnable components, earlier ones are started first.
+    void add(const std::string& name, std::vector<std::string> deps, Start start,
+             std::function<void()> init) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Component c;
+        c.name = name;
+        c.deps = std::move(deps);
+        c.start = start;
+        c.init = std::move(init);
+        c.timing.name = name;
+        c.timing.start = start;
+        auto [it, inserted] = components.insert_or_assign(name, std::move(c));
+        if (inserted) declared.push_back(&it->second);
+    }
+
+    // Starts the eager components on up to max_workers threads and returns
+    void run(size_t max_workers = 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (launched) return;
+        launched = true;
+
+        size_t eager = 0;
+        for (auto& [name, c] : components) {
+            if (c.start == Start::EAGER) promote(name);
+        }
+        for (const auto& [name, c] : components) {
+            if (c.start == Start::EAGER) eager++;
+        }
+        if (max_workers == 0) max_workers = std::max(2u, std::thread::hardware_concurrency());
+        size_t count = std::min(max_workers, eager);
+        active_workers = count;
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back(&Orchestrator::worker, this, i + 1);
+        }
+        if (count == 0) finish_boot(lock);
+    }
+
+    // Calls fn once every eager component is ready, failed or skipped: on
+    // the boot worker that finished last, or here if boot is already over.
+    // Meant for handing off to a loop or executor; fn must not join().
+    void on_complete(std::function<void()> fn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!booted) {
+            completion.push_back(std::move(fn));
+            return;
+        }
+        lock.unlock();
+        fn();
+    }
+
+    // Calls fn once name is ready: on the thread that built it, or here if
+    // it already is. Never called if it fails or is skipped.
+    void on_ready(const std::string& name, std::function<void()> fn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = components.find(name);
+        if (it == components.end()) return;
+        if (it->second.status != Status::READY) {
+            it->second.ready_hooks.push_back(std::move(fn));
+            return;
+        }
+        lock.unlock();
+        fn();
+    }
+
+    // Returns once name is initialized, starting it here (after its
+    // dependencies) if nothing has yet. False if it or a dependency failed.
+    bool require(const std::string& name) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = components.find(name);
+        if (it == components.end()) return false;
+        Component& c = it->second;
+        if (c.status == Status::READY) return true;
+
+        // Before run() an eager component is built here too
+        if (c.status == Status::PENDING && (c.start == Start::ON_DEMAND || !launched)) {
+            lock.unlock();
+            bool deps_ok = true;
+            for (const auto& dep : c.deps) deps_ok = require(dep) && deps_ok;
+            lock.lock();
+            if (c.status == Status::PENDING) {
+                if (deps_ok) {
+                    execute(lock, c, "on-demand");
+                } else {
+                    skip(c);
+                }
+            }
+        }
+        // Eager and not yet run, or being run by another thread
+        changed.wait(lock, [&] { return settled(c); });
+        return c.status == Status::READY;
+    }
+
+    Status status(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = components.find(name);
+        return it == components.end() ? Status::SKIPPED : it->second.status;
+    }
+
+    // Records a point on the timeline, e.g. the first rendered frame; only
+    // the first mark of each name counts
+    void mark(const std::string& name) {
+        auto at = since_power_on();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& m : milestones) {
+            if (m.name == name) return;
+        }
+        milestones.push_back({name, at});
+    }
+
+    // Waits for the boot workers; on-demand components may still be pending
+    void join() {
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+        workers.clear();
+    }
+
+    Timeline timeline() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Timeline result{origin, {}, milestones};
+        auto append = [&](const Component& c) {
+            result.components.push_back(c.timing);
+            result.components.back().status = c.status;
+        };
+        for (const auto& name : start_order) append(components.at(name));
+        for (const auto& [name, c] : components) {
+            if (c.status == Status::PENDING || c.status == Status::SKIPPED) append(c);
+        }
+        return result;
+    }
+
+    void report() const {
+        for (const auto& line : timeline().lines()) logging::info("{}", line);
+    }
+};
+
+// Owns a component built by an orchestrator. get() is a single acquire
+// load once the component exists; before that it calls require(), which
+// may build it on the calling thread. Declare the Orchestrator after its
+// Lazy members, so its workers are joined before they are destroyed.
+template <typename T>
+class Lazy {
+private:
+    std::atomic<T*> ptr{nullptr};
+    std::unique_ptr<T> owned;
+    Orchestrator* orchestrator{nullptr};
+    std::string name;
+
+public:
+    Lazy() = default;
+    Lazy(const Lazy&) = delete;
+    Lazy& operator=(const Lazy&) = delete;
+
+    // Registers factory as name's init
+    void bind(Orchestrator& boot, const std::string& component, std::vector<std::string> deps,
+              Start start, std::function<std::unique_ptr<T>()> factory) {
+        orchestrator = &boot;
+        name = component;
+        boot.add(component, std::move(deps), start, [this, factory = std::move(factory)] {
+            owned = factory();
+            ptr.store(owned.get(), std::memory_order_release);
+        });
+    }
+
+    T* get() {
+        T* p = ptr.load(std::memory_order_acquire);
+        if (p) return p;
+        if (orchestrator) orchestrator->require(name);
+        p = ptr.load(std::memory_order_acquire);
+        if (!p) throw std::runtime_error(name + " is unavailable");
+        return p;
+    }
+
+    // Null until built; never triggers initialization
+    T* peek() const { return ptr.load(std::memory_order_acquire); }
+
+    T* operator->() { return get(); }
+    T& operator*() { return *get(); }
+};
+
+} // namespace boot
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bounded {
+
+struct TableStats {
+    size_t capacity;
+    size_t size;
+    uint64_t inserts;
+    uint64_t evictions;
+
+    double occupancy() const {
+        return capacity ? static_cast<double>(size) / capacity : 0.0;
+    }
+
+    // Share of inserts that had to push out an existing entry
+    double eviction_rate() const {
+        return inserts ? static_cast<double>(evictions) / inserts : 0.0;
+    }
+};
+
+// Maps a signal strength to a CLOCK credit: strong entries survive more sweeps
+inline uint8_t signal_weight(int rssi) {
+    if (rssi > -60) return 3;
+    if (rssi > -75) return 2;
+    return 1;
+}
+
+// Fixed-capacity table with all slots allocated up front. When full, an
+// insert evicts the victim chosen by a generalized CLOCK sweep: each access
+// sets the slot's credit to its weight, and the hand decrements credits until
+// it finds one at zero, so recently seen and high-value entries stay longest.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class BoundedTable {
+public:
+    using EvictCallback = std::function<void(const Key&, Value&)>;
+
+private:
+    struct Slot {
+        Key key{};
+        Value value{};
+        uint8_t credit{0};
+        bool used{false};
+    };
+
+    std::vector<Slot> slots;
+    std::unordered_map<Key, uint32_t, Hash> index;
+    std::vector<uint32_t> free_slots;
+    size_t hand{0};
+
+    uint64_t inserts{0};
+    uint64_t evictions{0};
+    EvictCallback on_evict;
+
+    uint32_t take_victim() {
+        while (true) {
+            Slot& slot = slots[hand];
+            uint32_t current = static_cast<uint32_t>(hand);
+            hand = (hand + 1) % slots.size();
+            if (slot.credit == 0) return current;
+            slot.credit--;
+        }
+    }
+
+    void release(uint32_t i) {
+        Slot& slot = slots[i];
+        index.erase(slot.key);
+        slot.key = Key{};
+        slot.value = Value{};
+        slot.credit = 0;
+        slot.used = false;
+    }
+
+public:
+    template <typename Table, typename Ref>
+    class Iterator {
+    private:
+        Table* table;
+        size_t pos;
+
+        void skip_unused() {
+            while (pos < table->slots.size() && !table->slots[pos].used) ++pos;
+        }
+
+    public:
+        Iterator(Table* t, size_t p) : table(t), pos(p) { skip_unused(); }
+
+        std::pair<const Key&, Ref> operator*() const {
+            return {table->slots[pos].key, table->slots[pos].value};
+        }
+        Iterator& operator++() { ++pos; skip_unused(); return *this; }
+        bool operator==(const Iterator& other) const { return pos == other.pos; }
+        bool operator!=(const Iterator& other) const { return pos != other.pos; }
+    };
+
+    using iterator = Iterator<BoundedTable, Value&>;
+    using const_iterator = Iterator<const BoundedTable, const Value&>;
+
+    explicit BoundedTable(size_t capacity) : slots(std::max<size_t>(1, capacity)) {
+        index.reserve(slots.size());
+        free_slots.reserve(slots.size());
+        for (size_t i = slots.size(); i > 0; --i) {
+            free_slots.push_back(static_cast<uint32_t>(i - 1));
+        }
+    }
+
+    void set_evict_callback(EvictCallback callback) {
+        on_evict = std::move(callback);
+    }
+
+    // Returns the entry for key, inserting a default one if needed
+    Value& upsert(const Key& key, uint8_t weight = 1) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            Slot& slot = slots[it->second];
+            slot.credit = std::max(slot.credit, weight);
+            return slot.value;
+        }
+
+        uint32_t i;
+        if (!free_slots.empty()) {
+            i = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            i = take_victim();
+            evictions++;
+            if (on_evict) on_evict(slots[i].key, slots[i].value);
+            release(i);
+        }
+
+        inserts++;
+        Slot& slot = slots[i];
+        slot.key = key;
+        slot.credit = weight;
+        slot.used = true;
+        index.emplace(key, i);
+        return slot.value;
+    }
+
+    // Refreshes the entry's credit; returns false if it is not present
+    bool touch(const Key& key, uint8_t weight = 1) {
+        auto it = index.find(key);
+        if (it == index.end()) return false;
+        Slot& slot = slots[it->second];
+        slot.credit = std::max(slot.credit, weight);
+        return true;
+    }
+
+    Value* find(const Key& key) {
+        auto it = index.find(key);
+        return it == index.end() ? nullptr : &slots[it->second].value;
+    }
+
+    const Value* find(const Key& key) const {
+        auto it = index.find(key);
+        return it == index.end() ? nullptr : &slots[it->second].value;
+    }
+
+    bool contains(const Key& key) const { return index.count(key) != 0; }
+
+    bool erase(const Key& key) {
+        auto it = index.find(key);
+        if (it == index.end()) return false;
+        uint32_t i = it->second;
+        release(i);
+        free_slots.push_back(i);
+        return true;
+    }
+
+    size_t size() const { return index.size(); }
+    size_t capacity() const { return slots.size(); }
+    bool empty() const { return index.empty(); }
+
+    TableStats stats() const {
+        return TableStats{slots.size(), index.size(), inserts, evictions};
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, slots.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots.size()); }
+};
+
+} // namespace bounded
@@ -0,0 +1,76 @@
+#include "capture_log.hpp"
+#include <iostream>
+
+// Materializes captures from the capture log as individual files.
+//
+//   capture_export <log_dir> <out_dir> [bssid]
+//   capture_export --list <log_dir>
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " <log_dir> <out_dir> [bssid]\n"
+              << "       " << program << " --list <log_dir>" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    bool list_only = std::string(argv[1]) == "--list";
+    storage::CaptureLog::Config config;
+    config.dir = list_only ? argv[2] : argv[1];
+    config.read_only = true;  // the daemon may be appending right now
+    if (!std::filesystem::is_directory(config.dir)) {
+        std::cerr << "No capture log at " << config.dir << std::endl;
+        return 1;
+    }
+
+    storage::CaptureLog log;
+    if (!log.open(config)) {
+        std::cerr << "Failed to open capture log at " << config.dir << std::endl;
+        return 1;
+    }
+
+    std::vector<storage::IndexEntry> entries;
+    if (!list_only && argc > 3) {
+        wifi::Bssid bssid;
+        if (!wifi::Bssid::parse(argv[3], bssid)) {
+            std::cerr << "Invalid BSSID: " << argv[3] << std::endl;
+            return 1;
+        }
+        entries = log.entries(bssid);
+    } else {
+        entries = log.entries();
+    }
+
+    size_t exported = 0;
+    size_t failed = 0;
+    for (const auto& entry : entries) {
+        storage::CaptureRecord record;
+        if (!log.read(entry, record)) {
+            std::cerr << "Corrupt record " << entry.seq << " in segment " << entry.segment << std::endl;
+            failed++;
+            continue;
+        }
+
+        if (list_only) {
+            std::cout << record.bssid.str() << "  " << record.timestamp << "  "
+                      << storage::file_extension(record.type) + 1 << "  "
+                      << record.payload.size() << "  " << record.essid.str() << "\n";
+            continue;
+        }
+
+        auto path = storage::export_record(record, argv[2]);
+        if (path.empty()) {
+            failed++;
+        } else {
+            exported++;
+        }
+    }
+
+    if (!list_only) {
+        std::cout << "Exported " << exported << " captures to " << argv[2] << std::endl;
+    }
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,781 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "crc32.hpp"
+#include "lz_codec.hpp"
+#include "metrics.hpp"
+#include "wifi_types.hpp"
+
+namespace storage {
+
+enum class RecordType : uint8_t {
+    HANDSHAKE = 1,  // hccapx payload
+    PMKID = 2,      // raw 16-byte PMKID
+    TOMBSTONE = 3   // erases earlier records for the BSSID
+};
+
+inline const char* file_extension(RecordType type) {
+    switch (type) {
+        case RecordType::HANDSHAKE: return ".hccapx";
+        case RecordType::PMKID: return ".pmkid";
+        case RecordType::TOMBSTONE: return ".tombstone";
+    }
+    return ".bin";
+}
+
+// Where a record lives; kept in memory for every record in the log
+struct IndexEntry {
+    uint64_t seq;
+    uint64_t timestamp;
+    wifi::Bssid bssid;
+    RecordType type;
+    bool dead;
+    uint32_t segment;
+    uint32_t offset;
+    uint32_t size;  // header + body
+};
+
+struct CaptureRecord {
+    RecordType type;
+    wifi::Bssid bssid;
+    wifi::Ssid essid;
+    uint64_t seq;
+    uint64_t timestamp;
+    std::vector<uint8_t> payload;
+};
+
+struct CaptureLogStats {
+    size_t segments;
+    size_t live_records;
+    uint64_t live_bytes;
+    uint64_t dead_bytes;
+    uint64_t payload_bytes_in;   // capture bytes handed to append()
+    uint64_t bytes_written;      // bytes written to segments, incl. compaction
+    uint64_t compactions;
+    uint64_t torn_records;       // dropped during recovery
+    size_t compressed_segments;
+
+    double write_amplification() const {
+        return payload_bytes_in ? static_cast<double>(bytes_written) / payload_bytes_in : 0.0;
+    }
+};
+
+// Append-only, segmented capture store. Every capture becomes one
+// CRC-protected record appended to the active segment instead of a new file,
+// so the SD card sees sequential appends rather than a create/write/close per
+// capture. Segments roll over at a fixed size; a sealed segment gets a compact
+// sidecar index so reopening does not have to read it back. Erases write
+// tombstones, and compact() rewrites mostly-dead segments. With a
+// compressor attached, sealed segments are replaced by .seg.lz in the
+// background and read back through a block-indexed decoder.
+//
+// Record layout: RecordHeader, essid bytes, payload. The CRC covers
+// everything after the crc field.
+class CaptureLog {
+public:
+    struct Config {
+        std::filesystem::path dir;
+        uint32_t segment_bytes = 1024 * 1024;
+        uint64_t max_bytes = 0;       // retention limit, 0 = unlimited
+        uint32_t sync_every = 8;      // fdatasync after this many appends; 0 leaves it to sync()
+        double compact_ratio = 0.5;   // rewrite sealed segments this dead
+        bool read_only = false;       // inspect a log another process is writing
+    };
+
+private:
+    static constexpr uint32_t RECORD_MAGIC = 0x52504143;  // "CAPR"
+    static constexpr uint32_t INDEX_MAGIC = 0x58495043;   // "CPIX"
+    static constexpr uint32_t INDEX_VERSION = 1;
+    static constexpr uint32_t MAX_PAYLOAD = 1024 * 1024;
+
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t crc;
+        uint64_t seq;
+        uint64_t timestamp;
+        uint8_t bssid[6];
+        uint8_t type;
+        uint8_t essid_length;
+        uint32_t payload_length;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(RecordHeader) == 40, "on-disk layout");
+
+    // Sidecar index entry for a sealed segment (host byte order)
+    struct DiskIndexEntry {
+        uint64_t seq;
+        uint64_t timestamp;
+        uint32_t offset;
+        uint32_t size;
+        uint8_t bssid[6];
+        uint8_t type;
+        uint8_t reserved;
+    };
+    static_assert(sizeof(DiskIndexEntry) == 32, "on-disk layout");
+
+    struct DiskIndexHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+        uint32_t crc;  // over the entries
+    };
+
+    struct Segment {
+        uint64_t bytes{0};
+        uint64_t dead_bytes{0};
+        bool compressed{false};
+    };
+
+    Config config;
+    std::map<uint32_t, Segment> segments;
+    std::vector<IndexEntry> index;  // ordered by segment, then offset
+    std::mutex mutex;
+
+    int active_fd{-1};
+    uint32_t active_id{0};
+    uint64_t next_seq{1};
+    uint32_t unsynced{0};
+    uint64_t unsynced_bytes{0};
+    std::vector<uint8_t> write_buffer;
+
+    uint64_t payload_bytes_in{0};
+    uint64_t bytes_written{0};
+    uint64_t compaction_count{0};
+    uint64_t torn_count{0};
+    compress::BackgroundCompressor* compressor{nullptr};
+    metrics::Histogram write_latency = metrics::histogram("storage_write");  // append, lock wait included
+
+    std::filesystem::path segment_path(uint32_t id) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "capture-%08u.seg", id);
+        return config.dir / name;
+    }
+
+    std::filesystem::path compressed_path(uint32_t id) const {
+        auto path = segment_path(id);
+        path += ".lz";
+        return path;
+    }
+
+    std::filesystem::path index_path(uint32_t id) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "capture-%08u.idx", id);
+        return config.dir / name;
+    }
+
+    static bool write_all(int fd, const void* data, size_t length) {
+        const auto* p = static_cast<const uint8_t*>(data);
+        while (length > 0) {
+            ssize_t n = ::write(fd, p, length);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool read_all(int fd, void* data, size_t length, off_t offset) {
+        auto* p = static_cast<uint8_t*>(data);
+        while (length > 0) {
+            ssize_t n = ::pread(fd, p, length, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            length -= static_cast<size_t>(n);
+            offset += n;
+        }
+        return true;
+    }
+
+    static uint32_t record_crc(const RecordHeader& header, const uint8_t* body, size_t body_length) {
+        const auto* raw = reinterpret_cast<const uint8_t*>(&header);
+        uint32_t crc = checksum::crc32(raw + 8, sizeof(RecordHeader) - 8);
+        return checksum::crc32(body, body_length, crc);
+    }
+
+    static uint64_t file_size(int fd) {
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        return end < 0 ? 0 : static_cast<uint64_t>(end);
+    }
+
+    // A segment as written (.seg) or after background compression (.seg.lz).
+    // The .lz is renamed into place before the .seg is unlinked, so trying
+    // them in this order always finds one.
+    struct SegmentReader {
+        int fd{-1};
+        compress::BlockReader packed;
+        uint64_t length{0};
+
+        SegmentReader() = default;
+        SegmentReader(const SegmentReader&) = delete;
+        SegmentReader& operator=(const SegmentReader&) = delete;
+
+        ~SegmentReader() {
+            if (fd >= 0) ::close(fd);
+        }
+
+        bool open(const std::filesystem::path& plain, const std::filesystem::path& compressed,
+                  int flags = O_RDONLY) {
+            fd = ::open(plain.c_str(), flags | O_CLOEXEC);
+            if (fd >= 0) {
+                length = file_size(fd);
+                return true;
+            }
+            if (!packed.open(compressed)) return false;
+            length = packed.size();
+            return true;
+        }
+
+        bool read(void* data, size_t n, uint64_t offset) {
+            if (offset + n > length) return false;
+            return fd >= 0 ? read_all(fd, data, n, static_cast<off_t>(offset))
+                           : packed.read(data, n, offset);
+        }
+    };
+
+    // Reads and validates the record at offset; false on a torn or corrupt record
+    static bool read_record(SegmentReader& segment, uint64_t offset, uint64_t limit,
+                            RecordHeader& header, std::vector<uint8_t>& body) {
+        if (offset + sizeof(RecordHeader) > limit) return false;
+        if (!segment.read(&header, sizeof(header), offset)) return false;
+        if (header.magic != RECORD_MAGIC || header.payload_length > MAX_PAYLOAD) return false;
+
+        size_t body_length = header.essid_length + header.payload_length;
+        if (offset + sizeof(RecordHeader) + body_length > limit) return false;
+        body.resize(body_length);
+        if (body_length > 0 && !segment.read(body.data(), body_length, offset + sizeof(header))) {
+            return false;
+        }
+        return record_crc(header, body.data(), body.size()) == header.crc;
+    }
+
+    // Walks a segment record by record. Stops at the first bad record and
+    // returns its offset, which is where valid data ends.
+    uint64_t scan_segment(uint32_t id, SegmentReader& segment, std::vector<IndexEntry>& out) {
+        uint64_t size = segment.length;
+        uint64_t offset = 0;
+        RecordHeader header;
+        std::vector<uint8_t> body;
+        while (offset < size && read_record(segment, offset, size, header, body)) {
+            uint32_t record_size = static_cast<uint32_t>(sizeof(header) + body.size());
+            IndexEntry entry{header.seq, header.timestamp, {}, static_cast<RecordType>(header.type),
+                             false, id, static_cast<uint32_t>(offset), record_size};
+            std::memcpy(entry.bssid.bytes.data(), header.bssid, 6);
+            out.push_back(entry);
+            offset += record_size;
+        }
+        return offset;
+    }
+
+    bool load_sidecar(uint32_t id, std::vector<IndexEntry>& out, uint64_t& bytes) {
+        std::ifstream file(index_path(id), std::ios::binary);
+        DiskIndexHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION) return false;
+
+        std::vector<DiskIndexEntry> disk(header.count);
+        size_t length = disk.size() * sizeof(DiskIndexEntry);
+        if (!file.read(reinterpret_cast<char*>(disk.data()), static_cast<std::streamsize>(length))) {
+            return false;
+        }
+        if (checksum::crc32(disk.data(), length) != header.crc) return false;
+
+        bytes = 0;
+        for (const auto& d : disk) {
+            IndexEntry entry{d.seq, d.timestamp, {}, static_cast<RecordType>(d.type),
+                             false, id, d.offset, d.size};
+            std::memcpy(entry.bssid.bytes.data(), d.bssid, 6);
+            out.push_back(entry);
+            bytes = std::max<uint64_t>(bytes, uint64_t(d.offset) + d.size);
+        }
+        return true;
+    }
+
+    void write_sidecar(uint32_t id) {
+        std::vector<DiskIndexEntry> disk;
+        for (const auto& entry : index) {
+            if (entry.segment != id) continue;
+            DiskIndexEntry d{entry.seq, entry.timestamp, entry.offset, entry.size, {},
+                             static_cast<uint8_t>(entry.type), 0};
+            std::memcpy(d.bssid, entry.bssid.bytes.data(), 6);
+            disk.push_back(d);
+        }
+        size_t length = disk.size() * sizeof(DiskIndexEntry);
+        DiskIndexHeader header{INDEX_MAGIC, INDEX_VERSION, static_cast<uint32_t>(disk.size()),
+                               checksum::crc32(disk.data(), length)};
+
+        // A crash leaves either no sidecar (segment gets rescanned) or a complete one
+        persist::write_file_atomic(index_path(id), {{&header, sizeof(header)}, {disk.data(), length}});
+    }
+
+    bool open_active(uint32_t id) {
+        active_fd = ::open(segment_path(id).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (active_fd < 0) return false;
+        active_id = id;
+        segments[id];
+        return true;
+    }
+
+    uint64_t sync_active() {
+        if (active_fd < 0 || unsynced == 0) return 0;
+        ::fdatasync(active_fd);
+        uint64_t synced = unsynced_bytes;
+        unsynced = 0;
+        unsynced_bytes = 0;
+        return synced;
+    }
+
+    void seal_active() {
+        if (active_fd < 0) return;
+        ::fdatasync(active_fd);
+        ::close(active_fd);
+        active_fd = -1;
+        unsynced = 0;
+        unsynced_bytes = 0;
+        write_sidecar(active_id);
+        queue_compression(active_id);
+    }
+
+    void queue_compression(uint32_t id) {
+        if (!compressor || config.read_only) return;
+        compressor->submit(segment_path(id), compressed_path(id),
+                           [this, id](bool ok, const compress::CodecStats&) {
+                               finish_compression(id, ok);
+                           });
+    }
+
+    // Runs on the compressor thread once the .lz is durable
+    void finish_compression(uint32_t id, bool ok) {
+        if (!ok) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = segments.find(id);
+        std::error_code ec;
+        if (it == segments.end()) {
+            // Compacted or expired while it was being compressed
+            std::filesystem::remove(compressed_path(id), ec);
+            return;
+        }
+        std::filesystem::remove(segment_path(id), ec);
+        persist::sync_directory(config.dir);
+        it->second.compressed = true;
+    }
+
+    bool roll_over() {
+        seal_active();
+        return open_active(active_id + 1);
+    }
+
+    // Appends one encoded record to the active segment
+    bool append_raw(const IndexEntry& meta, const uint8_t* record, size_t length) {
+        if (active_fd < 0) return false;
+        Segment& active = segments[active_id];
+        if (active.bytes > 0 && active.bytes + length > config.segment_bytes) {
+            if (!roll_over()) return false;
+        }
+
+        Segment& target = segments[active_id];
+        uint64_t offset = target.bytes;
+        if (!write_all(active_fd, record, length)) {
+            // Drop whatever part made it to disk so the tail stays parseable
+            ::ftruncate(active_fd, static_cast<off_t>(offset));
+            return false;
+        }
+        target.bytes += length;
+        bytes_written += length;
+
+        IndexEntry entry = meta;
+        entry.segment = active_id;
+        entry.offset = static_cast<uint32_t>(offset);
+        entry.size = static_cast<uint32_t>(length);
+        index.push_back(entry);
+
+        unsynced++;
+        unsynced_bytes += length;
+        if (config.sync_every > 0 && unsynced >= config.sync_every) sync_active();
+        return true;
+    }
+
+    void encode(RecordType type, uint64_t seq, const wifi::Bssid& bssid, const wifi::Ssid& essid,
+                uint64_t timestamp, const uint8_t* data, size_t length) {
+        RecordHeader header{};
+        header.magic = RECORD_MAGIC;
+        header.seq = seq;
+        header.timestamp = timestamp;
+        std::memcpy(header.bssid, bssid.bytes.data(), 6);
+        header.type = static_cast<uint8_t>(type);
+        header.essid_length = essid.length;
+        header.payload_length = static_cast<uint32_t>(length);
+
+        write_buffer.resize(sizeof(header) + essid.length + length);
+        uint8_t* body = write_buffer.data() + sizeof(header);
+        std::memcpy(body, essid.data.data(), essid.length);
+        if (length > 0) std::memcpy(body + essid.length, data, length);
+        header.crc = record_crc(header, body, essid.length + length);
+        std::memcpy(write_buffer.data(), &header, sizeof(header));
+    }
+
+    void mark_dead(IndexEntry& entry) {
+        if (entry.dead) return;
+        entry.dead = true;
+        segments[entry.segment].dead_bytes += entry.size;
+    }
+
+    // Applies tombstones and drops duplicates left by an interrupted compaction
+    void replay() {
+        std::unordered_map<wifi::Bssid, uint64_t> erased_before;
+        std::unordered_map<uint64_t, size_t> by_seq;
+        for (size_t i = 0; i < index.size(); ++i) {
+            auto& entry = index[i];
+            auto [it, inserted] = by_seq.emplace(entry.seq, i);
+            if (!inserted) {
+                mark_dead(index[it->second]);  // the later copy wins
+                it->second = i;
+            }
+            if (entry.type == RecordType::TOMBSTONE) {
+                auto& bound = erased_before[entry.bssid];
+                bound = std::max(bound, entry.seq);
+            }
+            next_seq = std::max(next_seq, entry.seq + 1);
+        }
+        for (auto& entry : index) {
+            if (entry.type == RecordType::TOMBSTONE) continue;
+            auto it = erased_before.find(entry.bssid);
+            if (it != erased_before.end() && entry.seq < it->second) mark_dead(entry);
+        }
+    }
+
+    // A tombstone is needed while some other segment still holds older
+    // records for its BSSID
+    bool tombstone_needed(const IndexEntry& tombstone) const {
+        for (const auto& entry : index) {
+            if (entry.segment != tombstone.segment && entry.bssid == tombstone.bssid &&
+                entry.seq < tombstone.seq && entry.type != RecordType::TOMBSTONE) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void drop_segment(uint32_t id) {
+        index.erase(std::remove_if(index.begin(), index.end(),
+                                   [id](const IndexEntry& e) { return e.segment == id; }),
+                    index.end());
+        segments.erase(id);
+        std::error_code ec;
+        std::filesystem::remove(segment_path(id), ec);
+        std::filesystem::remove(compressed_path(id), ec);
+        std::filesystem::remove(index_path(id), ec);
+    }
+
+    // Compaction moves records forward, so segment order is not capture order
+    static void sort_by_seq(std::vector<IndexEntry>& entries) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const IndexEntry& a, const IndexEntry& b) { return a.seq < b.seq; });
+    }
+
+    bool read_locked(const IndexEntry& entry, CaptureRecord& out) {
+        SegmentReader segment;
+        if (!segment.open(segment_path(entry.segment), compressed_path(entry.segment))) return false;
+
+        RecordHeader header;
+        std::vector<uint8_t> body;
+        bool ok = read_record(segment, entry.offset, uint64_t(entry.offset) + entry.size, header, body);
+        if (!ok || header.seq != entry.seq) return false;
+
+        out.type = static_cast<RecordType>(header.type);
+        out.seq = header.seq;
+        out.timestamp = header.timestamp;
+        std::memcpy(out.bssid.bytes.data(), header.bssid, 6);
+        out.essid.assign(std::string_view(reinterpret_cast<const char*>(body.data()),
+                                          header.essid_length));
+        out.payload.assign(body.begin() + header.essid_length, body.end());
+        return true;
+    }
+
+public:
+    CaptureLog() = default;
+
+    ~CaptureLog() {
+        close();
+    }
+
+    CaptureLog(const CaptureLog&) = delete;
+    CaptureLog& operator=(const CaptureLog&) = delete;
+
+    // Opens or recovers the log in cfg.dir. Sealed segments load from their
+    // sidecar index; the newest segment is scanned and any torn tail cut off.
+    bool open(const Config& cfg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = cfg;
+        std::error_code ec;
+        if (!config.read_only) std::filesystem::create_directories(config.dir, ec);
+
+        bool repair = !config.read_only;
+        std::vector<uint32_t> ids;
+        for (const auto& dirent : std::filesystem::directory_iterator(config.dir, ec)) {
+            std::string name = dirent.path().filename().string();
+            unsigned id;
+            int end = 0;
+            if (std::sscanf(name.c_str(), "capture-%8u.seg%n", &id, &end) == 1 && end > 0) {
+                std::string_view rest(name.c_str() + end);
+                if (rest.empty() || rest == ".lz") ids.push_back(id);
+            }
+            // Leftovers of an interrupted compression or sidecar write
+            if (repair && dirent.path().extension() == ".tmp") {
+                std::filesystem::remove(dirent.path(), ec);
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            uint32_t id = ids[i];
+            bool newest = (i + 1 == ids.size());
+            bool has_plain = std::filesystem::exists(segment_path(id), ec);
+            bool has_packed = std::filesystem::exists(compressed_path(id), ec);
+            if (has_plain && has_packed && repair) {
+                // Crashed between renaming the .lz into place and unlinking the .seg
+                std::filesystem::remove(segment_path(id), ec);
+                has_plain = false;
+            }
+            segments[id].compressed = !has_plain;
+
+            uint64_t bytes = 0;
+            if (!newest && load_sidecar(id, index, bytes)) {
+                segments[id].bytes = bytes;
+                continue;
+            }
+
+            SegmentReader segment;
+            if (!segment.open(segment_path(id), compressed_path(id),
+                              newest && repair ? O_RDWR : O_RDONLY)) {
+                continue;
+            }
+            uint64_t valid = scan_segment(id, segment, index);
+            if (valid < segment.length) {
+                torn_count++;
+                if (newest && repair && segment.fd >= 0) {
+                    ::ftruncate(segment.fd, static_cast<off_t>(valid));
+                }
+            }
+            segments[id].bytes = valid;
+            if (!newest && repair) write_sidecar(id);
+        }
+
+        replay();
+        if (config.read_only) {
+            active_id = ids.empty() ? 0 : ids.back();
+            return true;
+        }
+        if (!ids.empty() && segments[ids.back()].compressed) {
+            return open_active(ids.back() + 1);  // never append to a compressed segment
+        }
+        return open_active(ids.empty() ? 1 : ids.back());
+    }
+
+    // Sealed segments are compressed on c's thread from now on, including
+    // any left uncompressed by an earlier run. c must outlive its use here:
+    // stop it before this log is destroyed.
+    void set_compressor(compress::BackgroundCompressor* c) {
+        std::lock_guard<std::mutex> lock(mutex);
+        compressor = c;
+        for (const auto& [id, segment] : segments) {
+            if (id != active_id && !segment.compressed) queue_compression(id);
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active_fd >= 0) {
+            ::fdatasync(active_fd);
+            ::close(active_fd);
+            active_fd = -1;
+        }
+    }
+
+    bool append(RecordType type, const wifi::Bssid& bssid, const wifi::Ssid& essid,
+                uint64_t timestamp, const uint8_t* data, size_t length) {
+        if (length > MAX_PAYLOAD) return false;
+        metrics::ScopedTimer timer(write_latency);
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t seq = next_seq++;
+        encode(type, seq, bssid, essid, timestamp, data, length);
+        IndexEntry meta{seq, timestamp, bssid, type, false, 0, 0, 0};
+        if (!append_raw(meta, write_buffer.data(), write_buffer.size())) return false;
+        payload_bytes_in += length;
+        return true;
+    }
+
+    bool append(RecordType type, const wifi::Bssid& bssid, const wifi::Ssid& essid,
+                uint64_t timestamp, const std::vector<uint8_t>& payload) {
+        return append(type, bssid, essid, timestamp, payload.data(), payload.size());
+    }
+
+    // Writes a tombstone; earlier records for bssid stop being visible
+    bool erase(const wifi::Bssid& bssid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t seq = next_seq++;
+        encode(RecordType::TOMBSTONE, seq, bssid, wifi::Ssid(), 0, nullptr, 0);
+        IndexEntry meta{seq, 0, bssid, RecordType::TOMBSTONE, false, 0, 0, 0};
+        if (!append_raw(meta, write_buffer.data(), write_buffer.size())) return false;
+        for (auto& entry : index) {
+            if (entry.bssid == bssid && entry.seq < seq) mark_dead(entry);
+        }
+        return true;
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        sync_active();
+    }
+
+    // For a WriteScheduler sync hook; returns the bytes made durable
+    uint64_t sync() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sync_active();
+    }
+
+    // Live capture records, optionally for one BSSID, oldest first
+    std::vector<IndexEntry> entries() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<IndexEntry> live;
+        for (const auto& entry : index) {
+            if (!entry.dead && entry.type != RecordType::TOMBSTONE) live.push_back(entry);
+        }
+        sort_by_seq(live);
+        return live;
+    }
+
+    std::vector<IndexEntry> entries(const wifi::Bssid& bssid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<IndexEntry> live;
+        for (const auto& entry : index) {
+            if (!entry.dead && entry.type != RecordType::TOMBSTONE && entry.bssid == bssid) {
+                live.push_back(entry);
+            }
+        }
+        sort_by_seq(live);
+        return live;
+    }
+
+    bool read(const IndexEntry& entry, CaptureRecord& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return read_locked(entry, out);
+    }
+
+    // Rewrites sealed segments whose dead fraction reached compact_ratio:
+    // live records are copied to the active segment byte-for-byte (seq and
+    // CRC unchanged), then the old segment is deleted. Returns segments freed.
+    size_t compact() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (config.read_only) return 0;
+        std::vector<uint32_t> victims;
+        for (const auto& [id, segment] : segments) {
+            if (id == active_id || segment.bytes == 0) continue;
+            if (segment.dead_bytes >= segment.bytes * config.compact_ratio) victims.push_back(id);
+        }
+
+        size_t freed = 0;
+        std::vector<uint8_t> raw;
+        for (uint32_t id : victims) {
+            std::vector<IndexEntry> keep;
+            for (const auto& entry : index) {
+                if (entry.segment != id || entry.dead) continue;
+                if (entry.type == RecordType::TOMBSTONE && !tombstone_needed(entry)) continue;
+                keep.push_back(entry);
+            }
+
+            SegmentReader segment;
+            if (!segment.open(segment_path(id), compressed_path(id))) continue;
+            bool ok = true;
+            for (const auto& entry : keep) {
+                raw.resize(entry.size);
+                if (!segment.read(raw.data(), raw.size(), entry.offset) ||
+                    !append_raw(entry, raw.data(), raw.size())) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (!ok) break;  // keep the source; replay() drops the duplicates
+
+            // Copies must be durable before the originals disappear
+            if (active_fd >= 0) ::fdatasync(active_fd);
+            unsynced = 0;
+            unsynced_bytes = 0;
+            drop_segment(id);
+            freed++;
+            compaction_count++;
+        }
+        return freed;
+    }
+
+    // Deletes whole segments, oldest first, while over max_bytes
+    size_t enforce_retention() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (config.read_only || config.max_bytes == 0) return 0;
+
+        uint64_t total = 0;
+        for (const auto& [id, segment] : segments) total += segment.bytes;
+
+        size_t dropped = 0;
+        while (total > config.max_bytes && segments.size() > 1) {
+            auto oldest = segments.begin();
+            if (oldest->first == active_id) break;
+            total -= oldest->second.bytes;
+            drop_segment(oldest->first);
+            dropped++;
+        }
+        return dropped;
+    }
+
+    CaptureLogStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        CaptureLogStats s{segments.size(), 0, 0, 0, payload_bytes_in, bytes_written,
+                          compaction_count, torn_count, 0};
+        for (const auto& [id, segment] : segments) {
+            if (segment.compressed) s.compressed_segments++;
+        }
+        for (const auto& entry : index) {
+            if (entry.dead) {
+                s.dead_bytes += entry.size;
+            } else if (entry.type != RecordType::TOMBSTONE) {
+                s.live_records++;
+                s.live_bytes += entry.size;
+            }
+        }
+        return s;
+    }
+};
+
+// Writes one record out as a standalone capture file named like the old
+// per-capture files (bssid_timestamp.ext). Returns the path, or empty on error.
+inline std::filesystem::path export_record(const CaptureRecord& record,
+                                           const std::filesystem::path& out_dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(out_dir, ec);
+    auto path = out_dir / (record.bssid.str() + "_" + std::to_string(record.timestamp) +
+                           file_extension(record.type));
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(record.payload.data()),
+               static_cast<std::streamsize>(record.payload.size()));
+    return file ? path : std::filesystem::path();
+}
+
+} // namespace storage
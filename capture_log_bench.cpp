@@ -0,0 +1,157 @@
+#include "capture_log.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <sys/stat.h>
+
+// Writes the same captures as one file per capture, the way they were
+// stored before CaptureLog, and through CaptureLog, then reports
+// throughput and write amplification for each. The log is read back and
+// checked.
+//
+//   capture_log_bench [captures] [scratch_dir]
+//
+// Point scratch_dir at the SD card for meaningful numbers; bytes submitted
+// to the block layer come from /proc/self/io.
+
+namespace fs = std::filesystem;
+
+struct Capture {
+    storage::RecordType type;
+    wifi::Bssid bssid;
+    std::vector<uint8_t> payload;
+};
+
+// Handshakes of a few hundred bytes to 1.5 KB, PMKIDs of about 100
+static std::vector<Capture> make_captures(size_t count) {
+    std::mt19937 rng(35);
+    std::vector<Capture> captures(count);
+    for (auto& capture : captures) {
+        bool handshake = rng() % 3 != 0;
+        capture.type = handshake ? storage::RecordType::HANDSHAKE : storage::RecordType::PMKID;
+        for (auto& b : capture.bssid.bytes) b = static_cast<uint8_t>(rng());
+        capture.payload.resize(handshake ? 300 + rng() % 1200 : 90 + rng() % 20);
+        for (auto& b : capture.payload) b = static_cast<uint8_t>(rng());
+    }
+    return captures;
+}
+
+// Bytes this process has caused to be sent to storage
+static uint64_t io_write_bytes() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value) {
+        if (key == "write_bytes:") return value;
+    }
+    return 0;
+}
+
+// Space taken on disk, whole blocks included
+static uint64_t allocated_bytes(const fs::path& dir) {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(dir, ec)) {
+        struct stat st;
+        if (::stat(entry.path().c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            total += static_cast<uint64_t>(st.st_blocks) * 512;
+        }
+    }
+    return total;
+}
+
+struct Result {
+    double seconds;
+    uint64_t block_bytes;   // /proc/self/io write_bytes delta
+    uint64_t allocated;
+};
+
+static void report(const char* name, const Result& result, size_t count, uint64_t payload) {
+    double mb = payload / 1e6;
+    std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(22) << name
+              << std::right << std::setw(9) << count / result.seconds << " captures/s "
+              << std::setw(7) << mb / result.seconds << " MB/s  block writes "
+              << static_cast<double>(result.block_bytes) / payload << "x  on disk "
+              << static_cast<double>(result.allocated) / payload << "x" << std::endl;
+}
+
+template <typename Fn>
+static Result measure(const fs::path& dir, Fn&& write) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    ::sync();
+    uint64_t before = io_write_bytes();
+    auto start = std::chrono::steady_clock::now();
+    write();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ::sync();
+    return Result{elapsed.count(), io_write_bytes() - before, allocated_bytes(dir)};
+}
+
+static void write_files(const fs::path& dir, const std::vector<Capture>& captures, bool durable) {
+    size_t n = 0;
+    for (const auto& capture : captures) {
+        auto path = dir / (capture.bssid.str() + "_" + std::to_string(n++) +
+                           (capture.type == storage::RecordType::PMKID ? ".pmkid" : ".hccapx"));
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) continue;
+        persist::detail::write_all(fd, capture.payload.data(), capture.payload.size());
+        if (durable) ::fdatasync(fd);
+        ::close(fd);
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+    const fs::path scratch = argc > 2 ? fs::path(argv[2])
+                                      : fs::temp_directory_path() / ("capture_log_bench." + std::to_string(::getpid()));
+    auto captures = make_captures(count);
+    uint64_t payload = 0;
+    for (const auto& capture : captures) payload += capture.payload.size();
+
+    std::cout << count << " captures, " << payload << " payload bytes" << std::endl;
+    Result plain = measure(scratch / "files", [&] { write_files(scratch / "files", captures, false); });
+    Result synced = measure(scratch / "files", [&] { write_files(scratch / "files", captures, true); });
+
+    storage::CaptureLog::Config config;
+    config.dir = scratch / "log";
+    storage::CaptureLogStats stats{};
+    Result logged = measure(config.dir, [&] {
+        storage::CaptureLog log;
+        CHECK(log.open(config), "open log");
+        for (const auto& capture : captures) {
+            log.append(capture.type, capture.bssid, "bench", 0, capture.payload);
+        }
+        log.flush();
+        stats = log.stats();
+    });
+
+    report("file per capture", plain, count, payload);
+    report("file per capture+sync", synced, count, payload);
+    report("capture log", logged, count, payload);
+    std::cout << "  capture log record overhead " << std::setprecision(3)
+              << stats.write_amplification() << "x (bytes written / payload)" << std::endl;
+
+    // Everything comes back intact and in order after a reopen
+    {
+        storage::CaptureLog log;
+        config.read_only = true;
+        CHECK(log.open(config), "reopen log");
+        auto entries = log.entries();
+        CHECK(entries.size() == captures.size(), "all captures indexed");
+        size_t mismatches = 0;
+        for (size_t i = 0; i < entries.size() && i < captures.size(); ++i) {
+            storage::CaptureRecord record;
+            if (!log.read(entries[i], record) || record.payload != captures[i].payload ||
+                record.bssid != captures[i].bssid || record.type != captures[i].type) {
+                mismatches++;
+            }
+        }
+        CHECK(mismatches == 0, "captures read back intact");
+    }
+    CHECK(stats.write_amplification() < 1.2, "record overhead under 20%");
+
+    fs::remove_all(scratch);
+    return testing::finish("capture_log_bench");
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "channel_scheduler.hpp"
+#include "wifi_types.hpp"
+
+// Offline evaluation of channel schedulers against recorded captures.
+// A trace is every frame a monitor interface heard, tagged with its
+// channel. Replaying it against a scheduler only delivers the frames on
+// the channel the scheduler is tuned to at that moment, so policies can
+// be compared on unique BSSes found per minute of capture.
+namespace channel {
+
+struct Frame {
+    std::chrono::microseconds at;  // from the first frame
+    uint8_t channel;
+    wifi::Bssid bssid;
+};
+
+struct Trace {
+    std::vector<Frame> frames;  // sorted by time
+    std::chrono::microseconds span{0};
+    uint64_t skipped{0};        // frames without a channel or BSSID
+};
+
+inline uint8_t mhz_to_channel(uint16_t mhz) {
+    if (mhz == 2484) return 14;
+    if (mhz >= 2412 && mhz < 2484) return static_cast<uint8_t>((mhz - 2407) / 5);
+    if (mhz >= 5000 && mhz < 5900) return static_cast<uint8_t>((mhz - 5000) / 5);
+    return 0;
+}
+
+namespace detail {
+
+inline uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+inline uint32_t le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Channel frequency from a radiotap header; 0 if absent. Only the fields
+// ahead of CHANNEL (TSFT, FLAGS, RATE) need walking over.
+inline uint16_t radiotap_mhz(const uint8_t* p, size_t len) {
+    if (len < 8) return 0;
+    uint32_t present = le32(p + 4);
+    if (!(present & (1u << 3))) return 0;
+    size_t offset = 8;
+    for (uint32_t word = present; word & (1u << 31); offset += 4) {
+        if (offset + 4 > len) return 0;
+        word = le32(p + offset);
+    }
+    if (present & (1u << 0)) offset = ((offset + 7) & ~size_t{7}) + 8;  // TSFT
+    if (present & (1u << 1)) offset += 1;                               // FLAGS
+    if (present & (1u << 2)) offset += 1;                               // RATE
+    offset = (offset + 1) & ~size_t{1};
+    if (offset + 2 > len) return 0;
+    return le16(p + offset);
+}
+
+// BSSID by frame type and DS bits; false for control and WDS frames
+inline bool frame_bssid(const uint8_t* p, size_t len, wifi::Bssid& out) {
+    if (len < 24) return false;
+    uint8_t type = (p[0] >> 2) & 0x3;
+    uint8_t ds = p[1] & 0x3;
+    const uint8_t* addr;
+    if (type == 0) {
+        addr = p + 16;
+    } else if (type == 2) {
+        switch (ds) {
+            case 0: addr = p + 16; break;  // IBSS
+            case 1: addr = p + 4; break;   // to AP
+            case 2: addr = p + 10; break;  // from AP
+            default: return false;
+        }
+    } else {
+        return false;
+    }
+    std::memcpy(out.bytes.data(), addr, 6);
+    return true;
+}
+
+} // namespace detail
+
+// Reads a radiotap pcap (as written by tcpdump/airodump on a monitor
+// interface). False if the file is not one; bad records are skipped.
+inline bool load_pcap(const std::filesystem::path& path, Trace& trace, std::string* error = nullptr) {
+    auto fail = [&](const char* why) {
+        if (error) *error = why;
+        return false;
+    };
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return fail("cannot open");
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 24) return fail("truncated header");
+
+    uint32_t magic = detail::le32(data.data());
+    bool nanos = magic == 0xa1b23c4d;
+    if (magic != 0xa1b2c3d4 && !nanos) return fail("not a little-endian pcap");
+    if (detail::le32(data.data() + 20) != 127) return fail("not radiotap (linktype 127)");
+
+    trace = Trace();
+    int64_t first = -1;
+    for (size_t pos = 24; pos + 16 <= data.size();) {
+        const uint8_t* rec = data.data() + pos;
+        int64_t sec = detail::le32(rec);
+        int64_t frac = detail::le32(rec + 4);
+        size_t caplen = detail::le32(rec + 8);
+        pos += 16;
+        if (pos + caplen > data.size()) break;
+        const uint8_t* pkt = data.data() + pos;
+        pos += caplen;
+
+        int64_t us = sec * 1000000 + (nanos ? frac / 1000 : frac);
+        if (first < 0) first = us;
+
+        if (caplen < 4) {
+            trace.skipped++;
+            continue;
+        }
+        size_t rt_len = detail::le16(pkt + 2);
+        uint8_t ch = rt_len <= caplen ? mhz_to_channel(detail::radiotap_mhz(pkt, rt_len)) : 0;
+        Frame frame{std::chrono::microseconds(us - first), ch, {}};
+        if (!ch || !detail::frame_bssid(pkt + rt_len, caplen - rt_len, frame.bssid)) {
+            trace.skipped++;
+            continue;
+        }
+        trace.frames.push_back(frame);
+    }
+    std::stable_sort(trace.frames.begin(), trace.frames.end(),
+                     [](const Frame& a, const Frame& b) { return a.at < b.at; });
+    if (!trace.frames.empty()) trace.span = trace.frames.back().at;
+    return true;
+}
+
+struct Evaluation {
+    Policy policy;
+    size_t unique_bsses;      // distinct BSSes heard at least once
+    size_t available_bsses;   // distinct BSSes anywhere in the trace
+    double bsses_per_minute;
+    uint64_t visits;
+    uint64_t frames_heard;
+    std::vector<ChannelStats> channels;
+};
+
+// Replays the trace on a virtual clock. Each hop costs switch_time of
+// deafness before frames on the new channel are heard.
+inline Evaluation evaluate(const Trace& trace, const ChannelScheduler::Config& cfg,
+                           std::chrono::milliseconds switch_time = std::chrono::milliseconds(5)) {
+    ChannelScheduler scheduler(cfg);
+    std::vector<std::vector<const Frame*>> by_channel(256);
+    std::unordered_set<wifi::Bssid> available;
+    for (const auto& frame : trace.frames) {
+        by_channel[frame.channel].push_back(&frame);
+        available.insert(frame.bssid);
+    }
+
+    Evaluation result{cfg.policy, 0, available.size(), 0.0, 0, 0, {}};
+    std::unordered_set<wifi::Bssid> heard;
+    const timesvc::MonoTime origin{};
+    std::chrono::microseconds clock{0};
+    while (clock < trace.span) {
+        Visit visit = scheduler.next(origin + clock);
+        result.visits++;
+        auto from = clock + switch_time;
+        auto until = std::min<std::chrono::microseconds>(clock + visit.dwell, trace.span + std::chrono::microseconds(1));
+
+        const auto& frames = by_channel[visit.channel];
+        auto it = std::lower_bound(frames.begin(), frames.end(), from,
+                                   [](const Frame* f, std::chrono::microseconds t) { return f->at < t; });
+        for (; it != frames.end() && (*it)->at < until; ++it) {
+            scheduler.on_frame((*it)->bssid, origin + (*it)->at);
+            heard.insert((*it)->bssid);
+            result.frames_heard++;
+        }
+        clock += std::max<std::chrono::microseconds>(visit.dwell, switch_time);
+    }
+    scheduler.end_visit(origin + clock);
+
+    double minutes = std::max(trace.span.count() / 60e6, 1e-6);
+    result.unique_bsses = heard.size();
+    result.bsses_per_minute = heard.size() / minutes;
+    result.channels = scheduler.stats();
+    return result;
+}
+
+// The configured policy next to the round-robin and uniform baselines
+inline std::vector<Evaluation> compare(const Trace& trace, ChannelScheduler::Config cfg,
+                                       std::chrono::milliseconds switch_time = std::chrono::milliseconds(5)) {
+    std::vector<Evaluation> results;
+    for (Policy policy : {Policy::BANDIT, Policy::ROUND_ROBIN, Policy::UNIFORM}) {
+        cfg.policy = policy;
+        results.push_back(evaluate(trace, cfg, switch_time));
+    }
+    return results;
+}
+
+} // namespace channel
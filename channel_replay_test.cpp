@@ -0,0 +1,139 @@
+#include "channel_replay.hpp"
+#include "test_support.hpp"
+#include <iomanip>
+#include <random>
+#include <unistd.h>
+
+// Replays traces through channel::compare and checks the bandit finds at
+// least as many BSSes as round-robin. Without arguments the trace is a
+// synthetic walk, written as a radiotap pcap and read back through
+// load_pcap; recorded monitor-mode captures can be given instead.
+//
+//   channel_replay_test [capture.pcap...]
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+static void put16(std::ofstream& out, uint16_t v) {
+    uint8_t b[2] = {static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8)};
+    out.write(reinterpret_cast<const char*>(b), 2);
+}
+
+static void put32(std::ofstream& out, uint32_t v) {
+    put16(out, static_cast<uint16_t>(v));
+    put16(out, static_cast<uint16_t>(v >> 16));
+}
+
+struct Beacon {
+    int64_t at_us;
+    uint8_t channel;
+    wifi::Bssid bssid;
+};
+
+// A walk past BSSes that come into range and leave again, most of them on
+// 1, 6 and 11; each beacons every 102.4 ms while in range
+static std::vector<Beacon> synthetic_walk(uint32_t seed, size_t bss_count, std::chrono::seconds span) {
+    std::mt19937 rng(seed);
+    std::discrete_distribution<int> channel_weight{0, 26, 2, 2, 2, 2, 30, 2, 2, 2, 2, 26, 2, 2};
+    std::uniform_int_distribution<int64_t> start(0, span.count() * 1000000);
+    std::uniform_int_distribution<int64_t> in_range(3000000, 25000000);
+    std::vector<Beacon> beacons;
+    for (size_t i = 0; i < bss_count; ++i) {
+        wifi::Bssid bssid;
+        for (auto& b : bssid.bytes) b = static_cast<uint8_t>(rng());
+        bssid.bytes[0] &= 0xFE;
+        auto channel = static_cast<uint8_t>(channel_weight(rng));
+        int64_t from = start(rng);
+        int64_t until = std::min<int64_t>(from + in_range(rng), span.count() * 1000000);
+        for (int64_t t = from; t < until; t += 102400) beacons.push_back({t, channel, bssid});
+    }
+    std::sort(beacons.begin(), beacons.end(), [](const Beacon& a, const Beacon& b) { return a.at_us < b.at_us; });
+    return beacons;
+}
+
+// Radiotap with only the channel field, then a beacon's 802.11 header
+static void write_pcap(const fs::path& path, const std::vector<Beacon>& beacons) {
+    std::ofstream out(path, std::ios::binary);
+    put32(out, 0xa1b2c3d4);
+    put16(out, 2);
+    put16(out, 4);
+    put32(out, 0);
+    put32(out, 0);
+    put32(out, 65535);
+    put32(out, 127);
+    for (const auto& beacon : beacons) {
+        int64_t at = beacon.at_us + 1700000000LL * 1000000;
+        put32(out, static_cast<uint32_t>(at / 1000000));
+        put32(out, static_cast<uint32_t>(at % 1000000));
+        put32(out, 12 + 24);
+        put32(out, 12 + 24);
+
+        put16(out, 0);   // version, pad
+        put16(out, 12);  // radiotap length
+        put32(out, 1u << 3);
+        put16(out, static_cast<uint16_t>(2407 + 5 * beacon.channel));
+        put16(out, 0x00a0);
+
+        uint8_t header[24] = {0x80, 0x00};
+        std::memset(header + 4, 0xFF, 6);
+        std::memcpy(header + 10, beacon.bssid.bytes.data(), 6);
+        std::memcpy(header + 16, beacon.bssid.bytes.data(), 6);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+}
+
+static void report(const std::string& name, const channel::Trace& trace,
+                   const std::vector<channel::Evaluation>& results) {
+    std::cout << name << ": " << trace.frames.size() << " frames over "
+              << trace.span.count() / 1e6 << " s, " << results[0].available_bsses << " BSSes\n";
+    for (const auto& result : results) {
+        std::cout << "  " << std::left << std::setw(12) << channel::to_string(result.policy) << std::right
+                  << std::setw(5) << result.unique_bsses << " found, " << std::fixed << std::setprecision(1)
+                  << std::setw(6) << result.bsses_per_minute << "/min, " << result.visits << " visits"
+                  << std::endl;
+    }
+}
+
+static std::vector<channel::Evaluation> check_trace(const std::string& name, const channel::Trace& trace) {
+    channel::ChannelScheduler::Config config;
+    config.seed = 46;
+    auto results = channel::compare(trace, config);
+    report(name, trace, results);
+    const auto& bandit = results[0];
+    const auto& round_robin = results[1];
+    CHECK(bandit.policy == channel::Policy::BANDIT && round_robin.policy == channel::Policy::ROUND_ROBIN,
+          name + ": policy order");
+    CHECK(bandit.unique_bsses >= round_robin.unique_bsses, name + ": bandit yield at least round-robin");
+    return results;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            channel::Trace trace;
+            std::string error;
+            bool loaded = channel::load_pcap(argv[i], trace, &error);
+            CHECK(loaded, std::string(argv[i]) + ": " + error);
+            if (loaded) check_trace(argv[i], trace);
+        }
+        return testing::finish("channel_replay_test");
+    }
+
+    const fs::path pcap = fs::temp_directory_path() / ("channel_replay_test." + std::to_string(::getpid()) + ".pcap");
+    for (uint32_t seed : {1u, 2u, 3u}) {
+        const size_t bss_count = 400;
+        auto beacons = synthetic_walk(seed, bss_count, 600s);
+        write_pcap(pcap, beacons);
+
+        channel::Trace trace;
+        CHECK(channel::load_pcap(pcap, trace), "synthetic pcap loads");
+        CHECK(trace.frames.size() == beacons.size() && trace.skipped == 0, "every beacon parsed");
+        CHECK(!trace.frames.empty() && trace.frames[0].channel == beacons[0].channel &&
+                  trace.frames[0].bssid == beacons[0].bssid,
+              "channel and BSSID from radiotap and header");
+        auto results = check_trace("walk seed " + std::to_string(seed), trace);
+        CHECK(results[0].available_bsses == bss_count, "every BSS in the trace");
+    }
+    fs::remove(pcap);
+    return testing::finish("channel_replay_test");
+}
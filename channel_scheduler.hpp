@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+#include "bounded_table.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
+
+// Activity-weighted channel hopping. New BSSes on a channel pile up
+// while the radio is elsewhere, so each channel keeps a discounted
+// estimate of its arrival rate: BSSes found per second away. The next
+// channel is the one whose expected backlog (rate x time since last
+// visit) per ms of dwell is highest, with a UCB bonus on the rate so
+// rarely seen channels still get explored, and no channel waits longer
+// than max_revisit. Dwell follows each channel's frame rate: busy
+// channels are held longer for handshakes, quiet ones are only listened
+// to for a few beacon intervals.
+namespace channel {
+
+enum class Policy : uint8_t {
+    BANDIT,        // discounted UCB with activity-weighted dwell
+    ROUND_ROBIN,   // fixed order, fixed dwell
+    UNIFORM        // uniformly random, fixed dwell
+};
+
+inline const char* to_string(Policy policy) {
+    switch (policy) {
+        case Policy::BANDIT: return "bandit";
+        case Policy::ROUND_ROBIN: return "round_robin";
+        case Policy::UNIFORM: return "uniform";
+    }
+    return "unknown";
+}
+
+struct Visit {
+    uint8_t channel;
+    std::chrono::milliseconds dwell;
+};
+
+struct ChannelStats {
+    uint8_t channel;
+    uint64_t visits;
+    uint64_t frames;
+    uint64_t new_bsses;
+    double frame_rate;       // frames/s, smoothed over visits
+    double arrival_rate;     // new BSSes per second away, discounted
+    std::chrono::milliseconds dwell_total;
+};
+
+class ChannelScheduler {
+public:
+    struct Config {
+        std::vector<uint8_t> channels{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+        Policy policy = Policy::BANDIT;
+        std::chrono::milliseconds base_dwell{500};   // for a channel of average activity
+        std::chrono::milliseconds min_dwell{150};    // covers at least one beacon interval
+        std::chrono::milliseconds max_dwell{2000};
+        std::chrono::milliseconds max_revisit{15000};  // no channel waits longer
+        double discount = 0.98;      // per visit; lets old activity fade
+        double exploration = 0.5;    // UCB bonus scale, relative to the best rate
+        size_t bss_capacity = 2048;
+        std::chrono::seconds bss_forget{300};  // heard again after this counts as new
+        uint32_t seed = 0;
+    };
+
+private:
+    struct Arm {
+        uint8_t channel;
+        double pulls{0.0};     // discounted visit count
+        double found{0.0};     // discounted new BSSes
+        double exposure{0.0};  // discounted seconds those accumulated over
+        double frame_rate{0.0};
+        uint64_t visits{0};
+        uint64_t frames{0};
+        uint64_t new_bsses{0};
+        timesvc::MonoTime last_visit{};  // end of the latest visit
+        std::chrono::milliseconds dwell_total{0};
+    };
+
+    Config config;
+    std::vector<Arm> arms;
+    bounded::BoundedTable<wifi::Bssid, timesvc::MonoTime> seen;
+    std::mt19937 rng;
+    mutable std::mutex mutex;
+    bool started{false};
+    timesvc::MonoTime first_visit{};
+
+    // The visit in progress
+    bool visiting{false};
+    size_t current{0};
+    size_t next_index{0};  // round-robin position
+    timesvc::MonoTime visit_start{};
+    uint64_t visit_frames{0};
+    uint64_t visit_new{0};
+
+    static constexpr double RATE_ALPHA = 0.3;
+
+    static double seconds(timesvc::MonoTime::duration d) {
+        return std::chrono::duration<double>(d).count();
+    }
+
+    // New BSSes per second away from the channel
+    static double arrival_rate(const Arm& arm) {
+        return arm.exposure > 0 ? arm.found / arm.exposure : 0.0;
+    }
+
+    void close_visit(timesvc::MonoTime now) {
+        if (!visiting) return;
+        visiting = false;
+        Arm& arm = arms[current];
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - visit_start);
+        // What was found accumulated since we last left the channel
+        auto since = arm.visits > 1 ? arm.last_visit : first_visit;
+        double window = std::max(0.001, seconds(now - since));
+
+        for (auto& other : arms) {
+            other.pulls *= config.discount;
+            other.found *= config.discount;
+            other.exposure *= config.discount;
+        }
+        arm.pulls += 1.0;
+        arm.found += visit_new;
+        arm.exposure += std::min(window, seconds(config.bss_forget));
+        double dwell = std::max(0.001, seconds(elapsed));
+        arm.frame_rate += RATE_ALPHA * (visit_frames / dwell - arm.frame_rate);
+        arm.dwell_total += elapsed;
+        arm.last_visit = now;
+    }
+
+    // Unvisited first, then the most overdue, then the best expected yield
+    size_t pick_bandit(timesvc::MonoTime now) const {
+        for (size_t i = 0; i < arms.size(); ++i) {
+            if (arms[i].visits == 0) return i;
+        }
+
+        size_t overdue = arms.size();
+        auto worst = config.max_revisit;
+        for (size_t i = 0; i < arms.size(); ++i) {
+            auto waiting = std::chrono::duration_cast<std::chrono::milliseconds>(now - arms[i].last_visit);
+            if (waiting >= worst && i != current) {
+                worst = waiting;
+                overdue = i;
+            }
+        }
+        if (overdue < arms.size()) return overdue;
+
+        double total = 0.0;
+        double best_rate = 0.0;
+        for (const auto& arm : arms) {
+            total += arm.pulls;
+            best_rate = std::max(best_rate, arrival_rate(arm));
+        }
+        // Bonus in units of the best rate, so exploration keeps pace
+        // with how busy the air is
+        double scale = config.exploration * std::max(best_rate, 1e-3);
+        size_t best = current;
+        double best_score = -1.0;
+        for (size_t i = 0; i < arms.size(); ++i) {
+            if (i == current && arms.size() > 1) continue;  // a hop, not a stay
+            const Arm& arm = arms[i];
+            double bonus = scale * std::sqrt(std::log(total + 1.0) / std::max(arm.pulls, 1e-3));
+            double backlog = (arrival_rate(arm) + bonus) * seconds(now - arm.last_visit);
+            double score = backlog / dwell_for(i).count();
+            if (score > best_score) {
+                best_score = score;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // Busier channels are held longer; sqrt keeps one hot channel from
+    // taking all the air time
+    std::chrono::milliseconds dwell_for(size_t i) const {
+        if (config.policy != Policy::BANDIT || arms[i].visits == 0) return config.base_dwell;
+        double average = 0.0;
+        for (const auto& arm : arms) average += arm.frame_rate;
+        average /= arms.size();
+        if (average <= 0.0) return config.min_dwell;
+        double share = std::sqrt(arms[i].frame_rate / average);
+        auto dwell = std::chrono::milliseconds(
+            static_cast<int64_t>(config.base_dwell.count() * share));
+        return std::clamp(dwell, config.min_dwell, config.max_dwell);
+    }
+
+public:
+    ChannelScheduler() : ChannelScheduler(Config()) {}
+
+    explicit ChannelScheduler(const Config& cfg)
+        : config(cfg), seen(cfg.bss_capacity),
+          rng(cfg.seed ? cfg.seed : std::random_device{}()) {
+        if (config.channels.empty()) config.channels = {1, 6, 11};
+        for (uint8_t ch : config.channels) arms.push_back(Arm{ch});
+    }
+
+    // Closes the visit in progress and starts the next one
+    Visit next(timesvc::MonoTime now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        close_visit(now);
+
+        size_t i = 0;
+        switch (config.policy) {
+            case Policy::BANDIT:
+                i = pick_bandit(now);
+                break;
+            case Policy::ROUND_ROBIN:
+                i = next_index++ % arms.size();
+                break;
+            case Policy::UNIFORM:
+                i = std::uniform_int_distribution<size_t>(0, arms.size() - 1)(rng);
+                break;
+        }
+
+        current = i;
+        visiting = true;
+        visit_start = now;
+        visit_frames = 0;
+        visit_new = 0;
+        if (!started) {
+            started = true;
+            first_visit = now;
+        }
+        arms[i].visits++;
+        return Visit{arms[i].channel, dwell_for(i)};
+    }
+
+    // A frame heard while visiting; counts toward the current channel
+    void on_frame(const wifi::Bssid& bssid, timesvc::MonoTime now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!visiting) return;
+        Arm& arm = arms[current];
+        arm.frames++;
+        visit_frames++;
+
+        timesvc::MonoTime* last = seen.find(bssid);
+        if (!last || now - *last >= config.bss_forget) {
+            arm.new_bsses++;
+            visit_new++;
+        }
+        seen.upsert(bssid) = now;
+    }
+
+    // Ends the current visit without starting another (e.g. on pause)
+    void end_visit(timesvc::MonoTime now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        close_visit(now);
+    }
+
+    // Seeds base dwell from config without rebuilding the scheduler
+    void set_base_dwell(std::chrono::milliseconds dwell) {
+        std::lock_guard<std::mutex> lock(mutex);
+        config.base_dwell = std::clamp(dwell, config.min_dwell, config.max_dwell);
+    }
+
+    uint8_t current_channel() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return arms[current].channel;
+    }
+
+    std::vector<ChannelStats> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ChannelStats> out;
+        out.reserve(arms.size());
+        for (const auto& arm : arms) {
+            out.push_back(ChannelStats{arm.channel, arm.visits, arm.frames, arm.new_bsses,
+                                       arm.frame_rate, arrival_rate(arm), arm.dwell_total});
+        }
+        return out;
+    }
+
+    const Config& get_config() const { return config; }
+};
+
+} // namespace channel
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "logger.hpp"
+#include "rcu_snapshot.hpp"
+#include "reactor.hpp"
+#include "write_scheduler.hpp"
+
+// Typed runtime configuration. config.txt is parsed once per change into an
+// immutable Settings snapshot that readers pin through RCU, so nothing
+// re-parses strings at runtime. An inotify watch on the config directory
+// republishes the snapshot when the file is replaced or rewritten, and
+// subscribers are told when the fields they registered for change.
+namespace config {
+
+struct Settings {
+    // Display and main loop
+    uint32_t display_refresh_hz = 0;     // 0: the display's own default
+    uint32_t dwell_ms = 500;             // main loop period, i.e. time per channel
+    uint32_t state_save_epochs = 5;
+
+    // Storage
+    uint32_t max_capture_files = 1000;
+    uint64_t min_free_mb = 100;
+    uint64_t log_rotate_mb = 50;
+
+    // Logging and card writes
+    logging::Level log_level = logging::Level::INFO;
+    uint32_t write_normal_ms = 5000;
+    uint32_t write_lazy_ms = 60000;
+    uint32_t write_block_size = 4096;
+
+    // Keys this build does not know, kept so saving does not drop them
+    std::map<std::string, std::string> extra;
+};
+
+// One config.txt key: how to parse it into Settings, print it back and
+// tell whether two snapshots differ in it
+struct Field {
+    const char* key;
+    std::function<bool(Settings&, std::string_view)> parse;
+    std::function<std::string(const Settings&)> print;
+    std::function<bool(const Settings&, const Settings&)> same;
+};
+
+template <typename T>
+inline Field number_field(const char* key, T Settings::*member, T min, T max) {
+    return Field{
+        key,
+        [=](Settings& settings, std::string_view text) {
+            T value{};
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec != std::errc() || end != text.data() + text.size() || value < min || value > max) {
+                return false;
+            }
+            settings.*member = value;
+            return true;
+        },
+        [=](const Settings& settings) { return std::to_string(settings.*member); },
+        [=](const Settings& a, const Settings& b) { return a.*member == b.*member; }};
+}
+
+template <typename T>
+inline Field choice_field(const char* key, T Settings::*member,
+                          std::vector<std::pair<const char*, T>> choices) {
+    return Field{
+        key,
+        [=](Settings& settings, std::string_view text) {
+            for (const auto& [name, value] : choices) {
+                if (text == name) {
+                    settings.*member = value;
+                    return true;
+                }
+            }
+            return false;
+        },
+        [=](const Settings& settings) {
+            for (const auto& [name, value] : choices) {
+                if (settings.*member == value) return std::string(name);
+            }
+            return std::string();
+        },
+        [=](const Settings& a, const Settings& b) { return a.*member == b.*member; }};
+}
+
+// Every known key, with its valid range
+inline const std::vector<Field>& schema() {
+    static const std::vector<Field> fields = {
+        number_field<uint32_t>("display_refresh_hz", &Settings::display_refresh_hz, 0, 60),
+        number_field<uint32_t>("dwell_ms", &Settings::dwell_ms, 50, 60000),
+        number_field<uint32_t>("state_save_epochs", &Settings::state_save_epochs, 1, 10000),
+        number_field<uint32_t>("max_capture_files", &Settings::max_capture_files, 1, 1000000),
+        number_field<uint64_t>("min_free_mb", &Settings::min_free_mb, 0, 1 << 20),
+        number_field<uint64_t>("log_rotate_mb", &Settings::log_rotate_mb, 1, 4096),
+        choice_field<logging::Level>("log_level", &Settings::log_level,
+                                     {{"debug", logging::Level::DEBUG}, {"info", logging::Level::INFO},
+                                      {"warn", logging::Level::WARN}, {"error", logging::Level::ERROR}}),
+        number_field<uint32_t>("write_normal_ms", &Settings::write_normal_ms, 100, 3600000),
+        number_field<uint32_t>("write_lazy_ms", &Settings::write_lazy_ms, 1000, 86400000),
+        number_field<uint32_t>("write_block_size", &Settings::write_block_size, 512, 1 << 20),
+    };
+    return fields;
+}
+
+inline const Field* find_field(std::string_view key) {
+    for (const auto& field : schema()) {
+        if (key == field.key) return &field;
+    }
+    return nullptr;
+}
+
+inline bool same_settings(const Settings& a, const Settings& b) {
+    for (const auto& field : schema()) {
+        if (!field.same(a, b)) return false;
+    }
+    return a.extra == b.extra;
+}
+
+struct ParseResult {
+    Settings settings;
+    std::vector<std::string> errors;  // one per rejected line; the rest still applies
+};
+
+inline std::string_view trim(std::string_view text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) return {};
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Parses key=value lines over the defaults, so a key removed from the file
+// goes back to its default. A bad value keeps fallback's value for that key
+// instead, so a typo during a reload does not reset it.
+inline ParseResult parse(std::string_view text, const Settings& fallback) {
+    ParseResult result{Settings(), {}};
+    std::vector<const Field*> accepted, rejected;
+    size_t line_number = 0;
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        std::string_view line = trim(text.substr(0, newline));
+        text = newline == std::string_view::npos ? std::string_view() : text.substr(newline + 1);
+        line_number++;
+        if (line.empty() || line[0] == '#') continue;
+
+        size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            result.errors.push_back("line " + std::to_string(line_number) + ": expected key=value");
+            continue;
+        }
+        std::string_view key = trim(line.substr(0, equals));
+        std::string_view value = trim(line.substr(equals + 1));
+        const Field* field = find_field(key);
+        if (!field) {
+            result.settings.extra[std::string(key)] = std::string(value);
+        } else if (field->parse(result.settings, value)) {
+            accepted.push_back(field);
+        } else {
+            rejected.push_back(field);
+            result.errors.push_back("line " + std::to_string(line_number) + ": invalid " +
+                                    std::string(key) + " '" + std::string(value) + "'");
+        }
+    }
+    for (const Field* field : rejected) {
+        if (std::find(accepted.begin(), accepted.end(), field) == accepted.end()) {
+            field->parse(result.settings, field->print(fallback));
+        }
+    }
+    return result;
+}
+
+inline std::string render(const Settings& settings) {
+    std::string text;
+    for (const auto& field : schema()) {
+        text += field.key;
+        text += '=';
+        text += field.print(settings);
+        text += '\n';
+    }
+    for (const auto& [key, value] : settings.extra) {
+        text += key + "=" + value + "\n";
+    }
+    return text;
+}
+
+struct StoreStats {
+    uint64_t version;
+    uint64_t reloads;       // file changes that produced a new snapshot
+    uint64_t unchanged;     // file events that parsed to the same settings
+    uint64_t rejected_lines;
+    size_t subscribers;
+};
+
+class ConfigStore {
+public:
+    using Callback = std::function<void(const Settings&)>;
+    using ReadGuard = rcu::SnapshotPublisher<Settings>::ReadGuard;
+
+private:
+    struct Subscription {
+        uint64_t id;
+        std::vector<const Field*> fields;  // empty: every change
+        Callback callback;
+    };
+
+    std::filesystem::path path;
+    rcu::SnapshotPublisher<Settings> snapshots;
+
+    std::mutex update_mutex;  // serializes reload/update and the subscriber list
+    std::vector<Subscription> subscriptions;
+    uint64_t next_subscription{1};
+
+    runtime::Reactor* reactor;
+    int inotify_fd{-1};
+
+    uint64_t reload_count{0};
+    uint64_t unchanged_count{0};
+    uint64_t rejected_count{0};
+
+    static bool touches(const Subscription& subscription, const Settings& before, const Settings& after) {
+        if (subscription.fields.empty()) return true;
+        for (const Field* field : subscription.fields) {
+            if (!field->same(before, after)) return true;
+        }
+        return false;
+    }
+
+    // Publishes next if it differs from the current snapshot and tells the
+    // affected subscribers; update_mutex must be held
+    bool publish_locked(Settings next) {
+        auto current = snapshots.read();
+        if (current && same_settings(*current, next)) {
+            unchanged_count++;
+            return false;
+        }
+        Settings before = current ? *current : Settings();
+        bool first = !current;
+        snapshots.publish(next);
+        if (!first) reload_count++;
+
+        for (const auto& subscription : subscriptions) {
+            if (first || touches(subscription, before, next)) subscription.callback(next);
+        }
+        return true;
+    }
+
+    // Runs on the loop when the directory has events
+    void watch_ready() {
+        alignas(struct inotify_event) char buffer[4096];
+        std::string name = path.filename().string();
+        bool changed = false;
+        ssize_t n;
+        while ((n = ::read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + n;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && name == event->name)) {
+                    changed = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (changed) reload();
+    }
+
+public:
+    // Watches from events, the process loop by default
+    explicit ConfigStore(runtime::Reactor* events = nullptr)
+        : reactor(events ? events : &runtime::Reactor::shared()) {}
+    ~ConfigStore() { stop_watching(); }
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    // Loads file (defaults if it is missing) and publishes the first snapshot
+    std::vector<std::string> open(const std::filesystem::path& file) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        path = file;
+        std::ifstream in(path);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        ParseResult result = parse(contents.str(), Settings());
+        rejected_count += result.errors.size();
+        publish_locked(std::move(result.settings));
+        return result.errors;
+    }
+
+    // Watches the file's directory, since editors and the write scheduler
+    // replace files by renaming a temp file over them
+    bool start_watching() {
+        if (inotify_fd >= 0) return true;
+        inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) return false;
+        auto dir = path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path();
+        if (::inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+            !reactor->add_fd(inotify_fd, EPOLLIN, [this](uint32_t) { watch_ready(); })) {
+            ::close(inotify_fd);
+            inotify_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void stop_watching() {
+        if (inotify_fd < 0) return;
+        // No reload is running from the watch once this returns
+        reactor->call([this] { reactor->remove_fd(inotify_fd); });
+        ::close(inotify_fd);
+        inotify_fd = -1;
+    }
+
+    // Re-reads the file; keeps the current snapshot if the file is gone.
+    // Returns true if a new snapshot was published.
+    bool reload() {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::stringstream contents;
+        contents << in.rdbuf();
+
+        std::lock_guard<std::mutex> lock(update_mutex);
+        auto current = snapshots.read();
+        ParseResult result = parse(contents.str(), current ? *current : Settings());
+        rejected_count += result.errors.size();
+        for (const auto& error : result.errors) {
+            logging::warn("{}: {}", path.string(), error);
+        }
+        return publish_locked(std::move(result.settings));
+    }
+
+    // Publishes programmatic changes; save() writes them to the file
+    bool update(const std::function<void(Settings&)>& change) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        auto current = snapshots.read();
+        Settings next = current ? *current : Settings();
+        change(next);
+        return publish_locked(std::move(next));
+    }
+
+    bool save(persist::WriteScheduler* writes = nullptr) {
+        return persist::save_file(writes, "config", path, render(*snapshots.read()),
+                                  persist::Durability::NORMAL);
+    }
+
+    // Pins the current snapshot; cheap, but do not hold it across sleeps
+    ReadGuard current() const {
+        return snapshots.read();
+    }
+
+    uint64_t version() const {
+        return snapshots.version();
+    }
+
+    // Runs callback now with the current settings and again, on the loop
+    // thread for edits the watch picks up, whenever one of keys changes
+    // (any change if keys is empty). Unknown keys are ignored. Callbacks
+    // must not call update().
+    uint64_t subscribe(std::initializer_list<const char*> keys, Callback callback) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        Subscription subscription{next_subscription++, {}, std::move(callback)};
+        for (const char* key : keys) {
+            if (const Field* field = find_field(key)) subscription.fields.push_back(field);
+        }
+        if (auto current = snapshots.read()) subscription.callback(*current);
+        subscriptions.push_back(std::move(subscription));
+        return subscriptions.back().id;
+    }
+
+    void unsubscribe(uint64_t id) {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(),
+                                           [id](const Subscription& s) { return s.id == id; }),
+                            subscriptions.end());
+    }
+
+    StoreStats stats() {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        return StoreStats{snapshots.version(), reload_count, unchanged_count,
+                          rejected_count, subscriptions.size()};
+    }
+};
+
+} // namespace config
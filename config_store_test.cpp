@@ -0,0 +1,74 @@
+#include "config_store.hpp"
+#include "test_support.hpp"
+#include <unistd.h>
+
+// Reload semantics of config::ConfigStore: removed keys go back to their
+// defaults, rejected lines keep the previous value, and the watcher picks
+// up a file renamed over config.txt.
+
+namespace fs = std::filesystem;
+
+static void write_config(const fs::path& path, const std::string& text) {
+    fs::path temp = path.string() + ".tmp";
+    std::ofstream(temp) << text;
+    fs::rename(temp, path);
+}
+
+static void check_reload(const fs::path& path) {
+    const config::Settings defaults;
+    write_config(path, "dwell_ms=700\nlog_level=debug\nmin_free_mb=250\ncustom_key=kept\n");
+
+    config::ConfigStore store;
+    CHECK(store.open(path).empty(), "initial file parses cleanly");
+    CHECK(store.current()->dwell_ms == 700, "dwell_ms loaded");
+    CHECK(store.current()->extra.count("custom_key") == 1, "unknown key kept");
+
+    std::vector<uint32_t> dwell_seen;
+    store.subscribe({"dwell_ms"}, [&](const config::Settings& s) { dwell_seen.push_back(s.dwell_ms); });
+
+    // dwell_ms and custom_key deleted, log_level mistyped, min_free_mb edited
+    write_config(path, "log_level=verbose\nmin_free_mb=300\n");
+    CHECK(store.reload(), "reload publishes");
+    auto settings = store.current();
+    CHECK(settings->dwell_ms == defaults.dwell_ms, "deleted key back to its default");
+    CHECK(settings->log_level == logging::Level::DEBUG, "rejected line keeps the previous value");
+    CHECK(settings->min_free_mb == 300, "edited key applied");
+    CHECK(settings->extra.empty(), "deleted unknown key dropped");
+    CHECK(store.stats().rejected_lines == 1, "one rejected line counted");
+    CHECK(dwell_seen.size() == 2 && dwell_seen.back() == defaults.dwell_ms,
+          "subscriber told about the reset");
+
+    // A bad line after a good one for the same key keeps the good value
+    write_config(path, "log_level=warn\nlog_level=loud\n");
+    store.reload();
+    CHECK(store.current()->log_level == logging::Level::WARN, "last accepted value wins");
+
+    // The same content again publishes nothing
+    uint64_t version = store.version();
+    CHECK(!store.reload(), "unchanged file");
+    CHECK(store.version() == version, "no new snapshot");
+}
+
+static void check_watcher(const fs::path& path) {
+    write_config(path, "dwell_ms=900\n");
+    config::ConfigStore store;
+    store.open(path);
+    CHECK(store.start_watching(), "watch starts");
+
+    write_config(path, "state_save_epochs=7\n");
+    for (int i = 0; i < 200 && store.current()->state_save_epochs != 7; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(store.current()->state_save_epochs == 7, "rename over the file reloads");
+    CHECK(store.current()->dwell_ms == config::Settings().dwell_ms, "dropped key reset by the watcher");
+    store.stop_watching();
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("config_store_test." + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    check_reload(dir / "config.txt");
+    check_watcher(dir / "config.txt");
+    fs::remove_all(dir);
+    return testing::finish("config_store_test");
+}
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "logger.hpp"
+#include "power_telemetry.hpp"
+#include "reactor.hpp"
+#include "time_service.hpp"
+
+// Closed-loop CPU frequency control. Every interval the controller turns
+// pipeline backlog, recent NN training, battery and temperature into one
+// of three levels, then applies it to every cpufreq policy (all cores)
+// as a governor plus min/max frequency. Raising the level is immediate.
+// Lowering it waits until the lower level has been wanted for `hold`.
+// Thermal throttling has its own on/off thresholds.
+namespace power {
+
+enum class Level : uint8_t { POWERSAVE, BALANCED, PERFORMANCE };
+
+inline const char* to_string(Level level) {
+    switch (level) {
+        case Level::POWERSAVE: return "powersave";
+        case Level::BALANCED: return "balanced";
+        case Level::PERFORMANCE: return "performance";
+    }
+    return "unknown";
+}
+
+// What the controller decides from; filled from reports and telemetry
+struct Signals {
+    double backlog = 0.0;       // pipeline queue fill, 0..1
+    bool training = false;      // NN training ran within the training window
+    bool has_battery = false;
+    int64_t battery_percent = 100;
+    bool charging = false;
+    bool has_temperature = false;
+    int64_t temperature_mc = 0;
+};
+
+// The rules; set_policy() swaps them at runtime
+struct Policy {
+    bool low_power = false;                 // user asked for powersave; overrides demand
+    double burst_backlog = 0.75;            // backlog at or above: performance
+    double idle_backlog = 0.10;             // at or below, and no training: powersave
+    bool burst_training_when_charging = true;
+    bool train_on_battery = true;           // false: training alone never raises the level on battery
+    int64_t low_battery_percent = 20;       // discharging at or below: powersave
+    int64_t throttle_mc = 75000;            // throttle at or above
+    int64_t release_mc = 68000;             // release at or below
+    double thermal_cap = 0.6;               // max frequency while throttled, fraction of range
+    std::chrono::milliseconds hold{10000};  // a lower level must be wanted this long
+};
+
+struct Decision {
+    Level level;
+    bool throttled;
+    const char* reason;
+};
+
+struct CpuFreqStats {
+    uint64_t evaluations;
+    uint64_t transitions;
+    uint64_t writes;          // sysfs attribute writes
+    uint64_t write_failures;
+    Level level;
+    bool throttled;
+    size_t policies;          // cpufreq policies under control
+};
+
+// One cpufreq policy directory; shared by the cores it lists
+class CpuPolicy {
+private:
+    std::filesystem::path dir;
+    std::vector<std::string> governors;
+    uint64_t min_khz{0};
+    uint64_t max_khz{0};
+
+    // Last values written, so unchanged settings cost nothing
+    std::string applied_governor;
+    uint64_t applied_min{0};
+    uint64_t applied_max{0};
+
+    // As found at discovery; put back by restore()
+    std::string original_governor;
+    uint64_t original_min{0};
+    uint64_t original_max{0};
+
+    static std::string read_text(const std::filesystem::path& file) {
+        std::ifstream in(file);
+        std::string text;
+        std::getline(in, text);
+        return text;
+    }
+
+    static uint64_t read_number(const std::filesystem::path& file) {
+        std::string text = read_text(file);
+        return text.empty() ? 0 : std::strtoull(text.c_str(), nullptr, 10);
+    }
+
+    bool write(const char* attribute, const std::string& value, uint64_t& writes) {
+        auto file = dir / attribute;
+        int fd = ::open(file.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        if (fd < 0) return false;
+        bool ok = persist::detail::write_all(fd, reinterpret_cast<const uint8_t*>(value.data()),
+                                             value.size());
+        ok = (::close(fd) == 0) && ok;
+        writes++;
+        return ok;
+    }
+
+    // Writes what differs from the last applied values, frequency limits
+    // in an order that keeps min <= max at every step. A failed write
+    // leaves applied_* stale, so the next pass retries it.
+    bool set(const std::string& governor, uint64_t low, uint64_t high, uint64_t& writes) {
+        bool ok = true;
+        if (governor != applied_governor) {
+            if (write("scaling_governor", governor, writes)) {
+                applied_governor = governor;
+            } else {
+                ok = false;
+            }
+        }
+        auto limit = [&](const char* attribute, uint64_t value, uint64_t& applied) {
+            if (value == applied) return;
+            if (write(attribute, std::to_string(value), writes)) {
+                applied = value;
+            } else {
+                ok = false;
+            }
+        };
+        if (low > applied_max) {
+            limit("scaling_max_freq", high, applied_max);
+            limit("scaling_min_freq", low, applied_min);
+        } else {
+            limit("scaling_min_freq", low, applied_min);
+            limit("scaling_max_freq", high, applied_max);
+        }
+        return ok;
+    }
+
+public:
+    explicit CpuPolicy(std::filesystem::path policy_dir) : dir(std::move(policy_dir)) {
+        std::istringstream available(read_text(dir / "scaling_available_governors"));
+        for (std::string name; available >> name;) governors.push_back(name);
+        min_khz = read_number(dir / "cpuinfo_min_freq");
+        max_khz = read_number(dir / "cpuinfo_max_freq");
+        applied_governor = original_governor = read_text(dir / "scaling_governor");
+        applied_min = original_min = read_number(dir / "scaling_min_freq");
+        applied_max = original_max = read_number(dir / "scaling_max_freq");
+    }
+
+    bool usable() const { return max_khz > 0 && max_khz >= min_khz; }
+
+    // First of the preferred governors the kernel offers, else the current
+    std::string pick(std::initializer_list<const char*> preferred) const {
+        for (const char* name : preferred) {
+            if (std::find(governors.begin(), governors.end(), name) != governors.end()) return name;
+        }
+        return applied_governor;
+    }
+
+    // Applies a level. Returns false if any write failed.
+    bool apply(Level level, bool throttled, double thermal_cap, uint64_t& writes) {
+        uint64_t cap = throttled ? min_khz + static_cast<uint64_t>((max_khz - min_khz) * thermal_cap)
+                                 : max_khz;
+        std::string governor;
+        uint64_t low = min_khz;
+        uint64_t high = cap;
+        switch (level) {
+            case Level::POWERSAVE:
+                governor = pick({"powersave", "conservative", "schedutil", "ondemand"});
+                if (governor != "powersave") high = min_khz;
+                break;
+            case Level::BALANCED:
+                governor = pick({"schedutil", "ondemand", "conservative"});
+                break;
+            case Level::PERFORMANCE:
+                governor = pick({"performance", "schedutil", "ondemand"});
+                if (governor != "performance") low = high;
+                break;
+        }
+        return set(governor, low, high, writes);
+    }
+
+    // Puts back the governor and limits found at discovery
+    bool restore(uint64_t& writes) {
+        if (original_governor.empty() || original_max == 0) return true;
+        return set(original_governor, original_min, original_max, writes);
+    }
+
+    const std::filesystem::path& get_dir() const { return dir; }
+};
+
+class CpuFreqController {
+public:
+    struct Config {
+        std::filesystem::path root = "/sys";  // point at a fake tree for tests
+        std::chrono::milliseconds interval{2000};
+        std::chrono::milliseconds training_window{5000};  // training counts this long after a report
+        bool charging_current_positive = true;  // sign of current_now while charging
+    };
+
+private:
+    Config config;
+    Policy policy;
+    std::vector<CpuPolicy> policies;
+    const Telemetry* telemetry{nullptr};
+
+    std::atomic<double> backlog{0.0};
+    std::atomic<int64_t> last_training_ns{0};
+
+    // Hysteresis state
+    Level level{Level::BALANCED};
+    bool throttled{false};
+    bool lower_pending{false};
+    timesvc::MonoTime lower_since{};
+    timesvc::MonoTime override_until{};
+    Level override_level{Level::BALANCED};
+    bool applied_once{false};
+
+    uint64_t evaluations{0};
+    uint64_t transitions{0};
+    uint64_t writes{0};
+    uint64_t write_failures{0};
+
+    mutable std::mutex mutex;  // everything above except the two atomics
+    bool running{false};
+    runtime::Reactor* reactor;
+    runtime::TimerId step_timer{0};
+
+    void discover() {
+        policies.clear();
+        std::error_code ec;
+        auto cpu = config.root / "devices/system/cpu";
+        std::vector<std::filesystem::path> dirs;
+        for (const auto& entry : std::filesystem::directory_iterator(cpu / "cpufreq", ec)) {
+            if (entry.path().filename().string().rfind("policy", 0) == 0) dirs.push_back(entry.path());
+        }
+        // Older kernels only expose cpuN/cpufreq; cores sharing a policy
+        // link to the same directory
+        if (dirs.empty()) {
+            for (const auto& entry : std::filesystem::directory_iterator(cpu, ec)) {
+                auto name = entry.path().filename().string();
+                auto dir = entry.path() / "cpufreq";
+                if (name.rfind("cpu", 0) != 0 || !std::filesystem::exists(dir, ec)) continue;
+                auto canonical = std::filesystem::canonical(dir, ec);
+                if (!ec && std::find(dirs.begin(), dirs.end(), canonical) == dirs.end()) {
+                    dirs.push_back(canonical);
+                }
+            }
+        }
+        std::sort(dirs.begin(), dirs.end());
+        for (const auto& dir : dirs) {
+            CpuPolicy cpu_policy(dir);
+            if (cpu_policy.usable()) policies.push_back(std::move(cpu_policy));
+        }
+    }
+
+    Signals gather(timesvc::MonoTime now) const {
+        Signals signals;
+        signals.backlog = backlog.load(std::memory_order_relaxed);
+        int64_t trained = last_training_ns.load(std::memory_order_relaxed);
+        signals.training = trained != 0 &&
+                           now.time_since_epoch() - std::chrono::nanoseconds(trained) <
+                               config.training_window;
+        if (telemetry) {
+            signals.has_battery = telemetry->has(Metric::BATTERY_PERCENT);
+            signals.battery_percent = telemetry->get(Metric::BATTERY_PERCENT, 100);
+            int64_t current = telemetry->get(Metric::BATTERY_CURRENT, 0);
+            signals.charging = config.charging_current_positive ? current > 0 : current < 0;
+            signals.has_temperature = telemetry->has(Metric::CPU_TEMPERATURE);
+            signals.temperature_mc = telemetry->get(Metric::CPU_TEMPERATURE, 0);
+        }
+        return signals;
+    }
+
+    // The level the signals ask for, before hysteresis
+    Decision want(const Signals& s) const {
+        if (policy.low_power) return {Level::POWERSAVE, throttled, "low power mode"};
+        if (s.has_battery && !s.charging && s.battery_percent <= policy.low_battery_percent) {
+            return {Level::POWERSAVE, throttled, "battery low"};
+        }
+        if (s.backlog >= policy.burst_backlog) return {Level::PERFORMANCE, throttled, "backlog"};
+        if (s.training && s.charging && policy.burst_training_when_charging) {
+            return {Level::PERFORMANCE, throttled, "training while charging"};
+        }
+        if (s.training && (s.charging || !s.has_battery || policy.train_on_battery)) {
+            return {Level::BALANCED, throttled, "training"};
+        }
+        if (s.backlog <= policy.idle_backlog) return {Level::POWERSAVE, throttled, "idle"};
+        return {Level::BALANCED, throttled, "load"};
+    }
+
+    void apply_locked() {
+        bool ok = true;
+        for (auto& cpu_policy : policies) {
+            ok = cpu_policy.apply(level, throttled, policy.thermal_cap, writes) && ok;
+        }
+        if (!ok) write_failures++;
+    }
+
+    // On the loop, every interval while started
+    void tick() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) return;
+        }
+        step(timesvc::precise_now());
+    }
+
+public:
+    // Steps from events, the process loop by default
+    explicit CpuFreqController(runtime::Reactor* events = nullptr)
+        : reactor(events ? events : &runtime::Reactor::shared()) {}
+    ~CpuFreqController() { stop(); }
+    CpuFreqController(const CpuFreqController&) = delete;
+    CpuFreqController& operator=(const CpuFreqController&) = delete;
+
+    // Finds the cpufreq policies; returns how many are controllable
+    size_t open(const Config& cfg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = cfg;
+        discover();
+        applied_once = false;
+        return policies.size();
+    }
+
+    // Battery and temperature come from here; may be null
+    void attach(const Telemetry* source) {
+        std::lock_guard<std::mutex> lock(mutex);
+        telemetry = source;
+    }
+
+    // Steps now and then every interval
+    void start(const Config& cfg) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (running) return;
+        }
+        open(cfg);
+        std::lock_guard<std::mutex> lock(mutex);
+        running = true;
+        step_timer = reactor->add_periodic(config.interval, [this] { tick(); });
+        reactor->post([this] { tick(); });
+    }
+
+    void start() { start(Config()); }
+
+    // Takes the steps off the loop and hands the policies back as they
+    // were found
+    void stop() {
+        bool was_running;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            was_running = running;
+            running = false;
+        }
+        // No step is running once this returns
+        if (was_running) reactor->call([this] { reactor->cancel_timer(step_timer); });
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!applied_once) return;
+        bool ok = true;
+        for (auto& cpu_policy : policies) ok = cpu_policy.restore(writes) && ok;
+        if (!ok) write_failures++;
+        applied_once = false;
+        level = Level::BALANCED;
+        throttled = false;
+        lower_pending = false;
+    }
+
+    // Cheap enough to call from hot loops: one relaxed store each
+    void report_backlog(double fill) {
+        backlog.store(std::clamp(fill, 0.0, 1.0), std::memory_order_relaxed);
+    }
+
+    void report_training() {
+        last_training_ns.store(timesvc::precise_now().time_since_epoch().count(),
+                               std::memory_order_relaxed);
+    }
+
+    // Applies from the next step
+    void set_policy(const Policy& next) {
+        std::lock_guard<std::mutex> lock(mutex);
+        policy = next;
+    }
+
+    Policy get_policy() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return policy;
+    }
+
+    // Pins a level for a while regardless of signals (thermal limits still
+    // apply), e.g. performance for a capture export
+    void hold(Level pinned, std::chrono::milliseconds duration) {
+        std::lock_guard<std::mutex> lock(mutex);
+        override_level = pinned;
+        override_until = timesvc::precise_now() + duration;
+    }
+
+    // One control pass with explicit signals; the loop calls step()
+    Decision evaluate(const Signals& signals, timesvc::MonoTime now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        evaluations++;
+
+        if (signals.has_temperature) {
+            bool was = throttled;
+            throttled = signals.temperature_mc >= policy.throttle_mc ||
+                        (throttled && signals.temperature_mc > policy.release_mc);
+            if (throttled != was) {
+                logging::warn("cpufreq: thermal throttle {} at {} mC", throttled ? "on" : "off",
+                              signals.temperature_mc);
+            }
+        }
+
+        Decision wanted = want(signals);
+        if (now < override_until) wanted = {override_level, throttled, "hold"};
+        if (throttled && wanted.level == Level::PERFORMANCE) {
+            wanted = {Level::BALANCED, throttled, "thermal"};
+        }
+
+        Level next = level;
+        if (wanted.level > level || !applied_once) {
+            next = wanted.level;
+            lower_pending = false;
+        } else if (wanted.level < level) {
+            if (!lower_pending) {
+                lower_pending = true;
+                lower_since = now;
+            }
+            // Throttling steps down at once; demand waits out the hold
+            if (now - lower_since >= policy.hold || (throttled && level == Level::PERFORMANCE)) {
+                next = wanted.level;
+                lower_pending = false;
+            }
+        } else {
+            lower_pending = false;
+        }
+
+        if (next != level) {
+            transitions++;
+            logging::info("cpufreq: {} -> {} ({})", to_string(level), to_string(next), wanted.reason);
+        }
+        level = next;
+        applied_once = true;
+        apply_locked();
+        return {level, throttled, wanted.reason};
+    }
+
+    Decision step(timesvc::MonoTime now) {
+        return evaluate(gather(now), now);
+    }
+
+    CpuFreqStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return CpuFreqStats{evaluations, transitions, writes, write_failures,
+                            level, throttled, policies.size()};
+    }
+};
+
+// A throwaway cpufreq tree with a single policy0, as on a Pi where all
+// cores share one clock, for tests and bench runs off the device
+class FakeCpufreq {
+private:
+    std::filesystem::path root;
+
+    void put(const std::filesystem::path& file, const std::string& text) {
+        std::ofstream(file) << text << "\n";
+    }
+
+public:
+    FakeCpufreq(std::filesystem::path dir, uint64_t min_khz = 600000, uint64_t max_khz = 1500000,
+                const std::string& governors = "conservative ondemand userspace powersave performance schedutil")
+        : root(std::move(dir)) {
+        auto policy = policy_dir();
+        std::filesystem::create_directories(policy);
+        put(policy / "cpuinfo_min_freq", std::to_string(min_khz));
+        put(policy / "cpuinfo_max_freq", std::to_string(max_khz));
+        put(policy / "scaling_min_freq", std::to_string(min_khz));
+        put(policy / "scaling_max_freq", std::to_string(max_khz));
+        put(policy / "scaling_governor", "ondemand");
+        put(policy / "scaling_available_governors", governors);
+    }
+
+    ~FakeCpufreq() {
+        std::error_code ec;
+        std::filesystem::remove_all(root, ec);
+    }
+
+    FakeCpufreq(const FakeCpufreq&) = delete;
+    FakeCpufreq& operator=(const FakeCpufreq&) = delete;
+
+    std::filesystem::path policy_dir() const {
+        return root / "devices/system/cpu/cpufreq/policy0";
+    }
+
+    std::string read(const char* attribute) const {
+        std::ifstream in(policy_dir() / attribute);
+        std::string text;
+        std::getline(in, text);
+        return text;
+    }
+
+    CpuFreqController::Config config() const {
+        CpuFreqController::Config cfg;
+        cfg.root = root;
+        return cfg;
+    }
+};
+
+} // namespace power
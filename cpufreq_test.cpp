@@ -0,0 +1,137 @@
+#include "cpufreq_controller.hpp"
+#include "test_support.hpp"
+#include <unistd.h>
+
+// Drives power::CpuFreqController against FakeCpufreq: the governor and
+// limits each level writes, hysteresis, thermal throttling, and that
+// stop() puts the policy back as it was found.
+
+using namespace std::chrono_literals;
+using power::Level;
+
+static std::filesystem::path scratch(const char* name) {
+    return std::filesystem::temp_directory_path() /
+           (std::string(name) + "." + std::to_string(::getpid()));
+}
+
+static power::Signals load(double backlog) {
+    power::Signals signals;
+    signals.backlog = backlog;
+    return signals;
+}
+
+static void check_transitions() {
+    power::FakeCpufreq fake(scratch("cpufreq_test.levels"), 600000, 1500000);
+    power::CpuFreqController controller;
+    CHECK(controller.open(fake.config()) == 1, "one policy found");
+    power::Policy policy;
+    policy.hold = 1000ms;
+    controller.set_policy(policy);
+    auto t = timesvc::MonoTime(std::chrono::seconds(100));
+
+    // Demand goes up at once
+    CHECK(controller.evaluate(load(0.9), t).level == Level::PERFORMANCE, "burst");
+    CHECK(fake.read("scaling_governor") == "performance", "performance governor");
+    CHECK(fake.read("scaling_min_freq") == "600000" && fake.read("scaling_max_freq") == "1500000",
+          "full range under performance");
+
+    // Going down waits out the hold
+    CHECK(controller.evaluate(load(0.5), t + 200ms).level == Level::PERFORMANCE, "held up");
+    CHECK(controller.evaluate(load(0.5), t + 1300ms).level == Level::BALANCED, "lowered after hold");
+    CHECK(fake.read("scaling_governor") == "schedutil", "balanced governor");
+    CHECK(controller.evaluate(load(0.0), t + 1400ms).level == Level::BALANCED, "idle held");
+    CHECK(controller.evaluate(load(0.0), t + 2500ms).level == Level::POWERSAVE, "idle after hold");
+    CHECK(fake.read("scaling_governor") == "powersave", "powersave governor");
+
+    // An unchanged level writes nothing
+    uint64_t writes = controller.stats().writes;
+    controller.evaluate(load(0.0), t + 2600ms);
+    CHECK(controller.stats().writes == writes, "no writes without a change");
+
+    // Thermal throttling caps the frequency and steps down from performance at once
+    power::Signals hot = load(0.9);
+    hot.has_temperature = true;
+    hot.temperature_mc = 80000;
+    auto decision = controller.evaluate(hot, t + 2700ms);
+    CHECK(decision.throttled && decision.level == Level::BALANCED, "throttled burst runs balanced");
+    CHECK(fake.read("scaling_max_freq") == std::to_string(600000 + uint64_t(900000 * policy.thermal_cap)),
+          "thermal cap on max frequency");
+    hot.temperature_mc = 70000;
+    CHECK(controller.evaluate(hot, t + 2800ms).throttled, "throttle holds above release");
+    hot.temperature_mc = 65000;
+    decision = controller.evaluate(hot, t + 2900ms);
+    CHECK(!decision.throttled && decision.level == Level::PERFORMANCE, "released");
+    CHECK(fake.read("scaling_max_freq") == "1500000", "cap lifted");
+
+    // Low power mode overrides demand, after the same hold
+    policy.low_power = true;
+    controller.set_policy(policy);
+    controller.evaluate(load(0.9), t + 3000ms);
+    controller.evaluate(load(0.9), t + 4100ms);
+    CHECK(fake.read("scaling_governor") == "powersave", "low power mode");
+
+    auto stats = controller.stats();
+    CHECK(stats.transitions == 6 && stats.write_failures == 0, "transition and failure counts");
+}
+
+// Without powersave/performance the limits do the work
+static void check_limited_governors() {
+    power::FakeCpufreq fake(scratch("cpufreq_test.limited"), 600000, 1200000, "ondemand conservative");
+    power::CpuFreqController controller;
+    controller.open(fake.config());
+    auto t = timesvc::MonoTime(std::chrono::seconds(100));
+
+    controller.evaluate(load(0.9), t);
+    CHECK(fake.read("scaling_governor") == "ondemand", "performance falls back to ondemand");
+    CHECK(fake.read("scaling_min_freq") == "1200000", "performance pins min to max");
+
+    power::Policy policy;
+    policy.low_power = true;
+    controller.set_policy(policy);
+    controller.evaluate(load(0.9), t + 100ms);
+    controller.evaluate(load(0.9), t + 100ms + policy.hold);
+    CHECK(fake.read("scaling_governor") == "conservative", "powersave falls back to conservative");
+    CHECK(fake.read("scaling_min_freq") == "600000" && fake.read("scaling_max_freq") == "600000",
+          "powersave pins max to min");
+}
+
+static bool wait_for_performance(const power::FakeCpufreq& fake) {
+    for (int i = 0; i < 200; ++i) {
+        if (fake.read("scaling_governor") == "performance" && fake.read("scaling_max_freq") == "1500000") {
+            return true;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    return false;
+}
+
+static void check_restore_on_stop() {
+    power::FakeCpufreq fake(scratch("cpufreq_test.restore"), 600000, 1500000);
+    {
+        std::ofstream(fake.policy_dir() / "scaling_max_freq") << "1400000\n";
+    }
+    auto config = fake.config();
+    config.interval = 20ms;
+    power::CpuFreqController controller;
+    controller.report_backlog(0.95);
+    controller.start(config);
+    CHECK(wait_for_performance(fake), "worker applies the level");
+
+    controller.stop();
+    CHECK(fake.read("scaling_governor") == "ondemand", "governor restored");
+    CHECK(fake.read("scaling_min_freq") == "600000", "min restored");
+    CHECK(fake.read("scaling_max_freq") == "1400000", "max restored");
+
+    // Restarting picks the level up again and stopping restores again
+    controller.start(config);
+    CHECK(wait_for_performance(fake), "reapplied after restart");
+    controller.stop();
+    CHECK(fake.read("scaling_governor") == "ondemand", "restored again");
+}
+
+int main() {
+    check_transitions();
+    check_limited_governors();
+    check_restore_on_stop();
+    return testing::finish("cpufreq_test");
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3, reflected, poly 0xEDB88320) for on-disk records
+namespace checksum {
+
+namespace detail {
+    constexpr std::array<uint32_t, 256> make_crc32_table() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    inline constexpr std::array<uint32_t, 256> crc32_table = make_crc32_table();
+}
+
+// Continues a running CRC; start with crc = 0
+inline uint32_t crc32(const void* data, size_t length, uint32_t crc = 0) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = detail::crc32_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+} // namespace checksum
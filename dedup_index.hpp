@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include "snapshot_writer.hpp"
+
+namespace storage {
+
+// MurmurHash64A: fast, well mixed, not cryptographic
+inline uint64_t hash64(const void* data, size_t length, uint64_t seed = 0) {
+    constexpr uint64_t m = 0xC6A4A7935BD1E995ull;
+    constexpr int r = 47;
+
+    const auto* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed ^ (length * m);
+
+    size_t blocks = length / 8;
+    for (size_t i = 0; i < blocks; ++i, p += 8) {
+        uint64_t k;
+        std::memcpy(&k, p, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    size_t tail = length & 7;
+    if (tail) {
+        uint64_t k = 0;
+        for (size_t i = 0; i < tail; ++i) k |= uint64_t(p[i]) << (8 * i);
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+struct DedupStats {
+    size_t entries;
+    uint64_t checks;
+    uint64_t hits;
+    uint64_t evictions;
+    persist::WriterStats persistence;
+};
+
+// Set of 64-bit capture fingerprints that survives restarts. Kept in
+// insertion order so the oldest fingerprints are forgotten first once
+// capacity is reached; saved as a snapshot of that order.
+class DedupIndex {
+private:
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    std::unordered_set<uint64_t> fingerprints;
+    std::deque<uint64_t> order;
+    size_t capacity{65536};
+    bool dirty{false};
+    std::chrono::milliseconds save_interval{10000};
+    timesvc::MonoTime last_save{};
+    mutable std::mutex mutex;
+    persist::SnapshotWriter writer;
+
+    uint64_t check_count{0};
+    uint64_t hit_count{0};
+    uint64_t eviction_count{0};
+
+    std::vector<uint8_t> encode() const {
+        std::vector<uint8_t> bytes(order.size() * sizeof(uint64_t));
+        uint8_t* out = bytes.data();
+        for (uint64_t fp : order) {
+            std::memcpy(out, &fp, sizeof(fp));
+            out += sizeof(fp);
+        }
+        return bytes;
+    }
+
+    void insert_locked(uint64_t fp) {
+        fingerprints.insert(fp);
+        order.push_back(fp);
+        while (order.size() > capacity) {
+            fingerprints.erase(order.front());
+            order.pop_front();
+            eviction_count++;
+        }
+        dirty = true;
+    }
+
+public:
+    // Loads path if present; a missing or damaged file starts an empty index
+    persist::LoadStatus open(const std::filesystem::path& path, size_t max_entries,
+                             std::chrono::milliseconds interval = std::chrono::seconds(10)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = std::max<size_t>(1, max_entries);
+        fingerprints.clear();
+        order.clear();
+        save_interval = interval;
+        writer.open(path, FILE_VERSION);
+
+        std::vector<uint8_t> payload;
+        auto status = writer.load(payload);
+        if (status == persist::LoadStatus::OK) {
+            for (size_t i = 0; i + sizeof(uint64_t) <= payload.size(); i += sizeof(uint64_t)) {
+                uint64_t fp;
+                std::memcpy(&fp, payload.data() + i, sizeof(fp));
+                if (fingerprints.insert(fp).second) order.push_back(fp);
+            }
+            while (order.size() > capacity) {
+                fingerprints.erase(order.front());
+                order.pop_front();
+            }
+        }
+        dirty = false;
+        return status;
+    }
+
+    void set_scheduler(persist::WriteScheduler* writes, persist::Durability durability) {
+        std::lock_guard<std::mutex> lock(mutex);
+        writer.set_scheduler(writes, "dedup", durability);
+    }
+
+    // Records fp; returns false if it was already present (a duplicate)
+    bool insert(uint64_t fp) {
+        std::lock_guard<std::mutex> lock(mutex);
+        check_count++;
+        if (fingerprints.count(fp)) {
+            hit_count++;
+            return false;
+        }
+        insert_locked(fp);
+        return true;
+    }
+
+    bool contains(uint64_t fp) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fingerprints.count(fp) != 0;
+    }
+
+    // Forget fp, e.g. when its capture could not be stored
+    void erase(uint64_t fp) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fingerprints.erase(fp) == 0) return;
+        order.erase(std::find(order.begin(), order.end(), fp));
+        dirty = true;
+    }
+
+    // Persists changes at most once per save interval; encoding is O(n),
+    // so the interval is checked before building the payload
+    void save(timesvc::MonoTime now = timesvc::coarse_now()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!dirty || now - last_save < save_interval) return;
+        writer.submit(encode(), now);
+        last_save = now;
+        dirty = false;
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (dirty) {
+            writer.submit(encode());
+            dirty = false;
+        }
+        writer.flush();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fingerprints.size();
+    }
+
+    DedupStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return DedupStats{fingerprints.size(), check_count, hit_count,
+                          eviction_count, writer.stats()};
+    }
+};
+
+} // namespace storage
@@ -8,6 +8,8 @@
 #include <thread>
 #include <mutex>
 #include <functional>
+#include "metrics.hpp"
+#include "wifi_types.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
@@ -79,11 +81,11 @@ class NetworkMapWidget : public Widget {
 private:
     struct NetworkNode {
         float x, y;
-        std::string bssid;
-        std::string ssid;
+        wifi::Bssid bssid;
+        wifi::Ssid ssid;
         int rssi;
         bool is_target;
-        std::vector<std::string> connected_clients;
+        std::vector<wifi::Bssid> connected_clients;
     };
     
     std::vector<NetworkNode> nodes;
@@ -214,9 +216,12 @@ private:
     bool running;
     std::thread render_thread;
     std::mutex state_mutex;
+    std::function<void()> on_first_frame;  // boot timeline hook
+    ::metrics::Histogram frame_latency = ::metrics::histogram("display_frame");  // clear to present
     
     void render_loop() {
         while (running) {
+            auto frame_start = timesvc::precise_now();
             SDL_SetRenderDrawColor(renderer, 
                 theme.background.r, theme.background.g, 
                 theme.background.b, theme.background.a);
@@ -229,6 +234,11 @@ private:
             }
             
             SDL_RenderPresent(renderer);
+            frame_latency.record(timesvc::precise_now() - frame_start);
+            if (on_first_frame) {
+                on_first_frame();
+                on_first_frame = nullptr;
+            }
             
             // Frame rate control
             SDL_Delay(1000 / 60);  // 60 FPS
@@ -288,6 +298,11 @@ public:
         SDL_Quit();
     }
     
+    // Called once, on the render thread, after the first frame is presented
+    void set_first_frame_hook(std::function<void()> hook) {
+        on_first_frame = std::move(hook);
+    }
+
     void start() {
         running = true;
         render_thread = std::thread(&DisplaySystem::render_loop, this);
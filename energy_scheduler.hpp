@@ -0,0 +1,475 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "logger.hpp"
+#include "power_telemetry.hpp"
+#include "reactor.hpp"
+#include "task_pool.hpp"
+#include "time_service.hpp"
+
+// Energy-aware front end to the task pool. Work is declared with the
+// subsystem it is charged to, a period, a deadline and a CPU budget per
+// run; each run is timed on its worker's thread CPU clock, so every
+// subsystem's CPU-seconds, and from them its energy, are measured rather
+// than guessed. LOW work (training, compression, cleanup) is held back
+// while the battery is low, the SoC is hot, or its subsystem has used up
+// its CPU share, and goes out in batches: when conditions clear, or when
+// the most urgent deadline forces it, together with everything due soon
+// after. HIGH and NORMAL work is never held, only measured.
+namespace runtime {
+
+using Duration = Reactor::Duration;
+
+// CPU time consumed so far by the calling thread
+inline std::chrono::nanoseconds thread_cpu_time() {
+    struct timespec ts;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return std::chrono::nanoseconds(0);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+struct TaskSpec {
+    std::string subsystem = "other";  // what the CPU time is charged to
+    Priority priority = Priority::NORMAL;
+    Duration period{0};    // every(): time between releases
+    Duration deadline{0};  // must finish this long after release; zero for none
+    Duration budget{0};    // expected CPU per run; zero for unbudgeted
+};
+
+struct SubsystemUsage {
+    std::string subsystem;
+    uint64_t runs;
+    uint64_t deferred;         // runs held back at release
+    uint64_t skipped;          // periodic releases while the last run was unfinished
+    uint64_t deadline_misses;  // finished past release + deadline
+    uint64_t overruns;         // used more CPU than the declared budget
+    double cpu_seconds;
+    double wall_seconds;
+    double energy_joules;      // cpu_seconds x active_watts
+    double share_limit;        // CPU share allowed per window; zero for none
+    double share_used;         // CPU share used in the current window
+};
+
+struct EnergyStats {
+    bool constrained;
+    const char* reason;        // why LOW work is held, "" when it is not
+    size_t deferred;           // held now
+    uint64_t batches;          // releases of held work
+    double battery_level;      // 0..1, 1 without a battery
+    double cpu_seconds;
+    double energy_joules;
+    double energy_mah;         // at the battery's voltage, or nominal without a reading
+    std::vector<SubsystemUsage> subsystems;  // by CPU-seconds, highest first
+};
+
+class EnergyScheduler {
+public:
+    struct Config {
+        double active_watts = 0.45;     // per busy core above idle; Pi Zero 2 W class SoC
+        double nominal_voltage = 3.7;   // without a battery voltage reading
+        int64_t low_battery_percent = 20;  // discharging at or below: hold LOW work
+        int64_t hot_mc = 75000;         // hold LOW work at or above
+        int64_t cool_mc = 68000;        // until back at or below
+        bool charging_current_positive = true;  // sign of current_now while charging
+        Duration max_defer = std::chrono::minutes(15);  // for LOW work without a deadline
+        Duration recheck = std::chrono::seconds(30);    // conditions polled while work is held
+        Duration coalesce = std::chrono::minutes(1);    // held work due this soon goes with a forced batch
+        Duration window = std::chrono::minutes(1);      // per-subsystem budget window
+        size_t max_deferred = 64;       // beyond this the oldest held work goes out
+        std::vector<std::pair<std::string, double>> shares{
+            {"training", 0.25}, {"compression", 0.10}, {"cleanup", 0.05}};
+    };
+
+    // Charges the calling thread's CPU time to a subsystem until destroyed;
+    // for work that runs inline on a loop rather than through submit()
+    class CpuScope {
+        EnergyScheduler* owner;
+        std::string subsystem;
+        std::chrono::nanoseconds cpu_start;
+        timesvc::MonoTime wall_start;
+
+    public:
+        CpuScope(EnergyScheduler& scheduler, std::string name)
+            : owner(&scheduler), subsystem(std::move(name)),
+              cpu_start(thread_cpu_time()), wall_start(timesvc::precise_now()) {}
+        ~CpuScope() {
+            owner->record(subsystem, thread_cpu_time() - cpu_start,
+                          timesvc::precise_now() - wall_start, false, false);
+        }
+        CpuScope(const CpuScope&) = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+    };
+
+private:
+    struct Job {
+        TaskSpec spec;
+        std::function<void(const CancelToken&)> fn;
+        TaskHandle handle;
+        timesvc::MonoTime released;
+        timesvc::MonoTime latest;  // held no later than this
+    };
+
+    struct Account {
+        uint64_t runs{0};
+        uint64_t deferred{0};
+        uint64_t skipped{0};
+        uint64_t deadline_misses{0};
+        uint64_t overruns{0};
+        std::chrono::nanoseconds cpu{0};
+        Duration wall{0};
+        double share_limit{0.0};
+        std::chrono::nanoseconds window_cpu{0};
+        timesvc::MonoTime window_start{};
+    };
+
+    struct Periodic {
+        TaskSpec spec;
+        std::function<void(const CancelToken&)> fn;
+        TaskHandle last;
+    };
+
+    Config config;
+    TaskPool* pool;
+    const power::Telemetry* telemetry{nullptr};
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Account> accounts;
+    std::vector<Job> held;
+    std::vector<TaskHandle> in_flight;
+    TimerId review_timer{0};
+    std::vector<TimerId> periodic_timers;  // every() releases still scheduled
+    bool closed{false};                    // destructor has begun
+    mutable bool hot{false};
+    uint64_t batch_count{0};
+    Reactor* reactor;
+
+    static double seconds(std::chrono::nanoseconds d) { return d.count() / 1e9; }
+
+    // mutex held
+    Account& account_locked(const std::string& subsystem) {
+        auto [it, inserted] = accounts.try_emplace(subsystem);
+        if (inserted) {
+            for (const auto& [name, share] : config.shares) {
+                if (name == subsystem) it->second.share_limit = share;
+            }
+        }
+        return it->second;
+    }
+
+    // mutex held; rolls the window over as a side effect
+    bool over_share_locked(Account& account, timesvc::MonoTime now) {
+        if (account.share_limit <= 0.0) return false;
+        if (now - account.window_start >= config.window) {
+            account.window_start = now;
+            account.window_cpu = std::chrono::nanoseconds(0);
+        }
+        auto allowed = std::chrono::duration_cast<std::chrono::nanoseconds>(config.window) *
+                       account.share_limit;
+        return account.window_cpu.count() > allowed.count();
+    }
+
+    // mutex held; "" when LOW work may run
+    const char* hold_reason_locked() const {
+        if (!telemetry) return "";
+        if (telemetry->has(power::Metric::CPU_TEMPERATURE)) {
+            int64_t temperature = telemetry->get(power::Metric::CPU_TEMPERATURE);
+            if (temperature >= config.hot_mc) hot = true;
+            else if (temperature <= config.cool_mc) hot = false;
+        }
+        if (hot) return "hot";
+        if (telemetry->has(power::Metric::BATTERY_PERCENT)) {
+            int64_t current = telemetry->get(power::Metric::BATTERY_CURRENT);
+            bool charging = config.charging_current_positive ? current > 0 : current < 0;
+            if (!charging && telemetry->get(power::Metric::BATTERY_PERCENT) <= config.low_battery_percent) {
+                return "battery low";
+            }
+        }
+        return "";
+    }
+
+    void record(const std::string& subsystem, std::chrono::nanoseconds cpu, Duration wall,
+                bool missed, bool overran) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Account& account = account_locked(subsystem);
+        account.runs++;
+        account.cpu += cpu;
+        account.wall += wall;
+        account.window_cpu += cpu;
+        if (missed) account.deadline_misses++;
+        if (overran) account.overruns++;
+    }
+
+    // mutex held; hands the job to the pool with its CPU time measured
+    void dispatch_locked(Job job) {
+        in_flight.erase(std::remove_if(in_flight.begin(), in_flight.end(),
+                                       [](const TaskHandle& h) { return h.finished(); }),
+                        in_flight.end());
+        if (job.handle.finished()) return;  // cancelled while held
+        in_flight.push_back(job.handle);
+        Priority priority = job.spec.priority;
+        TaskHandle handle = job.handle;
+        pool->submit(priority, handle, [this, job = std::move(job)](const CancelToken& token) {
+            auto cpu_start = thread_cpu_time();
+            auto wall_start = timesvc::precise_now();
+            struct Measure {
+                EnergyScheduler* owner;
+                const Job& job;
+                std::chrono::nanoseconds cpu_start;
+                timesvc::MonoTime wall_start;
+                ~Measure() {
+                    auto cpu = thread_cpu_time() - cpu_start;
+                    auto end = timesvc::precise_now();
+                    bool missed = job.spec.deadline.count() > 0 && end > job.released + job.spec.deadline;
+                    bool overran = job.spec.budget.count() > 0 && cpu > job.spec.budget;
+                    owner->record(job.spec.subsystem, cpu, end - wall_start, missed, overran);
+                }
+            } measure{this, job, cpu_start, wall_start};
+            job.fn(token);
+        });
+    }
+
+    // Runs on the reactor: releases held work that may go now, or must
+    void review() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) return;
+        if (review_timer) reactor->cancel_timer(review_timer);
+        review_timer = 0;
+        auto now = timesvc::precise_now();
+        bool constrained = *hold_reason_locked() != '\0';
+
+        // The most urgent deadline sets the batch; work due soon after
+        // rides along instead of waking the CPU again shortly
+        timesvc::MonoTime cutoff = timesvc::MonoTime::min();
+        for (const auto& job : held) {
+            if (job.latest <= now) cutoff = now + config.coalesce;
+        }
+        if (held.size() > config.max_deferred) {
+            std::vector<timesvc::MonoTime> order;
+            for (const auto& job : held) order.push_back(job.latest);
+            std::nth_element(order.begin(), order.begin() + (held.size() - config.max_deferred - 1), order.end());
+            cutoff = std::max(cutoff, order[held.size() - config.max_deferred - 1]);
+        }
+
+        std::vector<Job> keep;
+        size_t released = 0;
+        for (auto& job : held) {
+            if (job.handle.finished()) continue;
+            bool free = !constrained && !over_share_locked(account_locked(job.spec.subsystem), now);
+            if (free || job.latest <= cutoff) {
+                dispatch_locked(std::move(job));
+                released++;
+            } else {
+                keep.push_back(std::move(job));
+            }
+        }
+        held = std::move(keep);
+        if (released) batch_count++;
+        if (held.empty()) return;
+
+        auto next = now + config.recheck;
+        for (const auto& job : held) next = std::min(next, job.latest);
+        // A deadline is not pushed back by timer slack; a recheck may be
+        Duration slack = next < now + config.recheck ? Duration(0) : Reactor::AUTO_SLACK;
+        review_timer = reactor->add_timer(std::max(Duration(0), next - now), [this] { review(); }, slack);
+    }
+
+public:
+    // Reviews held work on events, the process loop by default
+    explicit EnergyScheduler(TaskPool* tasks = nullptr, Reactor* events = nullptr)
+        : EnergyScheduler(Config(), tasks, events) {}
+
+    EnergyScheduler(const Config& cfg, TaskPool* tasks, Reactor* events = nullptr)
+        : config(cfg), pool(tasks ? tasks : &TaskPool::shared()),
+          reactor(events ? events : &Reactor::shared()) {}
+
+    // Held work is cancelled; work already on the pool is waited for
+    ~EnergyScheduler() {
+        reactor->call([this] {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            if (review_timer) reactor->cancel_timer(review_timer);
+            for (TimerId id : periodic_timers) reactor->cancel_timer(id);
+        });
+        std::vector<TaskHandle> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& job : held) job.handle.cancel();
+            held.clear();
+            pending.swap(in_flight);
+        }
+        for (auto& handle : pending) {
+            if (!handle.cancel()) handle.wait();
+        }
+    }
+
+    EnergyScheduler(const EnergyScheduler&) = delete;
+    EnergyScheduler& operator=(const EnergyScheduler&) = delete;
+
+    // Process-wide scheduler over the shared pool and loop
+    static EnergyScheduler& shared() {
+        static EnergyScheduler scheduler(&TaskPool::shared(), &Reactor::shared());
+        return scheduler;
+    }
+
+    // Battery and temperature source; nullptr never holds work back
+    void attach(const power::Telemetry* source) {
+        std::lock_guard<std::mutex> lock(mutex);
+        telemetry = source;
+        if (!held.empty()) reactor->post([this] { review(); });
+    }
+
+    // Caps a subsystem's CPU share (0..1 of one core) per window; zero lifts it
+    void set_share(const std::string& subsystem, double share) {
+        std::lock_guard<std::mutex> lock(mutex);
+        account_locked(subsystem).share_limit = std::max(0.0, share);
+    }
+
+    // Releases fn now, or holds it if it is LOW work and energy is short
+    TaskHandle submit(TaskSpec spec, std::function<void(const CancelToken&)> fn) {
+        Job job{std::move(spec), std::move(fn), TaskHandle(std::make_shared<detail::TaskState>()), {}, {}};
+        TaskHandle handle = job.handle;
+        auto now = timesvc::precise_now();
+        job.released = now;
+        if (job.spec.deadline.count() > 0) {
+            // Leave room to run: the declared budget, or a tenth of the deadline
+            Duration reserve = job.spec.budget.count() > 0 ? job.spec.budget : job.spec.deadline / 10;
+            job.latest = now + std::max(Duration(0), job.spec.deadline - reserve);
+        } else {
+            job.latest = now + config.max_defer;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Account& account = account_locked(job.spec.subsystem);
+        bool hold = job.spec.priority == Priority::LOW &&
+                    (*hold_reason_locked() != '\0' || over_share_locked(account, now));
+        if (!hold) {
+            dispatch_locked(std::move(job));
+            return handle;
+        }
+        account.deferred++;
+        held.push_back(std::move(job));
+        reactor->post([this] { review(); });
+        return handle;
+    }
+
+    TaskHandle submit(TaskSpec spec, std::function<void()> fn) {
+        return submit(std::move(spec), [fn = std::move(fn)](const CancelToken&) { fn(); });
+    }
+
+    // Releases fn every spec.period; a release while the previous run is
+    // still queued or running is skipped
+    TimerId every(TaskSpec spec, std::function<void(const CancelToken&)> fn) {
+        auto periodic = std::make_shared<Periodic>(Periodic{std::move(spec), std::move(fn), {}});
+        Duration period = periodic->spec.period;
+        TimerId id = reactor->add_periodic(period, [this, periodic] {
+            if (!periodic->last.finished()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                account_locked(periodic->spec.subsystem).skipped++;
+                return;
+            }
+            periodic->last = submit(periodic->spec, periodic->fn);
+        });
+        std::lock_guard<std::mutex> lock(mutex);
+        periodic_timers.push_back(id);
+        return id;
+    }
+
+    bool cancel(TimerId id) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            periodic_timers.erase(std::remove(periodic_timers.begin(), periodic_timers.end(), id),
+                                  periodic_timers.end());
+        }
+        return reactor->cancel_timer(id);
+    }
+
+    // Sends held work to the pool now; for shutdown paths about to wait on it
+    bool expedite(const TaskHandle& handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = held.begin(); it != held.end(); ++it) {
+            if (it->handle == handle) {
+                Job job = std::move(*it);
+                held.erase(it);
+                dispatch_locked(std::move(job));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CpuScope measure(std::string subsystem) { return CpuScope(*this, std::move(subsystem)); }
+
+    bool constrained() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *hold_reason_locked() != '\0';
+    }
+
+    // Battery charge as 0..1; 1 on mains or without a battery
+    double battery_level() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!telemetry || !telemetry->has(power::Metric::BATTERY_PERCENT)) return 1.0;
+        return std::clamp(telemetry->get(power::Metric::BATTERY_PERCENT) / 100.0, 0.0, 1.0);
+    }
+
+    EnergyStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        EnergyStats s{};
+        s.reason = hold_reason_locked();
+        s.constrained = *s.reason != '\0';
+        s.deferred = held.size();
+        s.batches = batch_count;
+        s.battery_level = 1.0;
+        double volts = config.nominal_voltage;
+        if (telemetry && telemetry->has(power::Metric::BATTERY_PERCENT)) {
+            s.battery_level = std::clamp(telemetry->get(power::Metric::BATTERY_PERCENT) / 100.0, 0.0, 1.0);
+        }
+        if (telemetry && telemetry->has(power::Metric::BATTERY_VOLTAGE)) {
+            volts = std::max(1.0, telemetry->get(power::Metric::BATTERY_VOLTAGE) / 1e6);
+        }
+        auto now = timesvc::precise_now();
+        for (const auto& [name, account] : accounts) {
+            double cpu = seconds(account.cpu);
+            bool current = now - account.window_start < config.window;
+            double window = std::chrono::duration<double>(config.window).count();
+            s.subsystems.push_back(SubsystemUsage{
+                name, account.runs, account.deferred, account.skipped, account.deadline_misses,
+                account.overruns, cpu, std::chrono::duration<double>(account.wall).count(),
+                cpu * config.active_watts, account.share_limit,
+                current ? seconds(account.window_cpu) / window : 0.0});
+            s.cpu_seconds += cpu;
+        }
+        std::sort(s.subsystems.begin(), s.subsystems.end(),
+                  [](const SubsystemUsage& a, const SubsystemUsage& b) { return a.cpu_seconds > b.cpu_seconds; });
+        s.energy_joules = s.cpu_seconds * config.active_watts;
+        s.energy_mah = s.energy_joules / volts / 3.6;
+        return s;
+    }
+
+    // One line per subsystem, for tuning battery life from the logs
+    void log_report() const {
+        EnergyStats s = stats();
+        logging::info("Energy: {} CPU-s, {} J (~{} mAh), {} held, {} batches",
+                      s.cpu_seconds, s.energy_joules, s.energy_mah, s.deferred, s.batches);
+        for (const auto& u : s.subsystems) {
+            logging::info("  {}: {} CPU-s, {} J, {} runs, {} deferred, {} late",
+                          u.subsystem, u.cpu_seconds, u.energy_joules, u.runs, u.deferred,
+                          u.deadline_misses);
+            if (u.overruns || u.skipped) {
+                logging::info("  {}: {} runs over budget, {} periodic releases skipped",
+                              u.subsystem, u.overruns, u.skipped);
+            }
+        }
+    }
+
+    const Config& get_config() const { return config; }
+};
+
+} // namespace runtime
@@ -2,33 +2,94 @@
 
 #include <vector>
 #include <string>
-#include <thread>
 #include <mutex>
-#include <queue>
 #include <filesystem>
-#include <fstream>
+#include <iostream>
 #include <atomic>
+#include <algorithm>
+#include <deque>
+#include "capture_log.hpp"
+#include "dedup_index.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "energy_scheduler.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
+#include "write_scheduler.hpp"
 
 namespace anon {
 
 struct Handshake {
-    std::string bssid;
-    std::string essid;
+    wifi::Bssid bssid;
+    wifi::Ssid essid;
     std::vector<uint8_t> eapol_packets;
     std::vector<uint8_t> pmkid;
     uint64_t timestamp;
     bool is_complete;
 };
 
+struct HandshakeQueueStats {
+    size_t depth;                 // handshakes waiting right now
+    size_t max_depth;             // high-water mark since start
+    uint64_t enqueued;
+    uint64_t dropped;             // rejected because the queue was full or stopped
+    uint64_t duplicates;          // rejected because the capture was already stored
+    uint64_t processed;
+    std::chrono::microseconds avg_latency;  // enqueue -> dequeue, EWMA
+    std::chrono::microseconds max_latency;
+};
+
 class HandshakeProcessor {
 private:
     static constexpr size_t MAX_QUEUE_SIZE = 1000;
     static constexpr size_t MAX_STORAGE_SIZE = 10 * 1024 * 1024; // 10MB
-    
+    static constexpr double LATENCY_ALPHA = 0.1;
+    static constexpr size_t MAX_FINGERPRINTS = 16384;
+    static constexpr std::chrono::seconds DRAIN_DEADLINE{1};
+    static constexpr std::chrono::minutes CLEANUP_DEADLINE{5};  // retention may be held this long
+
+    // Bounded multi-producer queue drained by one pool task at a time.
+    // Producers only hold the lock long enough to move a handshake in; the
+    // first one into an idle queue submits the drain.
+    struct Pending {
+        Handshake handshake;
+        timesvc::MonoTime enqueued_at;
+    };
+
     std::atomic<bool> running{false};
-    std::queue<Handshake> processing_queue;
+    std::deque<Pending> processing_queue;
     std::mutex queue_mutex;
+    runtime::EnergyScheduler* energy;
+    runtime::TaskHandle drain_task;    // guarded by queue_mutex
+    runtime::TaskHandle cleanup_task;  // guarded by queue_mutex
+    bool draining{false};
+    bool cleanup_pending{false};
     std::string storage_path = "/opt/anon/handshakes/";
+    storage::CaptureLog capture_log;
+    compress::BackgroundCompressor compressor{energy};  // after capture_log: stops first
+    storage::DedupIndex dedup_index;
+    persist::WriteScheduler* writes;  // syncs the capture log when set
+
+    // Metrics, guarded by queue_mutex
+    size_t max_depth{0};
+    uint64_t enqueued_count{0};
+    uint64_t dropped_count{0};
+    uint64_t duplicate_count{0};
+    uint64_t processed_count{0};
+    double avg_latency_us{0.0};
+    int64_t max_latency_us{0};
+    metrics::Histogram queue_wait = metrics::histogram("handshake_queue_wait");
+    metrics::Gauge queue_depth = metrics::gauge("handshake_queue");
+    metrics::Counter dropped_metric = metrics::counter("handshakes_dropped");
+    
+    // Identifies the capture content: BSSID, EAPOL frames and PMKID. The
+    // timestamp and completeness flag are left out so a re-capture of the
+    // same exchange hashes the same.
+    static uint64_t fingerprint(const Handshake& hs) {
+        uint64_t h = storage::hash64(hs.bssid.bytes.data(), hs.bssid.bytes.size());
+        h = storage::hash64(hs.eapol_packets.data(), hs.eapol_packets.size(), h);
+        return storage::hash64(hs.pmkid.data(), hs.pmkid.size(), h ^ 0x9E3779B97F4A7C15ull);
+    }
     
     bool is_valid_handshake(const Handshake& hs) {
         // Check if we have all necessary EAPOL packets
@@ -53,27 +114,27 @@ private:
         return true;
     }
     
-    void save_handshake(const Handshake& hs) {
-        // Create filename based on BSSID and timestamp
-        std::string filename = storage_path + hs.bssid + "_" + 
-                             std::to_string(hs.timestamp) + ".hccapx";
-        
+    // Captures are appended to the capture log rather than written as one
+    // file each; capture_export materializes files when they are needed
+    bool save_handshake(const Handshake& hs) {
         // Convert to hccapx format
         std::vector<uint8_t> hccapx = convert_to_hccapx(hs);
         
-        // Save to file
-        std::ofstream file(filename, std::ios::binary);
-        file.write(reinterpret_cast<const char*>(hccapx.data()), hccapx.size());
+        if (!capture_log.append(storage::RecordType::HANDSHAKE, hs.bssid, hs.essid,
+                                hs.timestamp, hccapx)) {
+            logging::error("Failed to store handshake for {}", hs.bssid.str());
+            return false;
+        }
+        return true;
     }
     
-    void save_pmkid(const Handshake& hs) {
-        // Create filename based on BSSID and timestamp
-        std::string filename = storage_path + hs.bssid + "_" + 
-                             std::to_string(hs.timestamp) + ".pmkid";
-        
-        // Save PMKID
-        std::ofstream file(filename, std::ios::binary);
-        file.write(reinterpret_cast<const char*>(hs.pmkid.data()), hs.pmkid.size());
+    bool save_pmkid(const Handshake& hs) {
+        if (!capture_log.append(storage::RecordType::PMKID, hs.bssid, hs.essid,
+                                hs.timestamp, hs.pmkid)) {
+            logging::error("Failed to store PMKID for {}", hs.bssid.str());
+            return false;
+        }
+        return true;
     }
     
     std::vector<uint8_t> convert_to_hccapx(const Handshake& hs) {
@@ -82,93 +143,187 @@ private:
         return std::vector<uint8_t>();
     }
     
-    void process_loop() {
-        while (running) {
-            Handshake hs;
-            
-            // Get next handshake to process
+    void record_latency(timesvc::MonoTime enqueued_at) {
+        auto elapsed = timesvc::precise_now() - enqueued_at;
+        queue_wait.record(elapsed);
+        auto waited = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        avg_latency_us = processed_count == 0
+            ? static_cast<double>(waited)
+            : avg_latency_us + LATENCY_ALPHA * (waited - avg_latency_us);
+        max_latency_us = std::max<int64_t>(max_latency_us, waited);
+        processed_count++;
+    }
+
+    void process(const Handshake& hs) {
+        bool stored = true;
+        
+        // Process handshake
+        if (is_valid_handshake(hs)) {
+            stored = save_handshake(hs) && stored;
+        }
+        
+        // Process PMKID if present
+        if (!hs.pmkid.empty() && is_valid_pmkid(hs)) {
+            stored = save_pmkid(hs) && stored;
+        }
+        
+        // Let a retry of a capture that failed to store through dedup
+        if (!stored) {
+            dedup_index.erase(fingerprint(hs));
+        }
+    }
+
+    // Runs until the queue is empty, so everything accepted before
+    // shutdown is still written out
+    void drain() {
+        std::vector<Handshake> batch;
+        while (true) {
             {
                 std::lock_guard<std::mutex> lock(queue_mutex);
                 if (processing_queue.empty()) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    continue;
+                    draining = false;
+                    break;
                 }
                 
-                hs = processing_queue.front();
-                processing_queue.pop();
-            }
-            
-            // Process handshake
-            if (is_valid_handshake(hs)) {
-                save_handshake(hs);
+                // Take everything queued so far in one lock hold
+                batch.reserve(processing_queue.size());
+                for (auto& pending : processing_queue) {
+                    record_latency(pending.enqueued_at);
+                    batch.push_back(std::move(pending.handshake));
+                }
+                processing_queue.clear();
+                queue_depth.set(0);
             }
             
-            // Process PMKID if present
-            if (!hs.pmkid.empty() && is_valid_pmkid(hs)) {
-                save_pmkid(hs);
+            for (const auto& hs : batch) {
+                try {
+                    process(hs);
+                } catch (const std::exception& e) {
+                    logging::error("Handshake processing error: {}", e.what());
+                }
             }
+            batch.clear();
             
-            // Cleanup old files if needed
-            cleanup_storage();
+            // One sync for the whole batch, shared with whatever else is
+            // waiting to be written
+            if (writes) writes->mark("captures", persist::Durability::CRITICAL);
         }
+        schedule_cleanup();
     }
     
-    void cleanup_storage() {
-        namespace fs = std::filesystem;
-        
-        // Get total size of storage
-        size_t total_size = 0;
-        std::vector<fs::path> files;
-        
-        for (const auto& entry : fs::directory_iterator(storage_path)) {
-            total_size += fs::file_size(entry.path());
-            files.push_back(entry.path());
-        }
-        
-        // If over limit, remove oldest files
-        if (total_size > MAX_STORAGE_SIZE) {
-            // Sort by modification time
-            std::sort(files.begin(), files.end(), 
-                     [](const fs::path& a, const fs::path& b) {
-                         return fs::last_write_time(a) < fs::last_write_time(b);
-                     });
-            
-            // Remove oldest files until under limit
-            for (const auto& file : files) {
-                if (total_size <= MAX_STORAGE_SIZE) {
-                    break;
-                }
-                total_size -= fs::file_size(file);
-                fs::remove(file);
+    // Retention and compaction run at low priority, once for any number of
+    // batches that finished while one was queued
+    void schedule_cleanup() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (cleanup_pending) return;
+        cleanup_pending = true;
+        runtime::TaskSpec spec{"cleanup", runtime::Priority::LOW, {}, CLEANUP_DEADLINE};
+        cleanup_task = energy->submit(spec, [this] {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                cleanup_pending = false;
             }
-        }
+            try {
+                cleanup_storage();
+                dedup_index.save();
+            } catch (const std::exception& e) {
+                logging::error("Handshake storage cleanup error: {}", e.what());
+            }
+        });
+    }
+    
+    // Drop the oldest segments while over the size limit, then rewrite
+    // segments that are mostly erased captures
+    void cleanup_storage() {
+        capture_log.enforce_retention();
+        capture_log.compact();
     }
 
 public:
-    HandshakeProcessor() {
+    explicit HandshakeProcessor(persist::WriteScheduler* scheduler = nullptr,
+                                runtime::EnergyScheduler* tasks = nullptr)
+        : energy(tasks ? tasks : &runtime::EnergyScheduler::shared()), writes(scheduler) {
         // Create storage directory if it doesn't exist
         std::filesystem::create_directories(storage_path);
+        
+        storage::CaptureLog::Config log_config;
+        log_config.dir = storage_path;
+        log_config.max_bytes = MAX_STORAGE_SIZE;
+        if (writes) log_config.sync_every = 0;  // synced per batch through the scheduler
+        capture_log.open(log_config);
+        compressor.start();
+        capture_log.set_compressor(&compressor);
+        dedup_index.open(std::filesystem::path(storage_path) / "dedup.snap", MAX_FINGERPRINTS);
+        
+        if (writes) {
+            writes->attach("captures", [this] { return capture_log.sync(); });
+            dedup_index.set_scheduler(writes, persist::Durability::NORMAL);
+        }
     }
     
+    ~HandshakeProcessor() {
+        stop();
+    }
+    
+    HandshakeProcessor(const HandshakeProcessor&) = delete;
+    HandshakeProcessor& operator=(const HandshakeProcessor&) = delete;
+    
     void start() {
-        if (!running) {
-            running = true;
-            // Start processing thread
-            std::thread([this]() {
-                process_loop();
-            }).detach();
-        }
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        running = true;
     }
     
+    // Stops accepting handshakes and waits for the queue to drain
     void stop() {
-        running = false;
+        runtime::TaskHandle pending_drain;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            running = false;
+            pending_drain = drain_task;
+        }
+        pending_drain.wait();
+        runtime::TaskHandle pending_cleanup;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            pending_cleanup = cleanup_task;
+        }
+        energy->expedite(pending_cleanup);  // may be held for battery or heat
+        pending_cleanup.wait();
+        if (writes) writes->detach("captures");
+        capture_log.flush();
+        dedup_index.flush();
     }
     
-    void add_handshake(const Handshake& hs) {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        if (processing_queue.size() < MAX_QUEUE_SIZE) {
-            processing_queue.push(hs);
+    // Returns false if the handshake was dropped (queue full, stopped or
+    // already captured)
+    bool add_handshake(Handshake&& hs) {
+        uint64_t fp = fingerprint(hs);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (!running || processing_queue.size() >= MAX_QUEUE_SIZE) {
+                dropped_count++;
+                dropped_metric.add();
+                return false;
+            }
+            if (!dedup_index.insert(fp)) {
+                duplicate_count++;
+                return false;
+            }
+            processing_queue.push_back({std::move(hs), timesvc::precise_now()});
+            enqueued_count++;
+            max_depth = std::max(max_depth, processing_queue.size());
+            queue_depth.set(static_cast<int64_t>(processing_queue.size()));
+            if (!draining) {
+                draining = true;
+                runtime::TaskSpec spec{"capture", runtime::Priority::HIGH, {}, DRAIN_DEADLINE};
+                drain_task = energy->submit(spec, [this] { drain(); });
+            }
         }
+        return true;
+    }
+    
+    bool add_handshake(const Handshake& hs) {
+        return add_handshake(Handshake(hs));
     }
     
     size_t get_queue_size() {
@@ -176,9 +331,42 @@ public:
         return processing_queue.size();
     }
     
+    // Queue fill, 0..1
+    double get_queue_fill() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return static_cast<double>(processing_queue.size()) / MAX_QUEUE_SIZE;
+    }
+    
+    HandshakeQueueStats get_queue_stats() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return HandshakeQueueStats{
+            processing_queue.size(),
+            max_depth,
+            enqueued_count,
+            dropped_count,
+            duplicate_count,
+            processed_count,
+            std::chrono::microseconds(static_cast<int64_t>(avg_latency_us)),
+            std::chrono::microseconds(max_latency_us)
+        };
+    }
+    
     std::string get_storage_path() const {
         return storage_path;
     }
+    
+    storage::CaptureLogStats get_storage_stats() {
+        return capture_log.stats();
+    }
+    
+    storage::DedupStats get_dedup_stats() const {
+        return dedup_index.stats();
+    }
+    
+    // Stops listing captures for bssid; space is reclaimed by compaction
+    bool erase_captures(const wifi::Bssid& bssid) {
+        return capture_log.erase(bssid);
+    }
 };
 
 } // namespace anon
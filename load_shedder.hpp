@@ -0,0 +1,244 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include "time_service.hpp"
+
+namespace net_intel {
+
+// Processing modes, ordered from cheapest shedding to most aggressive
+enum class ShedMode : uint8_t {
+    FULL,             // every frame goes through the full pipeline
+    SAMPLED,          // management frames in full, 1-in-N data frames
+    MANAGEMENT_ONLY   // management frames only, data frames are just counted
+};
+
+inline const char* to_string(ShedMode mode) {
+    switch (mode) {
+        case ShedMode::FULL: return "full";
+        case ShedMode::SAMPLED: return "sampled";
+        case ShedMode::MANAGEMENT_ONLY: return "mgmt-only";
+    }
+    return "unknown";
+}
+
+struct LoadStats {
+    ShedMode mode;
+    double utilization;        // busy time / wall time over the last window
+    double shed_rate;          // fraction of frames not processed in the last window
+    uint32_t sample_interval;  // 1-in-N data frames kept while SAMPLED
+    uint64_t frames_seen;
+    uint64_t frames_processed;
+    uint64_t frames_shed;
+    uint64_t queue_drops;
+};
+
+// What admit() decided for one frame
+struct Admission {
+    bool process;     // false: shed, the frame is only counted
+    uint32_t weight;  // frames it stands for in the counters; 0 when a sampled frame already does
+};
+
+// Measures per-frame processing cost against a CPU budget and decides which
+// frames are admitted to the ingest queue. admit() runs on the capture path and
+// only touches atomics; record_cost()/end_window() run on the processing side,
+// one thread at a time. Stats and the budget may be used from any thread.
+class LoadShedder {
+public:
+    struct Config {
+        double cpu_budget = 0.5;            // fraction of one core for ingest
+        std::chrono::milliseconds window{1000};
+        double recover_ratio = 0.6;         // step down only below budget * ratio
+        uint32_t max_sample_interval = 64;
+    };
+
+private:
+    Config config;
+    std::atomic<double> cpu_budget;
+
+    std::atomic<ShedMode> mode{ShedMode::FULL};
+    std::atomic<uint32_t> sample_interval{1};
+    std::atomic<uint32_t> data_counter{0};
+
+    // Current window
+    std::atomic<uint64_t> window_busy_ns{0};
+    std::atomic<uint64_t> window_seen{0};
+    std::atomic<uint64_t> window_shed{0};
+    std::atomic<uint64_t> window_data_seen{0};
+    timesvc::MonoTime window_start;  // processing side only
+
+    // Lifetime totals
+    std::atomic<uint64_t> total_seen{0};
+    std::atomic<uint64_t> total_processed{0};
+    std::atomic<uint64_t> total_shed{0};
+    std::atomic<uint64_t> total_queue_drops{0};
+
+    // Smoothed per-frame cost, used to predict the load of stepping down;
+    // processing side only
+    double mgmt_cost_ns{0.0};
+    double data_cost_ns{0.0};
+
+    // Last closed window, for get_stats()
+    std::atomic<double> last_utilization{0.0};
+    std::atomic<double> last_shed_rate{0.0};
+
+    static constexpr double COST_ALPHA = 0.05;
+
+    void escalate() {
+        switch (mode.load()) {
+            case ShedMode::FULL:
+                sample_interval = 2;
+                mode = ShedMode::SAMPLED;
+                break;
+            case ShedMode::SAMPLED: {
+                uint32_t next = sample_interval.load() * 2;
+                if (next > config.max_sample_interval) {
+                    mode = ShedMode::MANAGEMENT_ONLY;
+                } else {
+                    sample_interval = next;
+                }
+                break;
+            }
+            case ShedMode::MANAGEMENT_ONLY:
+                break;
+        }
+    }
+
+    void relax(double utilization, uint64_t data_seen, double window_ns) {
+        // Extra data frames we would process after stepping down one level
+        double extra_frames = 0.0;
+        switch (mode.load()) {
+            case ShedMode::FULL:
+                return;
+            case ShedMode::SAMPLED: {
+                uint32_t interval = sample_interval.load();
+                uint32_t next = std::max<uint32_t>(1, interval / 2);
+                extra_frames = static_cast<double>(data_seen) / next -
+                               static_cast<double>(data_seen) / interval;
+                break;
+            }
+            case ShedMode::MANAGEMENT_ONLY:
+                extra_frames = static_cast<double>(data_seen) / config.max_sample_interval;
+                break;
+        }
+
+        double predicted = utilization + extra_frames * data_cost_ns / window_ns;
+        if (predicted >= cpu_budget.load() * config.recover_ratio) return;
+
+        if (mode.load() == ShedMode::MANAGEMENT_ONLY) {
+            sample_interval = config.max_sample_interval;
+            mode = ShedMode::SAMPLED;
+        } else {
+            uint32_t next = sample_interval.load() / 2;
+            if (next <= 1) {
+                sample_interval = 1;
+                mode = ShedMode::FULL;
+            } else {
+                sample_interval = next;
+            }
+        }
+    }
+
+public:
+    LoadShedder() : LoadShedder(Config{}) {}
+
+    explicit LoadShedder(const Config& cfg)
+        : config(cfg), cpu_budget(cfg.cpu_budget), window_start(timesvc::coarse_now()) {}
+
+    void set_cpu_budget(double budget) {
+        cpu_budget = std::clamp(budget, 0.05, 1.0);
+    }
+
+    // Shed frames are still counted: with weight 1 in MANAGEMENT_ONLY, and
+    // not at all while SAMPLED, where the kept frame carries their weight
+    Admission admit(bool is_management, bool is_data) {
+        total_seen.fetch_add(1, std::memory_order_relaxed);
+        window_seen.fetch_add(1, std::memory_order_relaxed);
+        if (is_data) {
+            window_data_seen.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Admission result{true, 1};
+        if (!is_management && is_data) {
+            switch (mode.load(std::memory_order_relaxed)) {
+                case ShedMode::FULL:
+                    break;
+                case ShedMode::SAMPLED: {
+                    // Systematic 1-in-N sampling keeps weighted totals within N of exact
+                    uint32_t interval = sample_interval.load(std::memory_order_relaxed);
+                    uint32_t n = data_counter.fetch_add(1, std::memory_order_relaxed);
+                    result = (n % interval == 0) ? Admission{true, interval} : Admission{false, 0};
+                    break;
+                }
+                case ShedMode::MANAGEMENT_ONLY:
+                    result = Admission{false, 1};
+                    break;
+            }
+        }
+
+        if (!result.process) {
+            total_shed.fetch_add(1, std::memory_order_relaxed);
+            window_shed.fetch_add(1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    // Admitted frame that could not be queued
+    void record_queue_drop() {
+        total_queue_drops.fetch_add(1, std::memory_order_relaxed);
+        window_shed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void record_cost(std::chrono::nanoseconds cost, bool is_management) {
+        auto ns = static_cast<uint64_t>(cost.count());
+        window_busy_ns.fetch_add(ns, std::memory_order_relaxed);
+        total_processed.fetch_add(1, std::memory_order_relaxed);
+
+        double& ewma = is_management ? mgmt_cost_ns : data_cost_ns;
+        ewma = ewma == 0.0 ? ns : ewma + COST_ALPHA * (ns - ewma);
+    }
+
+    // Closes the measurement window once it has elapsed and adjusts the mode
+    void end_window(timesvc::MonoTime now) {
+        auto elapsed = now - window_start;
+        if (elapsed < config.window) return;
+
+        double window_ns = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        uint64_t busy = window_busy_ns.exchange(0);
+        uint64_t seen = window_seen.exchange(0);
+        uint64_t shed = window_shed.exchange(0);
+        uint64_t data_seen = window_data_seen.exchange(0);
+        window_start = now;
+
+        double utilization = busy / window_ns;
+        last_utilization = utilization;
+        last_shed_rate = seen ? static_cast<double>(shed) / seen : 0.0;
+
+        if (utilization > cpu_budget.load()) {
+            escalate();
+        } else {
+            relax(utilization, data_seen, window_ns);
+        }
+    }
+
+    ShedMode get_mode() const { return mode.load(); }
+
+    LoadStats get_stats() const {
+        return LoadStats{
+            mode.load(),
+            last_utilization.load(),
+            last_shed_rate.load(),
+            sample_interval.load(),
+            total_seen.load(),
+            total_processed.load(),
+            total_shed.load(),
+            total_queue_drops.load()
+        };
+    }
+};
+
+} // namespace net_intel
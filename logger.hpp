@@ -0,0 +1,540 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "reactor.hpp"
+#include "time_service.hpp"
+#include "write_scheduler.hpp"
+
+// Asynchronous logger. A log call copies the format pointer and its raw
+// arguments into a fixed-size record in the calling thread's own ring; no
+// lock, no allocation and no formatting. The flusher, a reactor timer
+// every flush_interval and sooner for errors, drains all rings, orders
+// records by time, formats them and appends the text to the log file,
+// rotating it at a size limit.
+//
+//   logging::info("Captured handshake for {} on channel {}", bssid.str(), channel);
+//
+// Format strings must be literals: only the pointer is kept.
+namespace logging {
+
+enum class Level : uint8_t { DEBUG, INFO, WARN, ERROR };
+
+inline const char* to_string(Level level) {
+    switch (level) {
+        case Level::DEBUG: return "DEBUG";
+        case Level::INFO: return "INFO";
+        case Level::WARN: return "WARN";
+        case Level::ERROR: return "ERROR";
+    }
+    return "?";
+}
+
+namespace detail {
+    enum class ArgType : uint8_t { NONE, INT, UINT, FLOAT, BOOL, TEXT };
+
+    constexpr size_t MAX_ARGS = 6;
+    constexpr size_t RECORD_SIZE = 256;
+
+    // One log call, still unformatted. TEXT arguments are copied into the
+    // record's text area (truncated when it runs out); their slot holds
+    // offset << 16 | length.
+    struct RecordHeader {
+        int64_t timestamp_ns;
+        uint64_t args[MAX_ARGS];
+        const char* format;
+        uint16_t thread;
+        Level level;
+        uint8_t arg_count;
+        uint16_t text_used;
+        ArgType types[MAX_ARGS];
+    };
+
+    struct Record : RecordHeader {
+        char text[RECORD_SIZE - sizeof(RecordHeader)];
+    };
+    static_assert(sizeof(Record) == RECORD_SIZE, "records fill their ring slot exactly");
+
+    // Last formatted second, so strftime runs once per second at most
+    struct StampCache {
+        time_t second{-1};
+        char text[32]{};
+    };
+
+    inline void put_text(Record& record, const char* data, size_t length) {
+        size_t room = sizeof(record.text) - record.text_used;
+        length = std::min(length, room);
+        std::memcpy(record.text + record.text_used, data, length);
+        record.args[record.arg_count] = (uint64_t(record.text_used) << 16) | length;
+        record.types[record.arg_count++] = ArgType::TEXT;
+        record.text_used = static_cast<uint16_t>(record.text_used + length);
+    }
+
+    template <typename T>
+    inline void put(Record& record, const T& value) {
+        if (record.arg_count == MAX_ARGS) return;
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            record.args[record.arg_count] = value ? 1 : 0;
+            record.types[record.arg_count++] = ArgType::BOOL;
+        } else if constexpr (std::is_enum_v<U>) {
+            record.args[record.arg_count] = static_cast<uint64_t>(static_cast<int64_t>(value));
+            record.types[record.arg_count++] = ArgType::INT;
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            record.args[record.arg_count] = static_cast<uint64_t>(static_cast<int64_t>(value));
+            record.types[record.arg_count++] = ArgType::INT;
+        } else if constexpr (std::is_integral_v<U>) {
+            record.args[record.arg_count] = static_cast<uint64_t>(value);
+            record.types[record.arg_count++] = ArgType::UINT;
+        } else if constexpr (std::is_floating_point_v<U>) {
+            double d = static_cast<double>(value);
+            std::memcpy(&record.args[record.arg_count], &d, sizeof(d));
+            record.types[record.arg_count++] = ArgType::FLOAT;
+        } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+            std::string_view text(value);
+            put_text(record, text.data(), text.size());
+        } else {
+            static_assert(std::is_arithmetic_v<U>, "log arguments: numbers, bool or text");
+        }
+    }
+
+    inline void append_arg(std::string& out, const Record& record, size_t i) {
+        char buffer[32];
+        switch (record.types[i]) {
+            case ArgType::INT:
+                out.append(buffer, std::snprintf(buffer, sizeof(buffer), "%lld",
+                                                 static_cast<long long>(record.args[i])));
+                break;
+            case ArgType::UINT:
+                out.append(buffer, std::snprintf(buffer, sizeof(buffer), "%llu",
+                                                 static_cast<unsigned long long>(record.args[i])));
+                break;
+            case ArgType::FLOAT: {
+                double d;
+                std::memcpy(&d, &record.args[i], sizeof(d));
+                out.append(buffer, std::snprintf(buffer, sizeof(buffer), "%g", d));
+                break;
+            }
+            case ArgType::BOOL:
+                out += record.args[i] ? "true" : "false";
+                break;
+            case ArgType::TEXT:
+                out.append(record.text + (record.args[i] >> 16), record.args[i] & 0xFFFF);
+                break;
+            case ArgType::NONE:
+                break;
+        }
+    }
+
+    // Substitutes arguments for "{}" in order; surplus placeholders stay
+    inline void format_message(std::string& out, const Record& record) {
+        size_t next = 0;
+        for (const char* p = record.format; *p; ++p) {
+            if (p[0] == '{' && p[1] == '}' && next < record.arg_count) {
+                append_arg(out, record, next++);
+                ++p;
+            } else {
+                out += *p;
+            }
+        }
+    }
+
+    // Single-producer single-consumer ring owned by one logging thread.
+    // Indices are 32-bit so they stay lock-free on 32-bit ARM.
+    struct Ring {
+        std::vector<Record> slots;
+        uint32_t mask;
+        uint16_t thread;
+        alignas(64) std::atomic<uint32_t> head{0};   // written by the producer
+        uint32_t cached_tail{0};                      // producer's view of tail
+        alignas(64) std::atomic<uint32_t> tail{0};   // written by the flusher
+        std::atomic<uint32_t> dropped{0};
+        std::atomic<bool> retired{false};            // owning thread exited
+
+        Ring(size_t capacity, uint16_t id) : slots(capacity), mask(static_cast<uint32_t>(capacity - 1)), thread(id) {}
+
+        Record* reserve() {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h - cached_tail > mask) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (h - cached_tail > mask) return nullptr;
+            }
+            return &slots[h & mask];
+        }
+
+        // True once at least half the slots are in use; the shared tail is
+        // only read when the cached one says so
+        bool half_full() {
+            uint32_t half = (mask + 1) / 2;
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h - cached_tail < half) return false;
+            cached_tail = tail.load(std::memory_order_acquire);
+            return h - cached_tail >= half;
+        }
+
+        void publish() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+}
+
+struct Config {
+    std::filesystem::path path;
+    persist::WriteScheduler* writes = nullptr;   // appends go through it when set
+    runtime::Reactor* reactor = nullptr;         // flushes from it; the process loop when null
+    uint64_t rotate_bytes = 50 * 1024 * 1024;
+    uint32_t generations = 5;                    // used by the default rotation
+    std::function<void(const std::filesystem::path&)> rotate;  // replaces the default
+    Level min_level = Level::INFO;
+    Level echo_level = Level::ERROR;             // also written to stderr
+    std::chrono::milliseconds flush_interval{250};
+    size_t ring_records = 128;                   // per thread, rounded up to a power of two
+};
+
+struct LoggerStats {
+    uint64_t records;
+    uint64_t dropped;    // rings were full
+    uint64_t bytes;
+    uint64_t flushes;
+    uint64_t rotations;
+    size_t threads;
+};
+
+// path -> path.1 -> ... -> path.generations, oldest deleted
+inline void rotate_generations(const std::filesystem::path& path, uint32_t generations) {
+    std::error_code ec;
+    auto numbered = [&](uint32_t g) { return std::filesystem::path(path.string() + "." + std::to_string(g)); };
+    std::filesystem::remove(numbered(generations), ec);
+    for (uint32_t g = generations; g > 1; --g) {
+        std::filesystem::rename(numbered(g - 1), numbered(g), ec);
+    }
+    std::filesystem::rename(path, numbered(1), ec);
+}
+
+class Logger {
+private:
+    Config config;
+    std::atomic<uint8_t> min_level{static_cast<uint8_t>(Level::INFO)};
+    std::atomic<uint64_t> rotate_limit{0};  // config.rotate_bytes, adjustable while running
+    std::atomic<bool> running{false};
+    std::atomic<bool> urgent{false};
+
+    std::mutex rings_mutex;  // registration and flusher pass
+    std::vector<std::shared_ptr<detail::Ring>> rings;
+    uint16_t next_thread{1};
+
+    runtime::Reactor* reactor{nullptr};
+    runtime::TimerId flush_timer{0};
+
+    // Flusher state
+    int fd{-1};
+    uint64_t file_bytes{0};
+    uint64_t rotate_at{0};
+    persist::WriteScheduler::Ticket last_ticket{0};
+    std::vector<detail::Record> batch;
+    std::string text;
+    detail::StampCache stamp_cache;
+
+    std::atomic<uint64_t> record_count{0};
+    std::atomic<uint64_t> dropped_count{0};
+    std::atomic<uint64_t> byte_count{0};
+    std::atomic<uint64_t> flush_count{0};
+    std::atomic<uint64_t> rotation_count{0};
+
+    struct Handle {
+        std::shared_ptr<detail::Ring> ring;
+        ~Handle() { if (ring) ring->retired.store(true, std::memory_order_release); }
+    };
+
+    detail::Ring* local_ring() {
+        thread_local Handle handle;
+        if (!handle.ring) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            size_t capacity = 1;
+            while (capacity < std::max<size_t>(config.ring_records, 2)) capacity <<= 1;
+            handle.ring = std::make_shared<detail::Ring>(capacity, next_thread++);
+            rings.push_back(handle.ring);
+        }
+        return handle.ring.get();
+    }
+
+    static void append_stamp(std::string& out, int64_t timestamp_ns, detail::StampCache& cache) {
+        auto wall = timesvc::to_wall(timesvc::MonoTime(std::chrono::duration_cast<timesvc::MonoClock::duration>(
+            std::chrono::nanoseconds(timestamp_ns))));
+        int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(wall.time_since_epoch()).count();
+        time_t second = static_cast<time_t>(ms / 1000);
+        if (second != cache.second) {
+            struct tm local;
+            localtime_r(&second, &local);
+            std::strftime(cache.text, sizeof(cache.text), "%Y-%m-%d %H:%M:%S", &local);
+            cache.second = second;
+        }
+        char millis[8];
+        std::snprintf(millis, sizeof(millis), ".%03d ", static_cast<int>(ms % 1000));
+        out += cache.text;
+        out += millis;
+    }
+
+    static void format(std::string& out, const detail::Record& record, detail::StampCache& cache) {
+        append_stamp(out, record.timestamp_ns, cache);
+        out += to_string(record.level);
+        out += " [";
+        out += std::to_string(record.thread);
+        out += "] ";
+        detail::format_message(out, record);
+        out += '\n';
+    }
+
+    void open_file() {
+        if (config.writes || config.path.empty()) return;
+        fd = ::open(config.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+
+    void close_file() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    void rotate_if_needed() {
+        uint64_t limit = rotate_limit.load(std::memory_order_relaxed);
+        if (limit != config.rotate_bytes) {
+            config.rotate_bytes = limit;
+            rotate_at = limit;
+        }
+        if (config.path.empty() || file_bytes < rotate_at) return;
+        if (config.writes) config.writes->wait(last_ticket);  // old file complete first
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(config.path, ec);
+        if (ec || size < config.rotate_bytes) {
+            file_bytes = ec ? 0 : size;  // already rotated from outside
+            rotate_at = config.rotate_bytes;
+            return;
+        }
+
+        close_file();
+        if (config.rotate) {
+            config.rotate(config.path);
+        } else {
+            rotate_generations(config.path, config.generations);
+        }
+        file_bytes = std::filesystem::file_size(config.path, ec);
+        if (ec) file_bytes = 0;
+        // A rotation that did not happen is retried after some more growth
+        rotate_at = file_bytes < config.rotate_bytes ? config.rotate_bytes
+                                                     : file_bytes + config.rotate_bytes / 16;
+        if (file_bytes < config.rotate_bytes) rotation_count++;
+        open_file();
+    }
+
+    void write_text(bool has_error) {
+        if (text.empty() || config.path.empty()) return;
+        if (config.writes) {
+            last_ticket = config.writes->append("log", config.path, text.data(), text.size(),
+                                                has_error ? persist::Durability::NORMAL
+                                                          : persist::Durability::LAZY);
+        } else if (fd >= 0) {
+            persist::detail::write_all(fd, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        }
+        file_bytes += text.size();
+        byte_count += text.size();
+    }
+
+    // Drains every ring, formats in time order and writes one chunk
+    void drain() {
+        batch.clear();
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            for (auto it = rings.begin(); it != rings.end();) {
+                auto& ring = **it;
+                bool retired = ring.retired.load(std::memory_order_acquire);
+                uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+                uint32_t head = ring.head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) batch.push_back(ring.slots[tail & ring.mask]);
+                ring.tail.store(tail, std::memory_order_release);
+                dropped += ring.dropped.exchange(0, std::memory_order_relaxed);
+                it = retired ? rings.erase(it) : it + 1;
+            }
+        }
+        if (batch.empty() && dropped == 0) return;
+
+        std::stable_sort(batch.begin(), batch.end(), [](const detail::Record& a, const detail::Record& b) {
+            return a.timestamp_ns < b.timestamp_ns;
+        });
+
+        text.clear();
+        bool has_error = false;
+        for (const auto& record : batch) {
+            size_t start = text.size();
+            format(text, record, stamp_cache);
+            has_error |= record.level == Level::ERROR;
+            if (record.level >= config.echo_level) {
+                ::write(STDERR_FILENO, text.data() + start, text.size() - start);
+            }
+        }
+        if (dropped > 0) {
+            text += "WARN [logger] dropped " + std::to_string(dropped) + " records, rings full\n";
+            dropped_count += dropped;
+        }
+        record_count += batch.size();
+        flush_count++;
+
+        write_text(has_error);
+        rotate_if_needed();
+    }
+
+    // The flusher pass, on the loop thread
+    void flush() {
+        urgent.exchange(false, std::memory_order_acq_rel);
+        if (running.load(std::memory_order_acquire)) drain();
+    }
+
+    // Without a flusher, format on the spot and write to stderr
+    static void write_now(const detail::Record& record) {
+        std::string line;
+        detail::StampCache cache;
+        format(line, record, cache);
+        ::write(STDERR_FILENO, line.data(), line.size());
+    }
+
+public:
+    Logger() = default;
+    ~Logger() { stop(); }
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void start(const Config& cfg) {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        if (running.load(std::memory_order_relaxed)) return;
+        config = cfg;
+        reactor = config.reactor ? config.reactor : &runtime::Reactor::shared();
+        min_level.store(static_cast<uint8_t>(config.min_level), std::memory_order_relaxed);
+        rotate_limit.store(config.rotate_bytes, std::memory_order_relaxed);
+        std::error_code ec;
+        file_bytes = config.path.empty() ? 0 : std::filesystem::file_size(config.path, ec);
+        if (ec) file_bytes = 0;
+        rotate_at = config.rotate_bytes;
+        open_file();
+        running.store(true, std::memory_order_release);
+        flush_timer = reactor->add_periodic(config.flush_interval, [this] { flush(); });
+    }
+
+    // Writes out everything logged so far; the loop runs no flush after it
+    void stop() {
+        if (!running.load(std::memory_order_acquire)) return;
+        reactor->call([this] {
+            reactor->cancel_timer(flush_timer);
+            flush_timer = 0;
+            running.store(false, std::memory_order_release);
+            drain();
+        });
+        if (config.writes) config.writes->wait(last_ticket);
+        close_file();
+    }
+
+    void set_level(Level level) {
+        min_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+    }
+
+    // Picked up by the flusher at its next pass
+    void set_rotate_bytes(uint64_t bytes) {
+        if (bytes > 0) rotate_limit.store(bytes, std::memory_order_relaxed);
+    }
+
+    bool enabled(Level level) const {
+        return static_cast<uint8_t>(level) >= min_level.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void log(Level level, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= detail::MAX_ARGS, "too many log arguments");
+        if (!enabled(level)) return;
+
+        bool live = running.load(std::memory_order_acquire);
+        detail::Record local;
+        detail::Ring* ring = live ? local_ring() : nullptr;
+        detail::Record* record = ring ? ring->reserve() : &local;
+        if (!record) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        record->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            timesvc::precise_now().time_since_epoch()).count();
+        record->format = format;
+        record->thread = ring ? ring->thread : 0;
+        record->level = level;
+        record->arg_count = 0;
+        record->text_used = 0;
+        (detail::put(*record, args), ...);
+
+        if (!ring) {
+            write_now(*record);
+            return;
+        }
+        ring->publish();
+        // Errors go out promptly; a half-full ring is drained before it
+        // drops. The flag is cleared before the pass reads the rings, so a
+        // record published after that gets a pass of its own.
+        if ((level >= Level::ERROR || ring->half_full()) &&
+            !urgent.load(std::memory_order_relaxed) &&
+            !urgent.exchange(true, std::memory_order_acq_rel)) {
+            reactor->post([this] { flush(); });
+        }
+    }
+
+    LoggerStats stats() {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        return LoggerStats{record_count.load(), dropped_count.load(), byte_count.load(),
+                           flush_count.load(), rotation_count.load(), rings.size()};
+    }
+};
+
+// Process-wide logger used by the free functions below
+inline Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+inline void start(const Config& config) { logger().start(config); }
+inline void stop() { logger().stop(); }
+
+// Keeps the process logger running for a scope; declared after the write
+// scheduler it uses, so it is flushed before the scheduler goes away
+class Session {
+public:
+    explicit Session(const Config& config) { start(config); }
+    ~Session() { stop(); }
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+};
+
+template <typename... Args>
+inline void debug(const char* format, const Args&... args) { logger().log(Level::DEBUG, format, args...); }
+
+template <typename... Args>
+inline void info(const char* format, const Args&... args) { logger().log(Level::INFO, format, args...); }
+
+template <typename... Args>
+inline void warn(const char* format, const Args&... args) { logger().log(Level::WARN, format, args...); }
+
+template <typename... Args>
+inline void error(const char* format, const Args&... args) { logger().log(Level::ERROR, format, args...); }
+
+} // namespace logging
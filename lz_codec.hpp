@@ -0,0 +1,641 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "crc32.hpp"
+#include "energy_scheduler.hpp"
+
+// Streaming LZ77 compression for stored data. Input is cut into independent
+// 64KB blocks, each compressed with a greedy LZ4-style matcher, so encoder
+// and decoder each hold about 150KB regardless of file size and any block
+// can be decoded without the ones before it.
+//
+// Stream: "LZS1", block size (u32), then blocks of
+//   raw_size (u32, high bit = stored uncompressed), data_size (u32),
+//   crc32 of the raw bytes (u32), data
+// terminated by a zero raw_size.
+// Block data is a run of sequences: token (literal length << 4 | match
+// length - 4, 15 = continued in following bytes of 255), literals, then a
+// 16-bit little-endian offset and the match. The last sequence carries
+// literals only.
+namespace compress {
+
+constexpr uint32_t STREAM_MAGIC = 0x31535A4C;  // "LZS1"
+constexpr size_t BLOCK_SIZE = 64 * 1024;
+constexpr uint32_t STORED_FLAG = 0x80000000u;
+
+struct CodecStats {
+    uint64_t bytes_in{0};
+    uint64_t bytes_out{0};
+
+    double ratio() const {
+        return bytes_out ? static_cast<double>(bytes_in) / bytes_out : 0.0;
+    }
+};
+
+namespace detail {
+    constexpr size_t HASH_BITS = 12;
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t LAST_LITERALS = 5;   // the block always ends in literals
+    constexpr size_t MATCH_LIMIT = 12;    // no match starts this close to the end
+
+    inline uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    inline uint32_t hash4(uint32_t v) {
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    constexpr size_t max_compressed(size_t n) {
+        return n + n / 255 + 16;
+    }
+
+    inline uint8_t* put_length(uint8_t* op, size_t length) {
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    inline uint8_t* put_sequence(uint8_t* op, const uint8_t* literals, size_t literal_length,
+                                 size_t offset, size_t match_length) {
+        uint8_t* token = op++;
+        size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+        *token = static_cast<uint8_t>((std::min<size_t>(literal_length, 15) << 4) |
+                                      std::min<size_t>(match_code, 15));
+        if (literal_length >= 15) op = put_length(op, literal_length - 15);
+        std::memcpy(op, literals, literal_length);
+        op += literal_length;
+        if (match_length == 0) return op;
+
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        if (match_code >= 15) op = put_length(op, match_code - 15);
+        return op;
+    }
+
+    inline bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+        uint8_t b;
+        do {
+            if (ip >= end) return false;
+            b = *ip++;
+            length += b;
+        } while (b == 255);
+        return true;
+    }
+
+    inline bool write_all(int fd, const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = ::write(fd, data, length);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    inline bool read_exact(int fd, void* data, size_t length) {
+        auto* p = static_cast<uint8_t*>(data);
+        while (length > 0) {
+            ssize_t n = ::read(fd, p, length);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+// Compresses one block (n <= BLOCK_SIZE) into dst, which must hold
+// max_compressed(n) bytes. table is scratch space of 1 << HASH_BITS entries.
+inline size_t compress_block(const uint8_t* src, size_t n, uint8_t* dst, uint16_t* table) {
+    using namespace detail;
+    uint8_t* op = dst;
+    size_t anchor = 0;
+
+    if (n > MATCH_LIMIT) {
+        std::memset(table, 0, sizeof(uint16_t) << HASH_BITS);
+        size_t limit = n - MATCH_LIMIT;
+        size_t match_end = n - LAST_LITERALS;
+        size_t ip = 1;
+        table[hash4(read32(src))] = 0;
+
+        while (ip < limit) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t h = hash4(sequence);
+            size_t ref = table[h];
+            table[h] = static_cast<uint16_t>(ip);
+
+            if (ref >= ip || read32(src + ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            size_t length = MIN_MATCH;
+            while (ip + length < match_end && src[ref + length] == src[ip + length]) length++;
+
+            op = put_sequence(op, src + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+            if (ip < limit) {
+                table[hash4(read32(src + ip - 2))] = static_cast<uint16_t>(ip - 2);
+            }
+        }
+    }
+
+    return put_sequence(op, src + anchor, n - anchor, 0, 0) - dst;
+}
+
+// Decodes one block; false if the data is malformed or does not produce
+// exactly raw_size bytes
+inline bool decompress_block(const uint8_t* src, size_t n, uint8_t* dst, size_t raw_size) {
+    const uint8_t* ip = src;
+    const uint8_t* end = src + n;
+    size_t op = 0;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !detail::read_length(ip, end, literal_length)) return false;
+        if (literal_length > static_cast<size_t>(end - ip) || literal_length > raw_size - op) {
+            return false;
+        }
+        std::memcpy(dst + op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if (ip == end) break;  // final literal-only sequence
+
+        if (end - ip < 2) return false;
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t match_length = token & 0x0F;
+        if (match_length == 15 && !detail::read_length(ip, end, match_length)) return false;
+        match_length += detail::MIN_MATCH;
+        if (offset == 0 || offset > op || match_length > raw_size - op) return false;
+
+        // Byte by byte: overlapping matches repeat the pattern
+        for (size_t i = 0; i < match_length; ++i, ++op) dst[op] = dst[op - offset];
+    }
+    return op == raw_size;
+}
+
+// Writes a compressed stream to fd as data arrives
+class Encoder {
+private:
+    int fd;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    std::vector<uint16_t> table;
+    CodecStats totals;
+    bool ok{true};
+
+    bool emit_block() {
+        uint32_t raw_size = static_cast<uint32_t>(input.size());
+        size_t packed = compress_block(input.data(), input.size(), output.data(), table.data());
+
+        const uint8_t* data = output.data();
+        uint32_t header[3] = {raw_size, static_cast<uint32_t>(packed),
+                              checksum::crc32(input.data(), input.size())};
+        if (packed >= input.size()) {
+            header[0] |= STORED_FLAG;
+            header[1] = raw_size;
+            data = input.data();
+        }
+
+        ok = ok && detail::write_all(fd, reinterpret_cast<const uint8_t*>(header), sizeof(header)) &&
+             detail::write_all(fd, data, header[1]);
+        totals.bytes_in += raw_size;
+        totals.bytes_out += sizeof(header) + header[1];
+        input.clear();
+        return ok;
+    }
+
+public:
+    explicit Encoder(int out_fd)
+        : fd(out_fd), output(detail::max_compressed(BLOCK_SIZE)), table(1u << detail::HASH_BITS) {
+        input.reserve(BLOCK_SIZE);
+        uint32_t header[2] = {STREAM_MAGIC, static_cast<uint32_t>(BLOCK_SIZE)};
+        ok = detail::write_all(fd, reinterpret_cast<const uint8_t*>(header), sizeof(header));
+        totals.bytes_out = sizeof(header);
+    }
+
+    bool write(const void* data, size_t length) {
+        const auto* p = static_cast<const uint8_t*>(data);
+        while (ok && length > 0) {
+            size_t take = std::min(length, BLOCK_SIZE - input.size());
+            input.insert(input.end(), p, p + take);
+            p += take;
+            length -= take;
+            if (input.size() == BLOCK_SIZE) emit_block();
+        }
+        return ok;
+    }
+
+    bool finish() {
+        if (!input.empty()) emit_block();
+        uint32_t end = 0;
+        ok = ok && detail::write_all(fd, reinterpret_cast<const uint8_t*>(&end), sizeof(end));
+        totals.bytes_out += sizeof(end);
+        return ok;
+    }
+
+    const CodecStats& stats() const { return totals; }
+};
+
+// Reads a compressed stream from fd one block at a time
+class Decoder {
+private:
+    int fd;
+    std::vector<uint8_t> packed;
+    std::vector<uint8_t> block;
+    size_t position{0};
+    bool started{false};
+    bool finished{false};
+    bool failed{false};
+
+    bool next_block() {
+        if (!started) {
+            uint32_t header[2];
+            if (!detail::read_exact(fd, header, sizeof(header)) ||
+                header[0] != STREAM_MAGIC || header[1] > BLOCK_SIZE) {
+                failed = true;
+                return false;
+            }
+            started = true;
+        }
+
+        uint32_t raw_size;
+        if (!detail::read_exact(fd, &raw_size, sizeof(raw_size))) {
+            failed = true;
+            return false;
+        }
+        if (raw_size == 0) {
+            finished = true;
+            return false;
+        }
+
+        uint32_t rest[2];  // data_size, crc
+        bool stored = raw_size & STORED_FLAG;
+        raw_size &= ~STORED_FLAG;
+        if (!detail::read_exact(fd, rest, sizeof(rest)) || raw_size > BLOCK_SIZE ||
+            rest[0] > detail::max_compressed(BLOCK_SIZE)) {
+            failed = true;
+            return false;
+        }
+
+        block.resize(raw_size);
+        bool ok;
+        if (stored) {
+            ok = rest[0] == raw_size && detail::read_exact(fd, block.data(), raw_size);
+        } else {
+            packed.resize(rest[0]);
+            ok = detail::read_exact(fd, packed.data(), packed.size()) &&
+                 decompress_block(packed.data(), packed.size(), block.data(), raw_size);
+        }
+        if (!ok || checksum::crc32(block.data(), block.size()) != rest[1]) {
+            failed = true;
+            return false;
+        }
+        position = 0;
+        return true;
+    }
+
+public:
+    explicit Decoder(int in_fd) : fd(in_fd) {
+        packed.reserve(detail::max_compressed(BLOCK_SIZE));
+        block.reserve(BLOCK_SIZE);
+    }
+
+    // Returns bytes read; 0 at the end of the stream or on error (see ok())
+    size_t read(void* data, size_t length) {
+        auto* p = static_cast<uint8_t*>(data);
+        size_t done = 0;
+        while (done < length) {
+            if (position == block.size() && (finished || failed || !next_block())) break;
+            size_t take = std::min(length - done, block.size() - position);
+            std::memcpy(p + done, block.data() + position, take);
+            position += take;
+            done += take;
+        }
+        return done;
+    }
+
+    bool ok() const { return !failed; }
+    bool at_end() const { return finished; }
+};
+
+// Random access into a compressed file: block headers are indexed on open
+// and one decoded block is cached
+class BlockReader {
+private:
+    struct Block {
+        uint64_t file_offset;  // of the block header
+        uint64_t raw_offset;
+        uint32_t raw_size;
+    };
+
+    int fd{-1};
+    std::vector<Block> blocks;
+    uint64_t raw_total{0};
+    size_t cached{SIZE_MAX};
+    std::vector<uint8_t> packed;
+    std::vector<uint8_t> block;
+
+    bool load(size_t index) {
+        if (cached == index) return true;
+        const Block& b = blocks[index];
+        uint32_t header[3];
+        if (::pread(fd, header, sizeof(header), static_cast<off_t>(b.file_offset)) != sizeof(header)) {
+            return false;
+        }
+        bool stored = header[0] & STORED_FLAG;
+        off_t data_offset = static_cast<off_t>(b.file_offset + sizeof(header));
+        block.resize(b.raw_size);
+        if (stored) {
+            if (::pread(fd, block.data(), b.raw_size, data_offset) != static_cast<ssize_t>(b.raw_size)) {
+                return false;
+            }
+        } else {
+            packed.resize(header[1]);
+            if (::pread(fd, packed.data(), packed.size(), data_offset) !=
+                    static_cast<ssize_t>(packed.size()) ||
+                !decompress_block(packed.data(), packed.size(), block.data(), b.raw_size)) {
+                return false;
+            }
+        }
+        if (checksum::crc32(block.data(), block.size()) != header[2]) return false;
+        cached = index;
+        return true;
+    }
+
+public:
+    BlockReader() = default;
+    ~BlockReader() { close(); }
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    bool open(const std::filesystem::path& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        uint32_t header[2];
+        if (::pread(fd, header, sizeof(header), 0) != sizeof(header) ||
+            header[0] != STREAM_MAGIC || header[1] > BLOCK_SIZE) {
+            close();
+            return false;
+        }
+
+        uint64_t offset = sizeof(header);
+        while (true) {
+            uint32_t block_header[3];
+            ssize_t n = ::pread(fd, block_header, sizeof(block_header), static_cast<off_t>(offset));
+            if (n >= 4 && block_header[0] == 0) break;
+            if (n != sizeof(block_header)) {
+                close();
+                return false;
+            }
+            uint32_t raw_size = block_header[0] & ~STORED_FLAG;
+            blocks.push_back(Block{offset, raw_total, raw_size});
+            raw_total += raw_size;
+            offset += sizeof(block_header) + block_header[1];
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        blocks.clear();
+        raw_total = 0;
+        cached = SIZE_MAX;
+    }
+
+    bool is_open() const { return fd >= 0; }
+    uint64_t size() const { return raw_total; }
+
+    bool read(void* data, size_t length, uint64_t offset) {
+        if (fd < 0 || offset + length > raw_total) return false;
+        auto* p = static_cast<uint8_t*>(data);
+
+        auto it = std::upper_bound(blocks.begin(), blocks.end(), offset,
+                                   [](uint64_t off, const Block& b) { return off < b.raw_offset; });
+        size_t index = static_cast<size_t>(it - blocks.begin()) - 1;
+        while (length > 0) {
+            if (!load(index)) return false;
+            size_t start = static_cast<size_t>(offset - blocks[index].raw_offset);
+            size_t take = std::min<size_t>(length, block.size() - start);
+            std::memcpy(p, block.data() + start, take);
+            p += take;
+            offset += take;
+            length -= take;
+            index++;
+        }
+        return true;
+    }
+};
+
+// Compresses src into dst (temp file, fsync, rename). src is left in place.
+inline bool compress_file(const std::filesystem::path& src, const std::filesystem::path& dst,
+                          CodecStats* stats = nullptr) {
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+
+    auto temp = dst;
+    temp += ".tmp";
+    int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+
+    Encoder encoder(out);
+    std::vector<uint8_t> buffer(BLOCK_SIZE);
+    bool ok = true;
+    while (ok) {
+        ssize_t n = ::read(in, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) ok = false;
+        if (n <= 0) break;
+        ok = encoder.write(buffer.data(), static_cast<size_t>(n));
+    }
+    ok = ok && encoder.finish() && ::fsync(out) == 0;
+    ok = (::close(out) == 0) && ok;
+    ::close(in);
+
+    if (!ok || ::rename(temp.c_str(), dst.c_str()) != 0) {
+        ::unlink(temp.c_str());
+        return false;
+    }
+    persist::sync_directory(dst.parent_path());
+    if (stats) *stats = encoder.stats();
+    return true;
+}
+
+inline bool decompress_file(const std::filesystem::path& src, const std::filesystem::path& dst) {
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+
+    Decoder decoder(in);
+    std::vector<uint8_t> buffer(BLOCK_SIZE);
+    bool ok = true;
+    size_t n;
+    while (ok && (n = decoder.read(buffer.data(), buffer.size())) > 0) {
+        ok = detail::write_all(out, buffer.data(), n);
+    }
+    ok = ok && decoder.ok() && decoder.at_end();
+    ::close(in);
+    ok = (::close(out) == 0) && ok;
+    return ok;
+}
+
+struct CompressorStats {
+    uint64_t jobs_done;
+    uint64_t jobs_failed;
+    uint64_t jobs_pending;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+};
+
+// Runs compression jobs in order as LOW "compression" work on the energy
+// scheduler's shared pool, so they yield to capture work and are held back
+// while the battery is low or the CPU is hot
+class BackgroundCompressor {
+public:
+    using Callback = std::function<void(bool ok, const CodecStats& stats)>;
+
+private:
+    struct Job {
+        std::filesystem::path src;
+        std::filesystem::path dst;
+        Callback done;
+    };
+
+    // Jobs run one at a time as a single LOW task, so compression never
+    // takes more than one core from capture work and waits out low
+    // battery or heat
+    runtime::EnergyScheduler* energy;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    runtime::TaskHandle drain_task;
+    bool running{false};
+    bool draining{false};
+
+    uint64_t done_count{0};
+    uint64_t failed_count{0};
+    uint64_t bytes_in{0};
+    uint64_t bytes_out{0};
+
+    // mutex held
+    void schedule_locked() {
+        if (!running || draining || jobs.empty()) return;
+        draining = true;
+        runtime::TaskSpec spec{"compression", runtime::Priority::LOW};
+        drain_task = energy->submit(spec, [this](const runtime::CancelToken& token) {
+            drain(token);
+        });
+    }
+
+    void drain(const runtime::CancelToken& token) {
+        while (true) {
+            Job job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!running || jobs.empty() || token.cancelled()) {
+                    draining = false;
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            CodecStats stats;
+            bool ok = compress_file(job.src, job.dst, &stats);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ok) {
+                    done_count++;
+                    bytes_in += stats.bytes_in;
+                    bytes_out += stats.bytes_out;
+                } else {
+                    failed_count++;
+                }
+            }
+            if (job.done) job.done(ok, stats);
+        }
+    }
+
+public:
+    explicit BackgroundCompressor(runtime::EnergyScheduler* tasks = nullptr)
+        : energy(tasks ? tasks : &runtime::EnergyScheduler::shared()) {}
+    ~BackgroundCompressor() { stop(); }
+    BackgroundCompressor(const BackgroundCompressor&) = delete;
+    BackgroundCompressor& operator=(const BackgroundCompressor&) = delete;
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = true;
+        schedule_locked();
+    }
+
+    // Finishes the job in progress; queued jobs are dropped, their sources
+    // stay uncompressed and their callbacks run here with ok false
+    void stop() {
+        runtime::TaskHandle pending;
+        std::deque<Job> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+            dropped.swap(jobs);
+            pending = drain_task;
+        }
+        if (!pending.cancel()) pending.wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            draining = false;
+        }
+        for (auto& job : dropped) {
+            if (job.done) job.done(false, CodecStats{});
+        }
+    }
+
+    // done runs on a pool worker after dst is in place (or failed), or in
+    // stop() if the job never ran
+    void submit(std::filesystem::path src, std::filesystem::path dst, Callback done = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{std::move(src), std::move(dst), std::move(done)});
+        schedule_locked();
+    }
+
+    CompressorStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return CompressorStats{done_count, failed_count, jobs.size(), bytes_in, bytes_out};
+    }
+};
+
+} // namespace compress
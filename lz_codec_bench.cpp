@@ -0,0 +1,163 @@
+#include "lz_codec.hpp"
+#include "test_support.hpp"
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sys/resource.h>
+
+// Round-trips a corpus through the LZ file codec and reports compression
+// ratio, MB/s each way and peak RSS; then runs the same files through
+// BackgroundCompressor. Every file must come back byte for byte.
+//
+//   lz_codec_bench <file or dir>... [--min-ratio R]
+//
+// Give it real captures and logs, e.g. /opt/anon/logs and
+// /opt/anon/handshakes. Hidden directories are skipped.
+
+namespace fs = std::filesystem;
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void collect(const fs::path& root, std::vector<fs::path>& files) {
+    std::error_code ec;
+    if (fs::is_regular_file(root, ec)) {
+        files.push_back(root);
+        return;
+    }
+    for (auto it = fs::recursive_directory_iterator(root, ec); it != fs::recursive_directory_iterator();
+         it.increment(ec)) {
+        if (ec) break;
+        if (it->is_directory(ec) && it->path().filename().string().rfind('.', 0) == 0) {
+            it.disable_recursion_pending();
+        } else if (it->is_regular_file(ec) && it->file_size(ec) > 0) {
+            files.push_back(it->path());
+        }
+    }
+}
+
+// Compared in chunks, so the check itself adds little to peak RSS
+static bool same_contents(const fs::path& a, const fs::path& b) {
+    std::ifstream x(a, std::ios::binary), y(b, std::ios::binary);
+    std::vector<char> bx(64 * 1024), by(64 * 1024);
+    while (x && y) {
+        x.read(bx.data(), bx.size());
+        y.read(by.data(), by.size());
+        if (x.gcount() != y.gcount() || !std::equal(bx.begin(), bx.begin() + x.gcount(), by.begin())) {
+            return false;
+        }
+    }
+    return x.eof() && y.eof();
+}
+
+// Random reads through the block index must match the original
+static bool random_reads_match(const fs::path& original, const fs::path& compressed, std::mt19937& rng) {
+    compress::BlockReader reader;
+    if (!reader.open(compressed)) return false;
+    std::ifstream in(original, std::ios::binary);
+    uint64_t size = reader.size();
+    for (int i = 0; i < 8 && size > 0; ++i) {
+        uint64_t offset = rng() % size;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(1 + rng() % 4096, size - offset));
+        std::vector<uint8_t> got(length);
+        std::vector<char> want(length);
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(want.data(), static_cast<std::streamsize>(length));
+        if (!reader.read(got.data(), length, offset) ||
+            !std::equal(got.begin(), got.end(), reinterpret_cast<const uint8_t*>(want.data()))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<fs::path> files;
+    double min_ratio = 0.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--min-ratio" && i + 1 < argc) {
+            min_ratio = std::strtod(argv[++i], nullptr);
+        } else {
+            collect(arg, files);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <file or dir>... [--min-ratio R]" << std::endl;
+        return 1;
+    }
+
+    fs::path scratch = fs::temp_directory_path() / ("lz_codec_bench." + std::to_string(::getpid()));
+    fs::create_directories(scratch);
+    const fs::path packed = scratch / "packed.lz";
+    const fs::path unpacked = scratch / "unpacked";
+
+    long rss_before = peak_rss_kb();
+    std::mt19937 rng(38);
+    uint64_t raw = 0, compressed = 0;
+    double compress_s = 0, decompress_s = 0;
+    size_t round_trip_errors = 0, read_errors = 0;
+    for (const auto& file : files) {
+        compress::CodecStats stats;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = compress::compress_file(file, packed, &stats);
+        auto middle = std::chrono::steady_clock::now();
+        ok = ok && compress::decompress_file(packed, unpacked);
+        auto end = std::chrono::steady_clock::now();
+        if (!ok || !same_contents(file, unpacked)) {
+            std::cerr << "round trip failed: " << file << std::endl;
+            round_trip_errors++;
+            continue;
+        }
+        if (!random_reads_match(file, packed, rng)) read_errors++;
+        raw += stats.bytes_in;
+        compressed += stats.bytes_out;
+        compress_s += std::chrono::duration<double>(middle - start).count();
+        decompress_s += std::chrono::duration<double>(end - middle).count();
+    }
+    long rss_codec = peak_rss_kb();
+
+    // The same files through the background compressor, as rotation uses it
+    compress::BackgroundCompressor background;
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    size_t done = 0, failed = 0;
+    background.start();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < files.size(); ++i) {
+        background.submit(files[i], scratch / ("job" + std::to_string(i) + ".lz"),
+                          [&](bool ok, const compress::CodecStats&) {
+                              std::lock_guard<std::mutex> lock(mutex);
+                              ok ? done++ : failed++;
+                              done_cv.notify_one();
+                          });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [&] { return done + failed == files.size(); });
+    }
+    double background_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    background.stop();
+
+    double mb = raw / 1e6;
+    double ratio = compressed ? static_cast<double>(raw) / compressed : 0.0;
+    std::cout << std::fixed << std::setprecision(2)
+              << files.size() << " files, " << mb << " MB\n"
+              << "  ratio " << ratio << ", compress " << mb / compress_s << " MB/s, decompress "
+              << mb / decompress_s << " MB/s\n"
+              << "  background compressor " << mb / background_s << " MB/s\n"
+              << "  peak RSS " << rss_codec << " KB (+" << rss_codec - rss_before << " KB in the codec), "
+              << peak_rss_kb() << " KB with the background compressor" << std::endl;
+
+    CHECK(round_trip_errors == 0, "every file round-trips");
+    CHECK(read_errors == 0, "block-indexed reads match");
+    CHECK(failed == 0 && done == files.size(), "background jobs all succeed");
+    CHECK(ratio >= min_ratio, "ratio at least " + std::to_string(min_ratio));
+
+    fs::remove_all(scratch);
+    return testing::finish("lz_codec_bench");
+}
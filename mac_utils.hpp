@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// MAC address text conversion and hashing without iostreams or allocation
+// on the formatting path. Addresses are passed as pointers to 6 bytes so the
+// same helpers serve MacAddress and wifi::Bssid.
+namespace mac {
+
+constexpr size_t ADDRESS_LENGTH = 6;
+constexpr size_t STRING_LENGTH = 17;  // "aa:bb:cc:dd:ee:ff"
+
+namespace detail {
+    // Two lowercase hex characters for every byte value
+    struct HexTable {
+        char pairs[256][2];
+
+        constexpr HexTable() : pairs{} {
+            constexpr char digits[] = "0123456789abcdef";
+            for (int i = 0; i < 256; ++i) {
+                pairs[i][0] = digits[i >> 4];
+                pairs[i][1] = digits[i & 0x0F];
+            }
+        }
+    };
+
+    inline constexpr HexTable hex_table{};
+
+    constexpr uint64_t ONES = 0x0101010101010101ull;
+    constexpr uint64_t HIGH = 0x8080808080808080ull;
+
+    // Per byte lane: high bit set where lane >= a (lanes must be < 0x80)
+    constexpr uint64_t lanes_ge(uint64_t x, uint8_t a) {
+        return (x + ONES * (0x80 - a)) & HIGH;
+    }
+
+    // Per byte lane: high bit set where lane > b (lanes must be < 0x80)
+    constexpr uint64_t lanes_gt(uint64_t x, uint8_t b) {
+        return (x + ONES * (0x7F - b)) & HIGH;
+    }
+
+    inline uint64_t load_le64(const unsigned char* p) {
+        return uint64_t(p[0]) | uint64_t(p[1]) << 8 | uint64_t(p[2]) << 16 |
+               uint64_t(p[3]) << 24 | uint64_t(p[4]) << 32 | uint64_t(p[5]) << 40 |
+               uint64_t(p[6]) << 48 | uint64_t(p[7]) << 56;
+    }
+
+    // Decodes 8 hex characters (first character in the lowest lane) into
+    // 4 bytes, validating every lane at once
+    inline bool decode_hex8(uint64_t v, uint32_t& out) {
+        if (v & HIGH) return false;
+
+        uint64_t folded = v | (ONES * 0x20);  // 'A'-'F' -> 'a'-'f'
+        uint64_t digit = lanes_ge(v, '0') & ~lanes_gt(v, '9');
+        uint64_t alpha = lanes_ge(folded, 'a') & ~lanes_gt(folded, 'f');
+        if ((digit | alpha) != HIGH) return false;
+
+        uint64_t nibbles = (v & (ONES * 0x0F)) + (alpha >> 7) * 9;
+
+        // Join nibble pairs into bytes, then squeeze the bytes together
+        uint64_t bytes = ((nibbles & 0x000F000F000F000Full) << 4) |
+                         ((nibbles >> 8) & 0x000F000F000F000Full);
+        bytes = (bytes | (bytes >> 8)) & 0x0000FFFF0000FFFFull;
+        bytes = (bytes | (bytes >> 16)) & 0x00000000FFFFFFFFull;
+        out = static_cast<uint32_t>(bytes);
+        return true;
+    }
+}
+
+// Writes exactly STRING_LENGTH characters, no terminator
+inline void format(const uint8_t* addr, char* out) {
+    for (size_t i = 0; i < ADDRESS_LENGTH; ++i) {
+        const char* pair = detail::hex_table.pairs[addr[i]];
+        out[i * 3] = pair[0];
+        out[i * 3 + 1] = pair[1];
+        if (i < ADDRESS_LENGTH - 1) out[i * 3 + 2] = ':';
+    }
+}
+
+inline std::string to_string(const uint8_t* addr) {
+    char buffer[STRING_LENGTH];
+    format(addr, buffer);
+    return std::string(buffer, STRING_LENGTH);
+}
+
+// Parses "aa:bb:cc:dd:ee:ff" or "aa-bb-cc-dd-ee-ff", either case.
+// out is only written on success.
+inline bool parse(std::string_view text, uint8_t* out) {
+    if (text.size() != STRING_LENGTH) return false;
+    const char* p = text.data();
+
+    char sep = p[2];
+    if (sep != ':' && sep != '-') return false;
+    if (p[5] != sep || p[8] != sep || p[11] != sep || p[14] != sep) return false;
+
+    // Gather the 12 digits into two words, padding the second with '0'
+    unsigned char digits[16];
+    for (size_t i = 0; i < ADDRESS_LENGTH; ++i) {
+        std::memcpy(digits + i * 2, p + i * 3, 2);
+    }
+    std::memset(digits + 12, '0', 4);
+
+    uint32_t first, second;
+    if (!detail::decode_hex8(detail::load_le64(digits), first)) return false;
+    if (!detail::decode_hex8(detail::load_le64(digits + 8), second)) return false;
+
+    for (size_t i = 0; i < 4; ++i) out[i] = static_cast<uint8_t>(first >> (8 * i));
+    out[4] = static_cast<uint8_t>(second);
+    out[5] = static_cast<uint8_t>(second >> 8);
+    return true;
+}
+
+// Address as a 48-bit integer, first byte most significant
+inline uint64_t pack(const uint8_t* addr) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < ADDRESS_LENGTH; ++i) value = (value << 8) | addr[i];
+    return value;
+}
+
+// Vendor prefix: the first three bytes
+inline uint32_t oui(const uint8_t* addr) {
+    return (uint32_t(addr[0]) << 16) | (uint32_t(addr[1]) << 8) | addr[2];
+}
+
+// Mixes all 48 bits; vendor-heavy prefixes would cluster with a plain pack
+inline size_t hash(const uint8_t* addr) {
+    uint64_t x = pack(addr);
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+}
+
+inline int compare(const uint8_t* a, const uint8_t* b) {
+    return std::memcmp(a, b, ADDRESS_LENGTH);
+}
+
+} // namespace mac
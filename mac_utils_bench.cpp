@@ -0,0 +1,127 @@
+#include "mac_utils.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+// Checks mac::parse/format against straightforward reference versions,
+// then times them against the stringstream path they replaced.
+//
+//   mac_utils_bench [iterations]
+
+// The formatting MacAddress::toString() used before mac_utils
+static std::string stream_format(const uint8_t* addr) {
+    std::stringstream ss;
+    for (size_t i = 0; i < 6; ++i) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(addr[i]);
+        if (i < 5) ss << ":";
+    }
+    return ss.str();
+}
+
+static bool stream_parse(const std::string& text, uint8_t* out) {
+    if (text.size() != 17) return false;
+    std::istringstream in(text);
+    for (size_t i = 0; i < 6; ++i) {
+        unsigned value;
+        char separator;
+        if (!(in >> std::hex >> value) || value > 0xFF) return false;
+        if (i < 5 && (!(in >> separator) || (separator != ':' && separator != '-'))) return false;
+        out[i] = static_cast<uint8_t>(value);
+    }
+    return true;
+}
+
+// Per-character parser wifi::Bssid::parse used before mac_utils
+static bool scalar_parse(std::string_view text, uint8_t* out) {
+    if (text.size() != 17) return false;
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    const char separator = text[2];
+    if (separator != ':' && separator != '-') return false;
+    uint8_t bytes[6];
+    for (size_t i = 0; i < 6; ++i) {
+        int hi = nibble(text[i * 3]);
+        int lo = nibble(text[i * 3 + 1]);
+        if (hi < 0 || lo < 0) return false;
+        if (i < 5 && text[i * 3 + 2] != separator) return false;
+        bytes[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    std::memcpy(out, bytes, sizeof(bytes));
+    return true;
+}
+
+static void check_against_reference(size_t iterations) {
+    std::mt19937 rng(5);
+    size_t round_trip_errors = 0, parse_mismatches = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        uint8_t addr[6];
+        for (auto& b : addr) b = static_cast<uint8_t>(rng());
+
+        char text[mac::STRING_LENGTH];
+        mac::format(addr, text);
+        std::string formatted(text, sizeof(text));
+        uint8_t parsed[6];
+        bool round_trip = formatted == stream_format(addr) && mac::parse(formatted, parsed) &&
+                          std::memcmp(parsed, addr, 6) == 0;
+        if (!round_trip) round_trip_errors++;
+
+        // One corrupted character, sometimes upper-cased
+        std::string mutated = formatted;
+        mutated[rng() % mutated.size()] = static_cast<char>(rng());
+        if (rng() % 3 == 0) {
+            for (auto& c : mutated) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        uint8_t ours[6] = {}, reference[6] = {};
+        bool ok = mac::parse(mutated, ours);
+        bool expected = scalar_parse(mutated, reference);
+        bool agrees = ok == expected && (!ok || std::memcmp(ours, reference, 6) == 0);
+        if (!agrees) parse_mismatches++;
+    }
+    CHECK(round_trip_errors == 0, "format/parse round trip");
+    CHECK(parse_mismatches == 0, "parse agrees with the reference on corrupted input");
+}
+
+int main(int argc, char** argv) {
+    const size_t runs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    check_against_reference(std::min<size_t>(runs, 200000));
+
+    uint8_t addr[6] = {0xde, 0xad, 0xbe, 0xef, 0x01, 0x02};
+    char text[mac::STRING_LENGTH];
+    mac::format(addr, text);
+    const std::string formatted(text, sizeof(text));
+
+    double stream_fmt = testing::ns_per_call(runs / 10, [&](size_t i) {
+        addr[5] = static_cast<uint8_t>(i);
+        testing::keep(stream_format(addr));
+    });
+    double swar_fmt = testing::ns_per_call(runs, [&](size_t i) {
+        addr[5] = static_cast<uint8_t>(i);
+        mac::format(addr, text);
+        testing::keep(text);
+    });
+    double stream_prs = testing::ns_per_call(runs / 10, [&](size_t) {
+        uint8_t out[6];
+        testing::keep(stream_parse(formatted, out));
+    });
+    double scalar_prs = testing::ns_per_call(runs, [&](size_t) {
+        uint8_t out[6];
+        testing::keep(scalar_parse(formatted, out));
+    });
+    double swar_prs = testing::ns_per_call(runs, [&](size_t) {
+        uint8_t out[6];
+        testing::keep(mac::parse(formatted, out));
+    });
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "format: stringstream " << stream_fmt << " ns, mac::format " << swar_fmt << " ns\n"
+              << "parse:  stringstream " << stream_prs << " ns, per-char " << scalar_prs
+              << " ns, mac::parse " << swar_prs << " ns" << std::endl;
+    return testing::finish("mac_utils_bench");
+}
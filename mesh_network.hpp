@@ -5,7 +5,17 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "anon_core.hpp"
+#include "logger.hpp"
+#include "nl80211_client.hpp"
+#include "reactor.hpp"
 
 namespace anon {
 
@@ -21,9 +31,14 @@ private:
     static constexpr uint16_t MESH_PORT = 1337;
     static constexpr size_t MAX_PACKET_SIZE = 1500;
     
+    static constexpr const char* MESH_IFACE = "wlan1";
+    
     std::atomic<bool> running{false};
+    netlink::Nl80211 radio;
     std::queue<MeshData> incoming_data;
     std::mutex data_mutex;
+    int sock{-1};
+    runtime::Reactor* reactor;  // wakes only when a packet arrives
     
     // Network configuration
     struct {
@@ -35,25 +50,63 @@ private:
     } config;
     
     void setup_mesh_interface() {
-        // Set up WiFi interface in mesh mode
-        std::string cmd = "iw dev wlan1 set type mesh";
-        system(cmd.c_str());
-        
-        cmd = "iw dev wlan1 set mesh_param mesh_id " + config.mesh_id;
-        system(cmd.c_str());
-        
-        cmd = "iw dev wlan1 set channel " + std::to_string(config.channel);
-        system(cmd.c_str());
-        
-        cmd = "ip link set wlan1 up";
-        system(cmd.c_str());
+        // Set up WiFi interface in mesh mode; the type changes only while down
+        radio.set_link(MESH_IFACE, false);
+        radio.set_type(MESH_IFACE, netlink::IfType::MESH_POINT);
+        radio.set_channel(MESH_IFACE, config.channel);
+        radio.set_link(MESH_IFACE, true);
+        radio.join_mesh(MESH_IFACE, config.mesh_id);
+    }
+    
+    bool open_socket() {
+        sock = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0) return false;
+        int on = 1;
+        ::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        ::setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+        ::setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, MESH_IFACE, std::strlen(MESH_IFACE));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(MESH_PORT);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (::bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(sock);
+            sock = -1;
+            return false;
+        }
+        return true;
     }
     
-    void receive_loop() {
-        while (running) {
-            // TODO: Implement actual packet reception
-            // This would use raw sockets to receive mesh packets
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Drains every datagram that is ready
+    void receive_ready() {
+        uint8_t buffer[MAX_PACKET_SIZE];
+        while (true) {
+            sockaddr_in from{};
+            socklen_t from_len = sizeof(from);
+            ssize_t n = ::recvfrom(sock, buffer, sizeof(buffer), 0,
+                                   reinterpret_cast<sockaddr*>(&from), &from_len);
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    logging::warn("Mesh receive failed: {}", std::strerror(errno));
+                }
+                if (errno != EINTR) return;
+                continue;
+            }
+            
+            MeshData data;
+            char sender[INET_ADDRSTRLEN] = {0};
+            ::inet_ntop(AF_INET, &from.sin_addr, sender, sizeof(sender));
+            data.sender_id = sender;
+            data.data_type = "raw";
+            data.payload.assign(buffer, buffer + n);
+            if (config.encrypted) {
+                data.payload = decrypt_data(data.payload);
+            }
+            data.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+            
+            std::lock_guard<std::mutex> lock(data_mutex);
+            incoming_data.push(std::move(data));
         }
     }
     
@@ -68,21 +121,41 @@ private:
     }
 
 public:
-    MeshNetwork() = default;
+    // Receives on events, the process loop by default
+    explicit MeshNetwork(runtime::Reactor* events = nullptr)
+        : reactor(events ? events : &runtime::Reactor::shared()) {}
+    
+    ~MeshNetwork() {
+        stop();
+    }
+    
+    MeshNetwork(const MeshNetwork&) = delete;
+    MeshNetwork& operator=(const MeshNetwork&) = delete;
     
     void start() {
         if (!running) {
             running = true;
             setup_mesh_interface();
-            // Start receive thread
-            std::thread([this]() {
-                receive_loop();
-            }).detach();
+            if (!open_socket()) {
+                logging::error("Mesh socket on port {} failed: {}", MESH_PORT, std::strerror(errno));
+                return;
+            }
+            reactor->add_fd(sock, EPOLLIN, [this](uint32_t) { receive_ready(); });
         }
     }
     
     void stop() {
         running = false;
+        if (sock >= 0) {
+            // No receive is running once this returns
+            reactor->call([this] { reactor->remove_fd(sock); });
+            ::close(sock);
+            sock = -1;
+        }
+    }
+    
+    runtime::ReactorStats get_reactor_stats() const {
+        return reactor->stats();
     }
     
     void broadcast_data(const MeshData& data) {
@@ -117,18 +190,14 @@ public:
     void set_channel(uint8_t channel) {
         config.channel = channel;
         if (running) {
-            std::string cmd = "iw dev wlan1 set channel " + 
-                             std::to_string(config.channel);
-            system(cmd.c_str());
+            radio.set_channel(MESH_IFACE, config.channel);
         }
     }
     
     void set_tx_power(int8_t power) {
         config.tx_power = power;
         if (running) {
-            std::string cmd = "iw dev wlan1 set txpower fixed " + 
-                             std::to_string(config.tx_power * 100);
-            system(cmd.c_str());
+            radio.set_tx_power(MESH_IFACE, config.tx_power * 100);
         }
     }
 };
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "time_service.hpp"
+
+// Counters, gauges and latency histograms for the hot paths. Counters
+// and histograms are sharded per thread: each thread writes only its own
+// shard with relaxed loads and stores, so recording takes no lock and no
+// atomic read-modify-write, and a snapshot sums the shards. Histograms
+// are log-linear (HDR style): exact below 32 ns, then 32 buckets per
+// power of two, so any quantile is within about 3% of the true value.
+namespace metrics {
+
+constexpr size_t MAX_COUNTERS = 64;
+constexpr size_t MAX_GAUGES = 32;
+constexpr size_t MAX_HISTOGRAMS = 32;
+
+constexpr unsigned SUB_BITS = 5;
+constexpr uint64_t SUB_BUCKETS = uint64_t{1} << SUB_BITS;
+constexpr unsigned MAX_EXPONENT = 42;  // ~73 minutes in ns; longer lands in the last bucket
+constexpr size_t BUCKETS = SUB_BUCKETS + (MAX_EXPONENT - SUB_BITS + 1) * SUB_BUCKETS;
+
+inline size_t bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+    unsigned shift = exponent - SUB_BITS;
+    return static_cast<size_t>(SUB_BUCKETS + shift * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+}
+
+// Largest value that lands in bucket i
+inline uint64_t bucket_upper(size_t i) {
+    if (i < SUB_BUCKETS) return i;
+    size_t shift = (i - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t mantissa = (i - SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+namespace detail {
+
+// Only the owning thread writes a shard, so load + store is enough
+inline void bump(std::atomic<uint64_t>& cell, uint64_t n) {
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct HistogramCells {
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+struct Shard {
+    std::array<std::atomic<uint64_t>, MAX_COUNTERS> counters{};
+    // Allocated by the owner on its first record, so idle threads stay small
+    std::array<std::atomic<HistogramCells*>, MAX_HISTOGRAMS> histograms{};
+    std::atomic<bool> leased{true};  // false once the thread exits; reused by the next
+
+    ~Shard() {
+        for (auto& cells : histograms) delete cells.load();
+    }
+
+    HistogramCells& cells(size_t slot) {
+        HistogramCells* c = histograms[slot].load(std::memory_order_relaxed);
+        if (!c) {
+            c = new HistogramCells();
+            histograms[slot].store(c, std::memory_order_release);
+        }
+        return *c;
+    }
+};
+
+} // namespace detail
+
+struct HistogramSummary {
+    std::string name;
+    uint64_t count;
+    double mean;  // ns
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+// Raw merged histogram, kept so later snapshots can report an interval
+struct HistogramData {
+    std::string name;
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t max{0};
+    std::vector<uint64_t> buckets;
+
+    // Counts recorded since earlier (same histogram, taken before this);
+    // max stays the lifetime max
+    HistogramData since(const HistogramData& earlier) const {
+        HistogramData d{name, count - earlier.count, sum - earlier.sum, max, buckets};
+        if (earlier.buckets.size() == d.buckets.size()) {
+            for (size_t i = 0; i < d.buckets.size(); ++i) d.buckets[i] -= earlier.buckets[i];
+        }
+        return d;
+    }
+
+    uint64_t quantile(double q) const {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return std::min(bucket_upper(i), max);
+        }
+        return max;
+    }
+
+    HistogramSummary summary() const {
+        return HistogramSummary{name, count, count ? static_cast<double>(sum) / count : 0.0,
+                                quantile(0.5), quantile(0.9), quantile(0.99), quantile(0.999), max};
+    }
+};
+
+struct Snapshot {
+    timesvc::WallTime taken;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::vector<std::pair<std::string, int64_t>> gauges;
+    std::vector<HistogramData> histograms;
+};
+
+class Registry;
+
+class Counter {
+    Registry* registry{nullptr};
+    size_t slot{MAX_COUNTERS};
+
+public:
+    Counter() = default;
+    Counter(Registry* r, size_t s) : registry(r), slot(s) {}
+    inline void add(uint64_t n = 1) const;
+};
+
+class Gauge {
+    std::atomic<int64_t>* cell{nullptr};
+
+public:
+    Gauge() = default;
+    explicit Gauge(std::atomic<int64_t>* c) : cell(c) {}
+    void set(int64_t value) const {
+        if (cell) cell->store(value, std::memory_order_relaxed);
+    }
+    void add(int64_t delta) const {
+        if (cell) cell->fetch_add(delta, std::memory_order_relaxed);
+    }
+    int64_t get() const { return cell ? cell->load(std::memory_order_relaxed) : 0; }
+};
+
+class Histogram {
+    Registry* registry{nullptr};
+    size_t slot{MAX_HISTOGRAMS};
+
+public:
+    Histogram() = default;
+    Histogram(Registry* r, size_t s) : registry(r), slot(s) {}
+    inline void record(uint64_t nanoseconds) const;
+    template <typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> d) const {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(static_cast<uint64_t>(std::max<decltype(ns)>(ns, 0)));
+    }
+};
+
+// Records the time from construction to destruction
+class ScopedTimer {
+    const Histogram& histogram;
+    timesvc::MonoTime start;
+
+public:
+    explicit ScopedTimer(const Histogram& h) : histogram(h), start(timesvc::precise_now()) {}
+    ~ScopedTimer() { histogram.record(timesvc::precise_now() - start); }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+class Registry {
+private:
+    friend class Counter;
+    friend class Histogram;
+
+    mutable std::mutex mutex;
+    std::vector<std::string> counter_names;
+    std::vector<std::string> gauge_names;
+    std::vector<std::string> histogram_names;
+    std::array<std::atomic<int64_t>, MAX_GAUGES> gauges{};
+    std::atomic<int64_t> overflow_gauge{0};  // handed out once MAX_GAUGES are taken
+    std::vector<std::shared_ptr<detail::Shard>> shards;
+    uint64_t id;
+
+    static inline std::atomic<uint64_t> next_id{1};
+
+    // The calling thread's shard, found through a one-entry thread-local
+    // cache; a thread that exits hands its shard to the next one
+    detail::Shard& shard() {
+        struct Lease {
+            uint64_t owner{0};
+            std::shared_ptr<detail::Shard> shard;
+            void release() {
+                if (shard) shard->leased.store(false, std::memory_order_release);
+                shard.reset();
+            }
+            ~Lease() { release(); }
+        };
+        static thread_local Lease lease;
+        if (lease.owner == id) return *lease.shard;
+
+        lease.release();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& s : shards) {
+            bool free = false;
+            if (s->leased.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                lease.shard = s;
+                break;
+            }
+        }
+        if (!lease.shard) {
+            lease.shard = std::make_shared<detail::Shard>();
+            shards.push_back(lease.shard);
+        }
+        lease.owner = id;
+        return *lease.shard;
+    }
+
+    static size_t find_or_add(std::vector<std::string>& names, const std::string& name, size_t limit) {
+        auto it = std::find(names.begin(), names.end(), name);
+        if (it != names.end()) return static_cast<size_t>(it - names.begin());
+        if (names.size() == limit) return limit;  // full: records are dropped
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+public:
+    Registry() : id(next_id.fetch_add(1)) {}
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    // Process-wide registry the hot paths record into
+    static Registry& global() {
+        static Registry registry;
+        return registry;
+    }
+
+    // The same name always gives the same metric; register once and keep
+    // the handle rather than looking it up per event
+    Counter counter(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return Counter(this, find_or_add(counter_names, name, MAX_COUNTERS));
+    }
+
+    Gauge gauge(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t slot = find_or_add(gauge_names, name, MAX_GAUGES);
+        return Gauge(slot < MAX_GAUGES ? &gauges[slot] : &overflow_gauge);
+    }
+
+    Histogram histogram(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return Histogram(this, find_or_add(histogram_names, name, MAX_HISTOGRAMS));
+    }
+
+    // Sums every shard; each value is read atomically, the set as a whole
+    // is not, which costs at most the events recorded during the read
+    Snapshot snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Snapshot s;
+        s.taken = timesvc::WallClock::now();
+        for (size_t i = 0; i < counter_names.size(); ++i) {
+            uint64_t total = 0;
+            for (const auto& shard : shards) total += shard->counters[i].load(std::memory_order_relaxed);
+            s.counters.emplace_back(counter_names[i], total);
+        }
+        for (size_t i = 0; i < gauge_names.size(); ++i) {
+            s.gauges.emplace_back(gauge_names[i], gauges[i].load(std::memory_order_relaxed));
+        }
+        for (size_t i = 0; i < histogram_names.size(); ++i) {
+            HistogramData h{histogram_names[i], 0, 0, 0, std::vector<uint64_t>(BUCKETS, 0)};
+            for (const auto& shard : shards) {
+                const detail::HistogramCells* cells = shard->histograms[i].load(std::memory_order_acquire);
+                if (!cells) continue;
+                h.count += cells->count.load(std::memory_order_relaxed);
+                h.sum += cells->sum.load(std::memory_order_relaxed);
+                h.max = std::max(h.max, cells->max.load(std::memory_order_relaxed));
+                for (size_t b = 0; b < BUCKETS; ++b) h.buckets[b] += cells->buckets[b].load(std::memory_order_relaxed);
+            }
+            s.histograms.push_back(std::move(h));
+        }
+        return s;
+    }
+
+    size_t shard_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return shards.size();
+    }
+};
+
+inline void Counter::add(uint64_t n) const {
+    if (!registry || slot >= MAX_COUNTERS) return;
+    detail::bump(registry->shard().counters[slot], n);
+}
+
+inline void Histogram::record(uint64_t nanoseconds) const {
+    if (!registry || slot >= MAX_HISTOGRAMS) return;
+    detail::HistogramCells& cells = registry->shard().cells(slot);
+    detail::bump(cells.buckets[bucket_index(nanoseconds)], 1);
+    detail::bump(cells.count, 1);
+    detail::bump(cells.sum, nanoseconds);
+    if (nanoseconds > cells.max.load(std::memory_order_relaxed)) {
+        cells.max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+// Handles in the global registry
+inline Counter counter(const std::string& name) { return Registry::global().counter(name); }
+inline Gauge gauge(const std::string& name) { return Registry::global().gauge(name); }
+inline Histogram histogram(const std::string& name) { return Registry::global().histogram(name); }
+
+// One metric per line, latencies in microseconds:
+//   counter frames_ingested 1234
+//   gauge ingest_queue 12
+//   histogram frame_parse count=... mean_us=... p50_us=... p99_us=... p999_us=... max_us=...
+// With earlier set, each histogram gets a second ".recent" line covering
+// only what was recorded since earlier was taken.
+inline std::string to_text(const Snapshot& snapshot, const Snapshot* earlier = nullptr) {
+    std::string out;
+    char line[256];
+    std::time_t taken = timesvc::WallClock::to_time_t(snapshot.taken);
+    std::tm utc{};
+    ::gmtime_r(&taken, &utc);
+    std::strftime(line, sizeof(line), "# metrics %Y-%m-%dT%H:%M:%SZ\n", &utc);
+    out += line;
+    for (const auto& [name, value] : snapshot.counters) {
+        std::snprintf(line, sizeof(line), "counter %s %llu\n", name.c_str(),
+                      static_cast<unsigned long long>(value));
+        out += line;
+    }
+    for (const auto& [name, value] : snapshot.gauges) {
+        std::snprintf(line, sizeof(line), "gauge %s %lld\n", name.c_str(), static_cast<long long>(value));
+        out += line;
+    }
+    auto emit = [&](const HistogramData& data, const char* suffix) {
+        HistogramSummary h = data.summary();
+        std::snprintf(line, sizeof(line),
+                      "histogram %s%s count=%llu mean_us=%.1f p50_us=%.1f p90_us=%.1f p99_us=%.1f "
+                      "p999_us=%.1f max_us=%.1f\n",
+                      h.name.c_str(), suffix, static_cast<unsigned long long>(h.count), h.mean / 1e3,
+                      h.p50 / 1e3, h.p90 / 1e3, h.p99 / 1e3, h.p999 / 1e3, h.max / 1e3);
+        out += line;
+    };
+    for (const auto& h : snapshot.histograms) {
+        emit(h, "");
+        if (!earlier) continue;
+        for (const auto& before : earlier->histograms) {
+            if (before.name == h.name) {
+                emit(h.since(before), ".recent");
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace metrics
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "reactor.hpp"
+
+// Local export of the metrics registry. A Unix domain socket answers
+// every connection with the current snapshot and closes it, so
+// `socat - UNIX-CONNECT:<path>` or `nc -U <path>` is enough to read it;
+// the same text is also written to a file on a timer. Both show lifetime
+// histograms plus ".recent" ones covering the last file interval. The
+// defaults live on tmpfs, so neither touches the SD card.
+namespace metrics {
+
+struct ExporterStats {
+    uint64_t served;         // socket snapshots sent
+    uint64_t failed_sends;
+    uint64_t files_written;
+    uint64_t failed_writes;
+};
+
+class Exporter {
+public:
+    struct Config {
+        std::filesystem::path socket_path = "/run/pwnagotchi/metrics.sock";  // empty: no socket
+        std::filesystem::path file_path = "/run/pwnagotchi/metrics.txt";     // empty: no file
+        std::chrono::milliseconds file_interval{10000};
+        std::chrono::milliseconds send_timeout{200};  // a client that stalls longer is dropped
+    };
+
+private:
+    Registry* registry;
+    Config config;
+    int listen_fd{-1};
+    bool started{false};
+    std::mutex mutex;
+    Snapshot previous;      // as of the last file write
+    bool has_previous{false};
+    ExporterStats counts{};
+    runtime::Reactor* reactor;
+    runtime::TimerId file_timer{0};
+
+    std::string render_locked() {
+        Snapshot now = registry->snapshot();
+        return to_text(now, has_previous ? &previous : nullptr);
+    }
+
+    void accept_ready() {
+        while (true) {
+            int client = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                return;  // EAGAIN: drained
+            }
+            struct timeval timeout{};
+            timeout.tv_sec = config.send_timeout.count() / 1000;
+            timeout.tv_usec = (config.send_timeout.count() % 1000) * 1000;
+            ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            std::lock_guard<std::mutex> lock(mutex);
+            std::string text = render_locked();
+            bool ok = persist::detail::write_all(client, reinterpret_cast<const uint8_t*>(text.data()),
+                                                 text.size());
+            ::close(client);
+            ok ? counts.served++ : counts.failed_sends++;
+        }
+    }
+
+    void write_file() {
+        std::lock_guard<std::mutex> lock(mutex);
+        Snapshot now = registry->snapshot();
+        std::string text = to_text(now, has_previous ? &previous : nullptr);
+        // Not fsynced: a crash losing the latest copy costs nothing
+        if (persist::write_file_atomic(config.file_path, text.data(), text.size(), false)) {
+            counts.files_written++;
+        } else {
+            counts.failed_writes++;
+        }
+        previous = std::move(now);
+        has_previous = true;
+    }
+
+    bool open_socket() {
+        const std::string path = config.socket_path.string();
+        struct sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            logging::error("Metrics socket path too long: {}", path);
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) return false;
+        ::unlink(path.c_str());  // left over from a previous run
+        if (::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd, 8) != 0 ||
+            !reactor->add_fd(listen_fd, EPOLLIN, [this](uint32_t) { accept_ready(); })) {
+            logging::error("Metrics socket {} failed: {}", path, std::strerror(errno));
+            ::close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    // Serves from events, the process loop by default
+    explicit Exporter(Registry* source = nullptr, runtime::Reactor* events = nullptr)
+        : registry(source ? source : &Registry::global()),
+          reactor(events ? events : &runtime::Reactor::shared()) {}
+
+    ~Exporter() { stop(); }
+
+    Exporter(const Exporter&) = delete;
+    Exporter& operator=(const Exporter&) = delete;
+
+    // Serves and writes from the loop; false if nothing could be set up
+    bool start(const Config& cfg) {
+        if (started) return true;
+        config = cfg;
+        std::error_code ec;
+        bool serving = false;
+        if (!config.socket_path.empty()) {
+            std::filesystem::create_directories(config.socket_path.parent_path(), ec);
+            serving = open_socket();
+        }
+        if (!config.file_path.empty()) {
+            std::filesystem::create_directories(config.file_path.parent_path(), ec);
+            file_timer = reactor->add_periodic(config.file_interval, [this] { write_file(); });
+            serving = true;
+        }
+        started = serving;
+        return started;
+    }
+
+    bool start() { return start(Config()); }
+
+    // Writes the file a last time and removes the socket
+    void stop() {
+        if (!started) return;
+        started = false;
+        // Neither handler is running once this returns
+        reactor->call([this] {
+            if (file_timer) reactor->cancel_timer(file_timer);
+            if (listen_fd >= 0) reactor->remove_fd(listen_fd);
+        });
+        file_timer = 0;
+        if (listen_fd >= 0) {
+            ::close(listen_fd);
+            listen_fd = -1;
+            ::unlink(config.socket_path.c_str());
+        }
+        if (!config.file_path.empty()) write_file();
+    }
+
+    // The text a socket client would get now
+    std::string render() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return render_locked();
+    }
+
+    ExporterStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counts;
+    }
+};
+
+} // namespace metrics
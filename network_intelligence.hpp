@@ -10,14 +10,25 @@
 #include <thread>
 #include <mutex>
 #include <queue>
+#include <array>
+#include <atomic>
+#include <unordered_map>
 #include "advanced_neural_net.hpp"
+#include "load_shedder.hpp"
+#include "metrics.hpp"
+#include "rcu_snapshot.hpp"
+#include "energy_scheduler.hpp"
+#include "timing_wheel.hpp"
+#include "bounded_table.hpp"
+#include "time_service.hpp"
+#include "wifi_types.hpp"
 
 namespace net_intel {
 
 struct NetworkPacket {
     std::vector<uint8_t> data;
-    std::string source_mac;
-    std::string dest_mac;
+    wifi::Bssid source_mac;
+    wifi::Bssid dest_mac;
     uint16_t type;
     uint64_t timestamp;
     int8_t rssi;
@@ -25,15 +36,26 @@ struct NetworkPacket {
     bool is_management;
     bool is_data;
     bool is_control;
+    uint32_t sample_weight = 1;  // frames this one stands for when sampled
+};
+
+// Frame counts by type and channel, including shed and dropped frames.
+// Sampled frames are added with their weight, so totals stay unbiased
+// while data frames are being shed.
+struct FrameCounters {
+    uint64_t management{0};
+    uint64_t data{0};
+    uint64_t control{0};
+    std::array<uint64_t, 256> per_channel{};  // by channel number, 2.4 and 5 GHz
 };
 
 struct AccessPoint {
-    std::string bssid;
-    std::string ssid;
+    wifi::Bssid bssid;
+    wifi::Ssid ssid;
     uint8_t channel;
     int8_t rssi;
-    std::vector<std::string> clients;
-    std::chrono::system_clock::time_point last_seen;
+    std::vector<wifi::Bssid> clients;
+    timesvc::MonoTime last_seen;
     std::map<std::string, int> security_features;
     double vulnerability_score;
     bool is_target;
@@ -45,6 +67,28 @@ struct AccessPoint {
     double anomaly_score;
 };
 
+// Immutable view of the AP table, sorted by vulnerability score. Entries are
+// shared between consecutive versions; only APs updated since the previous
+// version are copied.
+struct TargetTable {
+    std::vector<std::shared_ptr<const AccessPoint>> entries;
+    double threshold{0.0};
+
+    // Entries above the detection threshold form a prefix of the table
+    size_t target_count() const {
+        auto it = std::partition_point(entries.begin(), entries.end(),
+            [this](const auto& ap) { return ap->vulnerability_score > threshold; });
+        return it - entries.begin();
+    }
+};
+
+// Entries dropped by TTL since startup, per store
+struct ExpiryStats {
+    uint64_t access_points;
+    uint64_t clients;
+    uint64_t packet_history;
+};
+
 class NetworkIntelligence {
 private:
     // Neural networks for different aspects
@@ -53,14 +97,55 @@ private:
     std::unique_ptr<ann::AdvancedNeuralNetwork> vulnerability_assessor;
     
     // Data structures for network understanding
-    std::map<std::string, AccessPoint> access_points;
-    std::map<std::string, std::vector<NetworkPacket>> packet_history;
+    // Fixed-capacity AP and client tables
+    static constexpr size_t DEFAULT_MAX_APS = 128;      // MAX_APS
+    static constexpr size_t DEFAULT_MAX_CLIENTS = 256;  // MAX_CLIENTS
+    bounded::BoundedTable<wifi::Bssid, AccessPoint> access_points;
+    bounded::BoundedTable<wifi::StationKey, int8_t> client_table;  // last rssi
+    std::unordered_map<wifi::Bssid, std::vector<NetworkPacket>> packet_history;
     std::queue<NetworkPacket> packet_queue;
+    static constexpr size_t BATCH_SIZE = 1000;
+    static constexpr size_t MAX_QUEUE_SIZE = 4096;
+    std::atomic<bool> batch_running{false};  // one consumer at a time
+    
+    // TTL expiry for the AP, client and packet-history stores
+    // AP and history keys carry a zero station
+    expiry::TimingWheel<wifi::StationKey> expiry_wheel;
+    expiry::StoreId ap_store;
+    expiry::StoreId client_store;
+    expiry::StoreId history_store;
+    
+    // Published AP table for lock-free readers
+    rcu::SnapshotPublisher<TargetTable> target_table;
+    std::vector<wifi::Bssid> dirty_aps;
+    
+    // Ingest load control
+    LoadShedder load_shedder;
+    FrameCounters frame_counters;  // guarded by queue_mutex, counted at admission
     
     // Pattern recognition
+    std::atomic<uint64_t> training_rounds{0};
     std::vector<std::vector<double>> traffic_patterns;
     std::vector<std::vector<double>> behavior_patterns;
     
+    // Training runs as LOW work, at most one round queued at a time, and
+    // waits out low battery or heat; model_mutex keeps it apart from
+    // scoring and model I/O
+    runtime::EnergyScheduler* energy{&runtime::EnergyScheduler::shared()};
+    runtime::TaskHandle training_task;
+    std::atomic<bool> training_queued{false};
+    std::mutex model_mutex;
+    
+    // Per-stage latencies for the metrics export: ingest is admission and
+    // queueing, parse is folding one frame into the AP table, score is
+    // one vulnerability assessment
+    metrics::Histogram ingest_latency = metrics::histogram("frame_ingest");
+    metrics::Histogram parse_latency = metrics::histogram("frame_parse");
+    metrics::Histogram score_latency = metrics::histogram("score");
+    metrics::Counter frames_ingested = metrics::counter("frames_ingested");
+    metrics::Counter frames_shed = metrics::counter("frames_shed");
+    metrics::Gauge ingest_queue = metrics::gauge("ingest_queue");
+    
     // Mutex for thread safety
     std::mutex data_mutex;
     std::mutex queue_mutex;
@@ -99,6 +184,7 @@ private:
     
     // Vulnerability assessment
     double assess_vulnerability(const AccessPoint& ap) {
+        metrics::ScopedTimer timer(score_latency);
         std::vector<double> features;
         
         // Security features
@@ -106,6 +192,8 @@ private:
         features.push_back(ap.security_features.count("WPA") ? 1.0 : 0.0);
         features.push_back(ap.security_features.count("WPA2") ? 1.0 : 0.0);
         
+        std::lock_guard<std::mutex> lock(model_mutex);
+        
         // Traffic patterns
         auto traffic_score = traffic_analyzer->predict(ap.traffic_pattern);
         features.insert(features.end(), traffic_score.begin(), traffic_score.end());
@@ -120,11 +208,32 @@ private:
     }
 
 public:
-    NetworkIntelligence(double detection_thresh = 0.75, double stealth = 0.9)
-        : detection_threshold(detection_thresh),
+    NetworkIntelligence(double detection_thresh = 0.75, double stealth = 0.9,
+                        size_t max_aps = DEFAULT_MAX_APS,
+                        size_t max_clients = DEFAULT_MAX_CLIENTS)
+        : access_points(max_aps),
+          client_table(max_clients),
+          detection_threshold(detection_thresh),
           stealth_factor(stealth),
           adaptive_mode(true) {
         
+        // Evicted entries take their dependent state with them
+        access_points.set_evict_callback([this](const wifi::Bssid& bssid, AccessPoint&) {
+            packet_history.erase(bssid);
+            expiry_wheel.remove(ap_store, wifi::StationKey{bssid, {}});
+            expiry_wheel.remove(history_store, wifi::StationKey{bssid, {}});
+            dirty_aps.push_back(bssid);
+        });
+        client_table.set_evict_callback([this](const wifi::StationKey& key, int8_t&) {
+            expiry_wheel.remove(client_store, key);
+            drop_client(key);
+        });
+        
+        // Stale entries are dropped after these TTLs unless seen again
+        ap_store = expiry_wheel.add_store("access_points", std::chrono::hours(24));
+        client_store = expiry_wheel.add_store("clients", std::chrono::hours(1));
+        history_store = expiry_wheel.add_store("packet_history", std::chrono::minutes(30));
+        
         // Initialize neural networks
         traffic_analyzer = std::make_unique<ann::AdvancedNeuralNetwork>(0.001, 0.9, 0.1);
         behavior_predictor = std::make_unique<ann::AdvancedNeuralNetwork>(0.001, 0.9, 0.1);
@@ -134,52 +243,188 @@ public:
         // ... (network architecture configuration)
     }
     
+    ~NetworkIntelligence() {
+        // A round in progress finishes; one still queued is dropped
+        if (!training_task.cancel()) training_task.wait();
+    }
+    
+    NetworkIntelligence(const NetworkIntelligence&) = delete;
+    NetworkIntelligence& operator=(const NetworkIntelligence&) = delete;
+    
+    // Set before packets arrive; defaults to the shared scheduler
+    void set_scheduler(runtime::EnergyScheduler* scheduler) {
+        energy = scheduler ? scheduler : &runtime::EnergyScheduler::shared();
+    }
+    
     void process_packet(const NetworkPacket& packet) {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        packet_queue.push(packet);
+        auto start = timesvc::precise_now();
+        Admission admission = load_shedder.admit(packet.is_management, packet.is_data);
+        
+        bool batch_ready;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            // Every frame is counted, whether it is processed or not
+            update_counters(packet, admission.weight);
+            if (!admission.process) {
+                frames_shed.add();
+                return;
+            }
+            if (packet_queue.size() >= MAX_QUEUE_SIZE) {
+                load_shedder.record_queue_drop();
+                frames_shed.add();
+                return;
+            }
+            packet_queue.push(packet);
+            packet_queue.back().sample_weight = admission.weight;
+            batch_ready = packet_queue.size() > BATCH_SIZE;
+            ingest_queue.set(static_cast<int64_t>(packet_queue.size()));
+        }
+        frames_ingested.add();
+        ingest_latency.record(timesvc::precise_now() - start);
         
-        if (packet_queue.size() > 1000) {  // Process in batches
+        if (batch_ready) {  // Process in batches
             process_packet_batch();
         }
     }
     
+    // Periodic upkeep, independent of traffic: processes frames short of a
+    // full batch, closes the shedder window and expires stale entries, so
+    // none of that stalls when the ingest path goes quiet
+    void tick() {
+        process_packet_batch();
+    }
+    
+    // Drains the queue; a caller that finds another batch running returns
+    // and its frames go in the next batch
     void process_packet_batch() {
+        if (batch_running.exchange(true, std::memory_order_acquire)) return;
+        struct Release {
+            std::atomic<bool>& flag;
+            ~Release() { flag.store(false, std::memory_order_release); }
+        } release{batch_running};
+        
         std::vector<NetworkPacket> batch;
         {
             std::lock_guard<std::mutex> lock(queue_mutex);
+            batch.reserve(packet_queue.size());
             while (!packet_queue.empty()) {
-                batch.push_back(packet_queue.front());
+                batch.push_back(std::move(packet_queue.front()));
                 packet_queue.pop();
             }
+            ingest_queue.set(0);
         }
         
         for (const auto& packet : batch) {
+            auto start = timesvc::precise_now();
             update_access_point(packet);
             update_patterns(packet);
+            auto end = timesvc::precise_now();
+            load_shedder.record_cost(end - start, packet.is_management);
+            parse_latency.record(end - start);
         }
+        auto now = timesvc::precise_now();
+        load_shedder.end_window(now);
+        expire_stale(now);
+        publish_targets();
+    }
+    
+    void expire_stale(timesvc::MonoTime now) {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        expiry_wheel.advance(now, [this](expiry::StoreId store, const wifi::StationKey& key) {
+            if (store == ap_store) {
+                access_points.erase(key.bssid);
+                packet_history.erase(key.bssid);
+                dirty_aps.push_back(key.bssid);
+            } else if (store == history_store) {
+                packet_history.erase(key.bssid);
+            } else if (store == client_store) {
+                client_table.erase(key);
+                drop_client(key);
+            }
+        });
+    }
+    
+    // Removes a station from its AP's client list
+    void drop_client(const wifi::StationKey& key) {
+        auto* ap = access_points.find(key.bssid);
+        if (!ap) return;
+        auto& clients = ap->clients;
+        clients.erase(std::remove(clients.begin(), clients.end(), key.station), clients.end());
+        dirty_aps.push_back(key.bssid);
+    }
+    
+    // Builds the next TargetTable from the previous one plus the APs touched
+    // since it was published
+    void publish_targets() {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        if (dirty_aps.empty()) return;
+        
+        std::sort(dirty_aps.begin(), dirty_aps.end());
+        dirty_aps.erase(std::unique(dirty_aps.begin(), dirty_aps.end()), dirty_aps.end());
+        
+        TargetTable next;
+        next.threshold = detection_threshold;
+        {
+            auto previous = target_table.read();
+            if (previous) {
+                next.entries.reserve(previous->entries.size() + dirty_aps.size());
+                for (const auto& entry : previous->entries) {
+                    if (!std::binary_search(dirty_aps.begin(), dirty_aps.end(), entry->bssid)) {
+                        next.entries.push_back(entry);
+                    }
+                }
+            }
+        }
+        
+        auto by_score = [](const std::shared_ptr<const AccessPoint>& a,
+                           const std::shared_ptr<const AccessPoint>& b) {
+            return a->vulnerability_score > b->vulnerability_score;
+        };
+        for (const auto& bssid : dirty_aps) {
+            auto* ap = access_points.find(bssid);
+            if (!ap) continue;
+            auto entry = std::make_shared<const AccessPoint>(*ap);
+            next.entries.insert(
+                std::upper_bound(next.entries.begin(), next.entries.end(), entry, by_score),
+                std::move(entry));
+        }
+        dirty_aps.clear();
+        
+        target_table.publish(std::move(next));
+    }
+    
+    // Caller holds queue_mutex
+    void update_counters(const NetworkPacket& packet, uint32_t weight) {
+        if (packet.is_management) frame_counters.management += weight;
+        if (packet.is_data) frame_counters.data += weight;
+        if (packet.is_control) frame_counters.control += weight;
+        frame_counters.per_channel[packet.channel] += weight;
     }
     
     void update_access_point(const NetworkPacket& packet) {
         std::lock_guard<std::mutex> lock(data_mutex);
         
         if (packet.is_management) {
-            auto& ap = access_points[packet.source_mac];
+            auto& ap = access_points.upsert(packet.source_mac, bounded::signal_weight(packet.rssi));
             ap.bssid = packet.source_mac;
             ap.channel = packet.channel;
             ap.rssi = packet.rssi;
-            ap.last_seen = std::chrono::system_clock::now();
+            ap.last_seen = timesvc::coarse_now();
+            if (dirty_aps.empty() || dirty_aps.back() != packet.source_mac) {
+                dirty_aps.push_back(packet.source_mac);
+            }
+            expiry_wheel.touch(ap_store, wifi::StationKey{packet.source_mac, {}}, ap.last_seen);
+            expiry_wheel.touch(history_store, wifi::StationKey{packet.source_mac, {}}, ap.last_seen);
             
             // Update traffic patterns
-            if (packet_history[packet.source_mac].size() > 1000) {
-                packet_history[packet.source_mac].erase(
-                    packet_history[packet.source_mac].begin(),
-                    packet_history[packet.source_mac].begin() + 100
-                );
+            auto& history = packet_history[packet.source_mac];
+            if (history.size() > 1000) {
+                history.erase(history.begin(), history.begin() + 100);
             }
-            packet_history[packet.source_mac].push_back(packet);
+            history.push_back(packet);
             
             // Update patterns and scores
-            ap.traffic_pattern = analyze_traffic_pattern(packet_history[packet.source_mac]);
+            ap.traffic_pattern = analyze_traffic_pattern(history);
             ap.entropy = calculate_entropy(ap.traffic_pattern);
             ap.vulnerability_score = assess_vulnerability(ap);
             
@@ -188,6 +433,19 @@ public:
                 detection_threshold = std::min(0.9, detection_threshold * 
                     (1.0 + 0.1 * (ap.vulnerability_score - 0.5)));
             }
+        } else if (packet.is_data) {
+            // Data frames towards a known AP identify its clients
+            auto* ap = access_points.find(packet.dest_mac);
+            if (!ap) return;
+            
+            wifi::StationKey key{packet.dest_mac, packet.source_mac};
+            bool known = client_table.contains(key);
+            client_table.upsert(key, bounded::signal_weight(packet.rssi)) = packet.rssi;
+            if (!known) {
+                ap->clients.push_back(packet.source_mac);
+                dirty_aps.push_back(packet.dest_mac);
+            }
+            expiry_wheel.touch(client_store, key, timesvc::coarse_now());
         }
     }
     
@@ -205,13 +463,24 @@ public:
             traffic_patterns.erase(traffic_patterns.begin());
         }
         
-        // Train neural networks periodically
+        // Train neural networks periodically, off the ingest path
         if (traffic_patterns.size() % 100 == 0) {
-            train_networks();
+            schedule_training();
         }
     }
     
+    // Rounds asked for while one is queued fold into it
+    void schedule_training() {
+        if (training_queued.exchange(true)) return;
+        training_task = energy->submit(runtime::TaskSpec{"training", runtime::Priority::LOW}, [this] {
+            training_queued = false;
+            train_networks();
+        });
+    }
+    
     void train_networks() {
+        std::lock_guard<std::mutex> lock(model_mutex);
+        
         // Prepare training data
         std::vector<std::vector<double>> inputs;
         std::vector<std::vector<double>> targets;
@@ -224,40 +493,95 @@ public:
         
         // Train vulnerability assessor
         vulnerability_assessor->train(inputs, targets, 10, 32);
+        training_rounds.fetch_add(1, std::memory_order_relaxed);
     }
     
-    std::vector<AccessPoint> get_potential_targets() {
-        std::lock_guard<std::mutex> lock(data_mutex);
+    // Pins the latest published AP table; never blocks the ingest path
+    rcu::SnapshotPublisher<TargetTable>::ReadGuard get_target_table() const {
+        return target_table.read();
+    }
+    
+    std::vector<AccessPoint> get_potential_targets() const {
         std::vector<AccessPoint> targets;
+        auto table = target_table.read();
+        if (!table) return targets;
         
-        for (const auto& [bssid, ap] : access_points) {
-            if (ap.vulnerability_score > detection_threshold) {
-                targets.push_back(ap);
-            }
+        size_t count = table->target_count();
+        targets.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            targets.push_back(*table->entries[i]);
         }
-        
-        // Sort by vulnerability score
-        std::sort(targets.begin(), targets.end(),
-                 [](const AccessPoint& a, const AccessPoint& b) {
-                     return a.vulnerability_score > b.vulnerability_score;
-                 });
-        
         return targets;
     }
     
+    // Ingest load reporting and tuning
+    LoadStats get_load_stats() const {
+        return load_shedder.get_stats();
+    }
+    
+    // Bumped after each training round; lets power control see training
+    uint64_t get_training_rounds() const {
+        return training_rounds.load(std::memory_order_relaxed);
+    }
+    
+    FrameCounters get_frame_counters() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return frame_counters;
+    }
+    
+    void set_cpu_budget(double budget) {
+        load_shedder.set_cpu_budget(budget);
+    }
+    
+    bounded::TableStats get_ap_table_stats() {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        return access_points.stats();
+    }
+    
+    bounded::TableStats get_client_table_stats() {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        return client_table.stats();
+    }
+    
+    ExpiryStats get_expiry_stats() {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        return ExpiryStats{
+            expiry_wheel.expired_count(ap_store),
+            expiry_wheel.expired_count(client_store),
+            expiry_wheel.expired_count(history_store)
+        };
+    }
+    
+    void set_ap_ttl(timesvc::MonoClock::duration ttl) {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        expiry_wheel.set_ttl(ap_store, ttl);
+    }
+    
+    void set_client_ttl(timesvc::MonoClock::duration ttl) {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        expiry_wheel.set_ttl(client_store, ttl);
+    }
+    
+    void set_history_ttl(timesvc::MonoClock::duration ttl) {
+        std::lock_guard<std::mutex> lock(data_mutex);
+        expiry_wheel.set_ttl(history_store, ttl);
+    }
+    
     void adjust_stealth(double new_factor) {
         stealth_factor = std::clamp(new_factor, 0.0, 1.0);
         detection_threshold = 0.75 * (1.0 + stealth_factor);
     }
     
     // Save and load models
-    void save_models(const std::string& prefix) {
-        traffic_analyzer->save(prefix + "_traffic.model");
-        behavior_predictor->save(prefix + "_behavior.model");
-        vulnerability_assessor->save(prefix + "_vulnerability.model");
+    void save_models(const std::string& prefix, persist::WriteScheduler* writes = nullptr) {
+        std::lock_guard<std::mutex> lock(model_mutex);
+        traffic_analyzer->save(prefix + "_traffic.model", writes);
+        behavior_predictor->save(prefix + "_behavior.model", writes);
+        vulnerability_assessor->save(prefix + "_vulnerability.model", writes);
     }
     
     void load_models(const std::string& prefix) {
+        std::lock_guard<std::mutex> lock(model_mutex);
         traffic_analyzer->load(prefix + "_traffic.model");
         behavior_predictor->load(prefix + "_behavior.model");
         vulnerability_assessor->load(prefix + "_vulnerability.model");
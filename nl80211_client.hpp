@@ -0,0 +1,454 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+#include "logger.hpp"
+
+// In-process wireless interface control. Channel, TX power, interface
+// type and link state go out as nl80211 (generic netlink) and rtnetlink
+// requests over sockets held open for the life of the client, instead of
+// a fork+exec of sh and iw per change. The transport is a Backend, so
+// tests can swap in RecordingBackend and check the encoded messages.
+namespace netlink {
+
+enum class Protocol { GENERIC, ROUTE };
+
+enum class IfType : uint32_t {
+    STATION = NL80211_IFTYPE_STATION,
+    MONITOR = NL80211_IFTYPE_MONITOR,
+    MESH_POINT = NL80211_IFTYPE_MESH_POINT
+};
+
+// 2.4GHz channels 1-14 and 5GHz channels; 0 if unknown
+inline uint32_t channel_to_mhz(uint32_t channel) {
+    if (channel >= 1 && channel <= 13) return 2407 + 5 * channel;
+    if (channel == 14) return 2484;
+    if (channel >= 32 && channel <= 177) return 5000 + 5 * channel;
+    return 0;
+}
+
+// Builds one netlink request: header, family header, then attributes
+class Message {
+private:
+    std::vector<uint8_t> buffer;
+
+    void align() { buffer.resize(NLMSG_ALIGN(buffer.size()), 0); }
+
+    template <typename T>
+    void append(const T& value) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+public:
+    Message(uint16_t type, uint16_t flags) {
+        struct nlmsghdr header{};
+        header.nlmsg_type = type;
+        header.nlmsg_flags = flags;
+        append(header);
+    }
+
+    static Message generic(uint16_t family, uint8_t command) {
+        Message message(family, NLM_F_REQUEST | NLM_F_ACK);
+        struct genlmsghdr header{};
+        header.cmd = command;
+        header.version = 1;
+        message.append(header);
+        return message;
+    }
+
+    static Message link(uint32_t ifindex, uint32_t flags, uint32_t change) {
+        Message message(RTM_NEWLINK, NLM_F_REQUEST | NLM_F_ACK);
+        struct ifinfomsg info{};
+        info.ifi_family = AF_UNSPEC;
+        info.ifi_index = static_cast<int>(ifindex);
+        info.ifi_flags = flags;
+        info.ifi_change = change;
+        message.append(info);
+        return message;
+    }
+
+    Message& put(uint16_t type, const void* data, size_t length) {
+        align();
+        struct nlattr attr{};
+        attr.nla_len = static_cast<uint16_t>(NLA_HDRLEN + length);
+        attr.nla_type = type;
+        append(attr);
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + length);
+        align();
+        return *this;
+    }
+
+    Message& put_u16(uint16_t type, uint16_t value) { return put(type, &value, sizeof(value)); }
+    Message& put_u32(uint16_t type, uint32_t value) { return put(type, &value, sizeof(value)); }
+    Message& put_string(uint16_t type, const std::string& value) {
+        return put(type, value.c_str(), value.size() + 1);
+    }
+
+    // Stamps length and sequence number; the result is ready to send
+    const std::vector<uint8_t>& finish(uint32_t seq) {
+        auto* header = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+        header->nlmsg_len = static_cast<uint32_t>(buffer.size());
+        header->nlmsg_seq = seq;
+        return buffer;
+    }
+};
+
+// Walks the attributes of one message, starting after its family header
+class AttrIterator {
+private:
+    const uint8_t* cursor;
+    const uint8_t* end;
+
+public:
+    AttrIterator(const struct nlmsghdr* message, size_t family_header) {
+        cursor = reinterpret_cast<const uint8_t*>(NLMSG_DATA(message)) + NLMSG_ALIGN(family_header);
+        end = reinterpret_cast<const uint8_t*>(message) + message->nlmsg_len;
+    }
+
+    // Next attribute, or null at the end or on a malformed length
+    const struct nlattr* next() {
+        if (cursor + NLA_HDRLEN > end) return nullptr;
+        const auto* attr = reinterpret_cast<const struct nlattr*>(cursor);
+        if (attr->nla_len < NLA_HDRLEN || cursor + attr->nla_len > end) return nullptr;
+        cursor += NLA_ALIGN(attr->nla_len);
+        return attr;
+    }
+
+    static const void* payload(const struct nlattr* attr) {
+        return reinterpret_cast<const uint8_t*>(attr) + NLA_HDRLEN;
+    }
+
+    static size_t payload_length(const struct nlattr* attr) {
+        return attr->nla_len - NLA_HDRLEN;
+    }
+};
+
+// Sends one request and collects its reply messages up to the ack.
+// Returns 0 or a negative errno.
+class Backend {
+public:
+    virtual ~Backend() = default;
+    virtual int transact(Protocol protocol, const std::vector<uint8_t>& request,
+                         std::vector<uint8_t>& reply) = 0;
+};
+
+// The kernel, over one persistent socket per protocol
+class SocketBackend : public Backend {
+private:
+    int sockets[2]{-1, -1};
+    std::vector<uint8_t> receive_buffer = std::vector<uint8_t>(16384);
+
+    int socket_for(Protocol protocol) {
+        int& fd = sockets[protocol == Protocol::GENERIC ? 0 : 1];
+        if (fd >= 0) return fd;
+        fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+                      protocol == Protocol::GENERIC ? NETLINK_GENERIC : NETLINK_ROUTE);
+        if (fd < 0) return -1;
+        struct sockaddr_nl local{};
+        local.nl_family = AF_NETLINK;
+        struct timeval timeout{1, 0};  // a wedged driver must not hang the hop loop
+        if (::bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) != 0 ||
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+public:
+    SocketBackend() = default;
+    ~SocketBackend() override {
+        for (int fd : sockets) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+    SocketBackend(const SocketBackend&) = delete;
+    SocketBackend& operator=(const SocketBackend&) = delete;
+
+    int transact(Protocol protocol, const std::vector<uint8_t>& request,
+                 std::vector<uint8_t>& reply) override {
+        int fd = socket_for(protocol);
+        if (fd < 0) return -errno;
+
+        struct sockaddr_nl kernel{};
+        kernel.nl_family = AF_NETLINK;
+        if (::sendto(fd, request.data(), request.size(), 0,
+                     reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+            return -errno;
+        }
+
+        uint32_t seq = reinterpret_cast<const struct nlmsghdr*>(request.data())->nlmsg_seq;
+        while (true) {
+            ssize_t n = ::recv(fd, receive_buffer.data(), receive_buffer.size(), 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -errno;
+            }
+            int length = static_cast<int>(n);
+            for (auto* header = reinterpret_cast<struct nlmsghdr*>(receive_buffer.data());
+                 NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+                if (header->nlmsg_seq != seq) continue;  // late reply to a timed-out request
+                if (header->nlmsg_type == NLMSG_ERROR) {
+                    auto* error = static_cast<struct nlmsgerr*>(NLMSG_DATA(header));
+                    return error->error;  // 0 is the ack
+                }
+                if (header->nlmsg_type == NLMSG_DONE) return 0;
+                const auto* bytes = reinterpret_cast<const uint8_t*>(header);
+                reply.insert(reply.end(), bytes, bytes + NLMSG_ALIGN(header->nlmsg_len));
+            }
+        }
+    }
+};
+
+// Records every request and acks it, answering the nl80211 family lookup;
+// for tests that check what would have gone to the kernel
+class RecordingBackend : public Backend {
+public:
+    static constexpr uint16_t FAMILY_ID = 0x1c;
+
+    struct Request {
+        Protocol protocol;
+        std::vector<uint8_t> bytes;
+
+        const struct nlmsghdr* header() const {
+            return reinterpret_cast<const struct nlmsghdr*>(bytes.data());
+        }
+
+        uint8_t command() const {
+            return static_cast<const struct genlmsghdr*>(NLMSG_DATA(header()))->cmd;
+        }
+
+        // First attribute of type, or null
+        const struct nlattr* find(uint16_t type) const {
+            size_t family_header = protocol == Protocol::GENERIC ? sizeof(struct genlmsghdr)
+                                                                 : sizeof(struct ifinfomsg);
+            AttrIterator it(header(), family_header);
+            while (const struct nlattr* attr = it.next()) {
+                if (attr->nla_type == type) return attr;
+            }
+            return nullptr;
+        }
+
+        uint32_t u32(uint16_t type) const {
+            const struct nlattr* attr = find(type);
+            uint32_t value = 0;
+            if (attr) std::memcpy(&value, AttrIterator::payload(attr), sizeof(value));
+            return value;
+        }
+    };
+
+    std::vector<Request> requests;
+    int fail_with{0};  // negative errno returned for everything but the family lookup
+
+    int transact(Protocol protocol, const std::vector<uint8_t>& request,
+                 std::vector<uint8_t>& reply) override {
+        requests.push_back({protocol, request});
+        const auto* header = requests.back().header();
+        if (protocol == Protocol::GENERIC && header->nlmsg_type == GENL_ID_CTRL) {
+            Message answer = Message::generic(GENL_ID_CTRL, CTRL_CMD_NEWFAMILY);
+            answer.put_u16(CTRL_ATTR_FAMILY_ID, FAMILY_ID);
+            const auto& bytes = answer.finish(header->nlmsg_seq);
+            reply.insert(reply.end(), bytes.begin(), bytes.end());
+            return 0;
+        }
+        return fail_with;
+    }
+};
+
+struct ClientStats {
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t total_ns;  // time spent in transact
+    uint64_t max_ns;
+};
+
+class Nl80211 {
+private:
+    std::unique_ptr<Backend> backend;
+    std::mutex mutex;  // one request in flight; sequence numbers
+    uint32_t seq{1};
+    uint16_t family{0};
+    std::unordered_map<std::string, uint32_t> ifindex_cache;
+    std::vector<uint8_t> reply;
+
+    uint64_t request_count{0};
+    uint64_t failure_count{0};
+    uint64_t total_ns{0};
+    uint64_t max_ns{0};
+    int last_error{0};
+
+    int send_locked(Protocol protocol, Message& message) {
+        reply.clear();
+        auto start = std::chrono::steady_clock::now();
+        int result = backend->transact(protocol, message.finish(seq++), reply);
+        auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        request_count++;
+        total_ns += ns;
+        max_ns = std::max(max_ns, ns);
+        if (result != 0) {
+            failure_count++;
+            last_error = -result;
+        }
+        return result;
+    }
+
+    // nl80211's generic netlink id, looked up once
+    bool resolve_locked() {
+        if (family != 0) return true;
+        Message message = Message::generic(GENL_ID_CTRL, CTRL_CMD_GETFAMILY);
+        message.put_string(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME);
+        if (send_locked(Protocol::GENERIC, message) != 0) return false;
+
+        int length = static_cast<int>(reply.size());
+        for (auto* header = reinterpret_cast<struct nlmsghdr*>(reply.data());
+             NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+            AttrIterator it(header, sizeof(struct genlmsghdr));
+            while (const struct nlattr* attr = it.next()) {
+                if (attr->nla_type == CTRL_ATTR_FAMILY_ID &&
+                    AttrIterator::payload_length(attr) >= sizeof(uint16_t)) {
+                    std::memcpy(&family, AttrIterator::payload(attr), sizeof(family));
+                }
+            }
+        }
+        if (family == 0) last_error = ENOENT;
+        return family != 0;
+    }
+
+    uint32_t index_locked(const std::string& ifname) {
+        auto it = ifindex_cache.find(ifname);
+        if (it != ifindex_cache.end()) return it->second;
+        uint32_t index = ::if_nametoindex(ifname.c_str());
+        if (index == 0) {
+            last_error = errno ? errno : ENODEV;
+            return 0;
+        }
+        ifindex_cache[ifname] = index;
+        return index;
+    }
+
+    // Runs one nl80211 command against ifname, with build adding attributes
+    bool command(const std::string& ifname, uint8_t cmd, const char* what,
+                 const std::function<void(Message&)>& build) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t index = index_locked(ifname);
+        if (index == 0 || !resolve_locked()) {
+            logging::warn("nl80211: {} on {}: {}", what, ifname, std::strerror(last_error));
+            return false;
+        }
+        Message message = Message::generic(family, cmd);
+        message.put_u32(NL80211_ATTR_IFINDEX, index);
+        build(message);
+        if (send_locked(Protocol::GENERIC, message) != 0) {
+            // The interface may have been renamed or recreated under us
+            if (last_error == ENODEV) ifindex_cache.erase(ifname);
+            logging::warn("nl80211: {} on {}: {}", what, ifname, std::strerror(last_error));
+            return false;
+        }
+        return true;
+    }
+
+    bool link_request(const std::string& ifname, uint32_t flags, uint32_t change,
+                      const std::string& new_name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t index = index_locked(ifname);
+        if (index == 0) {
+            logging::warn("rtnetlink: {}: {}", ifname, std::strerror(last_error));
+            return false;
+        }
+        Message message = Message::link(index, flags, change);
+        if (!new_name.empty()) message.put_string(IFLA_IFNAME, new_name);
+        if (send_locked(Protocol::ROUTE, message) != 0) {
+            logging::warn("rtnetlink: {}: {}", ifname, std::strerror(last_error));
+            return false;
+        }
+        if (!new_name.empty()) {
+            ifindex_cache.erase(ifname);
+            ifindex_cache[new_name] = index;
+        }
+        return true;
+    }
+
+public:
+    explicit Nl80211(std::unique_ptr<Backend> transport = std::make_unique<SocketBackend>())
+        : backend(std::move(transport)) {}
+
+    Nl80211(const Nl80211&) = delete;
+    Nl80211& operator=(const Nl80211&) = delete;
+
+    bool set_type(const std::string& ifname, IfType type) {
+        return command(ifname, NL80211_CMD_SET_INTERFACE, "set type", [type](Message& m) {
+            m.put_u32(NL80211_ATTR_IFTYPE, static_cast<uint32_t>(type));
+        });
+    }
+
+    bool set_frequency(const std::string& ifname, uint32_t mhz) {
+        return command(ifname, NL80211_CMD_SET_WIPHY, "set frequency", [mhz](Message& m) {
+            m.put_u32(NL80211_ATTR_WIPHY_FREQ, mhz);
+            m.put_u32(NL80211_ATTR_WIPHY_CHANNEL_TYPE, NL80211_CHAN_NO_HT);
+        });
+    }
+
+    bool set_channel(const std::string& ifname, uint32_t channel) {
+        uint32_t mhz = channel_to_mhz(channel);
+        if (mhz == 0) {
+            logging::warn("nl80211: no frequency for channel {}", channel);
+            return false;
+        }
+        return set_frequency(ifname, mhz);
+    }
+
+    // Fixed TX power in mBm (dBm * 100), as `iw set txpower fixed`
+    bool set_tx_power(const std::string& ifname, int32_t mbm) {
+        return command(ifname, NL80211_CMD_SET_WIPHY, "set txpower", [mbm](Message& m) {
+            m.put_u32(NL80211_ATTR_WIPHY_TX_POWER_SETTING, NL80211_TX_POWER_FIXED);
+            m.put_u32(NL80211_ATTR_WIPHY_TX_POWER_LEVEL, static_cast<uint32_t>(mbm));
+        });
+    }
+
+    // The interface must already be a mesh point and up
+    bool join_mesh(const std::string& ifname, const std::string& mesh_id) {
+        return command(ifname, NL80211_CMD_JOIN_MESH, "join mesh", [&mesh_id](Message& m) {
+            m.put(NL80211_ATTR_MESH_ID, mesh_id.data(), mesh_id.size());
+        });
+    }
+
+    bool set_link(const std::string& ifname, bool up) {
+        return link_request(ifname, up ? IFF_UP : 0, IFF_UP, "");
+    }
+
+    // The link must be down
+    bool rename(const std::string& ifname, const std::string& new_name) {
+        return link_request(ifname, 0, 0, new_name);
+    }
+
+    int get_last_error() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last_error;
+    }
+
+    ClientStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return ClientStats{request_count, failure_count, total_ns, max_ns};
+    }
+};
+
+} // namespace netlink
@@ -0,0 +1,127 @@
+#include "nl80211_client.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Checks the nl80211 client's encoding against RecordingBackend, then
+// times the same change through netlink and through a shell command.
+//
+//   nl80211_test            encoding checks; benchmark link up on lo
+//   nl80211_test <wlan_if>  encoding checks; benchmark channel set on wlan_if
+
+static int failures = 0;
+
+#define CHECK(cond, what)                                            \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            std::cerr << "FAIL " << (what) << ": " #cond << std::endl; \
+            failures++;                                              \
+        }                                                            \
+    } while (0)
+
+using netlink::RecordingBackend;
+
+static void check_encoding() {
+    auto recording = std::make_unique<RecordingBackend>();
+    RecordingBackend* recorded = recording.get();
+    netlink::Nl80211 client(std::move(recording));
+    const uint32_t lo = if_nametoindex("lo");
+
+    // The first command resolves the nl80211 family
+    CHECK(client.set_channel("lo", 6), "set channel");
+    CHECK(recorded->requests.size() == 2, "family lookup then command");
+    if (recorded->requests.size() == 2) {
+        const auto& request = recorded->requests[1];
+        CHECK(request.header()->nlmsg_type == RecordingBackend::FAMILY_ID, "channel family");
+        CHECK(request.header()->nlmsg_flags == (NLM_F_REQUEST | NLM_F_ACK), "channel flags");
+        CHECK(request.header()->nlmsg_len == request.bytes.size(), "channel length");
+        CHECK(request.command() == NL80211_CMD_SET_WIPHY, "channel command");
+        CHECK(request.u32(NL80211_ATTR_IFINDEX) == lo, "channel ifindex");
+        CHECK(request.u32(NL80211_ATTR_WIPHY_FREQ) == 2437, "channel 6 frequency");
+        CHECK(request.u32(NL80211_ATTR_WIPHY_CHANNEL_TYPE) == NL80211_CHAN_NO_HT, "channel type");
+    }
+
+    CHECK(client.set_channel("lo", 36), "set 5 GHz channel");
+    CHECK(recorded->requests.back().u32(NL80211_ATTR_WIPHY_FREQ) == 5180, "channel 36 frequency");
+    CHECK(!client.set_channel("lo", 200), "invalid channel rejected");
+
+    // Interface mode changes
+    size_t before = recorded->requests.size();
+    CHECK(client.set_type("lo", netlink::IfType::MONITOR), "set monitor");
+    CHECK(client.set_type("lo", netlink::IfType::STATION), "set managed");
+    CHECK(recorded->requests.size() == before + 2, "one request per mode change");
+    if (recorded->requests.size() == before + 2) {
+        const auto& monitor = recorded->requests[before];
+        const auto& managed = recorded->requests[before + 1];
+        CHECK(monitor.command() == NL80211_CMD_SET_INTERFACE, "monitor command");
+        CHECK(monitor.u32(NL80211_ATTR_IFINDEX) == lo, "monitor ifindex");
+        CHECK(monitor.u32(NL80211_ATTR_IFTYPE) == NL80211_IFTYPE_MONITOR, "monitor type");
+        CHECK(managed.u32(NL80211_ATTR_IFTYPE) == NL80211_IFTYPE_STATION, "managed type");
+    }
+
+    // Link state goes over rtnetlink
+    CHECK(client.set_link("lo", true), "link up");
+    const auto& link = recorded->requests.back();
+    CHECK(link.protocol == netlink::Protocol::ROUTE, "link protocol");
+    const auto* info = static_cast<const struct ifinfomsg*>(NLMSG_DATA(link.header()));
+    CHECK(info->ifi_index == static_cast<int>(lo), "link ifindex");
+    CHECK(info->ifi_flags == IFF_UP && info->ifi_change == IFF_UP, "link flags");
+
+    // Kernel errors and unknown interfaces surface as failures
+    recorded->fail_with = -EBUSY;
+    CHECK(!client.set_channel("lo", 1), "busy rejected");
+    CHECK(client.get_last_error() == EBUSY, "busy errno");
+    recorded->fail_with = 0;
+    size_t sent = recorded->requests.size();
+    CHECK(!client.set_channel("nonexistent0", 1), "unknown interface rejected");
+    CHECK(recorded->requests.size() == sent, "unknown interface sends nothing");
+}
+
+static double shell_us(const std::string& command, int runs) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        if (std::system(command.c_str()) != 0 && i == 0) {
+            std::cerr << "note: `" << command << "` failed; timing the attempt anyway" << std::endl;
+        }
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+static void benchmark(const std::string& ifname) {
+    constexpr int NETLINK_RUNS = 1000;
+    constexpr int SHELL_RUNS = 50;
+    bool wireless = ifname != "lo";
+
+    netlink::Nl80211 client;
+    auto change = [&] {
+        return wireless ? client.set_channel(ifname, 6) : client.set_link(ifname, true);
+    };
+    change();  // family lookup and ifindex outside the timing
+    auto base = client.stats();
+    for (int i = 0; i < NETLINK_RUNS; ++i) change();
+    auto after = client.stats();
+
+    double netlink = static_cast<double>(after.total_ns - base.total_ns) / 1e3 / NETLINK_RUNS;
+    std::string command = wireless ? "iw dev " + ifname + " set channel 6 2>/dev/null"
+                                   : "ip link set dev " + ifname + " up 2>/dev/null";
+    double shell = shell_us(command, SHELL_RUNS);
+
+    std::cout << (wireless ? "channel set on " : "link up on ") << ifname << ":\n"
+              << "  netlink " << netlink << " us avg, " << after.max_ns / 1e3 << " us max, "
+              << (after.failures - base.failures) << " failures\n"
+              << "  shell   " << shell << " us avg (" << command << ")\n";
+    if (netlink > 0) std::cout << "  speedup " << shell / netlink << "x" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    check_encoding();
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "nl80211 encoding: all checks passed" << std::endl;
+
+    benchmark(argc > 1 ? argv[1] : "lo");
+    return 0;
+}
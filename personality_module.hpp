@@ -6,6 +6,7 @@
 #include <chrono>
 #include <map>
 #include "anon_core.hpp"
+#include "time_service.hpp"
 
 namespace anon {
 
@@ -27,7 +28,7 @@ private:
     struct Memory {
         std::string event;
         float emotional_impact;
-        std::chrono::system_clock::time_point timestamp;
+        timesvc::MonoTime timestamp;
     };
     
     // Personality configuration
@@ -90,7 +91,7 @@ private:
     
     void update_mood() {
         // Update mood based on recent events and traits
-        auto now = std::chrono::system_clock::now();
+        auto now = timesvc::coarse_now();
         float recent_impact = 0.0f;
         
         // Calculate emotional impact from recent memories
@@ -139,7 +140,7 @@ private:
         Memory memory{
             event,
             impact,
-            std::chrono::system_clock::now()
+            timesvc::coarse_now()
         };
         
         memories.push_back(memory);
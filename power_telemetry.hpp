@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reactor.hpp"
+
+// Battery and thermal telemetry from sysfs. Each attribute file is opened
+// once and re-read with pread into a fixed buffer, so a sample costs one
+// syscall per attribute. A reactor timer samples on an adaptive cadence:
+// fast while values move, backing off while they hold still. Attributes
+// the kernel signals with sysfs_notify wake it early through epoll.
+namespace power {
+
+enum class Metric : uint8_t {
+    BATTERY_PERCENT,   // power_supply/<battery>/capacity
+    BATTERY_VOLTAGE,   // power_supply/<battery>/voltage_now, microvolts
+    BATTERY_CURRENT,   // power_supply/<battery>/current_now, microamps
+    CPU_TEMPERATURE,   // thermal/<zone>/temp, millidegrees Celsius
+    COUNT
+};
+
+inline const char* to_string(Metric metric) {
+    switch (metric) {
+        case Metric::BATTERY_PERCENT: return "battery_percent";
+        case Metric::BATTERY_VOLTAGE: return "battery_voltage_uv";
+        case Metric::BATTERY_CURRENT: return "battery_current_ua";
+        case Metric::CPU_TEMPERATURE: return "cpu_temperature_mc";
+        case Metric::COUNT: break;
+    }
+    return "unknown";
+}
+
+constexpr size_t METRIC_COUNT = static_cast<size_t>(Metric::COUNT);
+
+// One sysfs attribute, held open between reads
+class SysfsAttribute {
+private:
+    std::filesystem::path path;
+    int fd{-1};
+
+public:
+    SysfsAttribute() = default;
+    explicit SysfsAttribute(std::filesystem::path file) : path(std::move(file)) {}
+    ~SysfsAttribute() { close(); }
+    SysfsAttribute(const SysfsAttribute&) = delete;
+    SysfsAttribute& operator=(const SysfsAttribute&) = delete;
+    SysfsAttribute(SysfsAttribute&& other) noexcept : path(std::move(other.path)), fd(other.fd) {
+        other.fd = -1;
+    }
+    SysfsAttribute& operator=(SysfsAttribute&& other) noexcept {
+        if (this != &other) {
+            close();
+            path = std::move(other.path);
+            fd = other.fd;
+            other.fd = -1;
+        }
+        return *this;
+    }
+
+    bool open() {
+        if (fd < 0 && !path.empty()) fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return fd >= 0;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    // Reads the whole attribute as a decimal integer. Opens it first if
+    // needed, so an attribute that appears later (a battery plugged in)
+    // is picked up; one that errors is closed and retried next time.
+    bool read(int64_t& value) {
+        if (!open()) return false;
+        char buffer[32];
+        ssize_t n;
+        do {
+            n = ::pread(fd, buffer, sizeof(buffer), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            close();
+            return false;
+        }
+        const char* end = buffer + n;
+        while (end > buffer && (end[-1] == '\n' || end[-1] == ' ')) --end;
+        auto [parsed_end, ec] = std::from_chars(buffer, end, value);
+        return ec == std::errc() && parsed_end == end;
+    }
+
+    int descriptor() const { return fd; }
+    const std::filesystem::path& get_path() const { return path; }
+};
+
+struct TelemetryStats {
+    uint64_t samples;        // sampling passes
+    uint64_t reads;          // attribute reads
+    uint64_t changes;        // reads that changed a published value
+    uint64_t notifications;  // early wakeups from pollable attributes
+    std::chrono::milliseconds interval;  // current sampling interval
+};
+
+class Telemetry {
+public:
+    struct Config {
+        std::filesystem::path root = "/sys";  // point at a fake tree for tests
+        std::string battery = "battery";
+        std::string thermal_zone = "thermal_zone0";
+        std::chrono::milliseconds min_interval{1000};
+        std::chrono::milliseconds max_interval{30000};
+        // Changes at or below these are noise and do not speed sampling up
+        std::array<int64_t, METRIC_COUNT> noise{{0, 20000, 50000, 500}};
+    };
+
+    // Called on the loop thread with the previous and new value
+    using Callback = std::function<void(Metric, int64_t previous, int64_t current)>;
+
+private:
+    struct Channel {
+        SysfsAttribute attribute;
+        std::atomic<int64_t> value{0};
+        std::atomic<bool> valid{false};
+    };
+
+    Config config;
+    std::array<Channel, METRIC_COUNT> channels;
+    std::chrono::milliseconds interval{1000};
+
+    std::mutex sample_mutex;  // one sampling pass at a time
+    std::mutex callback_mutex;
+    std::vector<std::pair<uint64_t, Callback>> callbacks;
+    uint64_t next_callback{1};
+
+    runtime::Reactor* reactor;
+    runtime::TimerId sample_timer{0};  // sample_mutex
+    bool running{false};
+    // Duplicates of the attribute descriptors, watched for sysfs_notify;
+    // ours, so they stay valid for epoll while an attribute reopens
+    std::array<int, METRIC_COUNT> watched;
+    std::array<int, METRIC_COUNT> watched_source;  // the descriptor each one copies
+
+    std::atomic<uint64_t> sample_count{0};
+    std::atomic<uint64_t> read_count{0};
+    std::atomic<uint64_t> change_count{0};
+    std::atomic<uint64_t> notify_count{0};
+    std::atomic<int64_t> interval_ms{1000};
+
+    Channel& channel(Metric metric) { return channels[static_cast<size_t>(metric)]; }
+
+    void bind(const Config& cfg) {
+        config = cfg;
+        auto supply = config.root / "class/power_supply" / config.battery;
+        auto thermal = config.root / "class/thermal" / config.thermal_zone;
+        channel(Metric::BATTERY_PERCENT).attribute = SysfsAttribute(supply / "capacity");
+        channel(Metric::BATTERY_VOLTAGE).attribute = SysfsAttribute(supply / "voltage_now");
+        channel(Metric::BATTERY_CURRENT).attribute = SysfsAttribute(supply / "current_now");
+        channel(Metric::CPU_TEMPERATURE).attribute = SysfsAttribute(thermal / "temp");
+        interval = config.min_interval;
+    }
+
+    // Reads every attribute once; true if any value moved beyond its noise
+    bool sample_locked() {
+        bool moved = false;
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            Channel& c = channels[i];
+            int64_t value;
+            read_count.fetch_add(1, std::memory_order_relaxed);
+            if (!c.attribute.read(value)) {
+                c.valid.store(false, std::memory_order_release);
+                continue;
+            }
+            bool was_valid = c.valid.load(std::memory_order_relaxed);
+            int64_t previous = c.value.exchange(value, std::memory_order_release);
+            c.valid.store(true, std::memory_order_release);
+            if (was_valid && previous == value) continue;
+
+            change_count.fetch_add(1, std::memory_order_relaxed);
+            if (!was_valid || std::abs(value - previous) > config.noise[i]) moved = true;
+            std::lock_guard<std::mutex> lock(callback_mutex);
+            for (const auto& [id, callback] : callbacks) {
+                callback(static_cast<Metric>(i), was_valid ? previous : value, value);
+            }
+        }
+        sample_count.fetch_add(1, std::memory_order_relaxed);
+        return moved;
+    }
+
+    // sample_mutex held. Sysfs signals a change with
+    // EPOLLPRI|EPOLLERR once the attribute has been read; epoll refuses
+    // regular files (a fake tree), which are left to the timer.
+    void watch_locked() {
+        for (size_t i = 0; i < METRIC_COUNT; ++i) {
+            int source = channels[i].attribute.descriptor();
+            if (source == watched_source[i]) continue;
+            unwatch(i);
+            watched_source[i] = source;
+            if (source < 0) continue;
+            int fd = ::fcntl(source, F_DUPFD_CLOEXEC, 0);
+            if (fd < 0) continue;
+            if (!reactor->add_fd(fd, EPOLLPRI | EPOLLERR, [this](uint32_t) { notified(); })) {
+                ::close(fd);
+                continue;
+            }
+            watched[i] = fd;
+        }
+    }
+
+    // sample_mutex held
+    void unwatch(size_t i) {
+        if (watched[i] >= 0) {
+            reactor->remove_fd(watched[i]);
+            ::close(watched[i]);
+        }
+        watched[i] = -1;
+        watched_source[i] = -1;
+    }
+
+    // On the loop: a sample, then the next one scheduled from what it saw
+    void pass(bool early) {
+        std::lock_guard<std::mutex> lock(sample_mutex);
+        if (!running) return;
+        if (early) interval = config.min_interval;
+        bool moved = sample_locked();
+        // Fast while values move, doubling back to the slow cadence
+        interval = moved ? config.min_interval : std::min(config.max_interval, interval * 2);
+        interval_ms.store(interval.count(), std::memory_order_relaxed);
+        reactor->set_period(sample_timer, interval);
+        watch_locked();
+    }
+
+    void notified() {
+        notify_count.fetch_add(1, std::memory_order_relaxed);
+        pass(true);
+    }
+
+public:
+    // Samples from events, the process loop by default
+    explicit Telemetry(runtime::Reactor* events = nullptr)
+        : reactor(events ? events : &runtime::Reactor::shared()) {
+        watched.fill(-1);
+        watched_source.fill(-1);
+        bind(Config());
+    }
+    ~Telemetry() { stop(); }
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    // Opens the attributes, takes a first sample and puts the sampling
+    // on the loop
+    void start(const Config& cfg) {
+        std::lock_guard<std::mutex> lock(sample_mutex);
+        if (running) return;
+        bind(cfg);
+        sample_locked();
+        running = true;
+        sample_timer = reactor->add_periodic(interval, [this] { pass(false); });
+        watch_locked();
+    }
+
+    void start() { start(Config()); }
+
+    // No sample is running on the loop once this returns
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(sample_mutex);
+            if (!running) return;
+            running = false;
+        }
+        reactor->call([this] {
+            std::lock_guard<std::mutex> lock(sample_mutex);
+            reactor->cancel_timer(sample_timer);
+            sample_timer = 0;
+            for (size_t i = 0; i < METRIC_COUNT; ++i) unwatch(i);
+        });
+    }
+
+    // Samples on the caller's thread; without start() this is the only
+    // way values are refreshed
+    void sample_now() {
+        std::lock_guard<std::mutex> lock(sample_mutex);
+        sample_locked();
+    }
+
+    // Latest value, or fallback if the attribute is missing or unreadable
+    int64_t get(Metric metric, int64_t fallback = 0) const {
+        const Channel& c = channels[static_cast<size_t>(metric)];
+        return c.valid.load(std::memory_order_acquire) ? c.value.load(std::memory_order_acquire)
+                                                       : fallback;
+    }
+
+    bool has(Metric metric) const {
+        return channels[static_cast<size_t>(metric)].valid.load(std::memory_order_acquire);
+    }
+
+    // Callbacks run on the loop thread and must not subscribe or
+    // unsubscribe from inside the call
+    uint64_t subscribe(Callback callback) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        callbacks.emplace_back(next_callback, std::move(callback));
+        return next_callback++;
+    }
+
+    void unsubscribe(uint64_t id) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                       [id](const auto& entry) { return entry.first == id; }),
+                        callbacks.end());
+    }
+
+    TelemetryStats stats() const {
+        return TelemetryStats{sample_count.load(std::memory_order_relaxed),
+                              read_count.load(std::memory_order_relaxed),
+                              change_count.load(std::memory_order_relaxed),
+                              notify_count.load(std::memory_order_relaxed),
+                              std::chrono::milliseconds(interval_ms.load(std::memory_order_relaxed))};
+    }
+};
+
+// A throwaway sysfs tree with the layout Telemetry reads, for tests and
+// bench runs off the device. Values are written in place, as sysfs would.
+class FakeSysfs {
+private:
+    std::filesystem::path root;
+
+public:
+    explicit FakeSysfs(std::filesystem::path dir) : root(std::move(dir)) {
+        std::filesystem::create_directories(root / "class/power_supply/battery");
+        std::filesystem::create_directories(root / "class/thermal/thermal_zone0");
+        set(Metric::BATTERY_PERCENT, 100);
+        set(Metric::BATTERY_VOLTAGE, 4100000);
+        set(Metric::BATTERY_CURRENT, 500000);
+        set(Metric::CPU_TEMPERATURE, 45000);
+    }
+
+    ~FakeSysfs() {
+        std::error_code ec;
+        std::filesystem::remove_all(root, ec);
+    }
+
+    FakeSysfs(const FakeSysfs&) = delete;
+    FakeSysfs& operator=(const FakeSysfs&) = delete;
+
+    std::filesystem::path file(Metric metric) const {
+        switch (metric) {
+            case Metric::BATTERY_PERCENT: return root / "class/power_supply/battery/capacity";
+            case Metric::BATTERY_VOLTAGE: return root / "class/power_supply/battery/voltage_now";
+            case Metric::BATTERY_CURRENT: return root / "class/power_supply/battery/current_now";
+            case Metric::CPU_TEMPERATURE: return root / "class/thermal/thermal_zone0/temp";
+            case Metric::COUNT: break;
+        }
+        return {};
+    }
+
+    // Rewrites the attribute in place, keeping its inode like sysfs does
+    void set(Metric metric, int64_t value) {
+        std::string text = std::to_string(value) + "\n";
+        int fd = ::open(file(metric).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+        (void)::write(fd, text.data(), text.size());
+        ::close(fd);
+    }
+
+    void remove(Metric metric) {
+        std::error_code ec;
+        std::filesystem::remove(file(metric), ec);
+    }
+
+    Telemetry::Config config() const {
+        Telemetry::Config cfg;
+        cfg.root = root;
+        return cfg;
+    }
+};
+
+} // namespace power
@@ -0,0 +1,109 @@
+#include "power_telemetry.hpp"
+#include "test_support.hpp"
+#include <fstream>
+#include <tuple>
+#include <unistd.h>
+
+// Drives power::Telemetry through a FakeSysfs tree: reads, missing and
+// malformed attributes, change callbacks and the adaptive cadence.
+
+using namespace std::chrono_literals;
+using power::Metric;
+
+template <typename Pred>
+static bool wait_for(Pred pred, std::chrono::milliseconds limit = 2000ms) {
+    auto deadline = std::chrono::steady_clock::now() + limit;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(5ms);
+    }
+    return true;
+}
+
+static std::filesystem::path scratch(const char* name) {
+    return std::filesystem::temp_directory_path() /
+           (std::string(name) + "." + std::to_string(::getpid()));
+}
+
+static void check_sampling() {
+    power::FakeSysfs fake(scratch("power_telemetry_test.sample"));
+    fake.remove(Metric::BATTERY_CURRENT);
+    power::Telemetry telemetry;
+
+    std::vector<std::tuple<Metric, int64_t, int64_t>> seen;
+    telemetry.subscribe([&](Metric metric, int64_t previous, int64_t current) {
+        seen.emplace_back(metric, previous, current);
+    });
+
+    // start() takes the first sample before it returns
+    CHECK(!telemetry.has(Metric::BATTERY_PERCENT), "nothing before the first sample");
+    telemetry.start(fake.config());
+    telemetry.stop();
+    CHECK(telemetry.get(Metric::BATTERY_PERCENT) == 100, "battery percent");
+    CHECK(telemetry.get(Metric::BATTERY_VOLTAGE) == 4100000, "battery voltage");
+    CHECK(telemetry.get(Metric::CPU_TEMPERATURE) == 45000, "cpu temperature");
+    CHECK(!telemetry.has(Metric::BATTERY_CURRENT), "missing attribute");
+    CHECK(telemetry.get(Metric::BATTERY_CURRENT, -1) == -1, "missing attribute falls back");
+    CHECK(seen.size() == 3, "first values reported once each");
+
+    // A value change is reported with the previous one
+    seen.clear();
+    fake.set(Metric::BATTERY_PERCENT, 87);
+    telemetry.sample_now();
+    CHECK(seen.size() == 1 && seen[0] == std::make_tuple(Metric::BATTERY_PERCENT, int64_t(100), int64_t(87)),
+          "change callback with previous and current");
+
+    // An attribute that appears later is picked up; a malformed one is not
+    fake.set(Metric::BATTERY_CURRENT, -250000);
+    telemetry.sample_now();
+    CHECK(telemetry.get(Metric::BATTERY_CURRENT) == -250000, "late attribute read");
+    {
+        std::ofstream(fake.file(Metric::CPU_TEMPERATURE), std::ios::trunc) << "n/a\n";
+    }
+    telemetry.sample_now();
+    CHECK(!telemetry.has(Metric::CPU_TEMPERATURE), "malformed attribute invalid");
+    fake.set(Metric::CPU_TEMPERATURE, 51000);
+    telemetry.sample_now();
+    CHECK(telemetry.get(Metric::CPU_TEMPERATURE) == 51000, "attribute recovers");
+
+    auto stats = telemetry.stats();
+    CHECK(stats.reads == stats.samples * power::METRIC_COUNT, "one read per attribute per sample");
+}
+
+static void check_cadence() {
+    power::FakeSysfs fake(scratch("power_telemetry_test.cadence"));
+    auto config = fake.config();
+    config.min_interval = 20ms;
+    config.max_interval = 160ms;
+    power::Telemetry telemetry;
+    telemetry.start(config);
+
+    // Values holding still back the sampler off to the slow cadence
+    CHECK(wait_for([&] { return telemetry.stats().interval == config.max_interval; }),
+          "backs off while idle");
+
+    // Changes inside the noise band do not speed it up
+    fake.set(Metric::CPU_TEMPERATURE, 45000 + config.noise[static_cast<size_t>(Metric::CPU_TEMPERATURE)]);
+    CHECK(wait_for([&] { return telemetry.get(Metric::CPU_TEMPERATURE) != 45000; }), "small change read");
+    uint64_t before = telemetry.stats().samples;
+    std::this_thread::sleep_for(150ms);
+    CHECK(telemetry.stats().samples - before <= 1, "noise keeps the slow cadence");
+
+    // A real change samples fast again: 20, 40, 80 ms after it
+    fake.set(Metric::BATTERY_PERCENT, 42);
+    CHECK(wait_for([&] { return telemetry.get(Metric::BATTERY_PERCENT) == 42; }), "change read");
+    before = telemetry.stats().samples;
+    std::this_thread::sleep_for(150ms);
+    CHECK(telemetry.stats().samples - before >= 2, "change speeds sampling up");
+
+    telemetry.stop();
+    before = telemetry.stats().samples;
+    std::this_thread::sleep_for(100ms);
+    CHECK(telemetry.stats().samples == before, "no samples after stop");
+}
+
+int main() {
+    check_sampling();
+    check_cadence();
+    return testing::finish("power_telemetry_test");
+}
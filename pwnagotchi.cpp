@@ -1,113 +1,214 @@
 #include "pwnagotchi.hpp"
+#include "boot_orchestrator.hpp"
 #include "system_config.hpp"
+#include "logger.hpp"
+#include "metrics_export.hpp"
+#include "reactor.hpp"
+#include "energy_scheduler.hpp"
 #include <iostream>
 #include <chrono>
-#include <thread>
+#include <condition_variable>
+#include <mutex>
 #include <signal.h>
 
-// Global variables for graceful shutdown
-volatile sig_atomic_t g_running = 1;
-
-// Signal handler
-void signal_handler(int signum) {
-    g_running = 0;
-}
-
 class PwnagotchiSystem {
 private:
+    SystemConfig sys_config;  // first: owns the write scheduler ai uses
     PwnagotchiAI ai;
-    SystemConfig sys_config;
-    std::unique_ptr<std::thread> display_thread;
-    std::unique_ptr<std::thread> storage_thread;
+    boot::Orchestrator startup;
+    // Display, storage and epochs run on the process loop; this thread
+    // only waits for the signal to quit
+    runtime::Reactor& reactor = runtime::Reactor::shared();
+    runtime::TimerId display_timer{0};
+    runtime::TimerId storage_timer{0};
+    runtime::TimerId epoch_timer{0};
+    bool stopping{false};  // loop thread only
+    runtime::EnergyScheduler& energy = runtime::EnergyScheduler::shared();
+    runtime::TaskHandle cleanup_task;  // reactor thread only
+    metrics::Exporter exporter;        // /run/pwnagotchi/metrics.{sock,txt}
+    metrics::Histogram frame_latency = metrics::histogram("display_frame");
+    metrics::Histogram epoch_latency = metrics::histogram("epoch");
+    std::mutex quit_mutex;
+    std::condition_variable quit_cv;
+    bool quitting{false};
+    
+    // Epoch state
+    NetworkStats stats;
+    std::vector<AccessPoint> discovered_aps;
+    uint32_t epoch{0};
+    
+    // Display state
+    std::string shown;
+    bool first_frame{true};
     
-    void displayLoop() {
-        while (g_running) {
-            if (sys_config.getDisplayConfig().enabled) {
-                // Update display with AI status
-                std::cout << ai.getStatus() << "\n";
+    std::chrono::milliseconds refreshPeriod() {
+        return std::chrono::milliseconds(1000 / sys_config.getRefreshRate());
+    }
+    
+    void displayTick() {
+        auto scope = energy.measure("display");
+        metrics::ScopedTimer timer(frame_latency);
+        if (sys_config.getDisplayConfig().enabled) {
+            // Update display with AI status; unchanged frames are not logged again.
+            // Until the saved state is restored there is only a boot screen.
+            std::string status = startup.status("ai_state") == boot::Status::READY
+                                     ? ai.getStatus() : "Booting...";
+            if (status != shown) {
+                logging::info("{}", status);
+                shown = std::move(status);
+            }
+            if (first_frame) {
+                startup.mark("first_frame");
+                first_frame = false;
             }
-            // Respect display refresh rate
-            std::this_thread::sleep_for(
-                std::chrono::milliseconds(1000 / sys_config.getDisplayConfig().refresh_rate)
-            );
         }
+        // Respect display refresh rate, which config.txt can change live
+        reactor.set_period(display_timer, refreshPeriod());
     }
     
-    void storageLoop() {
-        while (g_running) {
-            // Check storage every minute
-            sys_config.checkStorage();
-            std::this_thread::sleep_for(std::chrono::minutes(1));
-        }
+    // Cleanup itself is started from the epoch, as a pool task
+    void storageTick() {
+        auto scope = energy.measure("storage");
+        sys_config.checkStorage();
     }
+    
+    // One scan/decide/learn round; the next one starts when the channel
+    // scheduler's dwell on the new channel is over
+    void runEpoch() {
+        timesvc::tick();
+        auto scope = energy.measure("epoch");
+        metrics::ScopedTimer timer(epoch_latency);
+        
+        // Check system resources; a full card can wait out low battery or
+        // heat for a couple of minutes, not longer
+        if (sys_config.hasStorageWarning() && cleanup_task.finished()) {
+            logging::warn("Low storage space: {} bytes free", sys_config.getFreeSpace());
+            runtime::TaskSpec spec{"cleanup", runtime::Priority::LOW, {}, std::chrono::minutes(2)};
+            cleanup_task = energy.submit(spec, [this] {
+                sys_config.cleanupOldFiles();
+            });
+        }
 
-public:
-    PwnagotchiSystem() {
-        // Set up signal handlers
-        signal(SIGINT, signal_handler);
-        signal(SIGTERM, signal_handler);
+        // Update AI state
+        ai.updateState(discovered_aps);
         
-        // Initialize display
-        sys_config.initializeDisplay();
+        // Get target decisions
+        auto targets = ai.decideTargets();
+        
+        // Simulate attacks (replace with real implementation)
+        if (!targets.empty()) {
+            stats.deauths_sent += targets.size();
+            stats.handshakes_captured += targets.size() / 2;
+            stats.success_rate = static_cast<float>(stats.handshakes_captured) / stats.deauths_sent;
+        }
+        
+        // Update AI learning
+        ai.updateLearning(stats);
+        
+        // Loop tuning, re-read each epoch so config.txt edits apply live
+        uint32_t save_epochs, dwell_ms;
+        {
+            auto settings = sys_config.getSettings();
+            save_epochs = settings->state_save_epochs;
+            dwell_ms = settings->dwell_ms;
+        }
+
+        // Channel hopping; dwell_ms is the dwell of an average channel
+        ai.setBaseDwell(std::chrono::milliseconds(dwell_ms));
+        ai.selectNextChannel();
+
+        // Save state periodically
+        if (++epoch % save_epochs == 0) {
+            ai.saveState(sys_config.getPaths().models / "ai_state.bin");
+        }
         
-        // Start monitoring threads
-        display_thread = std::make_unique<std::thread>(&PwnagotchiSystem::displayLoop, this);
-        storage_thread = std::make_unique<std::thread>(&PwnagotchiSystem::storageLoop, this);
+        // Stay on the channel for as long as the scheduler allotted
+        epoch_timer = reactor.add_timer(ai.getChannelDwell(), [this] { epochTick(); });
     }
     
-    ~PwnagotchiSystem() {
-        g_running = 0;
-        if (display_thread && display_thread->joinable()) {
-            display_thread->join();
+    // A failed epoch ends the session, as it did when epochs ran inline
+    void epochTick() {
+        if (stopping) return;
+        try {
+            runEpoch();
+        } catch (const std::exception& e) {
+            logging::error("Epoch failed: {}", e.what());
+            quit();
         }
-        if (storage_thread && storage_thread->joinable()) {
-            storage_thread->join();
+    }
+
+    void quit() {
+        {
+            std::lock_guard<std::mutex> lock(quit_mutex);
+            quitting = true;
         }
+        quit_cv.notify_all();
+    }
+
+public:
+    PwnagotchiSystem() {
+        // Delivered through the reactor; main() blocked them before any
+        // thread started
+        reactor.on_signal(SIGINT, [this](int) { quit(); });
+        reactor.on_signal(SIGTERM, [this](int) { quit(); });
+        
+        // Display detection shells out to tvservice; restoring the previous
+        // session reads the model file. Neither needs the other.
+        startup.add("display", {}, boot::Start::EAGER, [this] {
+            sys_config.initializeDisplay();
+        });
+        startup.add("ai_state", {}, boot::Start::EAGER, [this] {
+            ai.setWriteScheduler(sys_config.getWriteScheduler());
+            ai.loadState(sys_config.getPaths().models / "ai_state.bin");
+        });
+        startup.run();
     }
     
     void run() {
-        NetworkStats stats;
-        std::vector<AccessPoint> discovered_aps;
-
-        while (g_running) {
-            // Check system resources
-            if (sys_config.hasStorageWarning()) {
-                std::cout << "Warning: Low storage space\n";
-                sys_config.cleanupOldFiles();
-            }
+        if (!exporter.start()) logging::warn("Metrics export unavailable");
+        
+        // The boot screen shows while the saved state is still loading
+        startup.require("display");
+        display_timer = reactor.add_periodic(refreshPeriod(), [this] { displayTick(); });
+        reactor.post([this] { displayTick(); });
+        
+        // Check storage now and every minute
+        reactor.post([this] { storageTick(); });
+        storage_timer = reactor.add_periodic(std::chrono::minutes(1), [this] { storageTick(); });
+        
+        // Epochs start once the previous session is restored
+        startup.on_complete([this] {
+            reactor.post([this] {
+                startup.report();
+                epochTick();
+            });
+        });
 
-            // Update AI state
-            ai.updateState(discovered_aps);
-            
-            // Get target decisions
-            auto targets = ai.decideTargets();
-            
-            // Simulate attacks (replace with real implementation)
-            if (!targets.empty()) {
-                stats.deauths_sent += targets.size();
-                stats.handshakes_captured += targets.size() / 2;
-                stats.success_rate = static_cast<float>(stats.handshakes_captured) / stats.deauths_sent;
-            }
-            
-            // Update AI learning
-            ai.updateLearning(stats);
-            
-            // Channel hopping
-            uint8_t new_channel = ai.selectNextChannel();
-            
-            // Save state periodically
-            static int epoch = 0;
-            if (++epoch % 5 == 0) {
-                ai.saveState(sys_config.getPaths().models / "ai_state.bin");
-            }
-            
-            // Sleep for a bit
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        {
+            std::unique_lock<std::mutex> lock(quit_mutex);
+            quit_cv.wait(lock, [this] { return quitting; });
         }
+
+        // Boot has handed over by now; then the loop lets go of everything
+        // here, with no tick still running
+        startup.join();
+        reactor.call([this] {
+            stopping = true;
+            reactor.remove_signal(SIGINT);
+            reactor.remove_signal(SIGTERM);
+            for (auto id : {display_timer, storage_timer, epoch_timer}) reactor.cancel_timer(id);
+        });
+        
+        if (!cleanup_task.cancel()) cleanup_task.wait();
+        ai.flushState();
+        energy.log_report();
+        exporter.stop();
     }
 };
 
 int main() {
+    // Before any thread starts, so only the process loop ever sees them
+    runtime::block_signals({SIGINT, SIGTERM});
     try {
         PwnagotchiSystem system;
         std::cout << "Pwnagotchi started. Press Ctrl+C to exit.\n";
@@ -16,6 +16,12 @@
 #include <thread>
 #include <mutex>
 #include "neural_network.hpp"
+#include "bounded_table.hpp"
+#include "channel_scheduler.hpp"
+#include "time_service.hpp"
+#include "mac_utils.hpp"
+#include "snapshot_writer.hpp"
+#include "logger.hpp"
 
 // Forward declarations
 class AccessPoint;
@@ -33,14 +39,31 @@ struct MacAddress {
     std::array<uint8_t, 6> addr;
     
     std::string toString() const {
-        std::stringstream ss;
-        for (size_t i = 0; i < 6; ++i) {
-            ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(addr[i]);
-            if (i < 5) ss << ":";
-        }
-        return ss.str();
+        return mac::to_string(addr.data());
+    }
+
+    // Writes 17 characters into buf, no terminator
+    void format(char* buf) const {
+        mac::format(addr.data(), buf);
+    }
+
+    static bool fromString(std::string_view text, MacAddress& out) {
+        return mac::parse(text, out.addr.data());
     }
+
+    uint32_t oui() const { return mac::oui(addr.data()); }
+
+    bool operator==(const MacAddress& other) const { return addr == other.addr; }
+    bool operator!=(const MacAddress& other) const { return addr != other.addr; }
+    bool operator<(const MacAddress& other) const { return addr < other.addr; }
+};
+
+namespace std {
+template <>
+struct hash<MacAddress> {
+    size_t operator()(const MacAddress& m) const { return mac::hash(m.addr.data()); }
 };
+}
 
 struct NetworkStats {
     uint32_t deauths_sent{0};
@@ -59,11 +82,17 @@ public:
     int32_t rssi;
     bool has_handshake;
     std::vector<MacAddress> clients;
-    std::chrono::system_clock::time_point last_seen;
+    timesvc::MonoTime last_seen;
 
     AccessPoint() : channel(0), rssi(0), has_handshake(false) {}
 };
 
+// Client to AP association, kept in a bounded table across all APs
+struct ClientRecord {
+    MacAddress bssid;
+    timesvc::MonoTime last_seen;
+};
+
 class PwnagotchiAI {
 private:
     // Neural network for decision making
@@ -71,10 +100,15 @@ private:
     
     // State management
     NetworkStats stats;
-    std::map<MacAddress, AccessPoint> access_points;
+    bounded::BoundedTable<MacAddress, AccessPoint> access_points{MAX_APS};
+    bounded::BoundedTable<MacAddress, ClientRecord> clients{MAX_CLIENTS};
     std::vector<HandshakeCapture> handshakes;
     uint8_t current_channel;
     bool is_stealthy;
+
+    // Channel hopping weighted by what each channel has been yielding
+    channel::ChannelScheduler channels{hopConfig()};
+    std::chrono::milliseconds channel_dwell{500};
     
     // Random number generation optimized for 32-bit
     std::mt19937 rng;
@@ -87,10 +121,75 @@ private:
     float boredom;
     float tiredness;
 
+    // Persisted state; bump STATE_VERSION whenever encodeState() changes
+    static constexpr uint32_t STATE_VERSION = 1;
+    static constexpr std::chrono::seconds STATE_SAVE_INTERVAL{30};
+    persist::SnapshotWriter state_writer;
+
+    std::vector<uint8_t> encodeState() const {
+        persist::ByteWriter out;
+        out.put(stats.deauths_sent).put(stats.associations_sent)
+           .put(stats.handshakes_captured).put(stats.aps_seen)
+           .put(stats.clients_seen).put(stats.success_rate)
+           .put(current_channel).put(excitement).put(boredom).put(tiredness);
+        return out.take();
+    }
+
+    bool decodeState(const std::vector<uint8_t>& payload) {
+        persist::ByteReader in(payload);
+        NetworkStats s;
+        uint8_t channel;
+        float e, b, t;
+        bool ok = in.get(s.deauths_sent) && in.get(s.associations_sent) &&
+                  in.get(s.handshakes_captured) && in.get(s.aps_seen) &&
+                  in.get(s.clients_seen) && in.get(s.success_rate) &&
+                  in.get(channel) && in.get(e) && in.get(b) && in.get(t) && in.at_end();
+        if (!ok) return false;
+
+        stats = s;
+        current_channel = channel;
+        excitement = e;
+        boredom = b;
+        tiredness = t;
+        return true;
+    }
+
+    static channel::ChannelScheduler::Config hopConfig() {
+        channel::ChannelScheduler::Config cfg;
+        cfg.channels.clear();
+        for (uint8_t ch = 1; ch <= MAX_CHANNELS; ++ch) cfg.channels.push_back(ch);
+        return cfg;
+    }
+
+    // Keeps AccessPoint::clients in step with the client table
+    void detachClient(const MacAddress& client, const MacAddress& bssid) {
+        auto* ap = access_points.find(bssid);
+        if (!ap) return;
+        auto& list = ap->clients;
+        list.erase(std::remove(list.begin(), list.end(), client), list.end());
+    }
+
+    void useStateFile(const std::string& filename) {
+        if (state_writer.get_path() != filename) {
+            state_writer.open(filename, STATE_VERSION, STATE_SAVE_INTERVAL);
+        }
+    }
+
 public:
     PwnagotchiAI() : current_channel(1), is_stealthy(true),
                      rng(std::random_device{}()),
                      excitement(0.5f), boredom(0.0f), tiredness(0.0f) {
+        // A client evicted from the table is no longer listed under its AP,
+        // and an evicted AP takes its clients' records with it
+        clients.set_evict_callback([this](const MacAddress& client, ClientRecord& record) {
+            detachClient(client, record.bssid);
+        });
+        access_points.set_evict_callback([this](const MacAddress& bssid, AccessPoint& ap) {
+            for (const auto& client : ap.clients) {
+                auto* record = clients.find(client);
+                if (record && record->bssid == bssid) clients.erase(client);
+            }
+        });
         initializeNeuralNetwork();
     }
 
@@ -107,10 +206,28 @@ public:
     // Core functionality
     void updateState(const std::vector<AccessPoint>& new_aps) {
         std::lock_guard<std::mutex> lock(state_mutex);
+        auto now = timesvc::coarse_now();
         for (const auto& ap : new_aps) {
-            access_points[ap.bssid] = ap;
+            channels.on_frame(wifi::Bssid(ap.bssid.addr), now);
+            auto& entry = access_points.upsert(ap.bssid, bounded::signal_weight(ap.rssi));
+            entry = ap;
+            if (entry.clients.size() > MAX_CLIENTS) {
+                entry.clients.resize(MAX_CLIENTS);
+            }
+            
+            // Iterate a copy: an upsert may evict a client listed here
+            auto listed = entry.clients;
+            for (const auto& client : listed) {
+                auto& record = clients.upsert(client, bounded::signal_weight(ap.rssi));
+                if (record.bssid != ap.bssid) {
+                    detachClient(client, record.bssid);  // moved from another AP
+                }
+                record.bssid = ap.bssid;
+                record.last_seen = ap.last_seen;
+            }
         }
         stats.aps_seen = access_points.size();
+        stats.clients_seen = clients.size();
     }
 
     std::vector<MacAddress> decideTargets() {
@@ -157,11 +274,20 @@ public:
 
     // Channel management
     uint8_t selectNextChannel() {
-        std::uniform_int_distribution<uint8_t> dist(1, MAX_CHANNELS);
-        current_channel = dist(rng);
+        auto visit = channels.next(timesvc::precise_now());
+        current_channel = visit.channel;
+        channel_dwell = visit.dwell;
         return current_channel;
     }
 
+    // How long to stay on the channel selectNextChannel() picked
+    std::chrono::milliseconds getChannelDwell() const { return channel_dwell; }
+
+    // Dwell for an average channel; busier ones stay longer, quiet ones less
+    void setBaseDwell(std::chrono::milliseconds dwell) { channels.set_base_dwell(dwell); }
+
+    std::vector<channel::ChannelStats> getChannelStats() const { return channels.stats(); }
+
     // Stealth mode operations
     void setStealthMode(bool stealth) {
         is_stealthy = stealth;
@@ -171,6 +297,15 @@ public:
         return is_stealthy;
     }
 
+    // Table occupancy and eviction metrics
+    bounded::TableStats getAccessPointStats() const {
+        return access_points.stats();
+    }
+
+    bounded::TableStats getClientStats() const {
+        return clients.stats();
+    }
+
     // Status reporting
     std::string getStatus() const {
         std::stringstream ss;
@@ -179,30 +314,49 @@ public:
            << "Handshakes: " << stats.handshakes_captured << "\n"
            << "Success Rate: " << (stats.success_rate * 100) << "%\n"
            << "Excitement: " << (excitement * 100) << "%\n"
-           << "Channel: " << static_cast<int>(current_channel);
+           << "Channel: " << static_cast<int>(current_channel) << "\n"
+           << "AP Table: " << access_points.size() << "/" << access_points.capacity()
+           << " (" << access_points.stats().evictions << " evicted)";
         return ss.str();
     }
 
-    // Save and load functions
+    // Save and load functions. Saves are atomic and checksummed; unchanged
+    // state is skipped and changes are written at most every STATE_SAVE_INTERVAL.
     void saveState(const std::string& filename) {
-        std::ofstream file(filename, std::ios::binary);
-        if (file.is_open()) {
-            file.write(reinterpret_cast<char*>(&stats), sizeof(NetworkStats));
-            file.write(reinterpret_cast<char*>(&current_channel), sizeof(uint8_t));
-            file.write(reinterpret_cast<char*>(&excitement), sizeof(float));
-            file.write(reinterpret_cast<char*>(&boredom), sizeof(float));
-            file.write(reinterpret_cast<char*>(&tiredness), sizeof(float));
-        }
+        std::lock_guard<std::mutex> lock(state_mutex);
+        useStateFile(filename);
+        state_writer.submit(encodeState());
+    }
+
+    // Queue state writes on the shared scheduler instead of writing inline
+    void setWriteScheduler(persist::WriteScheduler& writes) {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        state_writer.set_scheduler(&writes, "ai_state", persist::Durability::NORMAL);
+    }
+
+    // Writes any change still held back by the save interval
+    void flushState() {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        state_writer.flush();
     }
 
-    void loadState(const std::string& filename) {
-        std::ifstream file(filename, std::ios::binary);
-        if (file.is_open()) {
-            file.read(reinterpret_cast<char*>(&stats), sizeof(NetworkStats));
-            file.read(reinterpret_cast<char*>(&current_channel), sizeof(uint8_t));
-            file.read(reinterpret_cast<char*>(&excitement), sizeof(float));
-            file.read(reinterpret_cast<char*>(&boredom), sizeof(float));
-            file.read(reinterpret_cast<char*>(&tiredness), sizeof(float));
+    // Returns false and keeps the current state if the file is missing,
+    // corrupt or from another version
+    bool loadState(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        useStateFile(filename);
+        std::vector<uint8_t> payload;
+        auto status = state_writer.load(payload);
+        if (status != persist::LoadStatus::OK) {
+            if (status != persist::LoadStatus::MISSING) {
+                logging::warn("Ignoring saved state {}: {}", filename, persist::to_string(status));
+            }
+            return false;
         }
+        return decodeState(payload);
+    }
+
+    persist::WriterStats getStateWriterStats() const {
+        return state_writer.stats();
     }
 };
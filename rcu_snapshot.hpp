@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rcu {
+
+// Publishes immutable, versioned snapshots of T. Readers never block the
+// writer and never take a lock: they announce the epoch they entered in, load
+// the current pointer and release the slot when done. Retired snapshots are
+// freed once every active reader has entered a later epoch.
+template <typename T>
+class SnapshotPublisher {
+private:
+    struct Node {
+        uint64_t version;
+        T value;
+    };
+
+    static constexpr size_t MAX_READERS = 16;
+    static constexpr uint64_t IDLE = 0;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    std::atomic<Node*> current{nullptr};
+    std::atomic<uint64_t> global_epoch{1};
+    mutable std::array<ReaderSlot, MAX_READERS> slots;
+
+    // Writer side only
+    std::mutex writer_mutex;
+    std::vector<std::pair<uint64_t, Node*>> retired;
+    uint64_t next_version{1};
+
+    ReaderSlot& enter() const {
+        size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % MAX_READERS;
+        while (true) {
+            for (size_t i = 0; i < MAX_READERS; ++i) {
+                auto& slot = slots[(start + i) % MAX_READERS];
+                uint64_t expected = IDLE;
+                if (slot.epoch.compare_exchange_strong(expected, global_epoch.load())) {
+                    return slot;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void reclaim() {
+        uint64_t oldest = UINT64_MAX;
+        for (auto& slot : slots) {
+            uint64_t e = slot.epoch.load();
+            if (e != IDLE && e < oldest) oldest = e;
+        }
+
+        auto it = retired.begin();
+        while (it != retired.end()) {
+            if (it->first < oldest) {
+                delete it->second;
+                it = retired.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+public:
+    class ReadGuard {
+    private:
+        ReaderSlot* slot;
+        const Node* node;
+
+    public:
+        ReadGuard(ReaderSlot* s, const Node* n) : slot(s), node(n) {}
+        ReadGuard(ReadGuard&& other) noexcept : slot(other.slot), node(other.node) {
+            other.slot = nullptr;
+        }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ReadGuard& operator=(ReadGuard&&) = delete;
+
+        ~ReadGuard() {
+            if (slot) slot->epoch.store(IDLE);
+        }
+
+        explicit operator bool() const { return node != nullptr; }
+        const T& operator*() const { return node->value; }
+        const T* operator->() const { return &node->value; }
+        uint64_t version() const { return node ? node->version : 0; }
+    };
+
+    SnapshotPublisher() = default;
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    ~SnapshotPublisher() {
+        delete current.load();
+        for (auto& [epoch, node] : retired) {
+            delete node;
+        }
+    }
+
+    // Pins the current snapshot for the lifetime of the guard
+    ReadGuard read() const {
+        ReaderSlot& slot = enter();
+        return ReadGuard(&slot, current.load());
+    }
+
+    // Version of the latest snapshot, without pinning it
+    uint64_t version() const {
+        return read().version();
+    }
+
+    void publish(T value) {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        Node* next = new Node{next_version++, std::move(value)};
+        Node* old = current.exchange(next);
+        uint64_t epoch = global_epoch.fetch_add(1);
+        if (old) {
+            retired.emplace_back(epoch, old);
+        }
+        reclaim();
+    }
+
+    size_t pending_reclaim() {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        reclaim();
+        return retired.size();
+    }
+};
+
+} // namespace rcu
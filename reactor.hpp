@@ -0,0 +1,511 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "time_service.hpp"
+
+// Single-threaded event loop: file descriptors, timers, signals and
+// posted callbacks all wake one epoll_wait. Timers share one timerfd
+// armed for the latest moment the earliest timer may fire: each timer
+// has a slack, and everything already due when it fires runs in the
+// same wakeup. Handlers run on the loop thread; registering, cancelling
+// and posting are safe from any thread. Reactor::shared() is the process
+// loop: subsystems register on it unless handed another, so an idle
+// process sleeps in a single epoll_wait.
+//
+// Sits below the logger, which flushes from this loop; handler failures
+// are counted and written straight to stderr.
+namespace runtime {
+
+using TimerId = uint64_t;
+
+// Blocks signals on the calling thread and every thread it starts after;
+// call from main() before anything spawns threads, then take them with
+// Reactor::on_signal
+inline bool block_signals(std::initializer_list<int> signals) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signo : signals) sigaddset(&mask, signo);
+    return ::pthread_sigmask(SIG_BLOCK, &mask, nullptr) == 0;
+}
+
+struct ReactorStats {
+    uint64_t wakeups;        // epoll_wait returns
+    uint64_t timer_batches;  // timerfd expirations
+    uint64_t timer_fires;    // timer handlers run
+    uint64_t fd_events;
+    uint64_t posted;
+    uint64_t signals;
+    uint64_t errors;         // handlers that threw, loop failures
+    std::chrono::microseconds avg_lateness;  // timer handler start past its deadline
+    std::chrono::microseconds max_lateness;
+    size_t timers;
+    size_t fds;
+};
+
+class Reactor {
+public:
+    using Duration = timesvc::MonoClock::duration;
+    using FdHandler = std::function<void(uint32_t events)>;
+    using TimerHandler = std::function<void()>;
+    using SignalHandler = std::function<void(int signo)>;
+
+    // Slack of a tenth of the delay, the kernel's own default ratio
+    static constexpr Duration AUTO_SLACK = Duration(-1);
+
+private:
+    struct Callback {
+        TimerHandler fn;
+        std::atomic<bool> cancelled{false};
+        explicit Callback(TimerHandler f) : fn(std::move(f)) {}
+    };
+
+    struct Timer {
+        timesvc::MonoTime deadline;
+        Duration period;  // zero for one-shot
+        Duration slack;
+        std::shared_ptr<Callback> callback;
+    };
+
+    int epoll_fd{-1};
+    int wake_fd{-1};
+    int timer_fd{-1};
+    int signal_fd{-1};
+    sigset_t signal_mask;
+
+    mutable std::mutex mutex;
+    std::unordered_map<int, std::shared_ptr<FdHandler>> fd_handlers;
+    std::unordered_map<int, std::shared_ptr<SignalHandler>> signal_handlers;
+    std::unordered_map<TimerId, Timer> timers;
+    std::set<std::pair<timesvc::MonoTime, TimerId>> by_deadline;
+    std::set<std::pair<timesvc::MonoTime, TimerId>> by_latest;  // deadline + slack
+    TimerId next_timer{1};
+    timesvc::MonoTime armed_for{timesvc::MonoTime::max()};
+    std::vector<std::function<void()>> posted;
+    bool looping{false};  // a thread is in run(); guarded by mutex
+
+    std::atomic<bool> stopped{false};
+    std::thread loop_thread;
+    std::atomic<std::thread::id> loop_id{};
+
+    // Metrics, guarded by mutex
+    uint64_t wakeup_count{0};
+    uint64_t batch_count{0};
+    uint64_t fire_count{0};
+    uint64_t fd_event_count{0};
+    uint64_t posted_count{0};
+    uint64_t signal_count{0};
+    uint64_t error_count{0};
+    double avg_lateness_us{0.0};
+    int64_t max_lateness_us{0};
+
+    static constexpr double LATENESS_ALPHA = 0.1;
+    static constexpr int MAX_EVENTS = 32;
+
+    bool watch(int fd, uint32_t events, int op) {
+        struct epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        return ::epoll_ctl(epoll_fd, op, fd, &ev) == 0;
+    }
+
+    static Duration resolve_slack(Duration delay, Duration slack) {
+        if (slack >= Duration::zero()) return slack;
+        return std::max(Duration::zero(), delay / 10);
+    }
+
+    void insert_locked(TimerId id, const Timer& timer) {
+        by_deadline.emplace(timer.deadline, id);
+        by_latest.emplace(timer.deadline + timer.slack, id);
+    }
+
+    void erase_locked(TimerId id, const Timer& timer) {
+        by_deadline.erase({timer.deadline, id});
+        by_latest.erase({timer.deadline + timer.slack, id});
+    }
+
+    // Arms the timerfd for the latest moment the most urgent timer allows
+    void rearm_locked() {
+        timesvc::MonoTime target = by_latest.empty() ? timesvc::MonoTime::max() : by_latest.begin()->first;
+        if (target == armed_for) return;
+        armed_for = target;
+
+        struct itimerspec spec{};
+        if (target != timesvc::MonoTime::max()) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(target.time_since_epoch()).count();
+            // Zero disarms, so a deadline at the clock's epoch still needs a tick
+            ns = std::max<int64_t>(ns, 1);
+            spec.it_value.tv_sec = ns / 1000000000;
+            spec.it_value.tv_nsec = ns % 1000000000;
+        }
+        ::timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    void report(const char* what, const char* detail) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error_count++;
+        }
+        std::string line = std::string("reactor: ") + what + ": " + detail + "\n";
+        (void)::write(STDERR_FILENO, line.data(), line.size());
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        (void)::write(wake_fd, &one, sizeof(one));
+    }
+
+    void run_timers() {
+        uint64_t expirations;
+        (void)::read(timer_fd, &expirations, sizeof(expirations));
+
+        std::vector<std::shared_ptr<Callback>> due;
+        auto now = timesvc::precise_now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            armed_for = timesvc::MonoTime::max();  // the timerfd has fired
+            while (!by_deadline.empty() && by_deadline.begin()->first <= now) {
+                TimerId id = by_deadline.begin()->second;
+                Timer& timer = timers[id];
+                erase_locked(id, timer);
+                int64_t late = std::chrono::duration_cast<std::chrono::microseconds>(now - timer.deadline).count();
+                avg_lateness_us = fire_count == 0 ? static_cast<double>(late)
+                                                  : avg_lateness_us + LATENESS_ALPHA * (late - avg_lateness_us);
+                max_lateness_us = std::max(max_lateness_us, late);
+                fire_count++;
+                due.push_back(timer.callback);
+                if (timer.period > Duration::zero()) {
+                    // From the batch time rather than the old deadline, so
+                    // timers that fired together stay together
+                    timer.deadline = now + timer.period;
+                    insert_locked(id, timer);
+                } else {
+                    timers.erase(id);
+                }
+            }
+            if (!due.empty()) batch_count++;
+            rearm_locked();
+        }
+
+        for (auto& callback : due) {
+            // An earlier handler in this batch may have cancelled it
+            if (callback->cancelled) continue;
+            try {
+                callback->fn();
+            } catch (const std::exception& e) {
+                report("timer handler", e.what());
+            }
+        }
+    }
+
+    void run_batch(std::vector<std::function<void()>>& batch) {
+        for (auto& fn : batch) {
+            try {
+                fn();
+            } catch (const std::exception& e) {
+                report("posted callback", e.what());
+            }
+        }
+    }
+
+    void run_posted() {
+        uint64_t count;
+        (void)::read(wake_fd, &count, sizeof(count));
+        std::vector<std::function<void()>> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch.swap(posted);
+        }
+        run_batch(batch);
+    }
+
+    // False if only_if_looping and no thread is running the loop
+    bool enqueue(std::function<void()> fn, bool only_if_looping) {
+        bool was_empty;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (only_if_looping && !looping) return false;
+            was_empty = posted.empty();
+            posted.push_back(std::move(fn));
+            posted_count++;
+        }
+        if (was_empty) wake();
+        return true;
+    }
+
+    void run_signals() {
+        struct signalfd_siginfo info;
+        while (::read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            std::shared_ptr<SignalHandler> handler;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                signal_count++;
+                auto it = signal_handlers.find(static_cast<int>(info.ssi_signo));
+                if (it != signal_handlers.end()) handler = it->second;
+            }
+            if (handler) (*handler)(static_cast<int>(info.ssi_signo));
+        }
+    }
+
+    void dispatch(int fd, uint32_t events) {
+        if (fd == timer_fd) return run_timers();
+        if (fd == wake_fd) return run_posted();
+        if (fd == signal_fd) return run_signals();
+
+        std::shared_ptr<FdHandler> handler;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = fd_handlers.find(fd);
+            if (it == fd_handlers.end()) return;  // removed by an earlier handler
+            handler = it->second;
+            fd_event_count++;
+        }
+        try {
+            (*handler)(events);
+        } catch (const std::exception& e) {
+            report(("handler for fd " + std::to_string(fd)).c_str(), e.what());
+        }
+    }
+
+public:
+    Reactor() {
+        sigemptyset(&signal_mask);
+        epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (epoll_fd < 0 || wake_fd < 0 || timer_fd < 0 ||
+            !watch(wake_fd, EPOLLIN, EPOLL_CTL_ADD) || !watch(timer_fd, EPOLLIN, EPOLL_CTL_ADD)) {
+            report("setup failed", std::strerror(errno));
+        }
+    }
+
+    ~Reactor() {
+        stop();
+        for (int fd : {epoll_fd, wake_fd, timer_fd, signal_fd}) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    bool is_open() const { return epoll_fd >= 0 && wake_fd >= 0 && timer_fd >= 0; }
+
+    // Process-wide loop, running on a thread of its own from first use.
+    // Never destroyed, so objects with static storage can still take their
+    // handlers off it while the process exits.
+    static Reactor& shared() {
+        static Reactor* loop = [] {
+            auto* reactor = new Reactor();
+            reactor->start();
+            return reactor;
+        }();
+        return *loop;
+    }
+
+    // Runs handlers on the calling thread until stop(). Callbacks posted
+    // before it returns still run, on the way out.
+    bool run() {
+        if (!is_open()) return false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            looping = true;
+        }
+        loop_id = std::this_thread::get_id();
+        struct epoll_event events[MAX_EVENTS];
+        bool ok = true;
+        while (!stopped) {
+            int n = ::epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                report("epoll_wait failed", std::strerror(errno));
+                ok = false;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                wakeup_count++;
+            }
+            for (int i = 0; i < n && !stopped; ++i) {
+                dispatch(events[i].data.fd, events[i].events);
+            }
+        }
+        std::vector<std::function<void()>> leftover;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            looping = false;
+            leftover.swap(posted);
+        }
+        run_batch(leftover);
+        loop_id = std::thread::id();
+        return ok;
+    }
+
+    // Runs the loop on a thread of its own
+    bool start() {
+        if (!is_open() || loop_thread.joinable()) return false;
+        stopped = false;
+        loop_thread = std::thread([this] { run(); });
+        return true;
+    }
+
+    // Returns once the loop has exited, unless called from a handler
+    void stop() {
+        stopped = true;
+        wake();
+        if (loop_thread.joinable() && !in_loop_thread()) loop_thread.join();
+    }
+
+    bool in_loop_thread() const { return loop_id.load() == std::this_thread::get_id(); }
+
+    // Calls handler with the ready events (EPOLLIN, EPOLLOUT, ...) for fd
+    bool add_fd(int fd, uint32_t events, FdHandler handler) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!watch(fd, events, EPOLL_CTL_ADD)) return false;
+        fd_handlers[fd] = std::make_shared<FdHandler>(std::move(handler));
+        return true;
+    }
+
+    bool modify_fd(int fd, uint32_t events) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fd_handlers.count(fd) && watch(fd, events, EPOLL_CTL_MOD);
+    }
+
+    // Call before closing fd
+    bool remove_fd(int fd) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fd_handlers.erase(fd)) return false;
+        return watch(fd, 0, EPOLL_CTL_DEL);
+    }
+
+    // Fires once, between delay and delay + slack from now
+    TimerId add_timer(Duration delay, TimerHandler handler, Duration slack = AUTO_SLACK) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TimerId id = next_timer++;
+        Timer& timer = timers[id];
+        timer = Timer{timesvc::precise_now() + delay, Duration::zero(), resolve_slack(delay, slack),
+                      std::make_shared<Callback>(std::move(handler))};
+        insert_locked(id, timer);
+        rearm_locked();
+        return id;
+    }
+
+    // Fires every period, each time within slack of being due
+    TimerId add_periodic(Duration period, TimerHandler handler, Duration slack = AUTO_SLACK) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TimerId id = next_timer++;
+        Timer& timer = timers[id];
+        timer = Timer{timesvc::precise_now() + period, period, resolve_slack(period, slack),
+                      std::make_shared<Callback>(std::move(handler))};
+        insert_locked(id, timer);
+        rearm_locked();
+        return id;
+    }
+
+    // A new period applies from now; false if the timer is gone
+    bool set_period(TimerId id, Duration period, Duration slack = AUTO_SLACK) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = timers.find(id);
+        if (it == timers.end()) return false;
+        Timer& timer = it->second;
+        if (timer.period == period) return true;
+        erase_locked(id, timer);
+        timer.period = period;
+        timer.slack = resolve_slack(period, slack);
+        timer.deadline = timesvc::precise_now() + period;
+        insert_locked(id, timer);
+        rearm_locked();
+        return true;
+    }
+
+    // A handler already running is not interrupted
+    bool cancel_timer(TimerId id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = timers.find(id);
+        if (it == timers.end()) return false;
+        it->second.callback->cancelled = true;
+        erase_locked(id, it->second);
+        timers.erase(it);
+        rearm_locked();
+        return true;
+    }
+
+    // Runs fn on the loop thread at its next wakeup
+    void post(std::function<void()> fn) { enqueue(std::move(fn), false); }
+
+    // Runs fn on the loop thread and returns once it has; inline from a
+    // handler, or while no thread runs the loop. Owners call it to take
+    // their fds and timers off the loop, after which none of their
+    // handlers is still running. Must not be called holding a lock those
+    // handlers take.
+    void call(const std::function<void()>& fn) {
+        if (in_loop_thread()) return fn();
+        std::promise<void> done;
+        bool queued = enqueue([&] {
+            try {
+                fn();
+                done.set_value();
+            } catch (...) {
+                done.set_exception(std::current_exception());
+            }
+        }, true);
+        if (!queued) return fn();
+        done.get_future().get();
+    }
+
+    // Delivers signo through the loop instead of an async handler. Only
+    // the calling thread is masked here; see block_signals().
+    bool on_signal(int signo, SignalHandler handler) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sigaddset(&signal_mask, signo);
+        if (::pthread_sigmask(SIG_BLOCK, &signal_mask, nullptr) != 0) return false;
+        bool fresh = signal_fd < 0;
+        int fd = ::signalfd(signal_fd, &signal_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (fd < 0) return false;
+        signal_fd = fd;
+        if (fresh && !watch(signal_fd, EPOLLIN, EPOLL_CTL_ADD)) return false;
+        signal_handlers[signo] = std::make_shared<SignalHandler>(std::move(handler));
+        return true;
+    }
+
+    // Drops signo's handler; the signal stays blocked and is discarded
+    bool remove_signal(int signo) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return signal_handlers.erase(signo) > 0;
+    }
+
+    ReactorStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return ReactorStats{wakeup_count, batch_count, fire_count, fd_event_count,
+                            posted_count, signal_count, error_count,
+                            std::chrono::microseconds(static_cast<int64_t>(avg_lateness_us)),
+                            std::chrono::microseconds(max_lateness_us),
+                            timers.size(), fd_handlers.size()};
+    }
+};
+
+} // namespace runtime
@@ -0,0 +1,180 @@
+#include "reactor.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <sys/eventfd.h>
+
+// Wakeups per second and reaction latency of the loops the daemon used to
+// run, one thread each sleeping a fixed interval and checking for work when
+// it wakes, against the same periods as timers on one runtime::Reactor,
+// with events arriving on an eventfd. Both see the same event schedule.
+//
+//   reactor_bench [seconds]
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+struct Loop {
+    const char* name;
+    std::chrono::milliseconds period;
+    bool takes_events;  // reacts to the driver's events
+};
+
+// The old sleep loops and their intervals
+static const Loop LOOPS[] = {
+    {"epoch", 500ms, false},
+    {"display", 1000ms, false},
+    {"storage", 60000ms, false},
+    {"intelligence", 100ms, false},
+    {"communication", 100ms, true},
+    {"mesh_receive", 100ms, false},
+    {"handshake_process", 100ms, false},
+};
+
+struct Result {
+    double wakeups_per_second;
+    double avg_latency_us;
+    double max_latency_us;
+    size_t events;
+};
+
+struct Latencies {
+    std::mutex mutex;
+    std::vector<double> us;
+
+    void record(Clock::time_point sent) {
+        double latency = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        us.push_back(latency);
+    }
+
+    void summarize(Result& result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        result.events = us.size();
+        double total = 0, worst = 0;
+        for (double v : us) {
+            total += v;
+            worst = std::max(worst, v);
+        }
+        result.avg_latency_us = us.empty() ? 0 : total / us.size();
+        result.max_latency_us = worst;
+    }
+};
+
+// Sends an event every 150-350 ms until stop, the same gaps each run
+template <typename Send>
+static void drive(std::atomic<bool>& stop, Send send) {
+    std::mt19937 rng(47);
+    std::uniform_int_distribution<int> gap(150, 350);
+    while (!stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(gap(rng)));
+        if (!stop) send();
+    }
+}
+
+static Result sleep_loops(std::chrono::seconds span) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> wakeups{0};
+    std::atomic<int64_t> pending{0};  // send time of an unhandled event, 0 for none
+    Latencies latencies;
+
+    std::vector<std::thread> threads;
+    for (const auto& loop : LOOPS) {
+        threads.emplace_back([&, loop] {
+            while (!stop) {
+                std::this_thread::sleep_for(loop.period);
+                wakeups++;
+                if (!loop.takes_events) continue;
+                int64_t sent = pending.exchange(0);
+                if (sent) latencies.record(Clock::time_point(Clock::duration(sent)));
+            }
+        });
+    }
+    std::thread driver([&] {
+        drive(stop, [&] { pending = Clock::now().time_since_epoch().count(); });
+    });
+
+    std::this_thread::sleep_for(span);
+    stop = true;
+    driver.join();
+    for (auto& thread : threads) thread.join();
+
+    Result result{};
+    result.wakeups_per_second = static_cast<double>(wakeups) / span.count();
+    latencies.summarize(result);
+    return result;
+}
+
+static Result one_reactor(std::chrono::seconds span, runtime::ReactorStats* stats) {
+    runtime::Reactor reactor;
+    CHECK(reactor.is_open(), "reactor set up");
+    std::atomic<int64_t> pending{0};
+    Latencies latencies;
+
+    int event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    reactor.add_fd(event_fd, EPOLLIN, [&](uint32_t) {
+        uint64_t count;
+        (void)::read(event_fd, &count, sizeof(count));
+        int64_t sent = pending.exchange(0);
+        if (sent) latencies.record(Clock::time_point(Clock::duration(sent)));
+    });
+    std::atomic<uint64_t> fires{0};
+    for (const auto& loop : LOOPS) {
+        reactor.add_periodic(loop.period, [&] { fires++; });
+    }
+    reactor.start();
+
+    std::atomic<bool> stop{false};
+    std::thread driver([&] {
+        drive(stop, [&] {
+            pending = Clock::now().time_since_epoch().count();
+            uint64_t one = 1;
+            (void)::write(event_fd, &one, sizeof(one));
+        });
+    });
+
+    std::this_thread::sleep_for(span);
+    stop = true;
+    driver.join();
+    reactor.call([&] { reactor.remove_fd(event_fd); });
+    *stats = reactor.stats();
+    reactor.stop();
+    ::close(event_fd);
+
+    Result result{};
+    result.wakeups_per_second = static_cast<double>(stats->wakeups) / span.count();
+    latencies.summarize(result);
+    CHECK(fires > 0, "timers fired");
+    return result;
+}
+
+static void report(const char* name, const Result& result) {
+    std::cout << "  " << std::left << std::setw(14) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(7) << result.wakeups_per_second << " wakeups/s, "
+              << result.events << " events, latency avg " << std::setw(9) << result.avg_latency_us
+              << " us, max " << std::setw(9) << result.max_latency_us << " us" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    const auto span = std::chrono::seconds(argc > 1 ? std::max(1, std::atoi(argv[1])) : 5);
+
+    Result sleeping = sleep_loops(span);
+    runtime::ReactorStats stats{};
+    Result reacting = one_reactor(span, &stats);
+
+    std::cout << LOOPS[0].name << ", " << LOOPS[1].name << " and " << std::size(LOOPS) - 2
+              << " more loops over " << span.count() << " s:\n";
+    report("sleep loops", sleeping);
+    report("one reactor", reacting);
+    std::cout << "  reactor: " << stats.timer_batches << " timer batches for " << stats.timer_fires
+              << " timer fires, lateness avg " << stats.avg_lateness.count() << " us, max "
+              << stats.max_lateness.count() << " us" << std::endl;
+
+    CHECK(sleeping.events > 0 && reacting.events > 0, "events handled in both runs");
+    CHECK(reacting.wakeups_per_second < sleeping.wakeups_per_second, "fewer wakeups on one reactor");
+    CHECK(reacting.avg_latency_us < sleeping.avg_latency_us, "events handled sooner on one reactor");
+    CHECK(stats.timer_batches < stats.timer_fires, "timers coalesced into shared wakeups");
+    CHECK(stats.errors == 0, "no handler errors");
+    return testing::finish("reactor_bench");
+}
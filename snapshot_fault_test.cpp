@@ -0,0 +1,125 @@
+#include "snapshot_writer.hpp"
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+// Fault injection for snapshot files: torn writes, truncation and bit
+// flips must be reported as CORRUPT or NOT_SNAPSHOT, never loaded, and
+// must leave the caller's previous state alone.
+//
+//   snapshot_fault_test [scratch_dir]
+
+static int failures = 0;
+
+#define CHECK(cond, what)                                            \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            std::cerr << "FAIL " << (what) << ": " #cond << std::endl; \
+            failures++;                                              \
+        }                                                            \
+    } while (0)
+
+static std::vector<uint8_t> read_bytes(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+static void write_bytes(const std::filesystem::path& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static bool rejected(persist::LoadStatus status) {
+    return status == persist::LoadStatus::CORRUPT || status == persist::LoadStatus::NOT_SNAPSHOT;
+}
+
+// Loads a damaged file into a caller state that holds `previous`
+static void expect_rejected(const std::filesystem::path& path, const std::vector<uint8_t>& damaged,
+                            const std::vector<uint8_t>& previous, const std::string& what) {
+    write_bytes(path, damaged);
+    persist::SnapshotWriter writer(path, 1);
+    std::vector<uint8_t> state = previous;
+    persist::LoadStatus status = writer.load(state);
+    CHECK(rejected(status), what + " (" + persist::to_string(status) + ")");
+    CHECK(state == previous, what + " kept previous state");
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path dir = argc > 1
+        ? std::filesystem::path(argv[1])
+        : std::filesystem::temp_directory_path() / ("snapshot_fault_test." + std::to_string(::getpid()));
+    std::filesystem::create_directories(dir);
+    auto path = dir / "state.bin";
+
+    std::vector<uint8_t> first, second;
+    for (int i = 0; i < 64; ++i) {
+        first.push_back(static_cast<uint8_t>(i));
+        second.push_back(static_cast<uint8_t>(255 - i));
+    }
+
+    // Round trip
+    {
+        persist::SnapshotWriter writer(path, 1);
+        CHECK(writer.submit(first), "initial write");
+        std::vector<uint8_t> loaded;
+        CHECK(persist::SnapshotWriter(path, 1).load(loaded) == persist::LoadStatus::OK, "round trip");
+        CHECK(loaded == first, "round trip payload");
+    }
+    const std::vector<uint8_t> good = read_bytes(path);
+
+    // Torn write: a crash before the rename leaves a partial temp file and
+    // the previous snapshot in place
+    {
+        auto temp = path;
+        temp += ".tmp";
+        auto next = persist::encode_snapshot(1, second.data(), second.size());
+        next.resize(next.size() / 2);
+        write_bytes(temp, next);
+        std::vector<uint8_t> loaded;
+        CHECK(persist::SnapshotWriter(path, 1).load(loaded) == persist::LoadStatus::OK, "torn write");
+        CHECK(loaded == first, "torn write keeps previous snapshot");
+        std::filesystem::remove(temp);
+    }
+
+    // Truncation at every length
+    for (size_t length = 0; length < good.size(); ++length) {
+        std::vector<uint8_t> damaged(good.begin(), good.begin() + length);
+        expect_rejected(path, damaged, second, "truncated to " + std::to_string(length));
+    }
+
+    // Every single-bit flip
+    for (size_t byte = 0; byte < good.size(); ++byte) {
+        for (int bit = 0; bit < 8; ++bit) {
+            std::vector<uint8_t> damaged = good;
+            damaged[byte] ^= static_cast<uint8_t>(1u << bit);
+            expect_rejected(path, damaged, second,
+                            "bit " + std::to_string(bit) + " of byte " + std::to_string(byte));
+        }
+    }
+
+    // A writer whose file went bad rewrites it on the next submit, even
+    // when the state equals what it last loaded
+    {
+        write_bytes(path, good);
+        persist::SnapshotWriter writer(path, 1);
+        std::vector<uint8_t> state;
+        CHECK(writer.load(state) == persist::LoadStatus::OK, "reload");
+        std::vector<uint8_t> damaged = good;
+        damaged.back() ^= 0x01;
+        write_bytes(path, damaged);
+        CHECK(writer.load(state) == persist::LoadStatus::CORRUPT, "reload corrupt");
+        CHECK(state == first, "reload corrupt kept previous state");
+        CHECK(writer.submit(state), "rewrite after corrupt load");
+        std::vector<uint8_t> loaded;
+        CHECK(persist::SnapshotWriter(path, 1).load(loaded) == persist::LoadStatus::OK, "repaired");
+        CHECK(loaded == first, "repaired payload");
+    }
+
+    std::filesystem::remove_all(dir);
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "snapshot fault injection: all checks passed" << std::endl;
+    return 0;
+}
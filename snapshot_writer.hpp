@@ -0,0 +1,304 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "crc32.hpp"
+#include "time_service.hpp"
+#include "write_scheduler.hpp"
+
+// Crash-safe state files. A snapshot is written to a temp file, fsynced,
+// renamed over the old one and the directory is fsynced, so after a power
+// loss the path holds either the previous or the new snapshot in full.
+namespace persist {
+
+enum class LoadStatus : uint8_t {
+    OK,
+    MISSING,           // no file at the path
+    NOT_SNAPSHOT,      // file exists but has no snapshot header (legacy format)
+    CORRUPT,           // bad header or payload CRC, or truncated
+    VERSION_MISMATCH   // valid snapshot written with another schema version
+};
+
+inline const char* to_string(LoadStatus status) {
+    switch (status) {
+        case LoadStatus::OK: return "ok";
+        case LoadStatus::MISSING: return "missing";
+        case LoadStatus::NOT_SNAPSHOT: return "not a snapshot";
+        case LoadStatus::CORRUPT: return "corrupt";
+        case LoadStatus::VERSION_MISMATCH: return "version mismatch";
+    }
+    return "unknown";
+}
+
+namespace detail {
+    constexpr uint32_t SNAPSHOT_MAGIC = 0x50414E53;  // "SNAP"
+    constexpr uint16_t FORMAT_VERSION = 1;
+
+    struct SnapshotHeader {
+        uint32_t magic;
+        uint16_t format_version;
+        uint16_t header_size;
+        uint32_t schema_version;  // owned by the caller, bumped on layout changes
+        uint32_t payload_length;
+        uint32_t payload_crc;
+        uint32_t header_crc;      // over the fields above
+    };
+    static_assert(sizeof(SnapshotHeader) == 24, "on-disk layout");
+
+    inline uint32_t header_crc(const SnapshotHeader& header) {
+        return checksum::crc32(&header, offsetof(SnapshotHeader, header_crc));
+    }
+
+    inline SnapshotHeader make_header(uint32_t schema_version, const void* payload, size_t length) {
+        SnapshotHeader header{SNAPSHOT_MAGIC, FORMAT_VERSION, sizeof(SnapshotHeader),
+                              schema_version, static_cast<uint32_t>(length),
+                              checksum::crc32(payload, length), 0};
+        header.header_crc = header_crc(header);
+        return header;
+    }
+}
+
+inline bool write_snapshot(const std::filesystem::path& path, uint32_t schema_version,
+                           const void* payload, size_t length) {
+    detail::SnapshotHeader header = detail::make_header(schema_version, payload, length);
+    return write_file_atomic(path, {{&header, sizeof(header)}, {payload, length}});
+}
+
+// The whole snapshot file as bytes, for handing to a WriteScheduler
+inline std::vector<uint8_t> encode_snapshot(uint32_t schema_version, const void* payload, size_t length) {
+    detail::SnapshotHeader header = detail::make_header(schema_version, payload, length);
+    std::vector<uint8_t> file(sizeof(header) + length);
+    std::memcpy(file.data(), &header, sizeof(header));
+    if (length > 0) std::memcpy(file.data() + sizeof(header), payload, length);
+    return file;
+}
+
+// Reads and verifies a snapshot; payload is only filled on OK
+inline LoadStatus read_snapshot(const std::filesystem::path& path, uint32_t schema_version,
+                                std::vector<uint8_t>& payload) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? LoadStatus::MISSING : LoadStatus::CORRUPT;
+
+    std::vector<uint8_t> contents;
+    uint8_t buffer[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            return LoadStatus::CORRUPT;
+        }
+        contents.insert(contents.end(), buffer, buffer + n);
+    }
+    ::close(fd);
+
+    detail::SnapshotHeader header;
+    if (contents.size() < sizeof(header)) {
+        return contents.size() >= 4 && std::memcmp(contents.data(), "SNAP", 4) == 0
+            ? LoadStatus::CORRUPT : LoadStatus::NOT_SNAPSHOT;
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    if (header.magic != detail::SNAPSHOT_MAGIC) return LoadStatus::NOT_SNAPSHOT;
+    if (header.header_crc != detail::header_crc(header) ||
+        header.format_version != detail::FORMAT_VERSION ||
+        header.header_size != sizeof(header) ||
+        contents.size() != sizeof(header) + header.payload_length) {
+        return LoadStatus::CORRUPT;
+    }
+
+    const uint8_t* body = contents.data() + sizeof(header);
+    if (checksum::crc32(body, header.payload_length) != header.payload_crc) {
+        return LoadStatus::CORRUPT;
+    }
+    if (header.schema_version != schema_version) return LoadStatus::VERSION_MISMATCH;
+
+    payload.assign(body, body + header.payload_length);
+    return LoadStatus::OK;
+}
+
+struct WriterStats {
+    uint64_t writes;
+    uint64_t unchanged;  // submissions identical to what is on disk
+    uint64_t coalesced;  // submissions superseded before they were written
+    uint64_t failures;
+};
+
+// Owns one snapshot file. Submissions identical to the last written state
+// are dropped, and writes are spaced at least min_interval apart; a change
+// inside the interval is held and replaced by any newer one until the next
+// submit() past the interval or flush(). With a scheduler set, writes are
+// queued there instead of being done on the caller's thread.
+class SnapshotWriter {
+private:
+    std::filesystem::path path;
+    uint32_t schema_version{1};
+    std::chrono::milliseconds min_interval{0};
+
+    WriteScheduler* scheduler{nullptr};
+    std::string subsystem;
+    Durability durability{Durability::NORMAL};
+    WriteScheduler::Ticket last_ticket{0};
+    std::shared_ptr<std::atomic<bool>> queued_write_failed{std::make_shared<std::atomic<bool>>(false)};
+
+    std::vector<uint8_t> written;  // what is on disk
+    std::vector<uint8_t> pending;
+    bool has_pending{false};
+    bool has_written{false};
+    timesvc::MonoTime last_write{};
+
+    WriterStats counters{0, 0, 0, 0};
+
+    // A queued write that failed leaves the disk behind `written`
+    bool check_queued_write() {
+        if (!queued_write_failed->exchange(false)) return true;
+        counters.failures++;
+        if (!has_pending) {
+            pending = written;
+            has_pending = true;
+        }
+        has_written = false;
+        return false;
+    }
+
+    bool write_pending(timesvc::MonoTime now) {
+        if (scheduler) {
+            auto failed = queued_write_failed;
+            last_ticket = scheduler->replace(
+                subsystem, path, encode_snapshot(schema_version, pending.data(), pending.size()),
+                durability, [failed](bool ok) { if (!ok) failed->store(true); });
+        } else if (!write_snapshot(path, schema_version, pending.data(), pending.size())) {
+            counters.failures++;
+            return false;  // keep it pending and retry on the next call
+        }
+        written.swap(pending);
+        pending.clear();
+        has_pending = false;
+        has_written = true;
+        last_write = now;
+        counters.writes++;
+        return true;
+    }
+
+public:
+    SnapshotWriter() = default;
+
+    SnapshotWriter(std::filesystem::path file, uint32_t version,
+                   std::chrono::milliseconds interval = std::chrono::milliseconds(0)) {
+        open(std::move(file), version, interval);
+    }
+
+    void open(std::filesystem::path file, uint32_t version,
+              std::chrono::milliseconds interval = std::chrono::milliseconds(0)) {
+        path = std::move(file);
+        schema_version = version;
+        min_interval = interval;
+        written.clear();
+        pending.clear();
+        has_pending = false;
+        has_written = false;
+    }
+
+    // Queue writes on scheduler under subsystem's account; null writes directly
+    void set_scheduler(WriteScheduler* writes, std::string name, Durability cls) {
+        scheduler = writes;
+        subsystem = std::move(name);
+        durability = cls;
+    }
+
+    const std::filesystem::path& get_path() const { return path; }
+
+    // Loads the current snapshot and remembers it as written, so an
+    // unchanged state after a restart is not rewritten. On failure payload
+    // is left as it was, and the next submit() rewrites the file.
+    LoadStatus load(std::vector<uint8_t>& payload) {
+        LoadStatus status = read_snapshot(path, schema_version, payload);
+        if (status == LoadStatus::OK) {
+            written = payload;
+            has_written = true;
+        } else {
+            has_written = false;
+        }
+        return status;
+    }
+
+    // Returns true if the payload was written to disk by this call
+    bool submit(std::vector<uint8_t> payload, timesvc::MonoTime now = timesvc::coarse_now()) {
+        check_queued_write();
+        if (has_written && payload == written) {
+            if (has_pending) counters.coalesced++;
+            has_pending = false;  // state went back to what is on disk
+            counters.unchanged++;
+            return false;
+        }
+        if (has_pending) counters.coalesced++;
+        pending = std::move(payload);
+        has_pending = true;
+
+        if (has_written && now - last_write < min_interval) return false;
+        return write_pending(now);
+    }
+
+    // Writes any held change immediately, e.g. on shutdown; with a
+    // scheduler this waits until the queued write is on disk
+    bool flush(timesvc::MonoTime now = timesvc::coarse_now()) {
+        if (has_pending && !write_pending(now)) return false;
+        if (!scheduler) return true;
+        scheduler->wait(last_ticket);
+        return check_queued_write();
+    }
+
+    bool has_unwritten() const { return has_pending; }
+    WriterStats stats() const { return counters; }
+};
+
+// Little helpers for explicit field-by-field payloads (host byte order)
+class ByteWriter {
+private:
+    std::vector<uint8_t> bytes;
+
+public:
+    template <typename T>
+    ByteWriter& put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "POD fields only");
+        const auto* p = reinterpret_cast<const uint8_t*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+        return *this;
+    }
+
+    std::vector<uint8_t> take() { return std::move(bytes); }
+};
+
+class ByteReader {
+private:
+    const std::vector<uint8_t>& bytes;
+    size_t offset{0};
+
+public:
+    explicit ByteReader(const std::vector<uint8_t>& data) : bytes(data) {}
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "POD fields only");
+        if (bytes.size() - offset < sizeof(T)) return false;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool at_end() const { return offset == bytes.size(); }
+};
+
+} // namespace persist
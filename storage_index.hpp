@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace storage {
+
+struct IndexStats {
+    size_t file_count;
+    uint64_t total_bytes;
+    uint64_t rescans;          // full directory scans since open()
+    uint64_t evictions;
+    uint64_t external_events;  // inotify events applied incrementally
+};
+
+// In-memory index of one capture directory: file sizes plus a min-heap on
+// modification time, so quota checks are O(1) and evicting the oldest file is
+// O(log n). The directory is scanned once in open(); afterwards writers report
+// their own files and inotify picks up changes made by anything else. A full
+// rescan only happens on request or when the kernel event queue overflows.
+class StorageIndex {
+private:
+    struct Entry {
+        uint64_t size;
+        int64_t mtime_ns;
+        uint64_t generation;  // matches the live heap node for this file
+    };
+
+    struct HeapNode {
+        int64_t mtime_ns;
+        uint64_t generation;
+        std::string name;
+
+        // std::*_heap builds a max-heap; invert so the oldest file is on top
+        bool operator<(const HeapNode& other) const {
+            return mtime_ns > other.mtime_ns;
+        }
+    };
+
+    std::filesystem::path root;
+    std::unordered_map<std::string, Entry> entries;
+    std::vector<HeapNode> heap;  // may hold stale nodes, skipped lazily
+    uint64_t total_bytes{0};
+    uint64_t next_generation{1};
+    mutable std::mutex mutex;
+
+    int inotify_fd{-1};
+    int watch_fd{-1};
+    bool needs_rescan{false};
+
+    uint64_t rescan_count{0};
+    uint64_t eviction_count{0};
+    uint64_t event_count{0};
+
+    static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                           IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    static int64_t to_ns(const struct timespec& ts) {
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    // One stat per file; false for anything that is not a regular file
+    bool stat_file(const std::string& name, uint64_t& size, int64_t& mtime_ns) const {
+        struct stat st;
+        if (::stat((root / name).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+        size = static_cast<uint64_t>(st.st_size);
+        mtime_ns = to_ns(st.st_mtim);
+        return true;
+    }
+
+    void upsert_locked(const std::string& name, uint64_t size, int64_t mtime_ns) {
+        uint64_t generation = next_generation++;
+        auto [it, inserted] = entries.try_emplace(name, Entry{size, mtime_ns, generation});
+        if (!inserted) {
+            // Our own writes come back through inotify; nothing to do then
+            if (it->second.size == size && it->second.mtime_ns == mtime_ns) return;
+            total_bytes -= it->second.size;
+            it->second = Entry{size, mtime_ns, generation};
+        }
+        total_bytes += size;
+
+        heap.push_back(HeapNode{mtime_ns, generation, name});
+        std::push_heap(heap.begin(), heap.end());
+        compact_locked();
+    }
+
+    void erase_locked(const std::string& name) {
+        auto it = entries.find(name);
+        if (it == entries.end()) return;
+        total_bytes -= it->second.size;
+        entries.erase(it);
+        // The heap node goes stale and is dropped when it reaches the top
+        compact_locked();
+    }
+
+    // Rebuild when stale nodes dominate so the heap stays O(live files)
+    void compact_locked() {
+        if (heap.size() <= 2 * entries.size() + 64) return;
+        rebuild_heap_locked();
+    }
+
+    void rebuild_heap_locked() {
+        heap.clear();
+        heap.reserve(entries.size());
+        for (const auto& [name, entry] : entries) {
+            heap.push_back(HeapNode{entry.mtime_ns, entry.generation, name});
+        }
+        std::make_heap(heap.begin(), heap.end());
+    }
+
+    bool is_live(const HeapNode& node) const {
+        auto it = entries.find(node.name);
+        return it != entries.end() && it->second.generation == node.generation;
+    }
+
+    void rescan_locked() {
+        entries.clear();
+        total_bytes = 0;
+
+        std::error_code ec;
+        for (const auto& dirent : std::filesystem::directory_iterator(root, ec)) {
+            std::string name = dirent.path().filename().string();
+            uint64_t size;
+            int64_t mtime_ns;
+            if (stat_file(name, size, mtime_ns)) {
+                entries.emplace(name, Entry{size, mtime_ns, next_generation++});
+                total_bytes += size;
+            }
+        }
+
+        rebuild_heap_locked();
+        needs_rescan = false;
+        rescan_count++;
+    }
+
+    void close_watch() {
+        if (inotify_fd >= 0) {
+            ::close(inotify_fd);
+        }
+        inotify_fd = -1;
+        watch_fd = -1;
+    }
+
+public:
+    StorageIndex() = default;
+
+    ~StorageIndex() {
+        close_watch();
+    }
+
+    StorageIndex(const StorageIndex&) = delete;
+    StorageIndex& operator=(const StorageIndex&) = delete;
+
+    // Starts watching dir and builds the index. Without inotify the index
+    // still works, it just won't notice files changed by other processes.
+    bool open(const std::filesystem::path& dir) {
+        std::lock_guard<std::mutex> lock(mutex);
+        close_watch();
+        root = dir;
+
+        inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd >= 0) {
+            watch_fd = ::inotify_add_watch(inotify_fd, root.c_str(), WATCH_MASK);
+            if (watch_fd < 0) {
+                close_watch();
+            }
+        }
+
+        rescan_locked();
+        return watch_fd >= 0;
+    }
+
+    // Full directory scan, for callers that know the index is out of date
+    void rescan() {
+        std::lock_guard<std::mutex> lock(mutex);
+        rescan_locked();
+    }
+
+    // Called by writers after a file in the directory is closed
+    void record_write(const std::filesystem::path& path) {
+        std::string name = path.filename().string();
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t size;
+        int64_t mtime_ns;
+        if (stat_file(name, size, mtime_ns)) {
+            upsert_locked(name, size, mtime_ns);
+        } else {
+            erase_locked(name);
+        }
+    }
+
+    void record_remove(const std::filesystem::path& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        erase_locked(path.filename().string());
+    }
+
+    // Applies pending inotify events without blocking. Each event costs one
+    // stat; only an overflowed queue or a vanished directory forces a rescan.
+    void poll_changes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (inotify_fd < 0) return;
+
+        alignas(struct inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t len = ::read(inotify_fd, buffer, sizeof(buffer));
+            if (len <= 0) break;
+
+            for (char* p = buffer; p < buffer + len; ) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    needs_rescan = true;
+                    continue;
+                }
+                if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+
+                std::string name(event->name);
+                uint64_t size;
+                int64_t mtime_ns;
+                if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+                    stat_file(name, size, mtime_ns)) {
+                    upsert_locked(name, size, mtime_ns);
+                } else {
+                    erase_locked(name);
+                }
+                event_count++;
+            }
+        }
+
+        if (needs_rescan) {
+            rescan_locked();
+        }
+    }
+
+    // Path of the oldest indexed file, empty if the directory is empty
+    std::filesystem::path oldest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!heap.empty() && !is_live(heap.front())) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+        return heap.empty() ? std::filesystem::path() : root / heap.front().name;
+    }
+
+    // Deletes oldest files until both limits hold (0 disables a limit).
+    // Returns the number of files removed.
+    size_t enforce(uint64_t max_bytes, size_t max_files,
+                   const std::function<void(const std::filesystem::path&)>& on_evict = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t removed = 0;
+
+        auto over_limit = [&] {
+            return (max_bytes && total_bytes > max_bytes) ||
+                   (max_files && entries.size() > max_files);
+        };
+
+        while (over_limit() && !heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end());
+            HeapNode node = std::move(heap.back());
+            heap.pop_back();
+            if (!is_live(node)) continue;
+
+            std::filesystem::path path = root / node.name;
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            erase_locked(node.name);
+            eviction_count++;
+            removed++;
+            if (on_evict) on_evict(path);
+        }
+        return removed;
+    }
+
+    uint64_t total_size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total_bytes;
+    }
+
+    size_t file_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    bool is_watching() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return watch_fd >= 0;
+    }
+
+    IndexStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return IndexStats{entries.size(), total_bytes, rescan_count,
+                          eviction_count, event_count};
+    }
+};
+
+} // namespace storage
@@ -4,18 +4,27 @@
 #include <fstream>
 #include <memory>
 #include <map>
+#include <set>
 #include <vector>
 #include <filesystem>
 #include <atomic>
+#include <mutex>
+#include <cctype>
+#include "config_store.hpp"
+#include "cpufreq_controller.hpp"
+#include "power_telemetry.hpp"
+#include "energy_scheduler.hpp"
+#include "storage_index.hpp"
+#include "logger.hpp"
+#include "lz_codec.hpp"
+#include "write_scheduler.hpp"
 
 namespace fs = std::filesystem;
 
 class SystemConfig {
 public:
-    // Storage management
-    static constexpr uint64_t MIN_FREE_SPACE = 100 * 1024 * 1024;  // 100MB minimum free space
-    static constexpr uint64_t LOG_ROTATE_SIZE = 50 * 1024 * 1024;  // 50MB log rotation
-    static constexpr uint32_t MAX_CAPTURE_FILES = 1000;            // Maximum handshake files
+    // Storage management; free space, log size and capture limits are in config::Settings
+    static constexpr uint32_t MAX_LOG_GENERATIONS = 5;             // Compressed rotations kept per log
     
     // Display configurations
     enum class DisplayMode {
@@ -47,14 +56,29 @@ private:
     DisplayConfig display_config;
     SystemPaths paths;
     std::atomic<bool> low_power_mode{false};
-    std::atomic<uint8_t> cpu_governor{0};  // 0=powersave, 1=ondemand, 2=performance
+
+    // Battery/thermal sampling and the frequency controller it feeds
+    power::Telemetry telemetry;
+    power::CpuFreqController cpufreq;
     
     // Storage monitoring
     std::atomic<uint64_t> free_space{0};
     std::atomic<bool> storage_warning{false};
 
-    // Configuration file handling
-    std::map<std::string, std::string> config_values;
+    // Capture directory index, kept current instead of rescanning
+    storage::StorageIndex capture_index;
+
+    // Compresses rotated logs off the main thread
+    compress::BackgroundCompressor log_compressor;
+    std::mutex rotate_mutex;  // the logger and the storage check both rotate
+    std::set<fs::path> compressing;  // staged logs with a job queued or running; rotate_mutex
+
+    // Typed config.txt snapshot, reloaded when the file changes
+    config::ConfigStore settings_store;
+
+    // Shared by everything that writes to the card; declared last so it
+    // is stopped, writing out what is queued, before the rest goes away
+    persist::WriteScheduler write_scheduler;
     
     void initializePaths() {
         // Set up directory structure for SD card
@@ -70,12 +94,123 @@ private:
                                paths.logs, paths.models, paths.plugins}) {
             fs::create_directories(path);
         }
+
+        capture_index.open(paths.captures);
+        log_compressor.start();
+        resumeStagedLogs();
+    }
+
+    // A .1 left by a crash, a failed compression or a shutdown with the
+    // job still queued is compressed again
+    void resumeStagedLogs() {
+        std::lock_guard<std::mutex> lock(rotate_mutex);
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(paths.logs, ec)) {
+            const auto& staged = entry.path();
+            if (staged.extension() == ".1" && entry.is_regular_file(ec)) {
+                compressStaged(staged.parent_path() / staged.stem(), staged);
+            }
+        }
+    }
+
+    static fs::path generationPath(const fs::path& log, uint32_t generation) {
+        return fs::path(log.string() + "." + std::to_string(generation) + ".lz");
+    }
+
+    // rotate_mutex held. On failure log.1 stays and is retried by the
+    // next rotation or at startup
+    void compressStaged(const fs::path& log, const fs::path& staged) {
+        if (!compressing.insert(staged).second) return;
+        log_compressor.submit(staged, generationPath(log, 1),
+                              [this, staged](bool ok, const compress::CodecStats&) {
+                                  std::lock_guard<std::mutex> lock(rotate_mutex);
+                                  compressing.erase(staged);
+                                  if (ok) {
+                                      std::error_code remove_ec;
+                                      fs::remove(staged, remove_ec);
+                                  }
+                              });
+    }
+
+    // Appends the live log to a staged one, keeping lines in order
+    static bool appendLog(const fs::path& log, const fs::path& staged) {
+        std::error_code ec;
+        if (fs::file_size(log, ec) == 0 || ec) return true;  // nothing to fold in
+        std::ifstream in(log, std::ios::binary);
+        std::ofstream out(staged, std::ios::binary | std::ios::app);
+        out << in.rdbuf();
+        out.flush();
+        if (!in || !out) return false;
+        fs::remove(log, ec);
+        return !ec;
+    }
+
+    // log -> log.1 (compressed in the background to log.1.lz); older
+    // generations shift up by one and the oldest is deleted
+    void rotateLog(const fs::path& log) {
+        std::lock_guard<std::mutex> lock(rotate_mutex);
+        std::error_code ec;
+        fs::path staged = log.string() + ".1";
+        if (compressing.count(staged)) return;  // previous rotation still compressing
+
+        if (fs::exists(staged, ec)) {
+            // Its compression failed or never ran; the generations were
+            // already shifted for it, so fold the live log in and retry
+            if (!appendLog(log, staged)) return;
+        } else {
+            fs::remove(generationPath(log, MAX_LOG_GENERATIONS), ec);
+            for (uint32_t g = MAX_LOG_GENERATIONS - 1; g >= 1; --g) {
+                if (fs::exists(generationPath(log, g), ec)) {
+                    fs::rename(generationPath(log, g), generationPath(log, g + 1), ec);
+                }
+            }
+
+            fs::rename(log, staged, ec);
+            if (ec) return;
+        }
+        compressStaged(log, staged);
     }
 
 public:
     SystemConfig() {
         initializePaths();
         loadConfig();
+        write_scheduler.start(writeSchedulerConfig(*settings_store.current()));
+
+        logging::Config log_config;
+        log_config.path = paths.logs / "pwnagotchi.log";
+        log_config.writes = &write_scheduler;
+        log_config.rotate_bytes = settings_store.current()->log_rotate_mb << 20;
+        log_config.min_level = settings_store.current()->log_level;
+        log_config.rotate = [this](const fs::path& log) { rotateLog(log); };
+        logging::start(log_config);
+
+        // Tuning that applies while running; the rest is read per use
+        settings_store.subscribe({"write_normal_ms", "write_lazy_ms", "write_block_size"},
+                                 [this](const config::Settings& settings) {
+                                     write_scheduler.configure(writeSchedulerConfig(settings));
+                                 });
+        settings_store.subscribe({"log_level", "log_rotate_mb"}, [](const config::Settings& settings) {
+            logging::logger().set_level(settings.log_level);
+            logging::logger().set_rotate_bytes(settings.log_rotate_mb << 20);
+        });
+        settings_store.start_watching();
+
+        telemetry.start();
+        cpufreq.attach(&telemetry);
+        cpufreq.start();
+        runtime::EnergyScheduler::shared().attach(&telemetry);
+    }
+
+    // Subscribers reach into write_scheduler and the logger; the logger
+    // writes through write_scheduler and rotates through us
+    ~SystemConfig() {
+        runtime::EnergyScheduler::shared().attach(nullptr);
+        cpufreq.stop();
+        settings_store.stop_watching();
+        logging::stop();
+        // Its callbacks use rotate_mutex, which is destroyed first
+        log_compressor.stop();
     }
 
     bool initializeDisplay(DisplayMode mode = DisplayMode::AUTO) {
@@ -112,19 +247,15 @@ public:
         return true;
     }
 
-    // Storage management
+    // Storage management. Only measures; on a warning the caller runs
+    // cleanupOldFiles() as background work, one pass at a time
     bool checkStorage() {
         std::error_code ec;
         auto space = fs::space(paths.root, ec);
         if (ec) return false;
 
         free_space = space.available;
-        storage_warning = (free_space < MIN_FREE_SPACE);
-
-        if (storage_warning) {
-            cleanupOldFiles();
-        }
-
+        storage_warning = (free_space < (settings_store.current()->min_free_mb << 20));
         return !storage_warning;
     }
 
@@ -137,82 +268,94 @@ public:
     }
 
     void rotateLogFiles() {
-        for (const auto& entry : fs::directory_iterator(paths.logs)) {
-            if (fs::file_size(entry) > LOG_ROTATE_SIZE) {
-                std::string filename = entry.path().string();
-                std::string new_name = filename + ".1";
-                fs::rename(filename, new_name);
+        // Collect first; rotating renames entries in the directory being iterated
+        std::vector<fs::path> oversized;
+        uint64_t rotate_bytes = settings_store.current()->log_rotate_mb << 20;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(paths.logs, ec)) {
+            auto ext = entry.path().extension().string();
+            bool rotated = ext == ".lz" || ext == ".tmp" ||
+                           (ext.size() > 1 && std::isdigit(static_cast<unsigned char>(ext[1])));
+            if (!rotated && entry.is_regular_file(ec) && entry.file_size(ec) > rotate_bytes) {
+                oversized.push_back(entry.path());
             }
         }
+
+        for (const auto& log : oversized) {
+            rotateLog(log);
+        }
+    }
+
+    compress::CompressorStats getLogCompressionStats() {
+        return log_compressor.stats();
     }
 
     void cleanupCaptures() {
-        std::vector<fs::path> captures;
-        for (const auto& entry : fs::directory_iterator(paths.captures)) {
-            captures.push_back(entry.path());
-        }
+        // Remove oldest captures beyond max_capture_files
+        uint32_t max_files = settings_store.current()->max_capture_files;
+        capture_index.poll_changes();
+        capture_index.enforce(0, max_files);
+    }
 
-        if (captures.size() > MAX_CAPTURE_FILES) {
-            // Sort by modification time
-            std::sort(captures.begin(), captures.end(), 
-                     [](const fs::path& a, const fs::path& b) {
-                         return fs::last_write_time(a) < fs::last_write_time(b);
-                     });
-
-            // Remove oldest files
-            size_t to_remove = captures.size() - MAX_CAPTURE_FILES;
-            for (size_t i = 0; i < to_remove; ++i) {
-                fs::remove(captures[i]);
-            }
-        }
+    // Writers call this after closing a file in the captures directory
+    void recordCapture(const fs::path& file) {
+        capture_index.record_write(file);
     }
 
-    // Power management
-    void setLowPowerMode(bool enabled) {
-        low_power_mode = enabled;
-        if (enabled) {
-            cpu_governor = 0;  // powersave
-        } else {
-            cpu_governor = 1;  // ondemand
-        }
-        updateCPUGovernor();
+    void rescanCaptures() {
+        capture_index.rescan();
     }
 
-    void updateCPUGovernor() {
-        std::string governor;
-        switch (cpu_governor) {
-            case 0: governor = "powersave"; break;
-            case 1: governor = "ondemand"; break;
-            case 2: governor = "performance"; break;
-            default: governor = "ondemand";
-        }
+    storage::IndexStats getCaptureStats() const {
+        return capture_index.stats();
+    }
 
-        // Write to scaling_governor
-        std::ofstream gov_file("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
-        if (gov_file.is_open()) {
-            gov_file << governor;
-        }
+    // Power management; the controller applies it to every core
+    void setLowPowerMode(bool enabled) {
+        low_power_mode = enabled;
+        power::Policy policy = cpufreq.get_policy();
+        policy.low_power = enabled;
+        cpufreq.set_policy(policy);
     }
 
+    power::CpuFreqController& getCpuFreq() { return cpufreq; }
+    const power::Telemetry& getTelemetry() const { return telemetry; }
+
     // Configuration management
     void loadConfig() {
-        std::ifstream config_file(paths.config / "config.txt");
-        std::string line;
-        while (std::getline(config_file, line)) {
-            size_t pos = line.find('=');
-            if (pos != std::string::npos) {
-                std::string key = line.substr(0, pos);
-                std::string value = line.substr(pos + 1);
-                config_values[key] = value;
-            }
+        for (const auto& error : settings_store.open(paths.config / "config.txt")) {
+            logging::warn("config.txt: {}", error);
         }
     }
 
     void saveConfig() {
-        std::ofstream config_file(paths.config / "config.txt");
-        for (const auto& [key, value] : config_values) {
-            config_file << key << "=" << value << "\n";
-        }
+        settings_store.save(&write_scheduler);
+    }
+
+    static persist::WriteScheduler::Config writeSchedulerConfig(const config::Settings& settings) {
+        persist::WriteScheduler::Config scheduler_config;
+        scheduler_config.normal_interval = std::chrono::milliseconds(settings.write_normal_ms);
+        scheduler_config.lazy_interval = std::chrono::milliseconds(settings.write_lazy_ms);
+        scheduler_config.block_size = settings.write_block_size;
+        return scheduler_config;
+    }
+
+    config::ConfigStore& getConfigStore() { return settings_store; }
+
+    // Pin briefly and copy out what is needed
+    config::ConfigStore::ReadGuard getSettings() const { return settings_store.current(); }
+
+    // Display refresh in Hz: display_refresh_hz if set, else the mode's own
+    uint32_t getRefreshRate() const {
+        uint32_t hz = settings_store.current()->display_refresh_hz;
+        if (hz == 0) hz = display_config.refresh_rate;
+        return hz > 0 ? hz : 1;
+    }
+
+    persist::WriteScheduler& getWriteScheduler() { return write_scheduler; }
+
+    persist::SchedulerStats getWriteStats() const {
+        return write_scheduler.stats();
     }
 
     // Getters
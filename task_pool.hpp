@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "logger.hpp"
+
+// Work-stealing executor for background work. One worker per core, each
+// with a deque per priority: a worker runs its own tasks oldest first,
+// and when it runs dry steals the newest from the back of the others'.
+// Priorities are strict across the pool, so a worker steals HIGH work
+// before running its own LOW work. Tasks submitted from a worker stay on
+// that worker; from any other thread they are spread round-robin.
+namespace runtime {
+
+enum class Priority : uint8_t {
+    HIGH,    // latency matters: capture processing, scoring
+    NORMAL,  // default
+    LOW      // training, compression, cleanup
+};
+
+constexpr size_t PRIORITY_LEVELS = 3;
+
+inline const char* to_string(Priority priority) {
+    switch (priority) {
+        case Priority::HIGH: return "high";
+        case Priority::NORMAL: return "normal";
+        case Priority::LOW: return "low";
+    }
+    return "unknown";
+}
+
+enum class TaskStatus : uint8_t {
+    QUEUED,
+    RUNNING,
+    DONE,
+    CANCELLED,  // never started
+    FAILED      // threw
+};
+
+namespace detail {
+
+struct TaskState {
+    std::atomic<TaskStatus> status{TaskStatus::QUEUED};
+    std::atomic<bool> cancel_requested{false};
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    void finish(TaskStatus final_status) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            status = final_status;
+        }
+        cv.notify_all();
+    }
+
+    bool finished() const {
+        TaskStatus s = status.load();
+        return s != TaskStatus::QUEUED && s != TaskStatus::RUNNING;
+    }
+};
+
+} // namespace detail
+
+// Lets a long task notice cancel() or a cancelling shutdown and return early
+class CancelToken {
+    const detail::TaskState* state;
+    const std::atomic<bool>* pool_cancelled;
+
+public:
+    CancelToken(const detail::TaskState* s, const std::atomic<bool>* pool)
+        : state(s), pool_cancelled(pool) {}
+
+    bool cancelled() const {
+        return state->cancel_requested.load(std::memory_order_relaxed) ||
+               pool_cancelled->load(std::memory_order_relaxed);
+    }
+};
+
+class TaskHandle {
+    friend class TaskPool;
+    std::shared_ptr<detail::TaskState> state;
+
+public:
+    TaskHandle() = default;
+    explicit TaskHandle(std::shared_ptr<detail::TaskState> s) : state(std::move(s)) {}
+
+    bool valid() const { return state != nullptr; }
+
+    bool operator==(const TaskHandle& other) const { return state == other.state; }
+
+    TaskStatus status() const { return state ? state->status.load() : TaskStatus::CANCELLED; }
+
+    bool finished() const { return !state || state->finished(); }
+
+    // A queued task will not start; a running one sees its token cancelled.
+    // True if the task had not started.
+    bool cancel() {
+        if (!state) return false;
+        state->cancel_requested = true;
+        TaskStatus expected = TaskStatus::QUEUED;
+        if (!state->status.compare_exchange_strong(expected, TaskStatus::CANCELLED)) return false;
+        state->finish(TaskStatus::CANCELLED);
+        return true;
+    }
+
+    // Blocks until the task is over; true if it ran to completion. Do not
+    // wait from a task on one that may be queued behind it.
+    bool wait() const {
+        if (!state) return false;
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [this] { return state->finished(); });
+        return state->status == TaskStatus::DONE;
+    }
+
+    template <typename Rep, typename Period>
+    bool wait_for(std::chrono::duration<Rep, Period> timeout) const {
+        if (!state) return true;
+        std::unique_lock<std::mutex> lock(state->mutex);
+        return state->cv.wait_for(lock, timeout, [this] { return state->finished(); });
+    }
+};
+
+struct TaskPoolStats {
+    size_t workers;
+    size_t queued;
+    size_t running;
+    uint64_t submitted;
+    uint64_t executed;
+    uint64_t stolen;     // run by a worker other than the one queued on
+    uint64_t cancelled;
+    uint64_t failed;
+    std::array<uint64_t, PRIORITY_LEVELS> executed_by_priority;
+};
+
+class TaskPool {
+public:
+    enum class Shutdown : uint8_t {
+        DRAIN,  // run everything already queued
+        CANCEL  // drop queued tasks, cancel the tokens of running ones
+    };
+
+private:
+    struct Task {
+        std::function<void(const CancelToken&)> fn;
+        std::shared_ptr<detail::TaskState> state;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::array<std::deque<Task>, PRIORITY_LEVELS> queues;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> next_worker{0};
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> running_count{0};
+    std::atomic<bool> accepting{true};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> cancelled{false};
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+
+    std::atomic<uint64_t> submitted_count{0};
+    std::atomic<uint64_t> executed_count{0};
+    std::atomic<uint64_t> stolen_count{0};
+    std::atomic<uint64_t> cancelled_count{0};
+    std::atomic<uint64_t> failed_count{0};
+    std::array<std::atomic<uint64_t>, PRIORITY_LEVELS> executed_by_priority{};
+
+    static inline thread_local TaskPool* current_pool = nullptr;
+    static inline thread_local size_t current_index = 0;
+
+    bool take(size_t self, Task& out, size_t& level) {
+        size_t n = workers.size();
+        for (level = 0; level < PRIORITY_LEVELS; ++level) {
+            {
+                Worker& own = *workers[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                auto& queue = own.queues[level];
+                if (!queue.empty()) {
+                    out = std::move(queue.front());
+                    queue.pop_front();
+                    return true;
+                }
+            }
+            for (size_t k = 1; k < n; ++k) {
+                Worker& victim = *workers[(self + k) % n];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                auto& queue = victim.queues[level];
+                if (!queue.empty()) {
+                    out = std::move(queue.back());
+                    queue.pop_back();
+                    stolen_count.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void execute(Task& task, size_t level) {
+        TaskStatus expected = TaskStatus::QUEUED;
+        if (!task.state->status.compare_exchange_strong(expected, TaskStatus::RUNNING)) {
+            return;  // cancelled while queued; cancel() already finished it
+        }
+        running_count++;
+        CancelToken token(task.state.get(), &cancelled);
+        TaskStatus result = TaskStatus::DONE;
+        try {
+            task.fn(token);
+        } catch (const std::exception& e) {
+            logging::error("Background task failed: {}", e.what());
+            result = TaskStatus::FAILED;
+            failed_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        running_count--;
+        executed_count.fetch_add(1, std::memory_order_relaxed);
+        executed_by_priority[level].fetch_add(1, std::memory_order_relaxed);
+        task.state->finish(result);
+    }
+
+    void run(size_t self) {
+        current_pool = this;
+        current_index = self;
+        while (true) {
+            Task task;
+            size_t level;
+            if (take(self, task, level)) {
+                pending--;
+                if (cancelled) {
+                    TaskStatus expected = TaskStatus::QUEUED;
+                    if (task.state->status.compare_exchange_strong(expected, TaskStatus::CANCELLED)) {
+                        task.state->finish(TaskStatus::CANCELLED);
+                    }
+                }
+                if (task.state->status == TaskStatus::CANCELLED) {
+                    cancelled_count.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                execute(task, level);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            idle_cv.wait(lock, [this] { return pending > 0 || stopping; });
+            if (stopping && pending == 0) break;
+        }
+        current_pool = nullptr;
+    }
+
+    void push(Priority priority, Task task) {
+        size_t n = workers.size();
+        size_t index = current_pool == this ? current_index
+                                            : next_worker.fetch_add(1, std::memory_order_relaxed) % n;
+        // Counted first so a worker that takes it never sees pending wrap
+        pending++;
+        {
+            Worker& worker = *workers[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.queues[static_cast<size_t>(priority)].push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+        }
+        idle_cv.notify_one();
+    }
+
+public:
+    // One worker per core unless told otherwise
+    explicit TaskPool(size_t worker_count = 0) {
+        if (worker_count == 0) worker_count = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < worker_count; ++i) workers.push_back(std::make_unique<Worker>());
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers[i]->thread = std::thread(&TaskPool::run, this, i);
+        }
+    }
+
+    ~TaskPool() { shutdown(Shutdown::CANCEL); }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Process-wide pool for components that are not handed one
+    static TaskPool& shared() {
+        static TaskPool pool;
+        return pool;
+    }
+
+    TaskHandle submit(Priority priority, std::function<void(const CancelToken&)> fn) {
+        auto state = std::make_shared<detail::TaskState>();
+        if (!accepting) {
+            state->status = TaskStatus::CANCELLED;
+            cancelled_count.fetch_add(1, std::memory_order_relaxed);
+            return TaskHandle(state);
+        }
+        submitted_count.fetch_add(1, std::memory_order_relaxed);
+        push(priority, Task{std::move(fn), state});
+        return TaskHandle(state);
+    }
+
+    TaskHandle submit(Priority priority, std::function<void()> fn) {
+        return submit(priority, [fn = std::move(fn)](const CancelToken&) { fn(); });
+    }
+
+    // Queues fn under a handle given out before the work reached the pool,
+    // for callers that hold work back. A handle cancelled meanwhile is
+    // returned as is.
+    TaskHandle submit(Priority priority, TaskHandle handle, std::function<void(const CancelToken&)> fn) {
+        if (!handle.state) handle.state = std::make_shared<detail::TaskState>();
+        if (handle.state->status != TaskStatus::QUEUED) return handle;
+        if (!accepting) {
+            TaskStatus expected = TaskStatus::QUEUED;
+            if (handle.state->status.compare_exchange_strong(expected, TaskStatus::CANCELLED)) {
+                handle.state->finish(TaskStatus::CANCELLED);
+            }
+            cancelled_count.fetch_add(1, std::memory_order_relaxed);
+            return handle;
+        }
+        submitted_count.fetch_add(1, std::memory_order_relaxed);
+        push(priority, Task{std::move(fn), handle.state});
+        return handle;
+    }
+
+    // Runs fn(i) for i in [0, count) across the pool; the caller takes a
+    // share too, so this is safe from inside a task
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn,
+                      Priority priority = Priority::NORMAL) {
+        if (count == 0) return;
+        auto next = std::make_shared<std::atomic<size_t>>(0);
+        auto body = [next, count, &fn] {
+            for (size_t i = next->fetch_add(1); i < count; i = next->fetch_add(1)) fn(i);
+        };
+        size_t helpers = std::min(count, workers.size()) - (current_pool == this ? 1 : 0);
+        std::vector<TaskHandle> handles;
+        for (size_t i = 0; i < helpers && i + 1 < count; ++i) handles.push_back(submit(priority, body));
+        body();
+        // Helpers that never started have nothing left to do
+        for (auto& handle : handles) {
+            if (!handle.cancel()) handle.wait();
+        }
+    }
+
+    // Stops accepting work and joins the workers. Safe to call twice.
+    void shutdown(Shutdown mode = Shutdown::DRAIN) {
+        accepting = false;
+        if (mode == Shutdown::CANCEL) cancelled = true;
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            stopping = true;
+        }
+        idle_cv.notify_all();
+        for (auto& worker : workers) {
+            if (worker->thread.joinable() && worker->thread.get_id() != std::this_thread::get_id()) {
+                worker->thread.join();
+            }
+        }
+    }
+
+    size_t worker_count() const { return workers.size(); }
+
+    // True on one of this pool's workers
+    bool in_worker() const { return current_pool == this; }
+
+    TaskPoolStats stats() const {
+        TaskPoolStats s{};
+        s.workers = workers.size();
+        s.queued = pending.load();
+        s.running = running_count.load();
+        s.submitted = submitted_count.load();
+        s.executed = executed_count.load();
+        s.stolen = stolen_count.load();
+        s.cancelled = cancelled_count.load();
+        s.failed = failed_count.load();
+        for (size_t i = 0; i < PRIORITY_LEVELS; ++i) s.executed_by_priority[i] = executed_by_priority[i].load();
+        return s;
+    }
+};
+
+} // namespace runtime
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Shared by the test and benchmark executables; built with -fno-exceptions,
+// so checks count failures instead of throwing
+namespace testing {
+
+inline int& failure_count() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond, what)                                                   \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            std::cerr << "FAIL " << (what) << ": " #cond << std::endl;      \
+            ::testing::failure_count()++;                                   \
+        }                                                                   \
+    } while (0)
+
+// Exit status for main: prints the outcome under name
+inline int finish(const std::string& name) {
+    if (failure_count()) {
+        std::cerr << name << ": " << failure_count() << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << name << ": all checks passed" << std::endl;
+    return 0;
+}
+
+// Keeps a benchmark result alive without a volatile store per call
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Mean wall time per call of fn over runs calls
+template <typename Fn>
+double ns_per_call(size_t runs, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; ++i) fn(i);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+} // namespace testing
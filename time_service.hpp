@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Shared time source. Hot paths read a coarse monotonic tick that the main
+// loops refresh once per iteration, which costs one atomic load instead of a
+// clock read. Monotonic time is immune to NTP steps after boot; wall-clock
+// time is only produced through explicit conversion for persisted or
+// transmitted timestamps.
+namespace timesvc {
+
+using MonoClock = std::chrono::steady_clock;
+using MonoTime = MonoClock::time_point;
+using WallClock = std::chrono::system_clock;
+using WallTime = WallClock::time_point;
+
+namespace detail {
+    inline std::atomic<int64_t> coarse_ns{0};
+    inline std::atomic<int64_t> wall_offset_ns{0};  // wall - mono at last tick
+
+    inline int64_t mono_ns(MonoTime t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            t.time_since_epoch()).count();
+    }
+}
+
+// Precise monotonic time, for measuring durations
+inline MonoTime precise_now() {
+    return MonoClock::now();
+}
+
+// Refreshes the coarse tick and the wall-clock offset; call once per loop
+inline MonoTime tick() {
+    MonoTime mono = MonoClock::now();
+    WallTime wall = WallClock::now();
+    int64_t mono_ns = detail::mono_ns(mono);
+    int64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        wall.time_since_epoch()).count();
+    detail::wall_offset_ns.store(wall_ns - mono_ns, std::memory_order_relaxed);
+    detail::coarse_ns.store(mono_ns, std::memory_order_release);
+    return mono;
+}
+
+// Monotonic time as of the last tick()
+inline MonoTime coarse_now() {
+    int64_t ns = detail::coarse_ns.load(std::memory_order_acquire);
+    if (ns == 0) return tick();
+    return MonoTime(std::chrono::duration_cast<MonoClock::duration>(
+        std::chrono::nanoseconds(ns)));
+}
+
+// Converts a monotonic time point to wall-clock time using the offset
+// sampled at the last tick, so an NTP step is picked up on the next loop
+inline WallTime to_wall(MonoTime t) {
+    if (detail::coarse_ns.load(std::memory_order_acquire) == 0) tick();
+    int64_t wall_ns = detail::mono_ns(t) + detail::wall_offset_ns.load(std::memory_order_relaxed);
+    return WallTime(std::chrono::duration_cast<WallClock::duration>(
+        std::chrono::nanoseconds(wall_ns)));
+}
+
+inline WallTime coarse_wall_now() {
+    return to_wall(coarse_now());
+}
+
+inline uint64_t to_unix_millis(WallTime t) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        t.time_since_epoch()).count());
+}
+
+} // namespace timesvc
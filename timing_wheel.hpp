@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace expiry {
+
+using StoreId = uint8_t;
+
+// Hierarchical timing wheel shared by several keyed stores, each with its own
+// TTL. Refreshing a key only updates its deadline; the wheel entry is checked
+// against it when its slot fires and rescheduled if the key was seen again.
+// A key keeps one wheel entry while scheduled: removing it only marks it, and
+// a later touch revives that entry instead of adding another.
+// Each expiry costs amortized O(1) regardless of how many keys are tracked.
+template <typename Key, typename Hash = std::hash<Key>>
+class TimingWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Tick = uint64_t;
+    using ExpireCallback = std::function<void(StoreId, const Key&)>;
+
+private:
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1u << SLOT_BITS;
+    static constexpr Tick SLOT_MASK = SLOTS - 1;
+    static constexpr size_t LEVELS = 4;  // 2^24 ticks, ~194 days at 1 s
+
+    struct Entry {
+        Key key;
+        StoreId store;
+        Tick deadline;
+    };
+
+    struct Scheduled {
+        Tick deadline;
+        bool live;  // false once removed; the entry is dropped when it fires
+    };
+
+    struct Store {
+        std::string name;
+        Tick ttl;
+        uint64_t expired{0};
+        size_t live{0};
+        std::unordered_map<Key, Scheduled, Hash> deadlines;  // one per wheel entry
+    };
+
+    std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> wheel;
+    std::vector<Entry> due;  // deadlines already reached when scheduled
+    std::vector<Store> stores;
+
+    Clock::time_point origin;
+    Clock::duration resolution;
+    Tick current{0};
+
+    Tick to_tick(Clock::time_point t) const {
+        if (t <= origin) return 0;
+        return static_cast<Tick>((t - origin) / resolution);
+    }
+
+    Tick to_ticks(Clock::duration d) const {
+        return std::max<Tick>(1, static_cast<Tick>((d + resolution - Clock::duration(1)) / resolution));
+    }
+
+    void schedule(Entry entry) {
+        if (entry.deadline <= current) {
+            due.push_back(std::move(entry));
+            return;
+        }
+
+        Tick delta = entry.deadline - current;
+        for (size_t level = 0; level < LEVELS; ++level) {
+            if (delta < (Tick(1) << (SLOT_BITS * (level + 1)))) {
+                size_t slot = (entry.deadline >> (SLOT_BITS * level)) & SLOT_MASK;
+                wheel[level][slot].push_back(std::move(entry));
+                return;
+            }
+        }
+
+        // Beyond the wheel span: park in the last top-level slot, it is
+        // re-cascaded with its real deadline when that slot comes round
+        Tick parked = current + (Tick(1) << (SLOT_BITS * LEVELS)) - 1;
+        size_t slot = (parked >> (SLOT_BITS * (LEVELS - 1))) & SLOT_MASK;
+        wheel[LEVELS - 1][slot].push_back(std::move(entry));
+    }
+
+    void fire(Entry& entry, const ExpireCallback& on_expire) {
+        auto& store = stores[entry.store];
+        auto it = store.deadlines.find(entry.key);
+        if (it == store.deadlines.end()) return;
+        if (!it->second.live) {  // removed meanwhile
+            store.deadlines.erase(it);
+            return;
+        }
+
+        if (it->second.deadline > entry.deadline) {
+            entry.deadline = it->second.deadline;  // refreshed since scheduled
+            schedule(std::move(entry));
+            return;
+        }
+
+        store.deadlines.erase(it);
+        store.live--;
+        store.expired++;
+        if (on_expire) on_expire(entry.store, entry.key);
+    }
+
+    void step(const ExpireCallback& on_expire) {
+        current++;
+
+        // Cascade higher levels whose lower bits just wrapped
+        for (size_t level = 1; level < LEVELS; ++level) {
+            if (current & ((Tick(1) << (SLOT_BITS * level)) - 1)) break;
+            size_t slot = (current >> (SLOT_BITS * level)) & SLOT_MASK;
+            std::vector<Entry> cascade;
+            cascade.swap(wheel[level][slot]);
+            for (auto& entry : cascade) {
+                schedule(std::move(entry));
+            }
+        }
+
+        std::vector<Entry> expiring;
+        expiring.swap(wheel[0][current & SLOT_MASK]);
+        for (auto& entry : expiring) {
+            fire(entry, on_expire);
+        }
+        drain_due(on_expire);
+    }
+
+    void drain_due(const ExpireCallback& on_expire) {
+        while (!due.empty()) {
+            std::vector<Entry> ready;
+            ready.swap(due);
+            for (auto& entry : ready) {
+                fire(entry, on_expire);
+            }
+        }
+    }
+
+public:
+    explicit TimingWheel(Clock::duration tick_resolution = std::chrono::seconds(1),
+                         Clock::time_point start = Clock::now())
+        : origin(start), resolution(tick_resolution) {}
+
+    StoreId add_store(const std::string& name, Clock::duration ttl) {
+        stores.push_back(Store{name, to_ticks(ttl), 0, 0, {}});
+        return static_cast<StoreId>(stores.size() - 1);
+    }
+
+    // Applies to live keys too, counted from their last touch. A longer
+    // TTL only moves deadlines, fire() reschedules; a shorter one pulls the
+    // store's entries out of the wheel and schedules them earlier, O(n)
+    void set_ttl(StoreId store, Clock::duration ttl) {
+        auto& s = stores[store];
+        Tick old_ttl = s.ttl;
+        s.ttl = to_ticks(ttl);
+        if (s.ttl == old_ttl) return;
+
+        for (auto& [key, scheduled] : s.deadlines) {
+            Tick touched = scheduled.deadline > old_ttl ? scheduled.deadline - old_ttl : 0;
+            scheduled.deadline = touched + s.ttl;
+        }
+        if (s.ttl > old_ttl) return;
+
+        std::vector<Entry> moved;
+        auto take = [&](std::vector<Entry>& slot) {
+            auto keep = std::partition(slot.begin(), slot.end(),
+                                       [store](const Entry& e) { return e.store != store; });
+            std::move(keep, slot.end(), std::back_inserter(moved));
+            slot.erase(keep, slot.end());
+        };
+        for (auto& level : wheel) {
+            for (auto& slot : level) take(slot);
+        }
+        take(due);
+        for (auto& entry : moved) {
+            entry.deadline = s.deadlines.at(entry.key).deadline;
+            schedule(std::move(entry));
+        }
+    }
+
+    // Inserts or refreshes a key; O(1)
+    void touch(StoreId store, const Key& key, Clock::time_point now) {
+        auto& s = stores[store];
+        Tick deadline = std::max(to_tick(now), current) + s.ttl;
+        auto [it, inserted] = s.deadlines.try_emplace(key, Scheduled{deadline, true});
+        if (inserted) {
+            s.live++;
+            schedule(Entry{key, store, deadline});
+            return;
+        }
+        if (!it->second.live) {
+            it->second.live = true;  // removed but still scheduled: reuse the entry
+            s.live++;
+        }
+        it->second.deadline = deadline;
+    }
+
+    void remove(StoreId store, const Key& key) {
+        auto& s = stores[store];
+        auto it = s.deadlines.find(key);
+        if (it == s.deadlines.end() || !it->second.live) return;
+        it->second.live = false;
+        s.live--;
+    }
+
+    // Fires every key whose deadline has passed
+    void advance(Clock::time_point now, const ExpireCallback& on_expire) {
+        drain_due(on_expire);
+
+        Tick target = to_tick(now);
+        while (current < target) {
+            step(on_expire);
+        }
+    }
+
+    uint64_t expired_count(StoreId store) const { return stores[store].expired; }
+    size_t tracked_count(StoreId store) const { return stores[store].live; }
+    size_t scheduled_count(StoreId store) const { return stores[store].deadlines.size(); }
+    const std::string& store_name(StoreId store) const { return stores[store].name; }
+    size_t store_count() const { return stores.size(); }
+};
+
+} // namespace expiry
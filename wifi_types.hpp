@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "mac_utils.hpp"
+
+namespace wifi {
+
+// 6-byte MAC/BSSID held by value; no allocation, compares as one integer
+struct Bssid {
+    std::array<uint8_t, 6> bytes{};
+
+    Bssid() = default;
+    explicit Bssid(const std::array<uint8_t, 6>& b) : bytes(b) {}
+
+    // Parses "aa:bb:cc:dd:ee:ff" (or '-' separated); false if malformed
+    static bool parse(std::string_view text, Bssid& out) {
+        return mac::parse(text, out.bytes.data());
+    }
+
+    static Bssid from_string(std::string_view text) {
+        Bssid result;
+        parse(text, result);
+        return result;
+    }
+
+    std::string str() const { return mac::to_string(bytes.data()); }
+    void format(char* out) const { mac::format(bytes.data(), out); }
+
+    uint64_t packed() const { return mac::pack(bytes.data()); }
+    uint32_t oui() const { return mac::oui(bytes.data()); }
+
+    bool is_zero() const { return packed() == 0; }
+
+    bool operator==(const Bssid& other) const { return bytes == other.bytes; }
+    bool operator!=(const Bssid& other) const { return bytes != other.bytes; }
+    bool operator<(const Bssid& other) const { return bytes < other.bytes; }
+};
+
+// SSID stored inline: 802.11 caps it at 32 octets
+struct Ssid {
+    static constexpr size_t MAX_LENGTH = 32;
+
+    std::array<char, MAX_LENGTH> data{};
+    uint8_t length{0};
+
+    Ssid() = default;
+    Ssid(std::string_view text) { assign(text); }
+    Ssid(const std::string& text) { assign(text); }
+    Ssid(const char* text) { assign(text); }
+
+    void assign(std::string_view text) {
+        length = static_cast<uint8_t>(std::min(text.size(), MAX_LENGTH));
+        std::memcpy(data.data(), text.data(), length);
+        std::memset(data.data() + length, 0, MAX_LENGTH - length);
+    }
+
+    std::string_view view() const { return std::string_view(data.data(), length); }
+    std::string str() const { return std::string(data.data(), length); }
+    bool empty() const { return length == 0; }
+
+    bool operator==(const Ssid& other) const { return view() == other.view(); }
+    bool operator!=(const Ssid& other) const { return view() != other.view(); }
+    bool operator<(const Ssid& other) const { return view() < other.view(); }
+};
+
+// An AP/station pair; the station is zero for keys that refer to the AP itself
+struct StationKey {
+    Bssid bssid;
+    Bssid station;
+
+    bool operator==(const StationKey& other) const {
+        return bssid == other.bssid && station == other.station;
+    }
+};
+
+// Process-wide string interner for peer and sender names. Ids are dense,
+// start at 1 and stay valid for the lifetime of the process. Names arrive
+// from the network, so the table is capped; once full, new names get
+// NO_PEER and are not tracked.
+using PeerId = uint32_t;
+constexpr PeerId NO_PEER = 0;
+
+class Interner {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string_view, PeerId> ids;
+    std::deque<std::string> names;  // stable storage backing the map keys
+    size_t capacity;
+    uint64_t overflowed{0};
+
+public:
+    explicit Interner(size_t max_names = DEFAULT_CAPACITY) : capacity(max_names) {}
+
+    static Interner& instance() {
+        static Interner interner;
+        return interner;
+    }
+
+    // NO_PEER once the table is full
+    PeerId intern(std::string_view name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        if (names.size() >= capacity) {
+            overflowed++;
+            return NO_PEER;
+        }
+
+        names.emplace_back(name);
+        PeerId id = static_cast<PeerId>(names.size());
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    // Like intern() but never adds the name
+    PeerId find(std::string_view name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(name);
+        return it == ids.end() ? NO_PEER : it->second;
+    }
+
+    std::string lookup(PeerId id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (id == 0 || id > names.size()) return std::string();
+        return names[id - 1];
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return names.size();
+    }
+
+    // Names turned away because the table was full
+    uint64_t overflow_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return overflowed;
+    }
+};
+
+inline PeerId intern(std::string_view name) {
+    return Interner::instance().intern(name);
+}
+
+} // namespace wifi
+
+namespace std {
+
+template <>
+struct hash<wifi::Bssid> {
+    size_t operator()(const wifi::Bssid& b) const {
+        return mac::hash(b.bytes.data());
+    }
+};
+
+template <>
+struct hash<wifi::Ssid> {
+    size_t operator()(const wifi::Ssid& s) const {
+        return std::hash<std::string_view>{}(s.view());
+    }
+};
+
+template <>
+struct hash<wifi::StationKey> {
+    size_t operator()(const wifi::StationKey& k) const {
+        return mac::hash(k.bssid.bytes.data()) * 31 + mac::hash(k.station.bytes.data());
+    }
+};
+
+} // namespace std
@@ -0,0 +1,610 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "atomic_file.hpp"
+#include "reactor.hpp"
+#include "time_service.hpp"
+
+// Write-behind scheduler for everything that goes to the SD card. Writers
+// hand over whole-file replacements or appends tagged with a durability
+// class; only the newest replacement of a file is kept, appends to a file are
+// merged, and whatever is due goes out in one batch, so the card wakes once
+// per batch instead of once per writer. Batches are written from a reactor
+// timer set for the earliest deadline.
+namespace persist {
+
+enum class Durability : uint8_t {
+    CRITICAL,  // written and synced at the loop's next wakeup
+    NORMAL,    // written and synced within normal_interval, or with any earlier batch
+    LAZY       // written within lazy_interval and left to kernel writeback
+};
+
+inline const char* to_string(Durability durability) {
+    switch (durability) {
+        case Durability::CRITICAL: return "critical";
+        case Durability::NORMAL: return "normal";
+        case Durability::LAZY: return "lazy";
+    }
+    return "unknown";
+}
+
+struct SubsystemStats {
+    uint64_t submissions;
+    uint64_t coalesced;        // replaced or merged before reaching the card
+    uint64_t bytes_submitted;
+    uint64_t bytes_written;
+    uint64_t writes;           // files written or sync hooks run
+    uint64_t syncs;            // fsync/fdatasync calls, directory syncs included
+    uint64_t failures;
+};
+
+struct SchedulerStats {
+    uint64_t batches;          // passes that touched the card
+    size_t pending_files;
+    size_t pending_bytes;
+    std::map<std::string, SubsystemStats> subsystems;
+
+    uint64_t bytes_written() const {
+        uint64_t total = 0;
+        for (const auto& [name, account] : subsystems) total += account.bytes_written;
+        return total;
+    }
+};
+
+class WriteScheduler {
+public:
+    struct Config {
+        std::chrono::milliseconds normal_interval{5000};
+        std::chrono::milliseconds lazy_interval{60000};
+        size_t block_size = 4096;               // appends are cut at multiples of this
+        size_t max_pending_bytes = 256 * 1024;  // write everything early past this
+    };
+
+    using Ticket = uint64_t;
+    using Callback = std::function<void(bool ok)>;
+    using SyncHook = std::function<uint64_t()>;  // returns the bytes it made durable
+
+private:
+    using Time = timesvc::MonoTime;
+
+    struct Replacement {
+        std::string subsystem;
+        std::vector<uint8_t> data;
+        Durability durability;
+        Time due;
+        std::vector<Ticket> tickets;  // this submission and the ones it superseded
+        std::vector<Callback> callbacks;
+    };
+
+    struct AppendBuffer {
+        std::string subsystem;
+        std::vector<uint8_t> data;
+        std::vector<std::pair<size_t, Ticket>> marks;  // ticket is done once data[0, end) is out
+        Durability durability;
+        Time due;
+        bool held{false};  // an unaligned tail was already kept back once
+    };
+
+    struct SyncTarget {
+        SyncHook hook;
+        std::vector<Ticket> tickets;
+        Durability durability{Durability::LAZY};
+        Time due{Time::max()};
+    };
+
+    // Work taken out of the queues for one pass; written without the lock
+    struct Batch {
+        struct Append {
+            std::filesystem::path path;
+            AppendBuffer buffer;
+            bool full;     // write the unaligned tail too
+            bool was_due;  // not just riding along with other due work
+            size_t written{0};
+            uint64_t syncs{0};
+            bool ok{false};
+        };
+        struct Sync {
+            std::string subsystem;
+            SyncHook hook;
+            std::vector<Ticket> tickets;
+            uint64_t bytes{0};
+        };
+
+        std::vector<Sync> syncs;
+        std::vector<std::pair<std::filesystem::path, Replacement>> replacements;
+        std::vector<bool> replaced_ok;
+        std::vector<Append> appends;
+
+        bool empty() const { return syncs.empty() && replacements.empty() && appends.empty(); }
+    };
+
+    Config config;
+    std::map<std::filesystem::path, Replacement> replacements;
+    std::map<std::filesystem::path, AppendBuffer> appends;
+    std::map<std::string, SyncTarget> targets;
+    std::set<Ticket> outstanding;
+    std::map<std::string, SubsystemStats> accounts;
+
+    Ticket next_ticket{1};
+    Ticket urgent_through{0};
+    size_t pending_bytes{0};
+    uint64_t batch_count{0};
+    bool running{false};
+    bool writing{false};  // a pass is between collect() and finish()
+
+    runtime::Reactor* reactor;
+    runtime::TimerId pass_timer{0};
+    uint64_t armed{0};                // bumped each time pass_timer is set
+    Time armed_for{Time::max()};      // when pass_timer fires
+
+    mutable std::mutex mutex;
+    std::condition_variable done_cv;  // a pass finished
+
+    Time due_after(Durability durability, Time now) const {
+        switch (durability) {
+            case Durability::CRITICAL: return now;
+            case Durability::NORMAL: return now + config.normal_interval;
+            case Durability::LAZY: return now + config.lazy_interval;
+        }
+        return now;
+    }
+
+    // The enum is ordered strongest first; merged work takes the stronger
+    // class and the earlier deadline
+    void merge_class(Durability& current, Time& due, Durability incoming, Time now) const {
+        current = std::min(current, incoming);
+        due = std::min(due, due_after(incoming, now));
+    }
+
+    // A deadline is not pushed back by timer slack; the reactor still runs
+    // it in the same wakeup as any other timer already due
+    void arm_locked(Time due) {
+        if (pass_timer) reactor->cancel_timer(pass_timer);
+        Time now = timesvc::precise_now();
+        uint64_t generation = ++armed;
+        armed_for = due;
+        pass_timer = reactor->add_timer(due <= now ? runtime::Reactor::Duration(0) : due - now,
+                                        [this, generation] { on_timer(generation); },
+                                        runtime::Reactor::Duration(0));
+    }
+
+    // Brings the next pass forward if the new work cannot wait for it
+    void request_wake(Time due) {
+        if (!running) return;
+        if (pending_bytes >= config.max_pending_bytes) due = Time::min();
+        if (due < armed_for) arm_locked(due);
+    }
+
+    // Runs on the loop: writes whatever is due, then sets the timer for
+    // the next deadline
+    void on_timer(uint64_t generation) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (generation == armed) {
+            pass_timer = 0;
+            armed_for = Time::max();
+        }
+        while (pass(lock)) {}
+        Time next = next_due();
+        if (running && next < armed_for) arm_locked(next);
+    }
+
+    SubsystemStats& account(const std::string& subsystem) {
+        return accounts.try_emplace(subsystem, SubsystemStats{0, 0, 0, 0, 0, 0, 0}).first->second;
+    }
+
+    bool is_outstanding(Ticket ticket) const {
+        return !outstanding.empty() && *outstanding.begin() <= ticket;
+    }
+
+    Time next_due() const {
+        Time next = Time::max();
+        for (const auto& [path, item] : replacements) next = std::min(next, item.due);
+        for (const auto& [path, item] : appends) next = std::min(next, item.due);
+        for (const auto& [name, target] : targets) {
+            if (!target.tickets.empty()) next = std::min(next, target.due);
+        }
+        return next;
+    }
+
+    // Takes everything due now. Once the card has to be woken, NORMAL work
+    // that is not due yet rides along; LAZY work only goes out on its own
+    // deadline so it keeps coalescing.
+    Batch collect(Time now) {
+        bool drain = !running || pending_bytes >= config.max_pending_bytes;
+        auto due = [&](Time deadline, Ticket first) {
+            return drain || deadline <= now || first <= urgent_through;
+        };
+
+        bool any_due = false;
+        for (const auto& [path, item] : replacements) any_due |= due(item.due, item.tickets.front());
+        for (const auto& [path, item] : appends) any_due |= due(item.due, item.marks.front().second);
+        for (const auto& [name, target] : targets) {
+            if (!target.tickets.empty()) any_due |= due(target.due, target.tickets.front());
+        }
+
+        Batch batch;
+        if (!any_due) return batch;
+
+        for (auto& [name, target] : targets) {
+            if (target.tickets.empty()) continue;
+            if (!due(target.due, target.tickets.front()) && target.durability == Durability::LAZY) continue;
+            batch.syncs.push_back({name, target.hook, std::move(target.tickets)});
+            target.tickets.clear();
+            target.due = Time::max();
+        }
+
+        for (auto it = replacements.begin(); it != replacements.end();) {
+            auto& item = it->second;
+            if (!due(item.due, item.tickets.front()) && item.durability == Durability::LAZY) {
+                ++it;
+                continue;
+            }
+            pending_bytes -= item.data.size();
+            batch.replacements.emplace_back(it->first, std::move(item));
+            it = replacements.erase(it);
+        }
+
+        for (auto it = appends.begin(); it != appends.end();) {
+            auto& item = it->second;
+            bool was_due = due(item.due, item.marks.front().second);
+            if (!was_due && item.durability == Durability::LAZY) {
+                ++it;
+                continue;
+            }
+            bool full = drain || item.held || item.marks.front().second <= urgent_through;
+            pending_bytes -= item.data.size();
+            batch.appends.push_back({it->first, std::move(item), full, was_due});
+            it = appends.erase(it);
+        }
+        return batch;
+    }
+
+    // Appends the front of the buffer. Unless full is set, only the part
+    // that ends on a block boundary of the file is written, so a partially
+    // filled block is written once instead of being rewritten per append.
+    bool write_append(const std::filesystem::path& path, const AppendBuffer& buffer,
+                      bool full, size_t& written, uint64_t& syncs) const {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+
+        size_t length = buffer.data.size();
+        struct stat st;
+        if (!full && ::fstat(fd, &st) == 0 && config.block_size > 0) {
+            size_t size = static_cast<size_t>(st.st_size);
+            size_t end = (size + length) / config.block_size * config.block_size;
+            length = end > size ? end - size : 0;
+        }
+
+        bool ok = length == 0 || detail::write_all(fd, buffer.data.data(), length);
+        if (ok && length > 0 && buffer.durability != Durability::LAZY) {
+            ok = ::fdatasync(fd) == 0;
+            syncs++;
+        }
+        ok = (::close(fd) == 0) && ok;
+        written = ok ? length : 0;
+        return ok;
+    }
+
+    // Runs without the lock; sync hooks go first so data they cover is
+    // durable before any state file that refers to it
+    void execute(Batch& batch) {
+        for (auto& sync : batch.syncs) {
+            sync.bytes = sync.hook();
+        }
+        for (const auto& [path, item] : batch.replacements) {
+            batch.replaced_ok.push_back(write_file_atomic(
+                path, item.data.data(), item.data.size(), item.durability != Durability::LAZY));
+        }
+        for (auto& append : batch.appends) {
+            append.ok = write_append(append.path, append.buffer, append.full,
+                                     append.written, append.syncs);
+        }
+        for (size_t i = 0; i < batch.replacements.size(); ++i) {
+            for (auto& done : batch.replacements[i].second.callbacks) {
+                if (done) done(batch.replaced_ok[i]);
+            }
+        }
+    }
+
+    void finish(Batch& batch, Time now) {
+        for (const auto& sync : batch.syncs) {
+            auto& stats = account(sync.subsystem);
+            stats.writes++;
+            if (sync.bytes > 0) stats.syncs++;
+            stats.bytes_written += sync.bytes;
+            for (Ticket ticket : sync.tickets) outstanding.erase(ticket);
+        }
+
+        for (size_t i = 0; i < batch.replacements.size(); ++i) {
+            const auto& item = batch.replacements[i].second;
+            auto& stats = account(item.subsystem);
+            if (batch.replaced_ok[i]) {
+                stats.writes++;
+                stats.bytes_written += item.data.size();
+                if (item.durability != Durability::LAZY) stats.syncs += 2;  // file and directory
+            } else {
+                stats.failures++;
+            }
+            for (Ticket ticket : item.tickets) outstanding.erase(ticket);
+        }
+
+        for (auto& append : batch.appends) {
+            auto& item = append.buffer;
+            auto& stats = account(item.subsystem);
+            stats.syncs += append.syncs;
+            if (!append.ok) {
+                stats.failures++;  // dropped: appends are not retried
+                append.written = item.data.size();
+            } else if (append.written > 0) {
+                stats.writes++;
+                stats.bytes_written += append.written;
+            }
+
+            size_t done = 0;
+            while (done < item.marks.size() && item.marks[done].first <= append.written) {
+                outstanding.erase(item.marks[done].second);
+                done++;
+            }
+            if (append.written == item.data.size()) continue;
+
+            // Put the tail back in front of anything appended meanwhile
+            AppendBuffer tail;
+            tail.subsystem = item.subsystem;
+            tail.data.assign(item.data.begin() + append.written, item.data.end());
+            for (size_t i = done; i < item.marks.size(); ++i) {
+                tail.marks.emplace_back(item.marks[i].first - append.written, item.marks[i].second);
+            }
+            tail.durability = item.durability;
+            tail.due = append.was_due ? due_after(item.durability, now) : item.due;
+            tail.held = item.held || append.was_due;
+            pending_bytes += tail.data.size();
+
+            auto it = appends.find(append.path);
+            if (it != appends.end()) {
+                auto& newer = it->second;
+                for (auto& mark : newer.marks) mark.first += tail.data.size();
+                tail.data.insert(tail.data.end(), newer.data.begin(), newer.data.end());
+                tail.marks.insert(tail.marks.end(), newer.marks.begin(), newer.marks.end());
+                merge_class(tail.durability, tail.due, newer.durability, now);
+                tail.due = std::min(tail.due, newer.due);
+                it->second = std::move(tail);
+            } else {
+                appends.emplace(append.path, std::move(tail));
+            }
+        }
+
+        batch_count++;
+    }
+
+    // One collect/execute/finish round; returns false if nothing was due
+    bool pass(std::unique_lock<std::mutex>& lock) {
+        done_cv.wait(lock, [this] { return !writing; });
+        Time now = timesvc::precise_now();
+        Batch batch = collect(now);
+        if (batch.empty()) return false;
+
+        writing = true;
+        lock.unlock();
+        execute(batch);
+        lock.lock();
+        finish(batch, now);
+        writing = false;
+        done_cv.notify_all();
+        return true;
+    }
+
+    // Stopped, or on the loop thread itself, waiters write on their own
+    // thread; collect() drains everything once stopped
+    void drain_inline(std::unique_lock<std::mutex>& lock, Ticket ticket) {
+        while (is_outstanding(ticket) && pass(lock)) {}
+    }
+
+public:
+    // Writes from events, the process loop by default
+    explicit WriteScheduler(runtime::Reactor* events = nullptr)
+        : reactor(events ? events : &runtime::Reactor::shared()) {}
+    ~WriteScheduler() { stop(); }
+    WriteScheduler(const WriteScheduler&) = delete;
+    WriteScheduler& operator=(const WriteScheduler&) = delete;
+
+    void start(const Config& cfg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = cfg;
+        if (running) return;
+        running = true;
+        Time next = next_due();
+        if (next != Time::max()) arm_locked(next);
+    }
+
+    void start() { start(Config()); }
+
+    // Takes effect for work submitted from now on; queued deadlines stand
+    void configure(const Config& cfg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        config = cfg;
+        request_wake(Time::min());
+    }
+
+    // Takes the timer off the loop, with no pass left running there, and
+    // writes everything still queued on the calling thread
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        done_cv.notify_all();
+        reactor->call([this] {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pass_timer) reactor->cancel_timer(pass_timer);
+            pass_timer = 0;
+            armed_for = Time::max();
+        });
+        flush();
+    }
+
+    // Queues path to be replaced by data. A newer replacement of the same
+    // path supersedes this one; done then reports the newer write's result.
+    // Callbacks run on the loop thread and must not call back in here.
+    Ticket replace(const std::string& subsystem, const std::filesystem::path& path,
+                   std::vector<uint8_t> data, Durability durability, Callback done = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Time now = timesvc::precise_now();
+        Ticket ticket = next_ticket++;
+        auto& stats = account(subsystem);
+        stats.submissions++;
+        stats.bytes_submitted += data.size();
+        outstanding.insert(ticket);
+        pending_bytes += data.size();
+
+        auto it = replacements.find(path);
+        if (it == replacements.end()) {
+            Replacement item{subsystem, std::move(data), durability, due_after(durability, now), {ticket}, {}};
+            if (done) item.callbacks.push_back(std::move(done));
+            replacements.emplace(path, std::move(item));
+        } else {
+            auto& item = it->second;
+            stats.coalesced++;
+            pending_bytes -= item.data.size();
+            item.data = std::move(data);
+            item.tickets.push_back(ticket);
+            if (done) item.callbacks.push_back(std::move(done));
+            merge_class(item.durability, item.due, durability, now);
+        }
+        request_wake(due_after(durability, now));
+        return ticket;
+    }
+
+    // Queues data to be appended to path (created if missing)
+    Ticket append(const std::string& subsystem, const std::filesystem::path& path,
+                  const void* data, size_t length, Durability durability) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Time now = timesvc::precise_now();
+        Ticket ticket = next_ticket++;
+        auto& stats = account(subsystem);
+        stats.submissions++;
+        stats.bytes_submitted += length;
+        outstanding.insert(ticket);
+        pending_bytes += length;
+
+        auto [it, inserted] = appends.try_emplace(path);
+        auto& item = it->second;
+        if (inserted) {
+            item.subsystem = subsystem;
+            item.durability = durability;
+            item.due = due_after(durability, now);
+        } else {
+            stats.coalesced++;
+            merge_class(item.durability, item.due, durability, now);
+        }
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        item.data.insert(item.data.end(), bytes, bytes + length);
+        item.marks.emplace_back(item.data.size(), ticket);
+        request_wake(due_after(durability, now));
+        return ticket;
+    }
+
+    // Registers a subsystem that writes through its own descriptors but
+    // leaves syncing to the scheduler. The hook runs on the loop thread
+    // after mark() and returns how many bytes it made durable.
+    void attach(const std::string& subsystem, SyncHook hook) {
+        std::lock_guard<std::mutex> lock(mutex);
+        targets[subsystem].hook = std::move(hook);
+        account(subsystem);
+    }
+
+    // Waits out a pass that may be running the hook, so whatever it
+    // references can be destroyed afterwards
+    void detach(const std::string& subsystem) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return !writing; });
+        auto it = targets.find(subsystem);
+        if (it == targets.end()) return;
+        for (Ticket ticket : it->second.tickets) outstanding.erase(ticket);
+        targets.erase(it);
+        done_cv.notify_all();
+    }
+
+    // Notes that an attached subsystem has data waiting for a sync;
+    // returns 0 if the subsystem is not attached
+    Ticket mark(const std::string& subsystem, Durability durability) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = targets.find(subsystem);
+        if (it == targets.end()) return 0;
+
+        auto& target = it->second;
+        Time now = timesvc::precise_now();
+        Ticket ticket = next_ticket++;
+        if (target.tickets.empty()) {
+            target.durability = durability;
+            target.due = due_after(durability, now);
+        } else {
+            merge_class(target.durability, target.due, durability, now);
+        }
+        target.tickets.push_back(ticket);
+        outstanding.insert(ticket);
+        account(subsystem).submissions++;
+        request_wake(due_after(durability, now));
+        return ticket;
+    }
+
+    // Blocks until the submission behind ticket, and everything queued
+    // before it, is written (or has failed)
+    void wait(Ticket ticket) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (ticket == 0 || !is_outstanding(ticket)) return;
+        urgent_through = std::max(urgent_through, ticket);
+        if (running && !reactor->in_loop_thread()) {
+            request_wake(Time::min());
+            done_cv.wait(lock, [this, ticket] { return !is_outstanding(ticket) || !running; });
+        }
+        drain_inline(lock, ticket);
+    }
+
+    // Writes everything queued so far, e.g. before shutdown
+    void flush() {
+        Ticket last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = next_ticket - 1;
+        }
+        wait(last);
+    }
+
+    bool has_pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !outstanding.empty();
+    }
+
+    SchedulerStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return SchedulerStats{batch_count, replacements.size() + appends.size(),
+                              pending_bytes, accounts};
+    }
+};
+
+// Replaces path with text through writes when given, else directly
+inline bool save_file(WriteScheduler* writes, const std::string& subsystem,
+                      const std::filesystem::path& path, const std::string& text,
+                      Durability durability) {
+    if (writes) {
+        writes->replace(subsystem, path, std::vector<uint8_t>(text.begin(), text.end()), durability);
+        return true;
+    }
+    return write_file_atomic(path, text.data(), text.size(), durability != Durability::LAZY);
+}
+
+} // namespace persist